@@ -0,0 +1,90 @@
+// File:	Arena.cpp
+// Description:
+//		A resettable monotonic arena, and an allocator that lets the
+//		standard containers take their memory from one.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "Arena.hpp"
+
+#include <cstdlib>
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CArena::CArena() {
+
+	m_current = 0;
+	m_offset = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CArena::~CArena() {
+
+	for( size_t block = 0; block < m_blocks.size(); block++ ) {
+		free( m_blocks[block].data );
+	}
+
+} // (destructor)
+
+//
+// Name:	Allocate
+//
+void *CArena::Allocate( size_t size, size_t alignment ) {
+
+	// Find room in the current block, or the next one big enough:
+	while( m_current < m_blocks.size() ) {
+		const SBlock &block = m_blocks[m_current];
+		const size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+
+		if( start + size <= block.size ) {
+			m_offset = start + size;
+			return block.data + start;
+		}
+		m_current++;
+		m_offset = 0;
+	}
+
+	// Take a new block from the heap (malloc aligns for any type):
+	SBlock block;
+	block.size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+	block.data = (char *)malloc( block.size );
+	if( !block.data ) {
+		throw bad_alloc();
+	}
+	m_blocks.push_back( block );
+
+	m_current = m_blocks.size() - 1;
+	m_offset = size;
+	return block.data;
+
+} // Allocate
+
+//
+// Name:	Reset
+//
+void CArena::Reset() {
+
+	m_current = 0;
+	m_offset = 0;
+
+} // Reset
+
+//
+// Name:	GetReserved
+//
+size_t CArena::GetReserved() const {
+	size_t reserved = 0;
+
+	for( size_t block = 0; block < m_blocks.size(); block++ ) {
+		reserved += m_blocks[block].size;
+	}
+	return reserved;
+
+} // GetReserved
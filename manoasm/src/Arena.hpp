@@ -0,0 +1,153 @@
+// File:	Arena.hpp
+// Description:
+//		A resettable monotonic arena, and an allocator that lets the
+//		standard containers take their memory from one.
+// Usage:
+//		1. create one instance of CArena
+//		2. construct containers with a CArenaAllocator for it, e.g.
+//		   std::map<K, V, std::less<K>,
+//			CArenaAllocator<std::pair<const K, V> > >
+//		3. once the containers are empty (or destroyed), call Reset
+//		   and fill them again.
+//
+// Notes:
+//
+//		Memory comes from blocks of at least ARENA_BLOCK_SIZE bytes
+//		and is only given back by Reset, which keeps the blocks for
+//		reuse: once a workload has run, running it again allocates
+//		nothing from the heap.  Freeing through the allocator does
+//		nothing, so a container that churns should not live in an
+//		arena for long between resets.
+//
+//		An arena is not thread-safe.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Smallest block the arena takes from the heap:
+#define ARENA_BLOCK_SIZE	16384
+
+class CArena {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CArena object.
+	//
+	CArena();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Frees every block.
+	//
+	~CArena();
+
+public:	// Allocation
+
+	//
+	// Name:	Allocate
+	//
+	// Description:	Takes memory from the arena.
+	// Arguments:	The number of bytes, and their alignment (a power
+	//		of 2)
+	// Returns:	The memory.
+	// Exceptions:	Throws std::bad_alloc if a new block cannot be had.
+	//
+	void *Allocate( size_t size, size_t alignment );
+
+	//
+	// Name:	Reset
+	//
+	// Description:	Makes all of the arena's memory free again, keeping
+	//		its blocks.  Nothing allocated from it may be used
+	//		afterwards.
+	//
+	void Reset();
+
+public:	// Accessors
+
+	//
+	// Name:	GetReserved
+	//
+	// Returns:	The bytes held in blocks.
+	//
+	size_t GetReserved() const;
+
+protected: // Types
+
+	// A block of memory:
+	struct SBlock {
+		char		*data;		// Its memory
+		size_t		size;		// Its size in bytes
+	};
+
+protected: // Attributes
+
+	std::vector<SBlock>	m_blocks;	// Blocks, in the order used
+
+	size_t			m_current;	// Block being allocated from
+
+	size_t			m_offset;	// First free byte in it
+
+private: // Not copyable
+
+	CArena( const CArena & );
+	CArena &operator=( const CArena & );
+};
+
+// A standard allocator that takes its memory from a CArena:
+template <class T>
+class CArenaAllocator {
+
+public:
+	typedef T value_type;
+
+	template <class U>
+	struct rebind {
+		typedef CArenaAllocator<U> other;
+	};
+
+	CArenaAllocator( CArena *arena ) : m_arena( arena ) {
+	}
+
+	template <class U>
+	CArenaAllocator( const CArenaAllocator<U> &other )
+		: m_arena( other.GetArena() ) {
+	}
+
+	T *allocate( size_t count ) {
+		return (T *)m_arena->Allocate( count * sizeof( T ),
+			alignof( T ) );
+	}
+
+	void deallocate( T *, size_t ) {
+		// Memory only comes back with CArena::Reset
+	}
+
+	CArena *GetArena() const {
+		return m_arena;
+	}
+
+protected:
+	CArena		*m_arena;	// Where memory comes from
+};
+
+template <class T, class U>
+bool operator==( const CArenaAllocator<T> &a, const CArenaAllocator<U> &b ) {
+	return a.GetArena() == b.GetArena();
+}
+
+template <class T, class U>
+bool operator!=( const CArenaAllocator<T> &a, const CArenaAllocator<U> &b ) {
+	return a.GetArena() != b.GetArena();
+}
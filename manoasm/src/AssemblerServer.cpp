@@ -0,0 +1,573 @@
+// File:	AssemblerServer.cpp
+// Description:
+//		A long-lived assembler that takes requests over a local
+//		(Unix domain) socket, so callers that assemble many small
+//		sources do not pay for a process each time.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "AssemblerServer.hpp"
+#include "ErrorException.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <afunix.h>
+#include <io.h>
+#ifdef _MSC_VER
+#pragma comment( lib, "ws2_32.lib" )
+#endif
+#define INVALID_SERVER_SOCKET	INVALID_SOCKET
+#define SHUTDOWN_RECEIVE	SD_RECEIVE
+#define unlink			_unlink
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define INVALID_SERVER_SOCKET	(-1)
+#define SHUTDOWN_RECEIVE	SHUT_RD
+#endif
+
+// A client that goes away must not kill the server with SIGPIPE:
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS		MSG_NOSIGNAL
+#else
+#define SEND_FLAGS		0
+#endif
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CAssemblerServer::CAssemblerServer() {
+
+	m_listener = INVALID_SERVER_SOCKET;
+	m_stopping = false;
+	m_next_latency = 0;
+	m_requests = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CAssemblerServer::~CAssemblerServer() {
+
+	for( int format = 0; format < 3; format++ ) {
+		for( size_t i = 0; i < m_pool[format].size(); i++ ) {
+			delete m_pool[format][i];
+		}
+	}
+
+} // (destructor)
+
+//
+// Name:	Run
+//
+void CAssemblerServer::Run( const char *path, unsigned workers,
+	ostream &status_stream )
+{
+
+#ifdef _WIN32
+	WSADATA wsa_data;
+	if( WSAStartup( MAKEWORD( 2, 2 ), &wsa_data ) != 0 ) {
+		throw CErrorException( path, 0, "A6001",
+			"Could not set up the server socket",
+			CErrorException::FATAL );
+	}
+#endif
+
+	sockaddr_un address;
+	memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	if( strlen( path ) >= sizeof( address.sun_path ) ) {
+		throw CErrorException( path, 0, "A6001",
+			"Could not set up the server socket",
+			CErrorException::FATAL );
+	}
+	strcpy( address.sun_path, path );
+
+	// Replace the socket of a server that did not clean up:
+	unlink( path );
+
+	m_listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( m_listener == INVALID_SERVER_SOCKET
+		|| bind( m_listener, (sockaddr *)&address,
+			sizeof( address ) ) != 0
+		|| listen( m_listener, SOMAXCONN ) != 0 )
+	{
+		if( m_listener != INVALID_SERVER_SOCKET ) {
+			CloseSocket( m_listener );
+			m_listener = INVALID_SERVER_SOCKET;
+		}
+		throw CErrorException( path, 0, "A6001",
+			"Could not set up the server socket",
+			CErrorException::FATAL );
+	}
+	{
+		lock_guard<mutex> lock( m_mutex );
+		m_path = path;
+		m_stopping = false;
+	}
+
+	if( workers == 0 ) {
+		workers = thread::hardware_concurrency();
+		if( workers == 0 ) {
+			workers = 1;
+		}
+	}
+	vector<thread> threads;
+	for( unsigned worker = 0; worker < workers; worker++ ) {
+		threads.push_back( thread( &CAssemblerServer::Work, this ) );
+	}
+
+	status_stream << "Serving on " << path << " with " << workers
+		<< " worker(s)..." << endl;
+
+	// Hand each connection to a worker:
+	while( !m_stopping ) {
+		const server_socket connection = accept( m_listener, 0, 0 );
+		if( connection == INVALID_SERVER_SOCKET ) {
+			continue;
+		}
+		if( m_stopping ) {
+			CloseSocket( connection );
+			break;
+		}
+
+		lock_guard<mutex> lock( m_mutex );
+		m_queue.push_back( connection );
+		m_ready.notify_one();
+	}
+
+	// Let the workers finish what they are assembling:
+	{
+		lock_guard<mutex> lock( m_mutex );
+		m_ready.notify_all();
+	}
+	for( size_t worker = 0; worker < threads.size(); worker++ ) {
+		threads[worker].join();
+	}
+
+	while( !m_queue.empty() ) {
+		CloseSocket( m_queue.front() );
+		m_queue.pop_front();
+	}
+	CloseSocket( m_listener );
+	m_listener = INVALID_SERVER_SOCKET;
+	unlink( path );
+	{
+		lock_guard<mutex> lock( m_mutex );
+		m_path.clear();
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+} // Run
+
+//
+// Name:	Stop
+//
+void CAssemblerServer::Stop() {
+
+	lock_guard<mutex> lock( m_mutex );
+	if( m_stopping || m_path.empty() ) {
+		return;
+	}
+	m_stopping = true;
+
+	// Clients waiting to send another request are not kept waiting:
+	for( size_t i = 0; i < m_active.size(); i++ ) {
+		shutdown( m_active[i], SHUTDOWN_RECEIVE );
+	}
+	m_ready.notify_all();
+
+	// Wake Run from accept with a connection of our own:
+	sockaddr_un address;
+	memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	strcpy( address.sun_path, m_path.c_str() );
+
+	const server_socket wake = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( wake != INVALID_SERVER_SOCKET ) {
+		connect( wake, (sockaddr *)&address, sizeof( address ) );
+		CloseSocket( wake );
+	}
+
+} // Stop
+
+//
+// Name:	GetRequestCount
+//
+unsigned long long CAssemblerServer::GetRequestCount() {
+
+	lock_guard<mutex> lock( m_latency_mutex );
+	return m_requests;
+
+} // GetRequestCount
+
+//
+// Name:	GetPercentile
+//
+unsigned long long CAssemblerServer::GetPercentile( double percentile ) {
+	vector<unsigned long long> latencies;
+
+	{
+		lock_guard<mutex> lock( m_latency_mutex );
+		latencies = m_latencies;
+	}
+	if( latencies.empty() ) {
+		return 0;
+	}
+
+	// The nearest rank:
+	size_t rank = (size_t)(percentile / 100.0 * latencies.size() + 0.999999);
+	if( rank < 1 ) {
+		rank = 1;
+	}
+	if( rank > latencies.size() ) {
+		rank = latencies.size();
+	}
+	nth_element( latencies.begin(), latencies.begin() + (rank - 1),
+		latencies.end() );
+	return latencies[rank - 1];
+
+} // GetPercentile
+
+//
+// Name:	WriteLatencyReport
+//
+void CAssemblerServer::WriteLatencyReport( ostream &out ) {
+
+	out << "Requests:\t" << GetRequestCount() << endl
+		<< "p50:\t\t" << GetPercentile( 50 ) << " us" << endl
+		<< "p99:\t\t" << GetPercentile( 99 ) << " us" << endl
+		<< "Largest:\t" << GetPercentile( 100 ) << " us" << endl;
+
+} // WriteLatencyReport
+
+//
+// Name:	Work
+//
+void CAssemblerServer::Work() {
+	SConnection connection;
+	SWorkspace workspace;
+
+	for(;;) {
+		{
+			unique_lock<mutex> lock( m_mutex );
+			while( m_queue.empty() && !m_stopping ) {
+				m_ready.wait( lock );
+			}
+			if( m_stopping ) {
+				return;
+			}
+			connection.socket = m_queue.front();
+			m_queue.pop_front();
+			m_active.push_back( connection.socket );
+		}
+
+		connection.start = connection.end = 0;
+		Serve( connection, workspace );
+
+		{
+			lock_guard<mutex> lock( m_mutex );
+			m_active.erase( find( m_active.begin(), m_active.end(),
+				connection.socket ) );
+		}
+		CloseSocket( connection.socket );
+	}
+
+} // Work
+
+//
+// Name:	Serve
+//
+void CAssemblerServer::Serve( SConnection &connection, SWorkspace &workspace )
+{
+	char command[16], format[4], flags[8], name[256];
+	unsigned long bytes;
+
+	while( !m_stopping && ReadLine( connection, workspace.header ) ) {
+		const chrono::steady_clock::time_point start =
+			chrono::steady_clock::now();
+
+		if( workspace.header == "QUIT" ) {
+			Stop();
+			return;
+		}
+
+		if( workspace.header == "STATS" ) {
+			ostringstream report;
+			WriteLatencyReport( report );
+			const string text = report.str();
+
+			char count[32];
+			sprintf( count, "%lu\n", (unsigned long)text.size() );
+			workspace.response.assign( count );
+			workspace.response += text;
+		}
+		else {
+			const int fields = sscanf( workspace.header.c_str(),
+				"%15s %3s %7s %lu %255s", command, format, flags,
+				&bytes, name );
+
+			CManoAssembler::format chosen = CManoAssembler::normal;
+			bool understood = fields >= 4
+				&& strcmp( command, "ASSEMBLE" ) == 0
+				&& strlen( format ) == 1 && bytes <= SERVER_MAX_SOURCE;
+			if( understood ) {
+				switch( format[0] ) {
+				case 'n':
+					break;
+				case 'v':
+					chosen = CManoAssembler::verilog;
+					break;
+				case 'c':
+					chosen = CManoAssembler::coe;
+					break;
+				default:
+					understood = false;
+					break;
+				}
+			}
+
+			// Without a length the rest of the connection cannot be
+			// followed:
+			if( !understood ) {
+				ostringstream message;
+				CErrorException( "", 0, "A6002",
+					"Malformed server request",
+					CErrorException::ERROR ).Display( message );
+
+				char count[64];
+				sprintf( count, "-1 0 %lu\n",
+					(unsigned long)message.str().size() );
+				workspace.response.assign( count );
+				workspace.response += message.str();
+				Send( connection.socket, workspace.response );
+				return;
+			}
+
+			if( !ReadBytes( connection, workspace.source, bytes ) ) {
+				return;
+			}
+			workspace.name.assign( fields >= 5 ? name : "request" );
+
+			Assemble( chosen, flags, workspace );
+		}
+
+		if( !Send( connection.socket, workspace.response ) ) {
+			return;
+		}
+
+		RecordLatency( (unsigned long long)
+			chrono::duration_cast<chrono::microseconds>(
+				chrono::steady_clock::now() - start ).count() );
+	}
+
+} // Serve
+
+//
+// Name:	Assemble
+//
+void CAssemblerServer::Assemble( CManoAssembler::format format,
+	const char *flags, SWorkspace &workspace )
+{
+	ostringstream diagnostics;
+	ostream discard( 0 );
+	int errors;
+
+	CManoAssembler *assembler = Acquire( format );
+	assembler->Reset();
+	assembler->SetOptimize( strchr( flags, 'O' ) != 0 );
+	assembler->SetSinglePass( strchr( flags, 's' ) != 0 );
+	assembler->SetThreads( 1 );
+	workspace.output.Rewind();
+
+	try {
+		assembler->AssembleFromText( workspace.name.c_str(),
+			workspace.source, workspace.output, discard, diagnostics );
+		errors = assembler->GetErrorCount();
+	}
+	catch( CErrorException e ) {
+		e.Display( diagnostics );
+		errors = -1;
+	}
+	Release( assembler, format );
+
+	// The image is the file manoasm would write:
+	workspace.image.clear();
+	for( size_t line = 0; line < workspace.output.size(); line++ ) {
+		workspace.image += workspace.output[line];
+		workspace.image += '\n';
+	}
+
+	const string text = diagnostics.str();
+	char header[64];
+	sprintf( header, "%d %lu %lu\n", errors,
+		(unsigned long)workspace.image.size(), (unsigned long)text.size() );
+	workspace.response.assign( header );
+	workspace.response += workspace.image;
+	workspace.response += text;
+
+} // Assemble
+
+//
+// Name:	Acquire
+//
+CManoAssembler *CAssemblerServer::Acquire( CManoAssembler::format format ) {
+
+	{
+		lock_guard<mutex> lock( m_pool_mutex );
+		if( !m_pool[format].empty() ) {
+			CManoAssembler *assembler = m_pool[format].back();
+			m_pool[format].pop_back();
+			return assembler;
+		}
+	}
+	return new CManoAssembler( format );
+
+} // Acquire
+
+//
+// Name:	Release
+//
+void CAssemblerServer::Release( CManoAssembler *assembler,
+	CManoAssembler::format format )
+{
+
+	lock_guard<mutex> lock( m_pool_mutex );
+	m_pool[format].push_back( assembler );
+
+} // Release
+
+//
+// Name:	RecordLatency
+//
+void CAssemblerServer::RecordLatency( unsigned long long microseconds ) {
+
+	lock_guard<mutex> lock( m_latency_mutex );
+	m_requests++;
+	if( m_latencies.size() < SERVER_LATENCY_WINDOW ) {
+		m_latencies.push_back( microseconds );
+		return;
+	}
+	m_latencies[m_next_latency] = microseconds;
+	m_next_latency = (m_next_latency + 1) % SERVER_LATENCY_WINDOW;
+
+} // RecordLatency
+
+//
+// Name:	ReadLine
+//
+bool CAssemblerServer::ReadLine( SConnection &connection, string &line ) {
+
+	line.clear();
+	for(;;) {
+		if( connection.start == connection.end && !Receive( connection ) ) {
+			return false;
+		}
+
+		const char *first = connection.buffer + connection.start;
+		const char *last = connection.buffer + connection.end;
+		const char *newline = (const char *)memchr( first, '\n',
+			last - first );
+		if( newline ) {
+			line.append( first, newline - first );
+			connection.start += (newline - first) + 1;
+
+			// Accept CR LF line ends:
+			if( !line.empty() && line[line.size() - 1] == '\r' ) {
+				line.erase( line.size() - 1 );
+			}
+			return true;
+		}
+
+		line.append( first, last - first );
+		connection.start = connection.end;
+		if( line.size() > sizeof( connection.buffer ) ) {
+			return false;
+		}
+	}
+
+} // ReadLine
+
+//
+// Name:	ReadBytes
+//
+bool CAssemblerServer::ReadBytes( SConnection &connection, string &bytes,
+	size_t count )
+{
+
+	bytes.clear();
+	while( bytes.size() < count ) {
+		if( connection.start == connection.end && !Receive( connection ) ) {
+			return false;
+		}
+
+		size_t available = connection.end - connection.start;
+		if( available > count - bytes.size() ) {
+			available = count - bytes.size();
+		}
+		bytes.append( connection.buffer + connection.start, available );
+		connection.start += available;
+	}
+	return true;
+
+} // ReadBytes
+
+//
+// Name:	Receive
+//
+bool CAssemblerServer::Receive( SConnection &connection ) {
+
+	const int received = (int)recv( connection.socket, connection.buffer,
+		(int)sizeof( connection.buffer ), 0 );
+	if( received <= 0 ) {
+		return false;
+	}
+	connection.start = 0;
+	connection.end = (size_t)received;
+	return true;
+
+} // Receive
+
+//
+// Name:	Send
+//
+bool CAssemblerServer::Send( server_socket socket, const string &bytes ) {
+	size_t sent = 0;
+
+	while( sent < bytes.size() ) {
+		const int count = (int)send( socket, bytes.data() + sent,
+			(int)(bytes.size() - sent), SEND_FLAGS );
+		if( count <= 0 ) {
+			return false;
+		}
+		sent += (size_t)count;
+	}
+	return true;
+
+} // Send
+
+//
+// Name:	CloseSocket
+//
+void CAssemblerServer::CloseSocket( server_socket socket ) {
+
+#ifdef _WIN32
+	closesocket( socket );
+#else
+	close( socket );
+#endif
+
+} // CloseSocket
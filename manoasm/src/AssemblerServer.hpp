@@ -0,0 +1,312 @@
+// File:	AssemblerServer.hpp
+// Description:
+//		A long-lived assembler that takes requests over a local
+//		(Unix domain) socket, so callers that assemble many small
+//		sources do not pay for a process each time.
+// Usage:
+//		1. create one instance of this class
+//		2. call Run with the socket path; it returns once a client
+//		   sends QUIT (or another thread calls Stop)
+//		3. call WriteLatencyReport for the request latencies.
+//
+// Notes:
+//
+//		A client may send any number of requests on a connection,
+//		each answered before the next is read.  A request is one
+//		header line, in one of these forms:
+//
+//		  ASSEMBLE <format> <flags> <bytes> [<name>]
+//		  STATS
+//		  QUIT
+//
+//		ASSEMBLE is followed by <bytes> bytes of source.  <format>
+//		is n, v or c as manoasm's -n, -v and -c; <flags> holds O to
+//		optimize and s to assemble in one pass, or is "-".  <name> is
+//		what error messages name the source (default "request").
+//		The answer is the line
+//
+//		  <errors> <image bytes> <diagnostic bytes>
+//
+//		followed by the image (the output file manoasm would write)
+//		and the error and warning messages.  <errors> is -1 if the
+//		assembly ended with a fatal error or the request was not
+//		understood; a request that cannot be read to its end also
+//		closes the connection.  STATS is answered with a line giving
+//		a byte count, then that many bytes of WriteLatencyReport.
+//		QUIT closes the connection and stops the server; requests
+//		being assembled on other connections are answered first.
+//
+//		Connections are served by a fixed set of worker threads.
+//		Each request borrows an assembler for its format from a pool
+//		and gives it back afterwards, so an assembler is only built
+//		the first time the server needs one more of that format, and
+//		a warm one reassembles without taking from the heap (see
+//		CManoAssembler).  Each assembly uses one thread.
+//
+//		The latency of a request runs from reading its header to
+//		sending its answer; the last SERVER_LATENCY_WINDOW are kept.
+//
+//		Windows needs version 10 (1803) or later for AF_UNIX.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoAssembler.hpp"
+#include "StringList.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET server_socket;
+#else
+typedef int server_socket;
+#endif
+
+// Largest source an ASSEMBLE request may send:
+#define SERVER_MAX_SOURCE	(16 * 1024 * 1024)
+
+// Request latencies kept for the report:
+#define SERVER_LATENCY_WINDOW	65536
+
+class CAssemblerServer {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CAssemblerServer object that is not
+	//		listening.
+	//
+	CAssemblerServer();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys the pooled assemblers.
+	//
+	~CAssemblerServer();
+
+public:	// Serving
+
+	//
+	// Name:	Run
+	//
+	// Description:	Listens on a socket and serves requests until Stop.
+	//		A file left at the path by an earlier server is
+	//		replaced, and the path is removed again on return.
+	// Arguments:	The socket path, the number of worker threads (0
+	//		for one per hardware thread), and the stream to
+	//		report the server's progress to
+	// Exceptions:	Throws a CErrorException (A6001) if the socket could
+	//		not be set up.
+	//
+	void Run( const char *path, unsigned workers,
+		std::ostream &status_stream );
+
+	//
+	// Name:	Stop
+	//
+	// Description:	Makes Run return once the requests being assembled
+	//		are answered.  May be called from any thread.
+	//
+	void Stop();
+
+public:	// Statistics
+
+	//
+	// Name:	GetRequestCount
+	//
+	// Returns:	The number of requests answered.
+	//
+	unsigned long long GetRequestCount();
+
+	//
+	// Name:	GetPercentile
+	//
+	// Description:	Gives a percentile of the kept request latencies.
+	// Arguments:	The percentile, from 0 to 100
+	// Returns:	The latency in microseconds, or 0 with none kept.
+	//
+	unsigned long long GetPercentile( double percentile );
+
+	//
+	// Name:	WriteLatencyReport
+	//
+	// Description:	Writes the request count and the p50, p99 and
+	//		largest latencies.
+	// Arguments:	The stream to write to
+	//
+	void WriteLatencyReport( std::ostream &out );
+
+protected: // Types
+
+	// A client connection, and what has been read from it:
+	struct SConnection {
+		server_socket	socket;		// The connection
+		char		buffer[4096];	// Bytes received, not yet used
+		size_t		start;		// First unused byte
+		size_t		end;		// End of the received bytes
+	};
+
+	// What a worker keeps from one request to the next:
+	struct SWorkspace {
+		std::string	header;		// The request line
+		std::string	source;		// The source sent
+		std::string	name;		// Its name
+		CStringList	output;		// The assembled output
+		std::string	image;		// The output as a file
+		std::string	response;	// The answer
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Work
+	//
+	// Description:	A worker thread: serves queued connections until
+	//		the server stops.
+	//
+	void Work();
+
+	//
+	// Name:	Serve
+	//
+	// Description:	Answers the requests of one connection until the
+	//		client closes it, or sends QUIT.
+	// Arguments:	The connection, and the worker's workspace
+	//
+	void Serve( SConnection &connection, SWorkspace &workspace );
+
+	//
+	// Name:	Assemble
+	//
+	// Description:	Assembles the source of an ASSEMBLE request with a
+	//		pooled assembler, and builds the answer.
+	// Arguments:	The format and flags of the request, and the
+	//		workspace holding its source and name
+	// Modifies:	The workspace's output, image and response
+	//
+	void Assemble( CManoAssembler::format format, const char *flags,
+		SWorkspace &workspace );
+
+	//
+	// Name:	Acquire
+	//
+	// Description:	Takes an assembler for a format from the pool, or
+	//		builds one if the pool has none.
+	// Arguments:	The format
+	// Returns:	The assembler, for Release.
+	//
+	CManoAssembler *Acquire( CManoAssembler::format format );
+
+	//
+	// Name:	Release
+	//
+	// Description:	Gives an assembler back to the pool.
+	// Arguments:	The assembler, and its format
+	//
+	void Release( CManoAssembler *assembler,
+		CManoAssembler::format format );
+
+	//
+	// Name:	RecordLatency
+	//
+	// Description:	Counts an answered request, and keeps its latency.
+	// Arguments:	The latency in microseconds
+	//
+	void RecordLatency( unsigned long long microseconds );
+
+	//
+	// Name:	ReadLine
+	//
+	// Description:	Reads a line from a connection, without its end.
+	// Arguments:	The connection, and the string to read into
+	// Returns:	false if the client closed the connection first, or
+	//		the line is longer than the buffer.
+	//
+	static bool ReadLine( SConnection &connection, std::string &line );
+
+	//
+	// Name:	ReadBytes
+	//
+	// Description:	Reads a number of bytes from a connection.
+	// Arguments:	The connection, the string to read into, and the
+	//		number of bytes
+	// Returns:	false if the client closed the connection first.
+	//
+	static bool ReadBytes( SConnection &connection, std::string &bytes,
+		size_t count );
+
+	//
+	// Name:	Receive
+	//
+	// Description:	Refills a connection's buffer, once it is used up.
+	// Arguments:	The connection
+	// Returns:	false if the client closed the connection.
+	//
+	static bool Receive( SConnection &connection );
+
+	//
+	// Name:	Send
+	//
+	// Description:	Sends every byte of a string.
+	// Arguments:	The connection, and the bytes
+	// Returns:	false if the client went away.
+	//
+	static bool Send( server_socket socket, const std::string &bytes );
+
+	//
+	// Name:	CloseSocket
+	//
+	// Description:	Closes a socket.
+	//
+	static void CloseSocket( server_socket socket );
+
+protected: // Attributes
+
+	std::string		m_path;		// Socket path while running
+
+	server_socket		m_listener;	// The listening socket
+
+	std::atomic<bool>	m_stopping;	// Stop was called
+
+	std::mutex		m_mutex;	// Guards m_queue and m_active
+
+	std::condition_variable m_ready;	// Signals m_queue and stopping
+
+	std::deque<server_socket> m_queue;	// Connections waiting for a
+						// worker
+
+	std::vector<server_socket> m_active;	// Connections being served
+
+	std::mutex		m_pool_mutex;	// Guards m_pool
+
+	std::vector<CManoAssembler *> m_pool[3]; // Idle assemblers, by format
+
+	std::mutex		m_latency_mutex; // Guards the statistics
+
+	std::vector<unsigned long long> m_latencies; // Latest latencies, in
+						// microseconds
+
+	size_t			m_next_latency;	// Where the next one goes, once
+						// the window is full
+
+	unsigned long long	m_requests;	// Requests answered
+
+private: // Not copyable
+
+	CAssemblerServer( const CAssemblerServer & );
+	CAssemblerServer &operator=( const CAssemblerServer & );
+};
@@ -0,0 +1,956 @@
+// File:	CycleEstimator.cpp
+// Description:
+//		Static worst-case cycle estimates for assembled Mano programs.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "CycleEstimator.hpp"
+#include "SymbolTable.hpp"
+
+#include <cstdio>
+#include <iomanip>
+
+using namespace std;
+
+// A path result meaning no path ends the way asked for:
+#define ESTIMATE_NONE	((unsigned long long)-2)
+
+// The interrupt vector, and the cycles the interrupt cycle can add:
+#define ESTIMATE_INTERRUPT_VECTOR	0x001
+#define ESTIMATE_INTERRUPT_CYCLES	2
+
+// main.v clock cycles of the memory-reference instructions by opcode,
+// direct and then indirect (CManoSimulator charges the same):
+static const int memory_cycles[2][7] = {
+	{ 3, 3, 3, 3, 2, 3, 5 },
+	{ 5, 5, 5, 5, 4, 5, 7 }
+};
+
+// Register and I/O instructions that may skip the next word:
+static const unsigned short skip_words[] = {
+	0x7010, 0x7008, 0x7004, 0x7002, 0xF200, 0xF100
+};
+
+// The word of HLT:
+#define ESTIMATE_HLT	0x7001
+
+//
+// Name:	Longer
+//
+// Description:	Picks the longer of two path results.
+//
+static unsigned long long Longer( unsigned long long a,
+	unsigned long long b )
+{
+
+	if( a == ESTIMATE_NONE ) {
+		return b;
+	}
+	if( b == ESTIMATE_NONE ) {
+		return a;
+	}
+	return a > b ? a : b;
+
+} // Longer
+
+//
+// Name:	Sum
+//
+// Description:	Adds two path results.
+//
+static unsigned long long Sum( unsigned long long a, unsigned long long b )
+{
+
+	if( a == ESTIMATE_UNBOUNDED || b == ESTIMATE_UNBOUNDED ) {
+		return ESTIMATE_UNBOUNDED;
+	}
+	if( a == ESTIMATE_NONE || b == ESTIMATE_NONE ) {
+		return ESTIMATE_NONE;
+	}
+	if( a + b < a || a + b >= ESTIMATE_NONE ) {
+		return ESTIMATE_UNBOUNDED;
+	}
+	return a + b;
+
+} // Sum
+
+//
+// Name:	(constructor)
+//
+CCycleEstimator::CCycleEstimator() {
+
+	for( int address = 0; address < 4096; address++ ) {
+		m_word[address] = 0;
+		m_line[address] = -1;
+		m_constant[address] = false;
+	}
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CCycleEstimator::~CCycleEstimator() {
+} // (destructor)
+
+//
+// Name:	Analyze
+//
+void CCycleEstimator::Analyze( const CManoAssembler &assembler ) {
+
+	for( int address = 0; address < 4096; address++ ) {
+		m_word[address] = assembler.GetWord( address );
+		m_line[address] = assembler.GetSourceLine( address );
+		m_constant[address] = assembler.IsConstant( address );
+	}
+	m_source = assembler.GetSource();
+
+	m_labels.clear();
+	const CSymbolTable::symbol_map &symbols =
+		assembler.GetSymbolTable().GetSymbols();
+	for( CSymbolTable::symbol_map::const_iterator i = symbols.begin();
+		i != symbols.end(); i++ )
+	{
+		if( m_labels.find( i->second ) == m_labels.end() ) {
+			m_labels[i->second] = i->first;
+		}
+	}
+
+	vector<bool> leaders;
+	FindCode( leaders );
+	BuildBlocks( leaders );
+	FindLoops();
+
+	m_worst.clear();
+	m_paths.clear();
+	m_active.assign( 4096, false );
+
+} // Analyze
+
+//
+// Name:	GetWorstCase
+//
+unsigned long long CCycleEstimator::GetWorstCase( int entry ) {
+
+	entry &= 0xFFF;
+
+	map<int, unsigned long long>::const_iterator found =
+		m_worst.find( entry );
+	if( found != m_worst.end() ) {
+		return found->second;
+	}
+
+	if( m_block_of.empty() || m_block_of[entry] < 0
+		|| m_blocks[m_block_of[entry]].start != entry )
+	{
+		return ESTIMATE_UNBOUNDED;
+	}
+
+	// A routine that is already being costed has recursed:
+	if( m_active[entry] ) {
+		return ESTIMATE_UNBOUNDED;
+	}
+
+	m_active[entry] = true;
+	unsigned long long worst = Path( m_block_of[entry], -1, at_exit );
+	m_active[entry] = false;
+
+	if( worst == ESTIMATE_NONE ) {
+		worst = ESTIMATE_UNBOUNDED;
+	}
+	m_worst[entry] = worst;
+	return worst;
+
+} // GetWorstCase
+
+//
+// Name:	GetInterruptPath
+//
+unsigned long long CCycleEstimator::GetInterruptPath() {
+
+	if( m_line[ESTIMATE_INTERRUPT_VECTOR] < 0 ) {
+		return 0;
+	}
+
+	// The longest instruction the interrupt can wait for:
+	int longest = 0;
+	for( int address = 0; address < 4096; address++ ) {
+		if( m_reached[address]
+			&& GetCycles( m_word[address] ) > longest )
+		{
+			longest = GetCycles( m_word[address] );
+		}
+	}
+
+	return Sum( GetWorstCase( ESTIMATE_INTERRUPT_VECTOR ),
+		longest + ESTIMATE_INTERRUPT_CYCLES );
+
+} // GetInterruptPath
+
+//
+// Name:	GetCycles
+//
+int CCycleEstimator::GetCycles( unsigned short word ) {
+
+	const unsigned opcode = (word >> 12) & 7;
+
+	if( opcode != 7 ) {
+		return memory_cycles[(word & 0x8000) ? 1 : 0][opcode];
+	}
+
+	// HLT stops the sequencer in par_sc_instexec:
+	return word == ESTIMATE_HLT ? 1 : 2;
+
+} // GetCycles
+
+//
+// Name:	WriteListing
+//
+void CCycleEstimator::WriteListing( ostream &out ) {
+
+	const ios::fmtflags flags = out.flags();
+	const char fill = out.fill();
+
+	// Which address each line was assembled to:
+	vector<int> address_of( m_source.size(), -1 );
+	for( int address = 0; address < 4096; address++ ) {
+		if( m_line[address] >= 0
+			&& (size_t)m_line[address] < m_source.size() )
+		{
+			address_of[m_line[address]] = address;
+		}
+	}
+
+	out << "Cycles are main.v clock cycles, from one instruction's "
+		"execute state to the next's." << endl
+		<< "AND ADD LDA STA BSA " << GetCycles( 0x0000 ) << " ("
+		<< GetCycles( 0x8000 ) << " indirect), ISZ "
+		<< GetCycles( 0x6000 ) << " (" << GetCycles( 0xE000 )
+		<< "), BUN " << GetCycles( 0x4000 ) << " ("
+		<< GetCycles( 0xC000 ) << "), HLT "
+		<< GetCycles( ESTIMATE_HLT ) << ", others "
+		<< GetCycles( 0x7800 ) << "." << endl
+		<< "Words the program never executes have no cycles." << endl
+		<< endl
+		<< "Addr  Word  Cycles  Line  Source" << endl;
+
+	for( size_t line = 0; line < m_source.size(); line++ ) {
+		const int address = address_of[line];
+
+		if( address < 0 ) {
+			out << setw( 20 ) << "";
+		}
+		else {
+			out << hex << uppercase << setfill( '0' ) << setw( 3 )
+				<< address << "   " << setw( 4 ) << m_word[address]
+				<< dec << setfill( ' ' ) << "  " << setw( 6 );
+			if( m_reached[address] ) {
+				out << GetCycles( m_word[address] );
+			}
+			else {
+				out << "";
+			}
+		}
+		out << setw( 6 ) << line + 1 << "  " << m_source[line] << endl;
+	}
+
+	out << endl << "Basic blocks" << endl << endl
+		<< "Start  End  Cycles  Calls" << endl;
+	for( size_t block = 0; block < m_blocks.size(); block++ ) {
+		const SBlock &info = m_blocks[block];
+
+		out << hex << uppercase << setfill( '0' ) << setw( 3 )
+			<< info.start << "    " << setw( 3 ) << info.end
+			<< dec << setfill( ' ' ) << setw( 8 ) << info.cycles
+			<< " ";
+		for( size_t call = 0; call < info.calls.size(); call++ ) {
+			out << " " << hex << setfill( '0' ) << setw( 3 )
+				<< info.calls[call] << dec << setfill( ' ' );
+		}
+		if( info.open ) {
+			out << "  (leaves the known code)";
+		}
+		const string label = GetLabel( info.start );
+		if( !label.empty() ) {
+			out << "  " << label;
+		}
+		out << endl;
+	}
+
+	out << endl << "Loops" << endl << endl
+		<< "Header  Bound  Counter  Iteration       Total" << endl;
+	for( size_t loop = 0; loop < m_loops.size(); loop++ ) {
+		const unsigned long long total = CostLoop( (int)loop );
+		const SLoop &info = m_loops[loop];
+		const int header = m_blocks[info.header].start;
+
+		out << hex << uppercase << setfill( '0' ) << setw( 3 )
+			<< header << dec << setfill( ' ' ) << "    ";
+		if( info.bound ) {
+			out << setw( 5 ) << info.bound << "  " << hex
+				<< setfill( '0' ) << setw( 3 ) << info.counter << dec
+				<< setfill( ' ' ) << "    ";
+		}
+		else {
+			out << setw( 5 ) << "-" << "  " << setw( 3 ) << "-"
+				<< "    ";
+		}
+		WriteCycles( out, 11, info.costed ? info.iteration
+			: ESTIMATE_UNBOUNDED );
+		out << " ";
+		WriteCycles( out, 11, total );
+		if( !info.reducible ) {
+			out << "  (entered other than at its header)";
+		}
+		const string label = GetLabel( header );
+		if( !label.empty() ) {
+			out << "  " << label;
+		}
+		out << endl;
+	}
+
+	out << endl << "Worst-case cycles" << endl << endl
+		<< "Entry       Cycles  Routine" << endl;
+	for( size_t routine = 0; routine < m_routines.size(); routine++ ) {
+		const int entry = m_routines[routine];
+
+		out << hex << uppercase << setfill( '0' ) << setw( 3 ) << entry
+			<< dec << setfill( ' ' ) << " ";
+		WriteCycles( out, 12, GetWorstCase( entry ) );
+		if( entry == 0 ) {
+			out << "  program start";
+		}
+		else if( entry == ESTIMATE_INTERRUPT_VECTOR ) {
+			out << "  interrupt routine";
+		}
+		else {
+			out << "  " << GetLabel( (entry - 1) & 0xFFF );
+		}
+		out << endl;
+	}
+
+	if( m_line[ESTIMATE_INTERRUPT_VECTOR] >= 0 ) {
+		out << endl << "Interrupt path (longest instruction, interrupt "
+			"cycle and routine): ";
+		WriteCycles( out, 0, GetInterruptPath() );
+		out << endl;
+	}
+
+	out.fill( fill );
+	out.flags( flags );
+
+} // WriteListing
+
+//
+// Name:	Decode
+//
+void CCycleEstimator::Decode( int address, SFlow &flow ) const {
+
+	const unsigned short word = m_word[address];
+	const unsigned opcode = (word >> 12) & 7;
+	const bool indirect = (word & 0x8000) != 0;
+	const int target = word & 0xFFF;
+
+	flow.next[0] = (address + 1) & 0xFFF;
+	flow.count = 1;
+	flow.call = -1;
+	flow.open = false;
+
+	switch( opcode ) {
+	case 0x4:	// BUN
+		if( indirect ) {
+			flow.count = 0;
+		}
+		else {
+			flow.next[0] = target;
+		}
+		return;
+	case 0x5:	// BSA
+		if( indirect ) {
+			flow.open = true;
+		}
+		else {
+			flow.call = (target + 1) & 0xFFF;
+		}
+		return;
+	case 0x6:	// ISZ
+		// An ISZ that would skip onto a constant is taken to count
+		// something that never reaches 0:
+		flow.next[1] = (address + 2) & 0xFFF;
+		if( !m_constant[flow.next[1]] ) {
+			flow.count = 2;
+		}
+		return;
+	case 0x7:
+		if( word == ESTIMATE_HLT ) {
+			flow.count = 0;
+			return;
+		}
+		for( size_t skip = 0;
+			skip < sizeof(skip_words) / sizeof(skip_words[0]); skip++ )
+		{
+			if( word == skip_words[skip] ) {
+				flow.next[1] = (address + 2) & 0xFFF;
+				flow.count = 2;
+			}
+		}
+		return;
+	}
+
+} // Decode
+
+//
+// Name:	FindCode
+//
+void CCycleEstimator::FindCode( vector<bool> &leaders ) {
+
+	m_reached.assign( 4096, false );
+	leaders.assign( 4096, false );
+	m_routines.clear();
+
+	vector<int> work;
+	for( int entry = 0; entry <= ESTIMATE_INTERRUPT_VECTOR; entry++ ) {
+		if( IsCode( entry ) ) {
+			m_routines.push_back( entry );
+			leaders[entry] = true;
+			work.push_back( entry );
+		}
+	}
+
+	while( !work.empty() ) {
+		int address = work.back();
+		work.pop_back();
+
+		// Run along the straight-line code from here:
+		while( !m_reached[address] && IsCode( address ) ) {
+			m_reached[address] = true;
+
+			SFlow flow;
+			Decode( address, flow );
+
+			if( flow.call >= 0 && IsCode( flow.call )
+				&& !leaders[flow.call] )
+			{
+				m_routines.push_back( flow.call );
+				leaders[flow.call] = true;
+				work.push_back( flow.call );
+			}
+
+			if( flow.count == 1 && flow.next[0] == address + 1 ) {
+				address++;
+				continue;
+			}
+			for( int i = 0; i < flow.count; i++ ) {
+				leaders[flow.next[i]] = true;
+				work.push_back( flow.next[i] );
+			}
+			break;
+		}
+	}
+
+} // FindCode
+
+//
+// Name:	BuildBlocks
+//
+void CCycleEstimator::BuildBlocks( const vector<bool> &leaders ) {
+
+	m_blocks.clear();
+	m_block_of.assign( 4096, -1 );
+
+	bool ended = true;
+	for( int address = 0; address < 4096; address++ ) {
+		if( !m_reached[address] ) {
+			ended = true;
+			continue;
+		}
+
+		if( ended || leaders[address] ) {
+			SBlock block;
+			block.start = address;
+			block.end = address;
+			block.cycles = 0;
+			block.open = false;
+			m_blocks.push_back( block );
+		}
+
+		SBlock &block = m_blocks.back();
+		block.end = address;
+		block.cycles += GetCycles( m_word[address] );
+		m_block_of[address] = (int)m_blocks.size() - 1;
+
+		SFlow flow;
+		Decode( address, flow );
+		if( flow.call >= 0 ) {
+			if( IsCode( flow.call ) ) {
+				block.calls.push_back( flow.call );
+			}
+			else {
+				block.open = true;
+			}
+		}
+		if( flow.open ) {
+			block.open = true;
+		}
+
+		// A block ends wherever the code does not simply fall through:
+		ended = flow.count != 1 || flow.next[0] != address + 1;
+	}
+
+	// Link each block to the blocks after it:
+	for( size_t index = 0; index < m_blocks.size(); index++ ) {
+		SBlock &block = m_blocks[index];
+
+		SFlow flow;
+		Decode( block.end, flow );
+		for( int i = 0; i < flow.count; i++ ) {
+			if( !IsCode( flow.next[i] ) ) {
+				block.open = true;
+			}
+			else {
+				block.successors.push_back(
+					m_block_of[flow.next[i]] );
+			}
+		}
+	}
+
+} // BuildBlocks
+
+//
+// Name:	FindLoops
+//
+void CCycleEstimator::FindLoops() {
+
+	m_loops.clear();
+	m_loop_of.assign( m_blocks.size(), -1 );
+
+	// Back edges, found from every routine entry:
+	vector<int> state( m_blocks.size(), 0 );
+	vector<pair<int, int> > edges;
+	for( size_t routine = 0; routine < m_routines.size(); routine++ ) {
+		const int block = m_block_of[m_routines[routine]];
+		if( state[block] == 0 ) {
+			FindBackEdges( block, state, edges );
+		}
+	}
+
+	// Predecessors, to grow each loop backwards from its back edges:
+	vector<vector<int> > predecessors( m_blocks.size() );
+	for( size_t block = 0; block < m_blocks.size(); block++ ) {
+		for( size_t i = 0; i < m_blocks[block].successors.size(); i++ ) {
+			predecessors[m_blocks[block].successors[i]].push_back(
+				(int)block );
+		}
+	}
+
+	for( size_t edge = 0; edge < edges.size(); edge++ ) {
+		const int header = edges[edge].second;
+
+		if( m_loop_of[header] < 0 ) {
+			SLoop loop;
+			loop.header = header;
+			loop.body.assign( m_blocks.size(), false );
+			loop.body[header] = true;
+			loop.reducible = true;
+			loop.bound = 0;
+			loop.counter = -1;
+			loop.iteration = 0;
+			loop.total = 0;
+			loop.costed = false;
+			m_loop_of[header] = (int)m_loops.size();
+			m_loops.push_back( loop );
+		}
+		SLoop &loop = m_loops[m_loop_of[header]];
+
+		vector<int> work( 1, edges[edge].first );
+		while( !work.empty() ) {
+			const int block = work.back();
+			work.pop_back();
+			if( loop.body[block] ) {
+				continue;
+			}
+			loop.body[block] = true;
+			for( size_t i = 0; i < predecessors[block].size(); i++ ) {
+				work.push_back( predecessors[block][i] );
+			}
+		}
+	}
+
+	for( size_t index = 0; index < m_loops.size(); index++ ) {
+		SLoop &loop = m_loops[index];
+
+		for( size_t block = 0; block < m_blocks.size(); block++ ) {
+			if( !loop.body[block] || (int)block == loop.header ) {
+				continue;
+			}
+			for( size_t i = 0; i < predecessors[block].size(); i++ ) {
+				if( !loop.body[predecessors[block][i]] ) {
+					loop.reducible = false;
+				}
+			}
+		}
+		if( loop.reducible ) {
+			BoundLoop( loop );
+		}
+	}
+
+	m_visiting.assign( m_blocks.size() * (m_loops.size() + 1) * 2, false );
+
+} // FindLoops
+
+//
+// Name:	FindBackEdges
+//
+void CCycleEstimator::FindBackEdges( int block, vector<int> &state,
+	vector<pair<int, int> > &edges ) const
+{
+
+	state[block] = 1;
+
+	const vector<int> &successors = m_blocks[block].successors;
+	for( size_t i = 0; i < successors.size(); i++ ) {
+		if( state[successors[i]] == 1 ) {
+			edges.push_back( make_pair( block, successors[i] ) );
+		}
+		else if( state[successors[i]] == 0 ) {
+			FindBackEdges( successors[i], state, edges );
+		}
+	}
+
+	state[block] = 2;
+
+} // FindBackEdges
+
+//
+// Name:	BoundLoop
+//
+void CCycleEstimator::BoundLoop( SLoop &loop ) const {
+
+	for( size_t block = 0; block < m_blocks.size(); block++ ) {
+		if( !loop.body[block] ) {
+			continue;
+		}
+
+		// Blocks end at an ISZ; its skip must leave the loop:
+		const int address = m_blocks[block].end;
+		const unsigned short word = m_word[address];
+		if( (word & 0xF000) != 0x6000 ) {
+			continue;
+		}
+		const int stay = m_block_of[(address + 1) & 0xFFF];
+		const int leave = m_block_of[(address + 2) & 0xFFF];
+		if( stay < 0 || !loop.body[stay] || (leave >= 0 && loop.body[leave])
+			|| Bypasses( loop, (int)block ) )
+		{
+			continue;
+		}
+
+		// Every value the counter can start from:
+		const int counter = word & 0xFFF;
+		vector<unsigned short> starts;
+		bool known = true;
+		bool initialized = false;
+		for( int writer = 0; writer < 4096 && known; writer++ ) {
+			const unsigned short store = m_word[writer];
+			const unsigned opcode = (store >> 12) & 0xF;
+			if( !m_reached[writer] || writer == address
+				|| (store & 0xFFF) != counter
+				|| (opcode != 0x3 && opcode != 0x5 && opcode != 0x6) )
+			{
+				continue;
+			}
+
+			// STA straight after an LDA of a constant, outside the loop:
+			const int load = (writer - 1) & 0xFFF;
+			known = opcode == 0x3 && m_reached[load]
+				&& m_block_of[load] == m_block_of[writer]
+				&& !loop.body[m_block_of[writer]]
+				&& (m_word[load] & 0xF000) == 0x2000;
+			const int constant = m_word[load] & 0xFFF;
+			for( int other = 0; other < 4096 && known; other++ ) {
+				const unsigned short other_word = m_word[other];
+				const unsigned op = (other_word >> 12) & 0xF;
+				if( m_reached[other] && (other_word & 0xFFF) == constant
+					&& (op == 0x3 || op == 0x5 || op == 0x6) )
+				{
+					known = false;
+				}
+			}
+			if( known ) {
+				starts.push_back( m_word[constant] );
+				if( Dominates( m_block_of[writer], loop.header ) ) {
+					initialized = true;
+				}
+			}
+		}
+		if( !known ) {
+			continue;
+		}
+
+		// The assembled value counts unless every way into the loop
+		// stores one of the others first:
+		if( !initialized ) {
+			starts.push_back( m_word[counter] );
+		}
+
+		unsigned long bound = 0;
+		for( size_t i = 0; i < starts.size(); i++ ) {
+			const unsigned long increments = 0x10000UL - starts[i];
+			if( increments > bound ) {
+				bound = increments;
+			}
+		}
+		if( loop.bound == 0 || bound < loop.bound ) {
+			loop.bound = bound;
+			loop.counter = counter;
+		}
+	}
+
+} // BoundLoop
+
+//
+// Name:	Bypasses
+//
+bool CCycleEstimator::Bypasses( const SLoop &loop, int block ) const {
+
+	if( block == loop.header ) {
+		return false;
+	}
+
+	vector<bool> seen( m_blocks.size(), false );
+	vector<int> work( 1, loop.header );
+	seen[loop.header] = true;
+
+	while( !work.empty() ) {
+		const int current = work.back();
+		work.pop_back();
+
+		const vector<int> &successors = m_blocks[current].successors;
+		for( size_t i = 0; i < successors.size(); i++ ) {
+			const int next = successors[i];
+			if( next == loop.header ) {
+				return true;
+			}
+			if( next != block && loop.body[next] && !seen[next] ) {
+				seen[next] = true;
+				work.push_back( next );
+			}
+		}
+	}
+	return false;
+
+} // Bypasses
+
+//
+// Name:	Dominates
+//
+bool CCycleEstimator::Dominates( int block, int target ) const {
+
+	if( block == target ) {
+		return true;
+	}
+
+	vector<bool> seen( m_blocks.size(), false );
+	vector<int> work;
+	for( size_t routine = 0; routine < m_routines.size(); routine++ ) {
+		const int entry = m_block_of[m_routines[routine]];
+		if( entry != block && !seen[entry] ) {
+			seen[entry] = true;
+			work.push_back( entry );
+		}
+	}
+
+	while( !work.empty() ) {
+		const int current = work.back();
+		work.pop_back();
+		if( current == target ) {
+			return false;
+		}
+
+		const vector<int> &successors = m_blocks[current].successors;
+		for( size_t i = 0; i < successors.size(); i++ ) {
+			const int next = successors[i];
+			if( next != block && !seen[next] ) {
+				seen[next] = true;
+				work.push_back( next );
+			}
+		}
+	}
+	return true;
+
+} // Dominates
+
+//
+// Name:	Path
+//
+unsigned long long CCycleEstimator::Path( int block, int loop,
+	path_end end )
+{
+
+	const long long key = ((long long)block * (long long)(m_loops.size() + 1)
+		+ (loop + 1)) * 2 + end;
+
+	map<long long, unsigned long long>::const_iterator found =
+		m_paths.find( key );
+	if( found != m_paths.end() ) {
+		return found->second;
+	}
+
+	// A cycle that is not a loop we know:
+	if( m_visiting[key] ) {
+		return ESTIMATE_UNBOUNDED;
+	}
+	m_visiting[key] = true;
+
+	unsigned long long result;
+	const int inner = m_loop_of[block];
+
+	if( inner >= 0 && inner != loop ) {
+		// The block heads a loop inside this one; go round it, then
+		// out of it:
+		const SLoop &info = m_loops[inner];
+		unsigned long long after = ESTIMATE_NONE;
+
+		for( size_t member = 0; member < m_blocks.size(); member++ ) {
+			if( !info.body[member] ) {
+				continue;
+			}
+			const vector<int> &successors = m_blocks[member].successors;
+			if( successors.empty() && (loop < 0 || end == at_exit) ) {
+				after = Longer( after, 0 );
+			}
+			for( size_t i = 0; i < successors.size(); i++ ) {
+				if( !info.body[successors[i]] ) {
+					after = Longer( after,
+						Arrive( successors[i], loop, end ) );
+				}
+			}
+		}
+		result = Sum( CostLoop( inner ), after );
+	}
+	else {
+		const vector<int> &successors = m_blocks[block].successors;
+		unsigned long long after = ESTIMATE_NONE;
+
+		if( successors.empty() && (loop < 0 || end == at_exit) ) {
+			after = 0;
+		}
+		for( size_t i = 0; i < successors.size(); i++ ) {
+			after = Longer( after, Arrive( successors[i], loop, end ) );
+		}
+		result = Sum( CostBlock( block ), after );
+	}
+
+	m_visiting[key] = false;
+	m_paths[key] = result;
+	return result;
+
+} // Path
+
+//
+// Name:	Arrive
+//
+unsigned long long CCycleEstimator::Arrive( int block, int loop,
+	path_end end )
+{
+
+	if( loop >= 0 ) {
+		const SLoop &info = m_loops[loop];
+
+		if( block == info.header ) {
+			return end == at_back_edge ? 0 : ESTIMATE_NONE;
+		}
+		if( !info.body[block] ) {
+			return end == at_exit ? 0 : ESTIMATE_NONE;
+		}
+	}
+	return Path( block, loop, end );
+
+} // Arrive
+
+//
+// Name:	CostLoop
+//
+unsigned long long CCycleEstimator::CostLoop( int loop ) {
+
+	SLoop &info = m_loops[loop];
+	if( info.costed ) {
+		return info.total;
+	}
+
+	unsigned long long iteration = Path( info.header, loop, at_back_edge );
+	const unsigned long long out = Path( info.header, loop, at_exit );
+
+	unsigned long long total = ESTIMATE_UNBOUNDED;
+	if( info.reducible && info.bound != 0 && iteration != ESTIMATE_NONE
+		&& out != ESTIMATE_NONE && iteration != ESTIMATE_UNBOUNDED )
+	{
+		const unsigned long long trips = info.bound - 1;
+		if( trips == 0 || iteration <= (ESTIMATE_NONE - 1) / trips ) {
+			total = Sum( trips * iteration, out );
+		}
+	}
+	if( iteration == ESTIMATE_NONE ) {
+		iteration = ESTIMATE_UNBOUNDED;
+	}
+
+	info.iteration = iteration;
+	info.total = total;
+	info.costed = true;
+	return total;
+
+} // CostLoop
+
+//
+// Name:	CostBlock
+//
+unsigned long long CCycleEstimator::CostBlock( int block ) {
+
+	const SBlock &info = m_blocks[block];
+	if( info.open ) {
+		return ESTIMATE_UNBOUNDED;
+	}
+
+	unsigned long long cycles = info.cycles;
+	for( size_t call = 0; call < info.calls.size(); call++ ) {
+		cycles = Sum( cycles, GetWorstCase( info.calls[call] ) );
+	}
+	return cycles;
+
+} // CostBlock
+
+//
+// Name:	IsCode
+//
+bool CCycleEstimator::IsCode( int address ) const {
+
+	return m_line[address] >= 0 && !m_constant[address];
+
+} // IsCode
+
+//
+// Name:	GetLabel
+//
+string CCycleEstimator::GetLabel( int address ) const {
+
+	map<int, string>::const_iterator found = m_labels.find( address );
+	return found != m_labels.end() ? found->second : string();
+
+} // GetLabel
+
+//
+// Name:	WriteCycles
+//
+void CCycleEstimator::WriteCycles( ostream &out, int width,
+	unsigned long long cycles )
+{
+
+	if( cycles == ESTIMATE_UNBOUNDED ) {
+		out << setw( width ) << "unbounded";
+	}
+	else {
+		out << setw( width ) << cycles;
+	}
+
+} // WriteCycles
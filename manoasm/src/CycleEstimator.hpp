@@ -0,0 +1,358 @@
+// File:	CycleEstimator.hpp
+// Description:
+//		Static worst-case cycle estimates for an assembled Mano
+//		program, costed with the main.v sequencer, and a listing
+//		annotated with them.
+// Usage:
+//		1. assemble a program with CManoAssembler::AssembleFromFile
+//		2. create one instance of this class, and call Analyze with
+//		   the assembler
+//		3. call WriteListing, or GetWorstCase and GetInterruptPath for
+//		   the numbers alone.
+//
+// Notes:
+//
+//		Each instruction costs the clock cycles main.v spends on it,
+//		from one par_sc_instexec state to the next (CManoSimulator
+//		charges the same).  The next instruction is fetched while
+//		AND, ADD and LDA wait for their operand and while BUN and the
+//		register and I/O instructions execute, so those cost one
+//		cycle less than STA and BSA would suggest; each indirection
+//		adds two.  No cost depends on data: a skip or an ISZ takes
+//		the same time whether it skips or not.
+//
+//		Code is found by following the program from 000, from the
+//		interrupt vector at 001, and from the word after each BSA
+//		target.  BUN through a pointer ends a path (it is taken to be
+//		a return), following BSA's textbook return address.  A path
+//		that calls through a pointer, runs into a HEX or DEC word or
+//		one nothing was assembled at, or recurses, is unbounded; an
+//		ISZ that would skip onto a HEX or DEC word is taken never to
+//		skip.
+//
+//		Basic blocks are costed alone; routines and loops are costed
+//		along their longest path, with callees included.  A loop is
+//		bounded when an ISZ that every iteration passes skips out of
+//		it, and its counter is only written by that ISZ or by STA
+//		straight after an LDA of a word nothing writes.  The bound is
+//		the most increments any of those starting values needs to
+//		reach 0.  Other loops, such as I/O polling loops, are
+//		unbounded.  Stores through pointers are not followed.
+//
+//		The interrupt path is the longest instruction the interrupt
+//		can wait for, the interrupt cycle, and the routine at 001 up
+//		to its return.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoAssembler.hpp"
+#include "StringList.hpp"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A worst case that has no bound:
+#define ESTIMATE_UNBOUNDED	((unsigned long long)-1)
+
+class CCycleEstimator {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CCycleEstimator object with nothing
+	//		analyzed.
+	//
+	CCycleEstimator();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CCycleEstimator object.
+	//
+	~CCycleEstimator();
+
+public:	// Analysis
+
+	//
+	// Name:	Analyze
+	//
+	// Description:	Finds the code, basic blocks, loops and routines of
+	//		the program an assembler last assembled, and costs
+	//		them.
+	// Arguments:	The assembler, after an AssembleFromFile without
+	//		errors
+	// Modifies:	Everything
+	//
+	void Analyze( const CManoAssembler &assembler );
+
+	//
+	// Name:	GetWorstCase
+	//
+	// Description:	Gives the worst-case cycles of a routine, from its
+	//		entry to its return or to HLT.
+	// Arguments:	The entry address: 000, 001, or the word after a
+	//		BSA target
+	// Returns:	The cycles, or ESTIMATE_UNBOUNDED if they have no
+	//		bound or the address is no entry.
+	//
+	unsigned long long GetWorstCase( int entry );
+
+	//
+	// Name:	GetInterruptPath
+	//
+	// Returns:	The worst-case cycles from an interrupt request to the
+	//		return of the routine at 001, ESTIMATE_UNBOUNDED if
+	//		they have no bound, or 0 if nothing was assembled at
+	//		001.
+	//
+	unsigned long long GetInterruptPath();
+
+	//
+	// Name:	GetCycles
+	//
+	// Description:	Gives the main.v clock cycles of an instruction.
+	// Arguments:	The instruction word
+	// Returns:	The number of cycles.
+	//
+	static int GetCycles( unsigned short word );
+
+public:	// Output
+
+	//
+	// Name:	WriteListing
+	//
+	// Description:	Writes the source with the address, word and cycles
+	//		of each line, then the basic blocks, the loops and the
+	//		worst case of each routine.
+	// Arguments:	The stream to write to
+	//
+	void WriteListing( std::ostream &out );
+
+protected: // Types
+
+	// Where an instruction can go next:
+	struct SFlow {
+		int		next[2];	// Following addresses
+		int		count;		// How many of next are used
+		int		call;		// Routine entry it calls, or -1
+		bool		open;		// Goes somewhere unknown
+	};
+
+	// A basic block:
+	struct SBlock {
+		int		start;		// First address
+		int		end;		// Last address
+		unsigned long long cycles;	// Its own instructions
+		std::vector<int> calls;		// Entries of the routines it calls
+		std::vector<int> successors;	// Indices of the following blocks
+		bool		open;		// Some path leaves it for the
+						// unknown
+	};
+
+	// A natural loop:
+	struct SLoop {
+		int		header;		// Block index of its header
+		std::vector<bool> body;		// Blocks in it, by index
+		bool		reducible;	// Only entered at the header
+		unsigned long	bound;		// Most header executions per
+						// entry, or 0 if unbounded
+		int		counter;	// Address of its ISZ counter, or -1
+		unsigned long long iteration;	// Worst trip back to the header
+		unsigned long long total;	// Worst case for the whole loop
+		bool		costed;		// iteration and total are set
+	};
+
+	// Ways for a path to end, when costing a loop:
+	enum path_end {
+		at_back_edge,			// Back at the loop header
+		at_exit				// Out of the loop, or returned
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Decode
+	//
+	// Description:	Works out where an instruction can go next.
+	// Arguments:	Its address, and the structure to fill in
+	//
+	void Decode( int address, SFlow &flow ) const;
+
+	//
+	// Name:	FindCode
+	//
+	// Description:	Follows the program from every entry point, marking
+	//		the words it reaches and the first word of each block.
+	// Arguments:	The list to mark first words in, by address
+	// Modifies:	m_reached, m_routines
+	//
+	void FindCode( std::vector<bool> &leaders );
+
+	//
+	// Name:	BuildBlocks
+	//
+	// Description:	Splits the reached words into basic blocks.
+	// Arguments:	The first words of the blocks
+	// Modifies:	m_blocks, m_block_of
+	//
+	void BuildBlocks( const std::vector<bool> &leaders );
+
+	//
+	// Name:	FindLoops
+	//
+	// Description:	Finds the natural loops of every routine and bounds
+	//		them.
+	// Modifies:	m_loops, m_loop_of
+	//
+	void FindLoops();
+
+	//
+	// Name:	FindBackEdges
+	//
+	// Description:	Depth-first search for edges back to a block on the
+	//		search path.
+	// Arguments:	The block to search from, the search state of each
+	//		block (0 unseen, 1 on the path, 2 done), and the list
+	//		to add back edges (source, header) to
+	//
+	void FindBackEdges( int block, std::vector<int> &state,
+		std::vector<std::pair<int, int> > &edges ) const;
+
+	//
+	// Name:	BoundLoop
+	//
+	// Description:	Looks for an ISZ counter that bounds a loop.
+	// Arguments:	The loop
+	// Modifies:	Its bound and counter
+	//
+	void BoundLoop( SLoop &loop ) const;
+
+	//
+	// Name:	Bypasses
+	//
+	// Description:	Determines whether an iteration of a loop can avoid
+	//		a block.
+	// Arguments:	The loop, and the index of the block
+	// Returns:	true if some path from the header back to the header
+	//		does not pass the block.
+	//
+	bool Bypasses( const SLoop &loop, int block ) const;
+
+	//
+	// Name:	Dominates
+	//
+	// Description:	Determines whether every path from a routine entry
+	//		to a block passes another block.
+	// Arguments:	The block that must be passed, and the block reached
+	// Returns:	true if there is no way round it.
+	//
+	bool Dominates( int block, int target ) const;
+
+	//
+	// Name:	Path
+	//
+	// Description:	Gives the longest path from the start of a block
+	//		to the end of a loop iteration, out of a loop, or to
+	//		the end of the routine.
+	// Arguments:	The block, the index of the loop to stay in (or -1
+	//		for none), and which end to look for
+	// Returns:	The cycles, ESTIMATE_UNBOUNDED, or ESTIMATE_NONE if
+	//		no path ends that way.
+	//
+	unsigned long long Path( int block, int loop, path_end end );
+
+	//
+	// Name:	Arrive
+	//
+	// Description:	As Path, for a path that has just taken an edge to
+	//		a block.
+	//
+	unsigned long long Arrive( int block, int loop, path_end end );
+
+	//
+	// Name:	CostLoop
+	//
+	// Description:	Costs a loop: bound - 1 trips around it, then the
+	//		worst way out.
+	// Arguments:	The index of the loop
+	// Returns:	Its total cycles, or ESTIMATE_UNBOUNDED.
+	//
+	unsigned long long CostLoop( int loop );
+
+	//
+	// Name:	CostBlock
+	//
+	// Description:	Costs a block's instructions and the routines it
+	//		calls.
+	// Arguments:	The index of the block
+	// Returns:	The cycles, or ESTIMATE_UNBOUNDED.
+	//
+	unsigned long long CostBlock( int block );
+
+	//
+	// Name:	IsCode
+	//
+	// Returns:	true if an instruction was assembled at an address.
+	//
+	bool IsCode( int address ) const;
+
+	//
+	// Name:	GetLabel
+	//
+	// Returns:	The label at an address, or an empty string.
+	//
+	std::string GetLabel( int address ) const;
+
+	//
+	// Name:	WriteCycles
+	//
+	// Description:	Writes a cycle count, or "unbounded".
+	// Arguments:	The stream, the field width, and the count
+	//
+	static void WriteCycles( std::ostream &out, int width,
+		unsigned long long cycles );
+
+protected: // Attributes
+
+	unsigned short		m_word[4096];	// The assembled image
+
+	int			m_line[4096];	// Source line of each word, or -1
+
+	bool			m_constant[4096]; // Assembled from HEX or DEC
+
+	CStringList		m_source;	// The assembled source
+
+	std::map<int, std::string> m_labels;	// First label at each address
+
+	std::vector<bool>	m_reached;	// Words the program can execute
+
+	std::vector<int>	m_routines;	// Routine entries, 000 and 001
+						// first
+
+	std::vector<SBlock>	m_blocks;	// The basic blocks, by address
+
+	std::vector<int>	m_block_of;	// Block index of each reached
+						// address, or -1
+
+	std::vector<SLoop>	m_loops;	// The natural loops
+
+	std::vector<int>	m_loop_of;	// Loop index of each header
+						// block, or -1
+
+	std::map<int, unsigned long long> m_worst; // Worst case by entry
+
+	std::vector<bool>	m_active;	// Routines being costed, by
+						// entry (to catch recursion)
+
+	std::map<long long, unsigned long long> m_paths; // Path results
+
+	std::vector<bool>	m_visiting;	// Path keys being worked out
+};
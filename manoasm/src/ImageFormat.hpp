@@ -0,0 +1,31 @@
+// File:	ImageFormat.hpp
+// Description:
+//		Layout of the binary memory image written by manoasm (-o b=)
+//		and read back by CImageLoader.
+//
+// Notes:
+//
+//		All fields are little-endian.  An image file is:
+//
+//		header:		"MANOIMG" and a version byte, then the number
+//				of segments (4 bytes)
+//		segments:	the address of the first word (2 bytes), the
+//				number of words (2 bytes), then the words (2
+//				bytes each)
+//
+//		Segments are in address order and do not overlap, as in
+//		CMemoryImage, and lie within 000-FFF.  Every field falls on
+//		a 2-byte boundary, so the words of a mapped image can be
+//		read in place.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#define IMAGE_MAGIC		"MANOIMG"
+#define IMAGE_VERSION		1
+
+#define IMAGE_HEADER_SIZE	12	// Magic, version, segment count
+#define IMAGE_SEGMENT_HEADER_SIZE 4	// Start address, word count
@@ -27,26 +27,95 @@
 //
 
 #include "ManoAssembler.hpp"
+#include "ImageFormat.hpp"
+#include "PeepholeOptimizer.hpp"
+#include "ProgramFormat.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
+//
+// Name:	StatsClock
+//
+// Description:	Gives a steady time in nanoseconds.
+//
+static unsigned long long StatsClock() {
+
+	return (unsigned long long)chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now().time_since_epoch() ).count();
+
+} // StatsClock
+
+//
+// Name:	PutFixed
+//
+// Description:	Stores a little-endian field of a binary image.
+//
+static void PutFixed( unsigned char *field, unsigned long value,
+	int bytes )
+{
+
+	for( int b = 0; b < bytes; b++ ) {
+		field[b] = (unsigned char)(value >> (8 * b));
+	}
+
+} // PutFixed
+
+//
+// Name:	InternString
+//
+// Description:	Adds a string to the string pool of a program file,
+//		unless the pool holds it already.
+// Returns:	The offset of the string in the pool.
+//
+static unsigned long InternString( const string &text, string &pool,
+	map<string, unsigned long> &offsets )
+{
+
+	const map<string, unsigned long>::const_iterator found =
+		offsets.find( text );
+	if( found != offsets.end() ) {
+		return found->second;
+	}
+
+	const unsigned long offset = (unsigned long)pool.size();
+	pool.append( text.c_str(), text.size() + 1 );
+	offsets[text] = offset;
+	return offset;
+
+} // InternString
+
 //
 // Name:	(constructor)
 //
-CManoAssembler::CManoAssembler(format setformat) : m_format(setformat) {
+CManoAssembler::CManoAssembler(format setformat) : m_format(setformat),
+	m_fixups( fixup_map::key_compare(),
+		fixup_map::allocator_type( &m_arena ) )
+{
 	m_file_name = 0;
 	m_line_number = 0;
 	m_symbol_table = 0;
-
-	if (m_format == coe)
-	{
-		for (int i = 0; i < 4096; i++)
-			m_data[i] = 0;
-		m_last_valid_address = 0;
+	m_error_count = 0;
+	m_optimize = false;
+	m_single_pass = false;
+	m_output = 0;
+	m_line_hint = 0;
+	m_collect_stats = false;
+	m_stats_start = m_stats_mark = 0;
+	m_output_start = 0;
+	m_record_image = false;
+	m_image_complete = false;
+	m_threads = thread::hardware_concurrency();
+	if( m_threads == 0 ) {
+		m_threads = 1;
 	}
 
 	// Reset the assembler
@@ -80,6 +149,13 @@ void CManoAssembler::Reset() {
 		m_symbol_table->Reset();
 	}
 
+	// Forget where every line was assembled, and what to:
+	for (int address = 0; address < 4096; address++) {
+		m_source_lines[address] = -1;
+		m_constants[address] = false;
+	}
+	m_memory.Clear();
+
 	// Reset the location counter and flags:
 	ResetLocationCounter();
 	
@@ -95,22 +171,146 @@ void CManoAssembler::AssembleFromFile(
 	ostream &error_stream ) 
 {
 
-	char line[90];
-	unsigned int i;
-	int errors = 0, warnings = 0;
+	StartStats( output_list );
+
+	// Read the input file into a string list, kept for GetSource.  A
+	// single pass reads it as it goes, unless the optimizer needs all
+	// of it first:
+	CStringList &string_list = m_source;
+	string_list.Rewind();
+	m_index.Clear();
+	ifstream file_stream;
+	istream *input_stream = 0;
+	if( m_single_pass && !m_optimize ) {
+		if( strcmp( filename, "stdin" ) == 0 ) {
+			input_stream = &cin;
+		}
+		else {
+			// Read through our own buffer, which the stream does not
+			// free when it closes:
+			file_stream.rdbuf()->pubsetbuf( m_read_buffer, 
+				sizeof( m_read_buffer ) );
+			file_stream.open( filename );
+			if( !file_stream.is_open() ) {
+				EndStats( "A0001" );
+				throw CErrorException( filename, 0, "A0001", 
+					"Could not open input file", 
+					CErrorException::FATAL );
+			}
+			input_stream = &file_stream;
+		}
+	}
+	else {
+		try {
+			m_index.ReadFromFile( filename );
+			m_index.GetLines( string_list );
+		}
+		catch( CErrorException error ) {
+			Report( error, error_stream );
+			EndStats( "A0001" );
+			throw CErrorException( filename, 0, "A0001", 
+				"Could not open input file", CErrorException::FATAL );
+		}
+	}
+	Lap( m_stats.read_ns );
 
-	// Read the input file into a string list:
-	CStringList string_list;
 	try {
-		string_list.ReadFromFile( filename );
+		AssembleSource( filename, input_stream, output_list, 
+			status_stream, error_stream );
+	}
+	catch( CErrorException e ) {
+		EndStats( e.GetCode() );
+		throw;
+	}
+	EndStats( 0 );
+
+} // AssembleFromFile
+
+//
+// Name:	AssembleFromText
+//
+void CManoAssembler::AssembleFromText(
+	const char *name, 
+	const string &text,
+	CStringList &output_list,
+	ostream &status_stream,
+	ostream &error_stream ) 
+{
+
+	StartStats( output_list );
+
+	m_source.Rewind();
+	try {
+		m_index.Index( text );
+		m_index.GetLines( m_source );
 	}
 	catch( CErrorException error ) {
-		error.Display( error_stream );
-		throw CErrorException( filename, 0, "A0001", 
-			"Could not open input file", CErrorException::FATAL );
+		m_index.Clear();
+		Report( error, error_stream );
+		EndStats( "A0004" );
+		throw CErrorException( name, error.GetLineNumber(), "A0004", 
+			"Line longer than 80 characters encountered", 
+			CErrorException::FATAL );
 	}
+	Lap( m_stats.read_ns );
+
+	try {
+		AssembleSource( name, 0, output_list, status_stream, 
+			error_stream );
+	}
+	catch( CErrorException e ) {
+		EndStats( e.GetCode() );
+		throw;
+	}
+	EndStats( 0 );
+
+} // AssembleFromText
+
+//
+// Name:	AssembleSource
+//
+void CManoAssembler::AssembleSource(
+	const char *filename, 
+	istream *input_stream,
+	CStringList &output_list,
+	ostream &status_stream,
+	ostream &error_stream ) 
+{
+
+	char line[90];
+	int errors = 0, warnings = 0;
+	CStringList &string_list = m_source;
 
 	SetFilename( filename );
+	m_words.clear();
+	m_image_complete = false;
+
+	// Rewrite the source before pass 1 if asked to:
+	if( m_optimize ) {
+		CPeepholeOptimizer optimizer;
+		optimizer.Optimize( filename, string_list, status_stream );
+
+		// Index the rewritten lines (without hints if they no longer
+		// read back):
+		try {
+			m_index.Index( string_list );
+		}
+		catch( CErrorException ) {
+			m_index.Clear();
+		}
+		Lap( m_stats.optimize_ns );
+	}
+
+	if( m_single_pass ) {
+		status_stream << "Assembling in a single pass..." << endl;
+
+		AssembleOnePass( input_stream, output_list, error_stream, 
+			errors, warnings );
+		Lap( m_stats.pass1_ns );
+
+		FinishAssembly( output_list, status_stream, errors, warnings );
+		return;
+	}
 
 	// Pass 1: Send all lines of input to the assembler for symbol
 	// parsing
@@ -119,8 +319,13 @@ void CManoAssembler::AssembleFromFile(
 
 	const size_t num_lines = string_list.size();
 
+	// A long source is scanned in parallel chunks, and then needs no
+	// serial pass 1:
+	const bool scanned = ParallelPass1( string_list, error_stream, 
+		errors, warnings );
+
 	for (unsigned line_number = 0;
-		(line_number < num_lines) && !EndEncountered();
+		!scanned && (line_number < num_lines) && !EndEncountered();
 		line_number++) {
 
 		// Copy the line from the string list:
@@ -139,10 +344,11 @@ void CManoAssembler::AssembleFromFile(
 		// Try assembling this line:
 		try {
 			SetLineNumber( line_number );
+			SetLineHint( m_index.GetLine( line_number ) );
 			ParseSymbolic( line );
 		}
 		catch( CErrorException e ) {
-			e.Display( error_stream );
+			Report( e, error_stream );
 			switch( e.GetSeverity() ) {
 			case CErrorException::FATAL:
 				throw;
@@ -156,8 +362,10 @@ void CManoAssembler::AssembleFromFile(
 			}
 		}
 	}
+	Lap( m_stats.pass1_ns );
 
 	// If there are errors, abort the assembly process:
+	m_error_count = errors;
 	if( errors > 0 ) {
 		status_stream << "Assembly aborted - " << errors 
 			<< " error(s), " << warnings << " warning(s)" << endl;
@@ -172,6 +380,30 @@ void CManoAssembler::AssembleFromFile(
 	// Ready the assembler:
 	ResetLocationCounter();
 
+	// After a parallel pass 1, pass 2 runs over the same chunks:
+	if( !ParallelPass2( output_list, error_stream, errors, warnings ) ) 
+	{
+		AssemblePass2( output_list, error_stream, errors, warnings );
+	}
+	Lap( m_stats.pass2_ns );
+
+	FinishAssembly( output_list, status_stream, errors, warnings );
+
+} // AssembleSource
+
+//
+// Name:	AssemblePass2
+//
+void CManoAssembler::AssemblePass2(
+	CStringList &output_list,
+	ostream &error_stream,
+	int &errors,
+	int &warnings ) 
+{
+	char line[90];
+	unsigned int i;
+	const size_t num_lines = m_source.size();
+
 	for (unsigned line_number = 0;
 		(line_number < num_lines) && !EndEncountered();
 		line_number++) {
@@ -179,10 +411,10 @@ void CManoAssembler::AssembleFromFile(
 
 		// Copy the line from the string list:
 		line[81] = 0;
-		strncpy( line, string_list[line_number].c_str(), 81 );
+		strncpy( line, m_source[line_number].c_str(), 81 );
 
 		if( strlen( line ) > 80 ) {
-			throw CErrorException( filename, line_number, "A0004", 
+			throw CErrorException( m_file_name, line_number, "A0004", 
 				"Line longer than 80 characters encountered", 
 				CErrorException::FATAL );
 		}
@@ -194,15 +426,16 @@ void CManoAssembler::AssembleFromFile(
 
 		try {
 			SetLineNumber( line_number );
+			SetLineHint( m_index.GetLine( line_number ) );
 			result = Assemble( line );
 
 			// If the line wasn't blank, output this instruction
 			if( result && m_format != coe ) {
-				output_list.push_back( result );
+				output_list.Append( result );
 			}
 		}
 		catch( CErrorException e ) {
-			e.Display( error_stream );
+			Report( e, error_stream );
 			switch( e.GetSeverity() ) {
 			case CErrorException::FATAL:
 				throw;
@@ -217,11 +450,23 @@ void CManoAssembler::AssembleFromFile(
 		}
 	}
 
+} // AssemblePass2
+
+//
+// Name:	FinishAssembly
+//
+void CManoAssembler::FinishAssembly( CStringList &output_list, 
+	ostream &status_stream, int errors, int warnings ) 
+{
+
 	// If there are errors, abort the assembly process:
+	m_error_count = errors;
 	if( errors > 0 ) {
 		status_stream << "Assembly aborted - " << errors 
 			<< " error(s), " << warnings << " warning(s)" << endl;
 
+		CountOutput( output_list );
+		Lap( m_stats.emit_ns );
 		return;
 	}
 
@@ -236,35 +481,985 @@ void CManoAssembler::AssembleFromFile(
 
 	// Display success message:
 
-	status_stream << "Assembly successful - " << errors << " error(s), "
-		 << warnings << " warning(s)" << endl;
+	status_stream << "Assembly successful - " << errors << " error(s), "
+		 << warnings << " warning(s)" << endl;
+	m_image_complete = true;
+
+	if (m_format == coe)
+	{
+		// Build the image in the string the last one was built in:
+		BuildCoeImage( m_memory, m_image );
+		output_list.Append( m_image.data(), m_image.size() );
+	}
+
+	CountOutput( output_list );
+	Lap( m_stats.emit_ns );
+
+} // FinishAssembly
+
+//
+// Name:	StartStats
+//
+void CManoAssembler::StartStats( const CStringList &output_list ) {
+
+	if( !m_collect_stats ) {
+		return;
+	}
+
+	m_stats.read_ns = m_stats.optimize_ns = 0;
+	m_stats.pass1_ns = m_stats.pass2_ns = m_stats.emit_ns = 0;
+	m_stats.total_ns = 0;
+	m_stats.lines = m_stats.symbols = m_stats.lookups = 0;
+	m_stats.bytes = 0;
+	m_stats.diagnostics.clear();
+	m_stats.fatal.clear();
+
+	m_output_start = output_list.size();
+	m_stats_start = m_stats_mark = StatsClock();
+
+} // StartStats
+
+//
+// Name:	Lap
+//
+void CManoAssembler::Lap( unsigned long long &phase ) {
+
+	if( !m_collect_stats ) {
+		return;
+	}
+
+	const unsigned long long now = StatsClock();
+	phase += now - m_stats_mark;
+	m_stats_mark = now;
+
+} // Lap
+
+//
+// Name:	EndStats
+//
+void CManoAssembler::EndStats( const char *fatal ) {
+
+	if( !m_collect_stats ) {
+		return;
+	}
+
+	m_stats.total_ns = StatsClock() - m_stats_start;
+	m_stats.lines = m_source.size();
+	m_stats.symbols = m_symbol_table->GetSymbols().size();
+	if( fatal ) {
+		m_stats.fatal = fatal;
+	}
+
+} // EndStats
+
+//
+// Name:	CountOutput
+//
+void CManoAssembler::CountOutput( const CStringList &output_list ) {
+
+	if( !m_collect_stats ) {
+		return;
+	}
+
+	// As CStringList::Dump writes it, a newline after each line:
+	m_stats.bytes = 0;
+	for( size_t line = m_output_start; line < output_list.size(); line++ ) {
+		m_stats.bytes += output_list[line].size() + 1;
+	}
+
+} // CountOutput
+
+//
+// Name:	Report
+//
+void CManoAssembler::Report( CErrorException &error, ostream &error_stream )
+{
+
+	error.Display( error_stream );
+	if( m_collect_stats ) {
+		m_stats.diagnostics[error.GetCode()]++;
+	}
+
+} // Report
+
+//
+// Name:	AssembleOnePass
+//
+void CManoAssembler::AssembleOnePass(
+	istream *input_stream, 
+	CStringList &output_list,
+	ostream &error_stream,
+	int &errors,
+	int &warnings ) 
+{
+	char line[90];
+	unsigned int i;
+	const size_t output_start = output_list.size();
+	int undeclared = 0;
+	bool checking = false;
+
+	// Words waiting for a label rewrite their line of output:
+	m_output = (m_format != coe) ? &output_list : 0;
+	m_fixups.clear();
+	m_arena.Reset();
+	m_warnings.clear();
+
+	for (unsigned line_number = 0; !EndEncountered(); line_number++) {
+		const char *result;
+
+		// Read the next line, or take it from the string list.  Like
+		// CStringList::ReadFromFile, a final newline gives a last,
+		// empty line:
+		if( input_stream ) {
+			if( !input_stream->good() ) {
+				break;
+			}
+			getline( *input_stream, m_read_line );
+			m_source.Append( m_read_line.data(), m_read_line.size() );
+		}
+		else if( line_number >= m_source.size() ) {
+			break;
+		}
+
+		// Copy the line:
+		line[81] = 0;
+		strncpy( line, m_source[line_number].c_str(), 81 );
+
+		// Pass 1 would stop here, and output nothing:
+		if( strlen( line ) > 80 ) {
+			m_output = 0;
+			DropAssembled( output_list, output_start );
+			throw CErrorException( m_file_name, line_number, "A0004", 
+				"Line longer than 80 characters encountered", 
+				CErrorException::FATAL );
+		}
+
+		// Convert the line to uppercase:
+		for( i=0; i < strlen(line); i++ ) {
+			line[i] = (char)toupper( line[i] );
+		}
+
+		try {
+			SetLineNumber( line_number );
+			SetLineHint( m_index.GetLine( line_number ) );
+			const bool org_encountered = m_org_encountered;
+
+			if( checking ) {
+				ParseSymbolic( line );
+			}
+			else {
+				result = Assemble( line );
+
+				// If the line wasn't blank, output this instruction
+				if( result && m_format != coe ) {
+					output_list.Append( result );
+				}
+			}
+
+			// Pass 1 warns about an END that comes before any ORG,
+			// and goes on past it, though pass 2 stops there; so the
+			// lines after it are only checked, as pass 1 would:
+			if( !checking && !org_encountered && EndEncountered() ) {
+				m_end_encountered = 0;
+				checking = true;
+			}
+		}
+		catch( CErrorException e ) {
+			// An undeclared symbol is a pass 2 error, which waits
+			// until we know that pass 1 would have let it through:
+			if( strcmp( e.GetCode(), "A2001" ) == 0 ) {
+				undeclared++;
+				continue;
+			}
+
+			Report( e, error_stream );
+			switch( e.GetSeverity() ) {
+			case CErrorException::FATAL:
+				m_output = 0;
+				DropAssembled( output_list, output_start );
+				throw;
+				break;
+			case CErrorException::ERROR:
+				errors++;
+				break;
+			case CErrorException::WARNING:
+				warnings++;
+				break;
+			}
+		}
+
+		// Report the warnings Assemble held back until its word was
+		// output:
+		for( i = 0; i < m_warnings.size(); i++ ) {
+			Report( m_warnings[i], error_stream );
+			warnings++;
+		}
+		m_warnings.clear();
+	}
+
+	// Keep the source after the END too, for GetSource:
+	while( input_stream && input_stream->good() ) {
+		getline( *input_stream, m_read_line );
+		m_source.Append( m_read_line.data(), m_read_line.size() );
+	}
+
+	// Settle the forward references no label was defined for:
+	undeclared += ResolveFixups();
+
+	m_output = 0;
+
+	// Pass 1 would have stopped at these errors, and output nothing:
+	if( errors > 0 ) {
+		DropAssembled( output_list, output_start );
+		return;
+	}
+
+	// Pass 2 stores no word for a line that names an undeclared
+	// symbol, so every word after it moves back.  Assemble the source
+	// again as pass 2 would, now that the symbol table is complete:
+	if( undeclared > 0 ) {
+		DropAssembled( output_list, output_start );
+
+		m_single_pass = false;
+		ResetLocationCounter();
+		AssemblePass2( output_list, error_stream, errors, warnings );
+		m_single_pass = true;
+	}
+
+} // AssembleOnePass
+
+//
+// Name:	DropAssembled
+//
+void CManoAssembler::DropAssembled( CStringList &output_list, 
+	size_t output_start ) 
+{
+
+	output_list.erase( output_list.begin() + output_start, 
+		output_list.end() );
+	for( int address = 0; address < 4096; address++ ) {
+		m_source_lines[address] = -1;
+		m_constants[address] = false;
+	}
+	m_memory.Clear();
+	m_words.clear();
+
+} // DropAssembled
+
+//
+// Name:	SetOptimize
+//
+void CManoAssembler::SetOptimize( bool optimize ) {
+
+	m_optimize = optimize;
+
+} // SetOptimize
+
+//
+// Name:	SetSinglePass
+//
+void CManoAssembler::SetSinglePass( bool single_pass ) {
+
+	m_single_pass = single_pass;
+
+} // SetSinglePass
+
+//
+// Name:	SetThreads
+//
+void CManoAssembler::SetThreads( unsigned threads ) {
+
+	m_threads = threads > 0 ? threads : 1;
+
+} // SetThreads
+
+//
+// Name:	SetRecordImage
+//
+void CManoAssembler::SetRecordImage( bool record ) {
+
+	m_record_image = record;
+
+} // SetRecordImage
+
+//
+// Name:	SetCollectStats
+//
+void CManoAssembler::SetCollectStats( bool collect ) {
+
+	m_collect_stats = collect;
+
+} // SetCollectStats
+
+//
+// Name:	GetStats
+//
+const CManoAssembler::SAssemblyStats &CManoAssembler::GetStats() const {
+
+	return m_stats;
+
+} // GetStats
+
+//
+// Name:	WriteStats
+//
+void CManoAssembler::WriteStats( ostream &out ) const {
+
+	// The symbol table dump may have left the stream in hex:
+	const ios::fmtflags flags = out.flags();
+	out << dec;
+
+	out << "{\"read_ns\":" << m_stats.read_ns
+		<< ",\"optimize_ns\":" << m_stats.optimize_ns
+		<< ",\"pass1_ns\":" << m_stats.pass1_ns
+		<< ",\"pass2_ns\":" << m_stats.pass2_ns
+		<< ",\"emit_ns\":" << m_stats.emit_ns
+		<< ",\"total_ns\":" << m_stats.total_ns
+		<< ",\"lines\":" << m_stats.lines
+		<< ",\"symbols\":" << m_stats.symbols
+		<< ",\"symbol_lookups\":" << m_stats.lookups
+		<< ",\"bytes_written\":" << m_stats.bytes
+		<< ",\"diagnostics\":{";
+
+	// Error codes are letters and digits, and need no escaping:
+	for( map<string, unsigned long long>::const_iterator code =
+		m_stats.diagnostics.begin(); 
+		code != m_stats.diagnostics.end(); code++ ) 
+	{
+		if( code != m_stats.diagnostics.begin() ) {
+			out << ',';
+		}
+		out << '"' << code->first << "\":" << code->second;
+	}
+
+	out << "},\"fatal\":";
+	if( m_stats.fatal.empty() ) {
+		out << "null";
+	}
+	else {
+		out << '"' << m_stats.fatal << '"';
+	}
+	out << '}';
+
+	out.flags( flags );
+
+} // WriteStats
+
+//
+// Name:	ParallelPass1
+//
+bool CManoAssembler::ParallelPass1( const CStringList &source, 
+	ostream &error_stream, int &errors, int &warnings ) 
+{
+
+	m_chunks.clear();
+
+	// Give each thread at least PARALLEL_CHUNK_LINES lines:
+	size_t count = source.size() / PARALLEL_CHUNK_LINES;
+	if( count > m_threads ) {
+		count = m_threads;
+	}
+	if( count < 2 ) {
+		return false;
+	}
+
+	// Scan the chunks:
+	vector<SChunk> &chunks = m_chunks;
+	chunks.resize( count );
+	vector<thread> workers;
+	for( size_t c = 0; c < count; c++ ) {
+		chunks[c].first = (unsigned)(source.size() * c / count);
+		chunks[c].last = (unsigned)(source.size() * (c + 1) / count);
+		workers.push_back( thread( &CManoAssembler::ScanChunk, &source, 
+			&m_index, m_file_name, &chunks[c] ) );
+	}
+	for( size_t c = 0; c < count; c++ ) {
+		workers[c].join();
+	}
+
+	// Work out where each chunk starts, and where its labels are, in
+	// line order.  Anything pass 1 would complain about (other than a
+	// missing ORG) needs the chunks gone over line by line instead:
+	map<string, int> symbols;
+	int location_counter = m_location_counter;
+	bool org_encountered = m_org_encountered;
+	bool end_encountered = false;
+	int missing_org = -1;
+	const unsigned long long lookups = m_stats.lookups;
+	bool complain = false;
+
+	size_t c;
+	for( c = 0; c < count && !end_encountered && !complain; c++ ) {
+		SChunk &chunk = chunks[c];
+		const int start = location_counter;
+
+		if( !chunk.diagnostics.empty() || chunk.overflow 
+			|| start + chunk.peak > 0x1000 || chunk.first_end ) 
+		{
+			complain = true;
+			break;
+		}
+
+		chunk.start = start;
+
+		// The first word before any ORG is where pass 1 warns:
+		if( !org_encountered ) {
+			if( chunk.first_word >= 0 ) {
+				missing_org = chunk.first_word;
+				org_encountered = true;
+			}
+			else if( chunk.absolute ) {
+				org_encountered = true;
+			}
+		}
+
+		for( size_t l = 0; l < chunk.labels.size(); l++ ) {
+			const SChunkLabel &label = chunk.labels[l];
+			const int address = label.absolute ? label.offset
+				: start + label.offset;
+
+			if( m_collect_stats ) {
+				m_stats.lookups++;
+			}
+			if( m_symbol_table->GetAddress( label.name.c_str() ) != -1
+				|| !symbols.insert( make_pair( label.name, 
+					address ) ).second )
+			{
+				complain = true;
+				break;
+			}
+		}
+
+		location_counter = chunk.absolute ? chunk.delta 
+			: start + chunk.delta;
+		end_encountered = chunk.end;
+	}
+
+	if( complain ) {
+		m_stats.lookups = lookups;
+		ReplayPass1( error_stream, errors, warnings );
+		m_chunks.clear();
+		return true;
+	}
+
+	// Pass 1 is done; pass 2 needs no chunk after the END:
+	chunks.resize( c );
+	for( map<string, int>::const_iterator symbol = symbols.begin();
+		symbol != symbols.end(); symbol++ )
+	{
+		m_symbol_table->AddSymbol( symbol->first.c_str(), 
+			symbol->second );
+	}
+	m_location_counter = location_counter;
+	m_org_encountered = org_encountered;
+	m_end_encountered = end_encountered;
+
+	if( missing_org >= 0 ) {
+		CErrorException e( m_file_name, missing_org, "A3000", 
+			"ORG not encountered.  Assuming 000 as origin.", 
+			CErrorException::WARNING );
+		Report( e, error_stream );
+		warnings++;
+	}
+
+	return true;
+
+} // ParallelPass1
+
+//
+// Name:	ReplayPass1
+//
+void CManoAssembler::ReplayPass1( ostream &error_stream, int &errors, 
+	int &warnings ) 
+{
+
+	for( size_t c = 0; c < m_chunks.size() && !m_end_encountered; c++ ) {
+		const SChunk &chunk = m_chunks[c];
+		size_t d = 0, l = 0;
+
+		for( size_t s = 0; s <= chunk.steps.size() 
+			&& !m_end_encountered; s++ ) 
+		{
+			const unsigned line_number = s < chunk.steps.size() 
+				? chunk.steps[s].line : chunk.last;
+
+			// Report the lines before this one that did not parse,
+			// or stop at one that was too long (an exception gives
+			// its line one-based):
+			for( ; d < chunk.diagnostics.size() 
+				&& (unsigned)chunk.diagnostics[d].GetLineNumber() 
+					<= line_number; d++ ) 
+			{
+				CErrorException e = chunk.diagnostics[d];
+				if( e.GetSeverity() == CErrorException::FATAL ) {
+					m_chunks.clear();
+					throw e;
+				}
+				Report( e, error_stream );
+				errors++;
+			}
+			if( s == chunk.steps.size() ) {
+				break;
+			}
+			const SChunkStep &step = chunk.steps[s];
+
+			// Define the label, as DefineSymbol does:
+			if( l < chunk.labels.size() 
+				&& chunk.labels[l].line == step.line ) 
+			{
+				const char *label = chunk.labels[l++].name.c_str();
+
+				if( m_collect_stats ) {
+					m_stats.lookups++;
+				}
+				if( m_symbol_table->GetAddress( label ) != -1 ) {
+					CErrorException e( m_file_name, step.line, "A2000", 
+						"Duplicate symbol encountered", 
+						CErrorException::ERROR );
+					Report( e, error_stream );
+					errors++;
+					continue;
+				}
+				m_symbol_table->AddSymbol( label, m_location_counter );
+			}
+
+			// Move the location counter, as UpdateLocationCounter
+			// and ParseSymbolic do:
+			if( step.org >= 0 ) {
+				m_location_counter = step.org;
+			}
+			else {
+				// A word, or END, takes an address:
+				m_location_counter++;
+
+				if( !m_org_encountered ) {
+					m_org_encountered = 1;
+					CErrorException e( m_file_name, step.line, "A3000", 
+						"ORG not encountered.  Assuming 000 as origin.", 
+						CErrorException::WARNING );
+					Report( e, error_stream );
+					warnings++;
+					continue;
+				}
+			}
+
+			if( m_location_counter > 0x1000 ) {
+				CErrorException e( m_file_name, step.line, "A0005", 
+					"Attempt to assemble past address FFF", 
+					CErrorException::FATAL );
+				Report( e, error_stream );
+				m_chunks.clear();
+				throw e;
+			}
+
+			if( step.org == -2 ) {
+				m_end_encountered = 1;
+			}
+			else if( step.org >= 0 ) {
+				m_org_encountered = 1;
+			}
+		}
+	}
+
+} // ReplayPass1
+
+//
+// Name:	ParallelPass2
+//
+bool CManoAssembler::ParallelPass2( CStringList &output_list, 
+	ostream &error_stream, int &errors, int &warnings ) 
+{
+	size_t c;
+
+	if( m_chunks.empty() ) {
+		return false;
+	}
+
+	// Each line assembles into a slot of its own:
+	const unsigned num_lines = m_chunks.back().last;
+	if( m_encoded.size() < num_lines ) {
+		m_encoded.resize( num_lines );
+	}
+
+	// Encode the chunks.  A line that names an undeclared symbol
+	// stores no word, so the chunks after it may start lower than pass
+	// 1 found; those are encoded again from where the chunk before
+	// them ends (which lines fail does not depend on the addresses),
+	// by the same workers:
+	SEncodeWork work;
+	for( c = 0; c < m_chunks.size(); c++ ) {
+		work.pending.push_back( c );
+	}
+	work.next = 0;
+	work.remaining = work.pending.size();
+	work.stopping = false;
+
+	vector<thread> workers;
+	for( c = 0; c < m_chunks.size(); c++ ) {
+		workers.push_back( thread( &CManoAssembler::EncodeChunks, this,
+			&work ) );
+	}
+	for(;;) {
+		{
+			unique_lock<mutex> lock( work.mutex );
+			while( work.remaining > 0 ) {
+				work.done.wait( lock );
+			}
+		}
+
+		vector<size_t> pending;
+		for( c = 1; c < m_chunks.size(); c++ ) {
+			SChunk &chunk = m_chunks[c];
+			const int start = m_chunks[c - 1].finish;
+
+			if( chunk.start != start ) {
+				// Without an ORG, it ends as much lower:
+				if( !chunk.absolute ) {
+					chunk.finish += start - chunk.start;
+				}
+				chunk.start = start;
+				pending.push_back( c );
+			}
+		}
+
+		lock_guard<mutex> lock( work.mutex );
+		if( pending.empty() ) {
+			work.stopping = true;
+			work.ready.notify_all();
+			break;
+		}
+		work.pending.swap( pending );
+		work.next = 0;
+		work.remaining = work.pending.size();
+		work.ready.notify_all();
+	}
+	for( c = 0; c < workers.size(); c++ ) {
+		workers[c].join();
+	}
+
+	// Report the lines that did not assemble, in line order:
+	for( c = 0; c < m_chunks.size(); c++ ) {
+		const SChunk &chunk = m_chunks[c];
+
+		for( size_t d = 0; d < chunk.diagnostics.size(); d++ ) {
+			CErrorException e = chunk.diagnostics[d];
+
+			Report( e, error_stream );
+			switch( e.GetSeverity() ) {
+			case CErrorException::FATAL:
+				m_chunks.clear();
+				throw e;
+				break;
+			case CErrorException::ERROR:
+				errors++;
+				break;
+			case CErrorException::WARNING:
+				warnings++;
+				break;
+			}
+		}
+		if( m_collect_stats ) {
+			m_stats.lookups += chunk.lookups;
+		}
+	}
+
+	// Store the words in line order, so that later ORG sections
+	// overwrite earlier ones as they would serially (for coe, ORG and
+	// END store theirs too):
+	for( unsigned line_number = 0; line_number < num_lines; 
+		line_number++ ) 
+	{
+		const SEncodedLine &encoded = m_encoded[line_number];
+
+		if( encoded.address < 0 ) {
+			continue;
+		}
+		if( encoded.address < 4096 ) {
+			if( encoded.listed ) {
+				m_memory.Store( encoded.address, encoded.data );
+				m_source_lines[encoded.address] = line_number;
+				m_constants[encoded.address] = encoded.constant;
+			}
+			else if( m_format == coe ) {
+				m_memory.Store( encoded.address, encoded.data );
+			}
+		}
+		if( encoded.listed && m_format != coe ) {
+			output_list.Append( encoded.output );
+		}
+		if( m_record_image ) {
+			SImageWord word;
+			word.address = encoded.address;
+			word.data = encoded.data;
+			word.listed = encoded.listed;
+			strcpy( word.comment, encoded.comment );
+			m_words.push_back( word );
+		}
+	}
+
+	m_chunks.clear();
+	return true;
+
+} // ParallelPass2
+
+//
+// Name:	EncodeChunks
+//
+void CManoAssembler::EncodeChunks( SEncodeWork *work ) {
+	CManoAssembler parser( normal );
+
+	parser.SetFilename( m_file_name );
+
+	for(;;) {
+		size_t c;
+		{
+			unique_lock<mutex> lock( work->mutex );
+			while( work->next == work->pending.size() 
+				&& !work->stopping ) 
+			{
+				work->ready.wait( lock );
+			}
+			if( work->stopping ) {
+				return;
+			}
+			c = work->pending[work->next++];
+		}
+
+		EncodeChunk( parser, m_chunks[c] );
+
+		lock_guard<mutex> lock( work->mutex );
+		if( --work->remaining == 0 ) {
+			work->done.notify_one();
+		}
+	}
+
+} // EncodeChunks
+
+//
+// Name:	EncodeChunk
+//
+void CManoAssembler::EncodeChunk( CManoAssembler &parser, 
+	SChunk &chunk ) 
+{
+	char line[90];
+	char label[33];
+	char instruction[4];
+	char argument[11];
+	char indirect[2];
+	unsigned int i;
+	unsigned line_number;
+	int location_counter = chunk.start;
+	SInstruction info;
+
+	// It may be encoded again, from another start:
+	chunk.diagnostics.clear();
+	chunk.lookups = 0;
+
+	for( line_number = chunk.first; line_number < chunk.last; 
+		line_number++ ) {
+		SEncodedLine &encoded = m_encoded[line_number];
+
+		encoded.address = -1;
+
+		// Copy the line from the string list (pass 1 checked its
+		// length):
+		line[81] = 0;
+		strncpy( line, m_source[line_number].c_str(), 81 );
+
+		// Convert the line to uppercase:
+		for( i=0; i < strlen(line); i++ ) {
+			line[i] = (char)toupper( line[i] );
+		}
+
+		// Encode it as Assemble does in pass 2 (pass 1 parsed it, so
+		// only an operand that names no symbol should fail):
+		try {
+			parser.SetLineNumber( line_number );
+			parser.SetLineHint( m_index.GetLine( line_number ) );
+			parser.Parse( line, label, instruction, argument, 
+				indirect );
+		}
+		catch( CErrorException e ) {
+			chunk.diagnostics.push_back( e );
+			continue;
+		}
+
+		if( strcmp( instruction, "" ) == 0 ) {
+			continue;
+		}
+		GetInstructionInfo( instruction, &info );
+
+		if( info.resolve_references && strcmp( argument, "" ) != 0 ) {
+			if( m_collect_stats ) {
+				chunk.lookups++;
+			}
+			const int address = m_symbol_table->GetAddress( argument );
+
+			if( address != -1 ) {
+				IntegerToHex( address, argument );
+			}
+			else if( !IsHexNumeric( argument ) ) {
+				chunk.diagnostics.push_back( CErrorException( 
+					m_file_name, line_number, "A2001", 
+					"Undeclared symbol encountered", 
+					CErrorException::ERROR ) );
+				continue;
+			}
+		}
+
+		unsigned short data = info.opcode << 12;
+		if( strcmp( indirect, "I" ) == 0 ) {
+			data += 0x8000;
+		}
+		data += info.operand;
+		if( strcmp( argument, "" ) != 0 ) {
+			data += strcmp( instruction, "DEC" ) == 0 
+				? (unsigned short)atol( argument ) 
+				: HexToInteger( argument );
+		}
+
+		encoded.address = location_counter;
+		encoded.data = data;
+		encoded.listed = strcmp( instruction, "ORG" ) != 0
+			&& strcmp( instruction, "END" ) != 0;
+		encoded.constant = strcmp( instruction, "HEX" ) == 0
+			|| strcmp( instruction, "DEC" ) == 0;
+		FormatComment( instruction, argument, indirect, 
+			encoded.comment );
+		if( encoded.listed ) {
+			FormatLine( m_format, location_counter, data, 
+				encoded.comment, encoded.output );
+		}
+
+		// Move the location counter (pass 1 found nothing wrong with
+		// where it goes):
+		if( strcmp( instruction, "ORG" ) == 0 ) {
+			location_counter = HexToInteger( argument );
+		}
+		else {
+			location_counter++;
+		}
+		if( strcmp( instruction, "END" ) == 0 ) {
+			break;
+		}
+	}
+
+	// The lines after an END assemble to nothing:
+	while( ++line_number < chunk.last ) {
+		m_encoded[line_number].address = -1;
+	}
+	chunk.finish = location_counter;
+
+} // EncodeChunk
+
+//
+// Name:	ScanChunk
+//
+void CManoAssembler::ScanChunk( const CStringList *source, 
+	const CSourceIndex *index, const char *filename, SChunk *chunk ) 
+{
+	CManoAssembler parser( normal );
+	char line[90];
+	char label[33];
+	char instruction[4];
+	char argument[11];
+	char indirect[2];
+
+	parser.SetFilename( filename );
+
+	chunk->delta = 0;
+	chunk->absolute = false;
+	chunk->peak = 0;
+	chunk->first_word = -1;
+	chunk->overflow = false;
+	chunk->end = false;
+	chunk->first_end = false;
+
+	for( unsigned line_number = chunk->first; line_number < chunk->last;
+		line_number++ ) {
+
+		// Copy the line from the string list:
+		line[81] = 0;
+		strncpy( line, (*source)[line_number].c_str(), 81 );
+
+		// Pass 1 would stop here, if it got this far:
+		if( strlen( line ) > 80 ) {
+			chunk->diagnostics.push_back( CErrorException( filename, 
+				line_number, "A0004", 
+				"Line longer than 80 characters encountered", 
+				CErrorException::FATAL ) );
+			return;
+		}
+
+		// Convert the line to uppercase:
+		_strupr( line );
+
+		try {
+			parser.SetLineNumber( line_number );
+			parser.SetLineHint( index->GetLine( line_number ) );
+			parser.Parse( line, label, instruction, argument, 
+				indirect );
+		}
+		catch( CErrorException e ) {
+			chunk->diagnostics.push_back( e );
+			continue;
+		}
+
+		if( strcmp( label, "" ) != 0 ) {
+			SChunkLabel found;
+			found.name = label;
+			found.line = line_number;
+			found.offset = chunk->delta;
+			found.absolute = chunk->absolute;
+			chunk->labels.push_back( found );
+		}
+
+		// Move the location counter as UpdateLocationCounter does,
+		// and keep the step in case pass 1 must be gone over again:
+		if( strcmp( instruction, "" ) == 0 ) {
+			continue;
+		}
+		SChunkStep step;
+		step.line = line_number;
+		step.org = -1;
+		if( strcmp( instruction, "ORG" ) == 0 ) {
+			chunk->delta = HexToInteger( argument );
+			chunk->absolute = true;
+			step.org = chunk->delta;
+		}
+		else {
+			if( !chunk->absolute && chunk->first_word < 0 ) {
+				chunk->first_word = line_number;
+			}
+			chunk->delta++;
+			if( !chunk->absolute ) {
+				chunk->peak = chunk->delta;
+			}
+		}
+
+		if( chunk->absolute && chunk->delta > 0x1000 ) {
+			chunk->overflow = true;
+		}
 
-	if (m_format == coe)
-	{
-		ostrstream ts;
-		ts << "memory_initialization_radix=16;\n"
-			"memory_initialization_vector=\n";
-		for (int y = 0; y < 4096/8; y++)
-		{
-			for (int x = 0; x < 8; x++)
+		// END takes an address as a word does, and ends pass 1 there,
+		// unless it is the first word and no ORG came before it: pass
+		// 1 then warns and goes on.  Only the merge can tell, so the
+		// chunk goes on too:
+		if( strcmp( instruction, "END" ) == 0 ) {
+			step.org = -2;
+			if( chunk->absolute 
+				|| chunk->first_word != (int)line_number ) 
 			{
-				ts << setw(4) << setfill('0') << hex << m_data[x+8*y];
-				ts << setw(1);
-				if (x + 8*y == m_last_valid_address)
-				{
-					ts << ";\n";
-					goto done;
-				}
-				else
-					ts << ',';
+				chunk->steps.push_back( step );
+				chunk->end = true;
+				return;
 			}
-			ts << '\n';
+			chunk->first_end = true;
 		}
-		done:
-		ts << '\0';
-		output_list.push_back(ts.str());
+		chunk->steps.push_back( step );
 	}
-} // AssembleFromFile
+
+} // ScanChunk
 
 //
 // Name:	ParseSymbolic
@@ -284,19 +1479,7 @@ void CManoAssembler::ParseSymbolic( const char *line ) {
 	// PROCESS THE LABEL
 	////////////////////////////////////////////////////////////////////////
 
-	// Process the label only if it exists, that is:
-	if( strcmp( label, "" ) != 0 ) {
-		// Check to see if this symbol already exists:
-		if( m_symbol_table->GetAddress( label ) != -1 ) {
-			throw CErrorException( m_file_name, m_line_number, 
-				"A2000", "Duplicate symbol encountered", 
-				CErrorException::ERROR );
-		}
-
-		// Add the label and its associated address to the symbol 
-		// table:
-		m_symbol_table->AddSymbol( label, m_location_counter );
-	}
+	DefineSymbol( label );
 
 	////////////////////////////////////////////////////////////////////////
 	// UPDATE THE LOCATION COUNTER
@@ -336,9 +1519,6 @@ char *CManoAssembler::Assemble( const char *line ) {
 	char argument[11];
 	char indirect[2];
 
-	char buffer[81];
-	char hex_data[16];
-
 	SInstruction info;
 
 	// Reset the output and create a stream:
@@ -357,24 +1537,41 @@ char *CManoAssembler::Assemble( const char *line ) {
 	// Do some research on our instruction:
 	GetInstructionInfo( instruction, &info );
 
+	// Without a pass 1, define the label here:
+	if( m_single_pass ) {
+		DefineSymbol( label );
+	}
+
 	////////////////////////////////////////////////////////////////////////
 	// RESOLVE REFERENCES
 	////////////////////////////////////////////////////////////////////////
 	
 	// If this operation is marked for resolving references, do so:
+	bool forward = false;
 	if( info.resolve_references ) {
 		if( strcmp( argument, "" ) != 0 ) {
 			// Replace symbolic variable it with it's numeric 
 			// equivalent:
 			int address;
 
+			if( m_collect_stats ) {
+				m_stats.lookups++;
+			}
 			address = m_symbol_table->GetAddress( argument );
 
 			// If the address is not found, yell at the user 
 			// a little:
 			if( address == -1 )
 			{
-				if ( !IsHexNumeric(argument) )
+				// In a single pass, the label may still be
+				// defined further on, unless the operand can
+				// only be a number:
+				if( m_single_pass && (IsValidIdentifier( argument )
+					|| !IsHexNumeric( argument )) ) 
+				{
+					forward = true;
+				}
+				else if ( !IsHexNumeric(argument) )
 				{
 					throw CErrorException( m_file_name, 
 						m_line_number, "A2001", 
@@ -410,8 +1607,9 @@ char *CManoAssembler::Assemble( const char *line ) {
 	// Add in operand:
 	data += info.operand;
 
-	// Add in user operand, if it exists:
-	if( strcmp( argument, "" ) != 0 ) {
+	// Add in user operand, if it exists (a forward reference is
+	// patched in later):
+	if( strcmp( argument, "" ) != 0 && !forward ) {
 		unsigned short user_operand;
 
 		// If it's DEC, read it in decimal, else in hexadecimal
@@ -425,49 +1623,42 @@ char *CManoAssembler::Assemble( const char *line ) {
 		data += user_operand;
 	}
 
-	// Convert to hex string:
-	IntegerToHex( data, hex_data );
-
 	////////////////////////////////////////////////////////////////////////
 	// CONSTRUCT OUTPUT
 	////////////////////////////////////////////////////////////////////////
+	const int word_address = m_location_counter;
+	char comment[20];
+
 	if( strcmp( instruction, "" ) != 0 ) {
-		IntegerToHex( m_location_counter, buffer );
-		switch (m_format)
+		// Remember which line produced this word:
+		if( strcmp( instruction, "ORG" ) != 0
+			&& strcmp( instruction, "END" ) != 0
+			&& m_location_counter < 4096 )
 		{
-		case normal:
-			// Command m = "Modify memory"
-			strcat( m_instruction, "m\t" );
-
-			// output address to modify:
-			strcat( m_instruction, buffer );
-			strcat( m_instruction, "\t" );
-
-			// output what to store at that address:
-			strcat( m_instruction, hex_data );
+			m_source_lines[m_location_counter] = m_line_number;
+			m_memory.Store( m_location_counter, data );
+			m_constants[m_location_counter] =
+				strcmp( instruction, "HEX" ) == 0
+				|| strcmp( instruction, "DEC" ) == 0;
+		}
 
-			// output a comment indicating the line of code
-			strcat( m_instruction, "\t/ " );
-			break;
-		case verilog:
-			// Output to a format suitable for Verilog $readmemh
-			strcat( m_instruction, "@");
-			strcat( m_instruction, buffer);
-			strcat( m_instruction, "\t");
-			strcat( m_instruction, hex_data);
-			strcat( m_instruction, "\t// ");
-			break;
-		case coe:
-			m_data[m_location_counter] = data;
-			if (m_last_valid_address < m_location_counter)
-				m_last_valid_address = m_location_counter;
-			break;
+		FormatComment( instruction, argument, indirect, comment );
+		FormatWord( m_location_counter, data, comment, m_instruction );
+
+		// Hold on to a word that waits for a label, to patch it once
+		// the label is defined.  AssembleFromFile outputs this line
+		// next:
+		if( forward ) {
+			SFixup fixup;
+			fixup.address = m_location_counter;
+			fixup.line_number = m_line_number;
+			fixup.output = m_output ? (int)m_output->size() : -1;
+			strcpy( fixup.instruction, instruction );
+			strcpy( fixup.indirect, indirect );
+			fixup.data = data;
+			fixup.word = m_record_image ? (int)m_words.size() : -1;
+			m_fixups.insert( make_pair( string( argument ), fixup ) );
 		}
-		strcat( m_instruction, instruction );
-		strcat( m_instruction, " " );
-		strcat( m_instruction, argument );
-		strcat( m_instruction, " " );
-		strcat( m_instruction, indirect );
 	}
 	
 	////////////////////////////////////////////////////////////////////////
@@ -479,20 +1670,33 @@ char *CManoAssembler::Assemble( const char *line ) {
 	catch( CErrorException error ) {
 		// Ignore any errors from updating the location counter.  
 		// The user has already seen them in pass 1, and they are 
-		// all warnings anyway.
+		// all warnings anyway.  Without a pass 1, a fatal error ends
+		// the assembly, and AssembleFromFile reports a warning once
+		// this word is output:
+		if( m_single_pass ) {
+			if( error.GetSeverity() == CErrorException::FATAL ) {
+				throw;
+			}
+			m_warnings.push_back( error );
+		}
 	}
 
 	// If we just tried to assemble an ORG or an END, don't output anything
+	// (the coe image still stores its word):
 	if( strcmp( instruction, "ORG" ) == 0) {
 		m_org_encountered = 1;
+		RecordWord( word_address, data, comment, false );
 		return 0;
 	}
 
 	if( strcmp( instruction, "END" ) == 0 ) {
 		m_end_encountered = 1;
+		RecordWord( word_address, data, comment, false );
 		return 0;
 	}
 
+	// Keep the word now that its line will be output:
+	RecordWord( word_address, data, comment, true );
 	return m_instruction;
 } // Assemble
 
@@ -534,9 +1738,264 @@ void CManoAssembler::UpdateLocationCounter( const char *instruction,
 	
 } // UpdateLocationCounter
 
+//
+// Name:	FormatWord
+//
+void CManoAssembler::FormatWord( int address, unsigned short data, 
+	const char *comment, char *output )
+{
+
+	if (m_format == coe && address < 4096)
+	{
+		m_memory.Store( address, data );
+	}
+
+	FormatLine( m_format, address, data, comment, output );
+
+} // FormatWord
+
+//
+// Name:	FormatLine
+//
+void CManoAssembler::FormatLine( format line_format, int address, 
+	unsigned short data, const char *comment, char *output )
+{
+	char buffer[81];
+	char hex_data[16];
+
+	strcpy( output, "" );
+
+	// Convert to hex string:
+	IntegerToHex( data, hex_data );
+
+	IntegerToHex( address, buffer );
+	switch (line_format)
+	{
+	case normal:
+		// Command m = "Modify memory"
+		strcat( output, "m\t" );
+
+		// output address to modify:
+		strcat( output, buffer );
+		strcat( output, "\t" );
+
+		// output what to store at that address:
+		strcat( output, hex_data );
+
+		// output a comment indicating the line of code
+		strcat( output, "\t/ " );
+		break;
+	case verilog:
+		// Output to a format suitable for Verilog $readmemh
+		strcat( output, "@");
+		strcat( output, buffer);
+		strcat( output, "\t");
+		strcat( output, hex_data);
+		strcat( output, "\t// ");
+		break;
+	case coe:
+		break;
+	}
+	strcat( output, comment );
+
+} // FormatLine
+
+//
+// Name:	FormatComment
+//
+void CManoAssembler::FormatComment( const char *instruction, 
+	const char *argument, const char *indirect, char *comment )
+{
+
+	strcpy( comment, instruction );
+	strcat( comment, " " );
+	strcat( comment, argument );
+	strcat( comment, " " );
+	strcat( comment, indirect );
+
+} // FormatComment
+
+//
+// Name:	RecordWord
+//
+void CManoAssembler::RecordWord( int address, unsigned short data, 
+	const char *comment, bool listed )
+{
+
+	if( !m_record_image ) {
+		return;
+	}
+
+	SImageWord word;
+	word.address = address;
+	word.data = data;
+	word.listed = listed;
+	strcpy( word.comment, comment );
+	m_words.push_back( word );
+
+} // RecordWord
+
+//
+// Name:	BuildCoeImage
+//
+void CManoAssembler::BuildCoeImage( const CMemoryImage &memory, 
+	string &image )
+{
+	char word[5];
+
+	// The vector runs from 0 to the last word stored, with the gaps
+	// between segments as 0:
+	const unsigned last_valid_address = memory.IsEmpty() 
+		? 0 : memory.GetEnd() - 1;
+	size_t segment = 0;
+
+	image.assign( "memory_initialization_radix=16;\n"
+		"memory_initialization_vector=\n" );
+	for (unsigned address = 0; ; address++)
+	{
+		unsigned short data = 0;
+
+		while (segment < memory.GetSegmentCount()
+			&& memory.GetSegment( segment ).start 
+				+ memory.GetSegment( segment ).words.size() <= address)
+			segment++;
+		if (segment < memory.GetSegmentCount()
+			&& memory.GetSegment( segment ).start <= address)
+		{
+			const CMemoryImage::SSegment &stored = 
+				memory.GetSegment( segment );
+			data = stored.words[address - stored.start];
+		}
+
+		IntegerToHex( data, word );
+		image.append( word, 4 );
+		if (address == last_valid_address)
+		{
+			image.append( ";\n" );
+			return;
+		}
+		image += ',';
+		if (address % 8 == 7)
+			image += '\n';
+	}
+
+} // BuildCoeImage
+
+//
+// Name:	DefineSymbol
+//
+void CManoAssembler::DefineSymbol( const char *label ) {
+
+	// Process the label only if it exists, that is:
+	if( strcmp( label, "" ) == 0 ) {
+		return;
+	}
+
+	// Check to see if this symbol already exists:
+	if( m_collect_stats ) {
+		m_stats.lookups++;
+	}
+	if( m_symbol_table->GetAddress( label ) != -1 ) {
+		throw CErrorException( m_file_name, m_line_number, 
+			"A2000", "Duplicate symbol encountered", 
+			CErrorException::ERROR );
+	}
+
+	// Add the label and its associated address to the symbol 
+	// table:
+	m_symbol_table->AddSymbol( label, m_location_counter );
+
+	// Patch the words that were waiting for it:
+	typedef fixup_map::iterator fixup_iterator;
+	const pair<fixup_iterator, fixup_iterator> waiting =
+		m_fixups.equal_range( label );
+	if( waiting.first != waiting.second ) {
+		char argument[11];
+		IntegerToHex( m_location_counter, argument );
+
+		for( fixup_iterator fixup = waiting.first;
+			fixup != waiting.second; fixup++ )
+		{
+			PatchFixup( fixup->second, 
+				(unsigned short)m_location_counter, argument );
+		}
+		m_fixups.erase( waiting.first, waiting.second );
+	}
+
+} // DefineSymbol
+
+//
+// Name:	PatchFixup
+//
+void CManoAssembler::PatchFixup( const SFixup &fixup, 
+	unsigned short operand, const char *argument )
+{
+	char buffer[81];
+	char comment[20];
+	const unsigned short data = (unsigned short)(fixup.data + operand);
+
+	// A later ORG section may have assembled over the word since, and
+	// then only its line of output and its recorded word change:
+	if( fixup.address < 4096 
+		&& m_source_lines[fixup.address] == fixup.line_number ) 
+	{
+		m_memory.Store( fixup.address, data );
+	}
+
+	FormatComment( fixup.instruction, argument, fixup.indirect, comment );
+	FormatLine( m_format, fixup.address, data, comment, buffer );
+
+	// Patch the recorded word where it was recorded, so that a word
+	// stored over it later still comes after it:
+	if( m_record_image && fixup.word >= 0 
+		&& (size_t)fixup.word < m_words.size() ) 
+	{
+		m_words[fixup.word].data = data;
+		strcpy( m_words[fixup.word].comment, comment );
+	}
+
+	if( m_output && fixup.output >= 0 
+		&& (size_t)fixup.output < m_output->size() )
+	{
+		(*m_output)[fixup.output] = buffer;
+	}
+
+} // PatchFixup
+
+//
+// Name:	ResolveFixups
+//
+int CManoAssembler::ResolveFixups() {
+
+	int undeclared = 0;
+
+	// A symbol's fixups sit together, so each name is looked at once.
+	// As in pass 2, a name no label was defined for may be a number:
+	fixup_map::iterator fixup = m_fixups.begin();
+	while( fixup != m_fixups.end() ) {
+		const fixup_map::iterator last = m_fixups.upper_bound( fixup->first );
+		const char *symbol = fixup->first.c_str();
+		if ( IsHexNumeric( symbol ) ) {
+			const unsigned short operand = HexToInteger( symbol );
+			for( ; fixup != last; fixup++ ) {
+				PatchFixup( fixup->second, operand, symbol );
+			}
+		}
+		else {
+			undeclared += (int)distance( fixup, last );
+			fixup = last;
+		}
+	}
+	m_fixups.clear();
+
+	return undeclared;
+
+} // ResolveFixups
+
 //
 // Name:	Parse
 //
+
 void CManoAssembler::Parse( const char *line, char *label, 
 			    char *instruction, char *argument, 
 			    char *indirect )
@@ -544,12 +2003,22 @@ void CManoAssembler::Parse( const char *line, char *label,
 	char local[81];
 	SInstruction instruction_info;
 
+	// Take what the source index found on this line, if anything:
+	const SSourceLine *hint = m_line_hint;
+	m_line_hint = 0;
+
 	// Make a local copy of the line that we can manipulate.
 	strncpy( local, line, 80 );
 
 	// Find the comment, if it exists, and strip it off.
 	char *p;
-	p = strchr( local, '/' );
+	if( hint ) {
+		p = (hint->comment >= 0 && hint->comment < 80) 
+			? local + hint->comment : NULL;
+	}
+	else {
+		p = strchr( local, '/' );
+	}
 	if( p != NULL ) {
 		*p = 0;
 	}
@@ -560,6 +2029,14 @@ void CManoAssembler::Parse( const char *line, char *label,
 	strcpy( instruction, "" );
 	strcpy( argument, "" );
 	strcpy( indirect, "" );
+
+	// A line the index found nothing but whitespace on is blank (if
+	// it ends within the stream below):
+	if( hint && hint->first < 0 
+		&& (hint->comment >= 0 ? hint->comment : hint->length) < 78 ) 
+	{
+		return;
+	}
 	
 	// Construct an input stream, and eat any white space:
 	istrstream input( local, 78 );
@@ -573,7 +2050,7 @@ void CManoAssembler::Parse( const char *line, char *label,
 	////////////////////////////////////////////////////////////////////////
 	// SEARCH FOR AND PARSE LABEL
 	////////////////////////////////////////////////////////////////////////
-	if( strchr( local, ',' ) != 0 ) {
+	if( hint ? hint->comma >= 0 : strchr( local, ',' ) != 0 ) {
 		SearchAndParseLabel( label, input );
 	}
 	input >> ws;
@@ -717,6 +2194,15 @@ void CManoAssembler::SetLineNumber( int number ) {
 	
 } // SetLineNumber
 
+//
+// Name:	SetLineHint
+//
+void CManoAssembler::SetLineHint( const SSourceLine *hint ) {
+
+	m_line_hint = hint;
+
+} // SetLineHint
+
 //
 // Name:	SetFileName
 //
@@ -744,6 +2230,81 @@ bool CManoAssembler::OrgEncountered() const {
 
 } // OrgEncountered
 
+//
+// Name:	GetErrorCount
+//
+int CManoAssembler::GetErrorCount() const {
+
+	return m_error_count;
+
+} // GetErrorCount
+
+//
+// Name:	GetSourceLine
+//
+int CManoAssembler::GetSourceLine( int address ) const {
+
+	if( address < 0 || address >= 4096 ) {
+		return -1;
+	}
+
+	return m_source_lines[address];
+
+} // GetSourceLine
+
+//
+// Name:	GetWord
+//
+unsigned short CManoAssembler::GetWord( int address ) const {
+
+	if( address < 0 || address >= 4096 || m_source_lines[address] < 0 ) {
+		return 0;
+	}
+
+	return m_memory.Fetch( address );
+
+} // GetWord
+
+//
+// Name:	GetImage
+//
+const CMemoryImage &CManoAssembler::GetImage() const {
+
+	return m_memory;
+
+} // GetImage
+
+//
+// Name:	IsConstant
+//
+bool CManoAssembler::IsConstant( int address ) const {
+
+	if( address < 0 || address >= 4096 ) {
+		return false;
+	}
+
+	return m_constants[address];
+
+} // IsConstant
+
+//
+// Name:	GetSource
+//
+const CStringList &CManoAssembler::GetSource() const {
+
+	return m_source;
+
+} // GetSource
+
+//
+// Name:	GetSymbolTable
+//
+const CSymbolTable &CManoAssembler::GetSymbolTable() const {
+
+	return *m_symbol_table;
+
+} // GetSymbolTable
+
 //
 // Name:	Disassemble
 //
@@ -838,6 +2399,204 @@ void CManoAssembler::DumpSymbolTable( ostream &out ) {
 
 } // DumpSymbolTable
 
+//
+// Name:	WriteImage
+//
+void CManoAssembler::WriteImage( format image_format, ostream &out ) const {
+	char line[81];
+	size_t w;
+
+	// A listing has a line per word that was output:
+	if( image_format != coe ) {
+		for( w = 0; w < m_words.size(); w++ ) {
+			const SImageWord &word = m_words[w];
+
+			if( word.listed ) {
+				FormatLine( image_format, word.address, word.data, 
+					word.comment, line );
+				out << line << '\n';
+			}
+		}
+		return;
+	}
+
+	// A coe image stores every word in turn, as the assembly did:
+	if( !m_image_complete ) {
+		return;
+	}
+
+	CMemoryImage memory;
+	for( w = 0; w < m_words.size(); w++ ) {
+		const SImageWord &word = m_words[w];
+
+		if( word.address < 4096 ) {
+			memory.Store( word.address, word.data );
+		}
+	}
+
+	string image;
+	BuildCoeImage( memory, image );
+	out << image << '\n';
+
+} // WriteImage
+
+//
+// Name:	WriteBinaryImage
+//
+void CManoAssembler::WriteBinaryImage( ostream &out ) const {
+	size_t w;
+
+	if( !m_image_complete ) {
+		return;
+	}
+
+	// Store the words that were output, in turn, as a loader would:
+	CMemoryImage memory;
+	for( w = 0; w < m_words.size(); w++ ) {
+		const SImageWord &word = m_words[w];
+
+		if( word.listed && word.address < 4096 ) {
+			memory.Store( word.address, word.data );
+		}
+	}
+
+	unsigned char header[IMAGE_HEADER_SIZE];
+	memcpy( header, IMAGE_MAGIC, strlen( IMAGE_MAGIC ) );
+	header[strlen( IMAGE_MAGIC )] = IMAGE_VERSION;
+	PutFixed( header + 8, (unsigned long)memory.GetSegmentCount(), 4 );
+	out.write( (const char *)header, IMAGE_HEADER_SIZE );
+
+	vector<unsigned char> bytes;
+	for( size_t segment = 0; segment < memory.GetSegmentCount();
+		segment++ )
+	{
+		const CMemoryImage::SSegment &stored =
+			memory.GetSegment( segment );
+
+		bytes.resize( IMAGE_SEGMENT_HEADER_SIZE
+			+ 2 * stored.words.size() );
+		PutFixed( &bytes[0], stored.start, 2 );
+		PutFixed( &bytes[2], (unsigned long)stored.words.size(), 2 );
+		for( w = 0; w < stored.words.size(); w++ ) {
+			PutFixed( &bytes[IMAGE_SEGMENT_HEADER_SIZE + 2 * w],
+				stored.words[w], 2 );
+		}
+		out.write( (const char *)&bytes[0], (streamsize)bytes.size() );
+	}
+
+} // WriteBinaryImage
+
+//
+// Name:	WriteProgram
+//
+void CManoAssembler::WriteProgram( ostream &out ) const {
+	unsigned char field[PROGRAM_LINE_SIZE];
+
+	if( !m_image_complete ) {
+		return;
+	}
+
+	// The sections, in id order:
+	static const unsigned long ids[] = { PROGRAM_SECTION_IMAGE,
+		PROGRAM_SECTION_STRINGS, PROGRAM_SECTION_SYMBOLS,
+		PROGRAM_SECTION_LINES, PROGRAM_SECTION_SOURCE };
+	const size_t count = sizeof( ids ) / sizeof( ids[0] );
+	string sections[count];
+	string &strings = sections[1];
+	map<string, unsigned long> offsets;
+
+	// The image, as WriteBinaryImage writes it:
+	ostringstream image;
+	WriteBinaryImage( image );
+	sections[0] = image.str();
+
+	// The symbols, by address:
+	const CSymbolTable::symbol_map &symbols = m_symbol_table->GetSymbols();
+	vector< pair<int, string> > sorted;
+	for( CSymbolTable::symbol_map::const_iterator i = symbols.begin();
+		i != symbols.end();
+		i++ )
+	{
+		sorted.push_back( make_pair( i->second, i->first ) );
+	}
+	sort( sorted.begin(), sorted.end() );
+
+	for( size_t i = 0; i < sorted.size(); i++ ) {
+		PutFixed( field, InternString( sorted[i].second, strings,
+			offsets ), 4 );
+		PutFixed( field + 4, (unsigned long)sorted[i].first, 4 );
+		sections[2].append( (const char *)field, PROGRAM_SYMBOL_SIZE );
+	}
+
+	// The lines, as runs of addresses from consecutive lines:
+	int start = 0, run = 0, first = 0;
+	for( int address = 0; address <= 4096; address++ ) {
+		const int line = address < 4096 ? m_source_lines[address] : -1;
+
+		if( run && line >= 0 && address == start + run
+			&& line + 1 == first + run )
+		{
+			run++;
+			continue;
+		}
+		if( run ) {
+			PutFixed( field, (unsigned long)start, 2 );
+			PutFixed( field + 2, (unsigned long)run, 2 );
+			PutFixed( field + 4, (unsigned long)first, 4 );
+			sections[3].append( (const char *)field,
+				PROGRAM_LINE_SIZE );
+		}
+		start = address;
+		run = line >= 0 ? 1 : 0;
+		first = line + 1;
+	}
+
+	// The source file:
+	PutFixed( field, InternString( m_file_name ? m_file_name : "",
+		strings, offsets ), 4 );
+	PutFixed( field + 4, (unsigned long)m_source.size(), 4 );
+	sections[4].append( (const char *)field, PROGRAM_SOURCE_HEADER_SIZE );
+	for( size_t line = 0; line < m_source.size(); line++ ) {
+		PutFixed( field, InternString( m_source[line], strings,
+			offsets ), 4 );
+		sections[4].append( (const char *)field, 4 );
+	}
+
+	// The header and the directory, then the sections in turn:
+	string head( PROGRAM_HEADER_SIZE + count * PROGRAM_ENTRY_SIZE, '\0' );
+	unsigned char *bytes = (unsigned char *)&head[0];
+	memcpy( bytes, PROGRAM_MAGIC, strlen( PROGRAM_MAGIC ) );
+	bytes[strlen( PROGRAM_MAGIC )] = PROGRAM_VERSION;
+	PutFixed( bytes + 8, (unsigned long)count, 4 );
+
+	unsigned long offset = (unsigned long)head.size();
+	for( size_t section = 0; section < count; section++ ) {
+		unsigned char *entry = bytes + PROGRAM_HEADER_SIZE
+			+ section * PROGRAM_ENTRY_SIZE;
+
+		offset = (offset + PROGRAM_ALIGNMENT - 1)
+			& ~(unsigned long)(PROGRAM_ALIGNMENT - 1);
+		PutFixed( entry, ids[section], 4 );
+		PutFixed( entry + 4, offset, 4 );
+		PutFixed( entry + 8, (unsigned long)sections[section].size(), 4 );
+		offset += (unsigned long)sections[section].size();
+	}
+	out.write( head.data(), (streamsize)head.size() );
+
+	offset = (unsigned long)head.size();
+	for( size_t section = 0; section < count; section++ ) {
+		static const char padding[PROGRAM_ALIGNMENT] = { 0 };
+
+		const unsigned long pad = (PROGRAM_ALIGNMENT
+			- offset % PROGRAM_ALIGNMENT) % PROGRAM_ALIGNMENT;
+		out.write( padding, (streamsize)pad );
+		out.write( sections[section].data(),
+			(streamsize)sections[section].size() );
+		offset += pad + (unsigned long)sections[section].size();
+	}
+
+} // WriteProgram
+
 //
 // Name:	SearchAndParseLabel
 //
@@ -853,6 +2612,7 @@ void CManoAssembler::SearchAndParseLabel( char *label, istrstream &input ) {
 	
 	// Create a temporary input stream so we can strip spaces:
 	istrstream lstream( word, 80 );
+	strcpy( buffer, "" );	// Nothing before the comma is no label
 	lstream >> buffer;
 	
 	// Copy buffer into label, up to 32 characters:
@@ -1062,6 +2822,24 @@ bool CManoAssembler::GetInstructionInfo( const char *name, SInstruction *info )
 
 } // GetInstructionInfo
 
+//
+// Name:	GetInstructionCount
+//
+unsigned CManoAssembler::GetInstructionCount() {
+
+	return NUM_VALID_INSTRUCTIONS;
+
+} // GetInstructionCount
+
+//
+// Name:	GetInstruction
+//
+const SInstruction &CManoAssembler::GetInstruction( unsigned index ) {
+
+	return m_instruction_list[index];
+
+} // GetInstruction
+
 
 //
 // Name:	m_instruction_list
@@ -20,7 +20,15 @@
 //		2. Call the AssembleFromFile function, and pass it a file, or
 //		   "con" to assemble from DOS input, or "stdin" to assemble
 //		   from UNIX standard input.  Pass in a CStringList object to
-//		   hold the output of the compilation.
+//		   hold the output of the compilation.  AssembleFromText
+//		   does the same for a source already in memory.
+//
+// Single-pass Usage:
+//
+//		1. create one instance of this class, and call SetSinglePass
+//		2. Call AssembleFromFile as above.  Each line is encoded as it
+//		   is read, so "stdin" is read only once; the lines after the
+//		   END are kept for GetSource.
 //
 // Notes:
 //
@@ -33,23 +41,102 @@
 //		because they will be incomplete.  If the severity is fatal, 
 //		immediately abort the assembly.
 //
+//		In single-pass mode Assemble defines labels itself.  A word
+//		that names a label not yet defined (unless its operand can
+//		only be a hex number) is assembled with operand 0 and
+//		recorded in a fixup list, and patched (with its line of
+//		output) when the label is defined; memory is only patched if
+//		no later ORG section has assembled over the word.  Fixups
+//		still open at the END take the operand as a hex number, as
+//		pass 2 would, or are undeclared symbols.  Those are held
+//		back: if the pass found errors pass 1 would have found, the
+//		output is dropped, as two passes give none; otherwise the
+//		source is assembled again as pass 2 would, since pass 2 moves
+//		every word after an undeclared symbol back.  The output and
+//		error messages are the same as in two passes.
+//
+//		Pass 1 of a source long enough to give each thread at least
+//		PARALLEL_CHUNK_LINES lines is split into chunks that are
+//		parsed in parallel.  Each chunk records how far it moves the
+//		location counter (or where it leaves it, after an ORG) and
+//		its labels relative to that; a prefix scan over the chunks
+//		gives their start addresses, and the labels are merged in
+//		line order.  If any chunk finds an error, or the merge finds
+//		a duplicate label or an address past FFF, the chunks' lines
+//		and instructions are gone over in line order instead (not
+//		parsed again), so errors are reported just as before.
+//
+//		Pass 2 then encodes the same chunks in parallel, each from
+//		its start address and against the finished symbol table.
+//		Each line's word, comment and line of output go in its own
+//		slot of m_encoded; the slots are taken in line order, so ORG
+//		sections that overwrite each other end up as they would
+//		serially.  Each chunk keeps its errors, and they are
+//		reported in line order; since a line that names an
+//		undeclared symbol stores no word, the chunks after it are
+//		encoded again from where the chunk before them really ends,
+//		by the same workers.
+//
+//		AssembleFromFile reads the source through a CSourceIndex,
+//		and passes what it knows about each line to Parse with
+//		SetLineHint, so Parse need not look for the comment and the
+//		label comma, or parse a blank line.
+//
+//		An assembler can be reused: call Reset, Rewind the output
+//		list, and call AssembleFromFile again.  Once a source has
+//		been assembled, assembling it (or one no bigger) again takes
+//		nothing from the heap: the symbol table and the fixups live
+//		in arenas that Reset rewinds, the source, output and index
+//		keep their strings and buffers, and a single pass reads
+//		through m_read_buffer.  Errors, -O and parallel passes still
+//		allocate, as do labels too long for a string's own storage.
+//
+//		The words assembled are kept in a CMemoryImage, as segments
+//		of contiguous words, so a program placed in a few pieces
+//		with ORG takes room only for its words.  The coe image is
+//		still dense: it runs from 0 to the last word, with 0 in the
+//		gaps.
+//
+//		With SetRecordImage on, the assembler also keeps every word
+//		it formats, in order: address, data and comment, and whether
+//		it has a line of output (ORG and END do not, but the coe
+//		image stores them too).  WriteImage then writes the result
+//		in any format from these words, so one assembly can give
+//		normal, verilog and coe files alike; it only reads the
+//		words, so several formats may be written from threads at
+//		once.  WriteBinaryImage writes the words that have lines
+//		as a binary image instead, and WriteProgram those with the
+//		symbols and source lines.  A single pass patches the
+//		recorded word of a fixup where it was recorded.
+//
 // Revision History:
 //		0.0:	Initial Revision
 //
 
 #pragma once
 
+#include "Arena.hpp"
+#include "MemoryImage.hpp"
+#include "SourceIndex.hpp"
 #include "StringList.hpp"
 #include "SymbolTable.hpp"
 #include "ErrorException.hpp"
 #include "Instruction.hpp"
 
+#include <condition_variable>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
 #include <strstream>
+#include <vector>
 
 // Number of valid instructions and pseudo-instructions:
 #define NUM_VALID_INSTRUCTIONS	29
 
+// Fewest lines each thread of a parallel pass scans:
+#define PARALLEL_CHUNK_LINES	4096
+
 class CManoAssembler {
 public:
 	enum format
@@ -59,6 +146,29 @@ public:
 		coe
 	} m_format;
 
+	// What the last AssembleFromFile (or AssembleFromText) did, when
+	// SetCollectStats is on.  A single pass reads as it assembles,
+	// so its reading is part of pass1_ns; phases an assembly did not
+	// reach stay 0.
+	struct SAssemblyStats {
+		unsigned long long read_ns;	// Reading and indexing the source
+		unsigned long long optimize_ns;	// The peephole pass
+		unsigned long long pass1_ns;	// Pass 1, or the single pass
+		unsigned long long pass2_ns;	// Pass 2
+		unsigned long long emit_ns;	// The result, symbol table and
+						// coe image
+		unsigned long long total_ns;	// All of it
+		unsigned long long lines;	// Source lines read
+		unsigned long long symbols;	// Symbols defined
+		unsigned long long lookups;	// Symbol table lookups
+		unsigned long long bytes;	// Bytes of output, as
+						// CStringList::Dump writes them
+		std::map<std::string, unsigned long long> diagnostics;
+						// Messages reported, by code
+		std::string	fatal;		// Code of the fatal error that
+						// ended it, or empty
+	};
+
 public:	// Construction / Destruction
 
 	//
@@ -103,6 +213,90 @@ public: // Automated Assembly from file:
 	void AssembleFromFile( const char *filename, CStringList &output_list,
 		std::ostream &status_stream = std::cout, std::ostream &error_stream = std::cerr );
 
+	//
+	// Name:		AssembleFromText
+	//
+	// Description:	As AssembleFromFile, for a source held in memory.
+	// Arguments:	The name to report errors against (it must outlive
+	//		the call), the source text, and as AssembleFromFile
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	//
+	void AssembleFromText( const char *name, const std::string &text,
+		CStringList &output_list, std::ostream &status_stream = std::cout,
+		std::ostream &error_stream = std::cerr );
+
+	//
+	// Name:		SetOptimize
+	//
+	// Description:	Turns the peephole pass (see CPeepholeOptimizer)
+	//		on or off for AssembleFromFile.  It is off by default.
+	// Arguments:	true to optimize
+	// Modifies:	m_optimize
+	//
+	void SetOptimize( bool optimize );
+
+	//
+	// Name:		SetSinglePass
+	//
+	// Description:	Makes AssembleFromFile assemble in one pass,
+	//		backpatching forward references.  It is off by default.
+	//		With the peephole pass on, the whole source is still
+	//		read before it is assembled.
+	// Arguments:	true to assemble in one pass
+	// Modifies:	m_single_pass
+	//
+	void SetSinglePass( bool single_pass );
+
+	//
+	// Name:		SetThreads
+	//
+	// Description:	Sets how many threads AssembleFromFile may use.  It
+	//		defaults to the number of hardware threads.
+	// Arguments:	The number of threads; 1 assembles serially
+	// Modifies:	m_threads
+	//
+	void SetThreads( unsigned threads );
+
+	//
+	// Name:		SetRecordImage
+	//
+	// Description:	Makes AssembleFromFile keep the words it formats, for
+	//		WriteImage.  It is off by default.
+	// Arguments:	true to keep them
+	// Modifies:	m_record_image
+	//
+	void SetRecordImage( bool record );
+
+public:	// Statistics
+
+	//
+	// Name:		SetCollectStats
+	//
+	// Description:	Turns timing and counting of AssembleFromFile on or
+	//		off.  It is off by default, and then costs a test of
+	//		a flag per phase and per symbol lookup.
+	// Arguments:	true to collect statistics
+	// Modifies:	m_collect_stats
+	//
+	void SetCollectStats( bool collect );
+
+	//
+	// Name:		GetStats
+	//
+	// Returns:	The statistics of the last assembly made with them
+	//		on.
+	//
+	const SAssemblyStats &GetStats() const;
+
+	//
+	// Name:		WriteStats
+	//
+	// Description:	Writes the statistics of GetStats as one line of
+	//		JSON, without the line end.
+	// Arguments:	The stream to write to
+	//
+	void WriteStats( std::ostream &out ) const;
+
 public:	// Parsing / Assembly
 
 	//
@@ -149,6 +343,18 @@ public:	// Parsing / Assembly
 	//
 	void SetLineNumber( int number );
 
+	//
+	// Name:	SetLineHint
+	//
+	// Description:	Tells the next Parse what the source index found on
+	//		the line it is given: where its comment and label
+	//		comma are, and whether it is blank.  Parse forgets it
+	//		once used.
+	// Arguments:	The index's description of the line, or 0
+	// Modifies:	m_line_hint
+	//
+	void SetLineHint( const SSourceLine *hint );
+
 	//
 	// Name:		SetFileName
 	//
@@ -175,6 +381,146 @@ public:	// Parsing / Assembly
 	//
 	bool OrgEncountered() const;
 
+	//
+	// Name:		GetErrorCount
+	//
+	// Returns:		The number of errors found by the last call to
+	//			AssembleFromFile.
+	//
+	int GetErrorCount() const;
+
+public:		// Source information
+
+	//
+	// Name:		GetSourceLine
+	//
+	// Description:	Finds the line of code that was assembled into a
+	//		given address during pass 2.
+	// Arguments:	The address to look up
+	// Returns:	The line number (as passed to SetLineNumber), or -1
+	//		if nothing was assembled at that address.
+	//
+	int GetSourceLine( int address ) const;
+
+	//
+	// Name:		GetWord
+	//
+	// Returns:		The word assembled at an address during pass 2, or 0
+	//			if nothing was assembled there.
+	//
+	unsigned short GetWord( int address ) const;
+
+	//
+	// Name:		GetImage
+	//
+	// Returns:		The words assembled by the last AssembleFromFile, as
+	//			segments.  For coe they include ORG and END, as the
+	//			coe image does.
+	//
+	const CMemoryImage &GetImage() const;
+
+	//
+	// Name:		IsConstant
+	//
+	// Returns:		true if the word at an address was assembled from
+	//			HEX or DEC.
+	//
+	bool IsConstant( int address ) const;
+
+	//
+	// Name:		GetSource
+	//
+	// Returns:		The source read by the last AssembleFromFile, as
+	//			the optimizer left it.  GetSourceLine indexes it.
+	//
+	const CStringList &GetSource() const;
+
+	//
+	// Name:		GetSymbolTable
+	//
+	// Returns:		The symbol table built during pass 1.
+	//
+	const CSymbolTable &GetSymbolTable() const;
+
+public:		// Grammar
+
+	//
+	// Name:		Parse
+	//
+	// Description:	Parses a line into it's label, instruction, 
+	//		argument, and indirect flag.
+	// Arguments:	The line to parse, pointers to the strings
+	//		to receive the label and instruction (both no
+	//		more than 3 characters), a pointer to store
+	//		the argument (up to 10 characters), and a pointer
+	//		to receive the indirect flat (up to 1 character)
+	// Exceptions:	Throws a CErrorException if there are parsing errors
+	//
+	void Parse( const char *line, char *label, char *instruction, 
+		char *argument, char *indirect );
+
+	//
+	// Name:	GetInstructionCount
+	//
+	// Returns:	The number of instructions and pseudo-instructions
+	//		the assembler knows.
+	//
+	static unsigned GetInstructionCount();
+
+	//
+	// Name:	GetInstruction
+	//
+	// Returns:	Information about an instruction, by its index in the
+	//		instruction table (below GetInstructionCount).
+	//
+	static const SInstruction &GetInstruction( unsigned index );
+
+	//
+	// Name:	GetInstructionInfo
+	//
+	// Description:	Obtains information about a given instruction
+	// Arguments:	The name of the instruction, and a pointer to where to
+	//		store the instruction information
+	// Returns:	1 if the instruction exists, or else 0.
+	//
+	bool GetInstructionInfo( const char *name, SInstruction *info ) const;
+
+	//
+	// Name:	IsValidIdentifier
+	//
+	// Description:	Determines if a given string is a valid identifier.
+	//		An identifier is valid if all of these hold true:
+	//			1. It is 3 characters or less
+	//			2. The first character is alphabetic [A-Z]
+	//			3. All remaining characters are 
+	//			   alphanumeric [A-Z0-9]
+	// Arguments:	The identifier to examine
+	// Returns:	1 if the identifier is valid, or 0 otherwise.
+	//
+	static bool IsValidIdentifier( char *identifier );
+
+	//
+	// Name:	IsHexNumeric
+	//
+	// Description:	Determines if a given string is hexnumeric
+	//		A string is hexnumeric if all of these hold true:
+	//		    1. The first character is -, or [0-9][A-F]
+	//		    2. The remaining characters are [0-9][A-F]
+	// Arguments:	The string to examine
+	// Returns:	1 if the string is numeric, or 0 otherwise.
+	//
+	static bool IsHexNumeric( const char *str );
+
+	//
+	// Name		HexToInteger
+	//
+	// Description:	Converts a hexadecimal string to an integer
+	// Arguments:	The string to convert
+	// Returns:	An unsigned long value, that is the integer that
+	//		hex string represents.
+	//
+	static unsigned short HexToInteger( const char *str );
+
 public:		// Disassembly
 
 	//
@@ -197,8 +543,445 @@ public:		// Output
 	//
 	void DumpSymbolTable( std::ostream &out );
 
+	//
+	// Name:		WriteImage
+	//
+	// Description:	Writes the result of the last assembly, as
+	//		CStringList::Dump would write its output list had it
+	//		been assembled in the given format.  The assembly must
+	//		have been made with SetRecordImage on.  A coe image is
+	//		only written if the assembly succeeded.
+	// Arguments:	The format, and the stream to write to
+	//
+	void WriteImage( format image_format, std::ostream &out ) const;
+
+	//
+	// Name:		WriteBinaryImage
+	//
+	// Description:	Writes the words of the last assembly as a binary
+	//		image (see ImageFormat.hpp): the memory a normal or
+	//		verilog output would load.  As for WriteImage, the
+	//		assembly must have been made with SetRecordImage on,
+	//		and nothing is written unless it succeeded.
+	// Arguments:	The stream to write to, opened in binary mode
+	//
+	void WriteBinaryImage( std::ostream &out ) const;
+
+	//
+	// Name:		WriteProgram
+	//
+	// Description:	Writes the last assembly as a program file (see
+	//		ProgramFormat.hpp): its binary image, its symbols, the
+	//		line assembled at each address and the source text.
+	//		As for WriteBinaryImage, the assembly must have been
+	//		made with SetRecordImage on, and nothing is written
+	//		unless it succeeded.
+	// Arguments:	The stream to write to, opened in binary mode
+	//
+	void WriteProgram( std::ostream &out ) const;
+
+protected: // Types
+
+	// A word that names a label not yet defined (single-pass mode):
+	struct SFixup {
+		int		address;	// Address of the word
+		int		line_number;	// Line it was assembled from
+		int		output;		// Index of its output line, or -1
+		char		instruction[4];	// Its mnemonic
+		char		indirect[2];	// Its indirect flag
+		unsigned short	data;		// The word without its operand
+		int		word;		// Index of its image word, or -1
+	};
+
+	// A word formatted by the last assembly, for WriteImage:
+	struct SImageWord {
+		int		address;	// Where
+		unsigned short	data;		// What
+		bool		listed;		// Has a line of output (not ORG
+						// or END)
+		char		comment[20];	// Its instruction, argument and
+						// indirect flag
+	};
+
+	// Fixups by the label they name, in m_arena:
+	typedef std::multimap<std::string, SFixup, std::less<std::string>,
+		CArenaAllocator<std::pair<const std::string, SFixup> > >
+		fixup_map;
+
+	// A label found by a chunk of a parallel pass 1:
+	struct SChunkLabel {
+		std::string	name;		// The label
+		unsigned	line;		// The line it is on
+		int		offset;		// Its address, relative to the
+						// chunk start unless absolute
+		bool		absolute;	// An ORG came before it
+	};
+
+	// A line with an instruction, found by a chunk of a parallel pass
+	// 1 (for ReplayPass1):
+	struct SChunkStep {
+		unsigned	line;		// The line
+		int		org;		// Its ORG address, or -1 for a
+						// word, or -2 for END
+	};
+
+	// What a line assembled to in a parallel pass 2:
+	struct SEncodedLine {
+		int		address;	// Where, or -1 if nothing (no
+						// instruction, or an error)
+		unsigned short	data;		// What
+		bool		listed;		// Has a line of output (not ORG
+						// or END)
+		bool		constant;	// Assembled from HEX or DEC
+		char		comment[20];	// As in SImageWord
+		char		output[80];	// Its line of output, if listed
+	};
+
+	// Chunks a parallel pass 2 has still to encode, for its workers:
+	struct SEncodeWork {
+		std::mutex	mutex;		// Guards the rest
+		std::condition_variable ready;	// Signals pending and stopping
+		std::condition_variable done;	// Signals remaining reaching 0
+		std::vector<size_t> pending;	// Chunks of this round
+		size_t		next;		// Next of them to take
+		size_t		remaining;	// Of them not yet encoded
+		bool		stopping;	// No more rounds
+	};
+
+	// A chunk of a parallel pass 1, and of pass 2 after it:
+	struct SChunk {
+		unsigned	first;		// First line
+		unsigned	last;		// Line after the last
+		int		delta;		// Location counter at the end,
+						// relative unless absolute
+		bool		absolute;	// Contains an ORG
+		int		peak;		// Words before the first ORG
+		int		first_word;	// Line of the first word before
+						// any ORG, or -1
+		bool		overflow;	// Passed FFF after an ORG
+		bool		end;		// Ends with END
+		bool		first_end;	// Its first word, before any
+						// ORG, is an END it went past
+		std::vector<CErrorException> diagnostics; // Lines that did
+						// not parse (or, in pass 2,
+						// assemble), in order; the
+						// last may be too long (fatal)
+		std::vector<SChunkLabel> labels;	// Its labels, in order
+		std::vector<SChunkStep> steps;		// Its instructions, in
+							// order
+		int		start;		// Location counter at its first
+						// line, after pass 1
+		int		finish;		// Location counter after its
+						// last line, after pass 2
+		unsigned long long lookups;	// Pass 2 symbol lookups
+	};
+
 protected: // Utility functions
 
+	//
+	// Name:		ParallelPass1
+	//
+	// Description:	Runs pass 1 over chunks of the source in parallel,
+	//		if it is long enough.  If pass 1 finds anything wrong,
+	//		ReplayPass1 reports it.
+	// Arguments:	The source
+	//		the stream to send error messages to
+	//		the error and warning counts to add to.
+	// Returns:	true if pass 1 is done; false if the source is too
+	//		short to split, and pass 1 should be run serially
+	//		(nothing has been changed).
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	// Modifies:	m_symbol_table, m_location_counter, m_org_encountered,
+	//		m_end_encountered, m_chunks
+	//
+	bool ParallelPass1( const CStringList &source,
+		std::ostream &error_stream, int &errors, int &warnings );
+
+	//
+	// Name:		ReplayPass1
+	//
+	// Description:	Goes over what the chunks of a parallel pass 1
+	//		found, line by line without parsing again, as the
+	//		serial pass 1 would: it reports the lines that did not
+	//		parse, duplicate symbols, a missing ORG and a location
+	//		counter past FFF in line order, and fills in the symbol
+	//		table.
+	// Arguments:	The stream to send error messages to
+	//		the error and warning counts to add to.
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	// Modifies:	m_symbol_table, m_location_counter, m_org_encountered,
+	//		m_end_encountered
+	//
+	void ReplayPass1( std::ostream &error_stream, int &errors, 
+		int &warnings );
+
+	//
+	// Name:		ParallelPass2
+	//
+	// Description:	Runs pass 2 over the chunks of a parallel pass 1,
+	//		and reports the lines that did not assemble in line
+	//		order.
+	// Arguments:	The CStringList to store the assembled information
+	//		to
+	//		the stream to send error messages to
+	//		the error and warning counts to add to.
+	// Returns:	true if pass 2 is done; false if there are no chunks,
+	//		and it should be run serially (nothing has been
+	//		changed).
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	// Modifies:	m_memory, m_source_lines, m_constants, m_words,
+	//		m_encoded, m_chunks
+	//
+	bool ParallelPass2( CStringList &output_list, 
+		std::ostream &error_stream, int &errors, int &warnings );
+
+	//
+	// Name:		ScanChunk
+	//
+	// Description:	Parses the lines of one chunk of a parallel pass 1,
+	//		with a parser of its own.
+	// Arguments:	The source, its index (which may be empty), the file
+	//		name for errors, and the chunk to fill in (first and
+	//		last must be set)
+	//
+	static void ScanChunk( const CStringList *source,
+		const CSourceIndex *index, const char *filename, SChunk *chunk );
+
+	//
+	// Name:		EncodeChunks
+	//
+	// Description:	A worker of a parallel pass 2: encodes the chunks
+	//		it takes from each round, until there are no more
+	//		rounds.  It parses with an assembler of its own, made
+	//		once.
+	// Arguments:	The work it shares with the other workers
+	//
+	void EncodeChunks( SEncodeWork *work );
+
+	//
+	// Name:		EncodeChunk
+	//
+	// Description:	Assembles the lines of one chunk of a parallel pass
+	//		2 into their slots in m_encoded, as Assemble would in
+	//		pass 2, reading the symbol table (which pass 1
+	//		finished).  The lines that do not assemble are kept in
+	//		the chunk's diagnostics.
+	// Arguments:	The assembler to parse with, and the chunk
+	// Modifies:	m_encoded for the chunk's lines, and the chunk
+	//
+	void EncodeChunk( CManoAssembler &parser, SChunk &chunk );
+
+	//
+	// Name:		AssembleSource
+	//
+	// Description:	The passes of AssembleFromFile and AssembleFromText,
+	//		once the source is in m_source (or is to be read).
+	// Arguments:	The name of the source, the stream a single pass
+	//		reads it from or 0, and as AssembleFromFile
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	//
+	void AssembleSource( const char *filename, std::istream *input_stream,
+		CStringList &output_list, std::ostream &status_stream,
+		std::ostream &error_stream );
+
+	//
+	// Name:		AssembleOnePass
+	//
+	// Description:	The single pass of AssembleFromFile.  It ends with
+	//		the output, image and errors two passes would give:
+	//		nothing if pass 1 would have found errors, and if a
+	//		symbol is undeclared, what AssemblePass2 gives over
+	//		m_source.
+	// Arguments:	The stream to read lines from (they are added to
+	//		m_source), or 0 to take them from m_source
+	//		the CStringList to store the assembled information to
+	//		the stream to send error messages to
+	//		the error and warning counts to add to.
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs;
+	//		what was assembled so far is dropped first.
+	//
+	void AssembleOnePass( std::istream *input, CStringList &output_list,
+		std::ostream &error_stream, int &errors, int &warnings );
+
+	//
+	// Name:		DropAssembled
+	//
+	// Description:	Forgets what a single pass has assembled so far:
+	//		its lines of output and its image.
+	// Arguments:	The CStringList the output went to, and its size
+	//		before the pass
+	// Modifies:	m_memory, m_source_lines, m_constants, m_words
+	//
+	void DropAssembled( CStringList &output_list, size_t output_start );
+
+	//
+	// Name:		AssemblePass2
+	//
+	// Description:	The serial pass 2 of AssembleFromFile, over
+	//		m_source with the symbol table pass 1 built.
+	// Arguments:	The CStringList to store the assembled information to
+	//		the stream to send error messages to
+	//		the error and warning counts to add to.
+	// Exceptions:	A CErrorException is thrown if a fatal error occurs.
+	//
+	void AssemblePass2( CStringList &output_list,
+		std::ostream &error_stream, int &errors, int &warnings );
+
+	//
+	// Name:		FinishAssembly
+	//
+	// Description:	Ends AssembleFromFile: reports the result, dumps the
+	//		symbol table, and outputs the coe memory image.
+	// Arguments:	The CStringList the assembly was stored to
+	//		the stream to send status messages to
+	//		the error and warning counts.
+	// Modifies:	m_error_count
+	//
+	void FinishAssembly( CStringList &output_list,
+		std::ostream &status_stream, int errors, int warnings );
+
+	//
+	// Name:		StartStats
+	//
+	// Description:	Clears the statistics and starts the clock, if they
+	//		are collected.
+	// Arguments:	The output list, as the assembly starts
+	// Modifies:	m_stats, m_stats_start, m_stats_mark, m_output_start
+	//
+	void StartStats( const CStringList &output_list );
+
+	//
+	// Name:		Lap
+	//
+	// Description:	Adds the time since the last lap to a phase, if
+	//		statistics are collected.
+	// Arguments:	The phase's time in m_stats
+	// Modifies:	m_stats_mark
+	//
+	void Lap( unsigned long long &phase );
+
+	//
+	// Name:		EndStats
+	//
+	// Description:	Stops the clock and counts the lines and symbols, if
+	//		statistics are collected.
+	// Arguments:	The code of the fatal error that ended the assembly,
+	//		or 0
+	// Modifies:	m_stats
+	//
+	void EndStats( const char *fatal );
+
+	//
+	// Name:		CountOutput
+	//
+	// Description:	Counts the bytes of output this assembly added, if
+	//		statistics are collected.
+	// Arguments:	The output list
+	// Modifies:	m_stats
+	//
+	void CountOutput( const CStringList &output_list );
+
+	//
+	// Name:		Report
+	//
+	// Description:	Displays an error or warning, and counts it by code
+	//		if statistics are collected.
+	// Arguments:	The error, and the stream to display it on
+	//
+	void Report( CErrorException &error, std::ostream &error_stream );
+
+	//
+	// Name:		DefineSymbol
+	//
+	// Description:	Adds a label at the location counter to the symbol
+	//		table, and in single-pass mode patches the words that
+	//		were waiting for it.
+	// Arguments:	The label, or an empty string
+	// Exceptions:	Throws a CErrorException if the symbol is already
+	//		defined.
+	// Modifies:	m_symbol_table, m_fixups
+	//
+	void DefineSymbol( const char *label );
+
+	//
+	// Name:		PatchFixup
+	//
+	// Description:	Fills in the operand of a word that waited for a
+	//		label, and rewrites its line of output.  Memory keeps
+	//		a word a later line assembled over it.
+	// Arguments:	The fixup, and the operand and its text for the
+	//		output comment
+	// Modifies:	m_memory, m_words, *m_output
+	//
+	void PatchFixup( const SFixup &fixup, unsigned short operand,
+		const char *argument );
+
+	//
+	// Name:		ResolveFixups
+	//
+	// Description:	Settles the fixups still open at the end of a
+	//		single pass: a hex number is taken as one, as pass 2
+	//		would.
+	// Returns:	The number of fixups that name no symbol
+	// Modifies:	m_fixups, and see PatchFixup
+	//
+	int ResolveFixups();
+
+	//
+	// Name:		FormatWord
+	//
+	// Description:	Forms the line of output that stores a word (for
+	//		coe, stores it in m_memory instead).
+	// Arguments:	The address and the word, its comment (from
+	//		FormatComment), and a buffer of at least 80
+	//		characters for the line
+	//
+	void FormatWord( int address, unsigned short data,
+		const char *comment, char *output );
+
+	//
+	// Name:		FormatLine
+	//
+	// Description:	Forms the line of output that stores a word in a
+	//		format.  For coe, the line is just the comment.
+	// Arguments:	The format, the address and the word, its comment,
+	//		and a buffer of at least 80 characters for the line
+	//
+	static void FormatLine( format line_format, int address,
+		unsigned short data, const char *comment, char *output );
+
+	//
+	// Name:		FormatComment
+	//
+	// Description:	Forms the comment that ends a word's line of output.
+	// Arguments:	The instruction, argument and indirect flag, and a
+	//		buffer of at least 20 characters for the comment
+	//
+	static void FormatComment( const char *instruction,
+		const char *argument, const char *indirect, char *comment );
+
+	//
+	// Name:		RecordWord
+	//
+	// Description:	Keeps a formatted word for WriteImage, if
+	//		SetRecordImage is on.
+	// Arguments:	The address and the word, its comment, and whether
+	//		it has a line of output
+	// Modifies:	m_words
+	//
+	void RecordWord( int address, unsigned short data,
+		const char *comment, bool listed );
+
+	//
+	// Name:		BuildCoeImage
+	//
+	// Description:	Forms a coe memory image: every word from 0 to the
+	//		last one stored, 0 where nothing is.
+	// Arguments:	The memory, and the string to build the image in
+	//
+	static void BuildCoeImage( const CMemoryImage &memory,
+		std::string &image );
+
 	//
 	// Name:		UpdateLocationCounter
 	//
@@ -210,21 +993,6 @@ protected: // Utility functions
 	//
 	void UpdateLocationCounter( const char *instruction, const char *operand );
 
-	//
-	// Name:		Parse
-	//
-	// Description:	Parses a line into it's label, instruction, 
-	//		argument, and indirect flag.
-	// Arguments:	The line to parse, pointers to the strings
-	//		to receive the label and instruction (both no
-	//		more than 3 characters), a pointer to store
-	//		the argument (up to 10 characters), and a pointer
-	//		to receive the indirect flat (up to 1 character)
-	// Exceptions:	Throws a CErrorException if there are parsing errors
-	//
-	void Parse( const char *line, char *label, char *instruction, 
-		char *argument, char *indirect );
-
 	//
 	// Name:		SearchAndParseLabel
 	//
@@ -271,20 +1039,6 @@ protected: // Utility functions
 	//
 	void ParseIndirect( char *indirect, std::istrstream &input );
 
-	//
-	// Name:	IsValidIdentifier
-	//
-	// Description:	Determines if a given string is a valid identifier.
-	//		An identifier is valid if all of these hold true:
-	//			1. It is 3 characters or less
-	//			2. The first character is alphabetic [A-Z]
-	//			3. All remaining characters are 
-	//			   alphanumeric [A-Z0-9]
-	// Arguments:	The identifier to examine
-	// Returns:	1 if the identifier is valid, or 0 otherwise.
-	//
-	static bool IsValidIdentifier( char *identifier );
-
 	//
 	// Name:	IsNumeric
 	//
@@ -297,38 +1051,6 @@ protected: // Utility functions
 	//
 	static bool IsNumeric( const char *str );
 
-	//
-	// Name:	IsHexNumeric
-	//
-	// Description:	Determines if a given string is hexnumeric
-	//		A string is hexnumeric if all of these hold true:
-	//		    1. The first character is -, or [0-9][A-F]
-	//		    2. The remaining characters are [0-9][A-F]
-	// Arguments:	The string to examine
-	// Returns:	1 if the string is numeric, or 0 otherwise.
-	//
-	static bool IsHexNumeric( const char *str );
-
-	//
-	// Name:	GetInstructionInfo
-	//
-	// Description:	Obtains information about a given instruction
-	// Arguments:	The name of the instruction, and a pointer to where to
-	//		store the instruction information
-	// Returns:	1 if the instruction exists, or else 0.
-	//
-	bool GetInstructionInfo( const char *name, SInstruction *info ) const;
-
-	//
-	// Name		HexToInteger
-	//
-	// Description:	Converts a hexadecimal string to an integer
-	// Arguments:	The string to convert
-	// Returns:	An unsigned long value, that is the integer that
-	//		hex string represents.
-	//
-	static unsigned short HexToInteger( const char *str );
-
 	//
 	// Name		IntegerToHex
 	//
@@ -356,8 +1078,77 @@ protected: // Attributes
 	const char		*m_file_name;		// The file we are currently 
 										// assembling
 
-	unsigned short m_data[4096];
-	unsigned m_last_valid_address;
+	CMemoryImage	m_memory;			// Words assembled (for coe,
+										// with ORG and END)
+
+	int				m_source_lines[4096];	// Line assembled at each
+										// address, or -1
+
+	bool			m_constants[4096];	// Assembled from HEX or DEC
+
+	int				m_error_count;		// Errors in the last
+										// AssembleFromFile
+
+	bool			m_optimize;			// Run the peephole pass
+
+	bool			m_single_pass;		// Assemble in one pass
+
+	unsigned		m_threads;			// Threads AssembleFromFile
+										// may use
+
+	std::vector<SChunk>	m_chunks;		// Chunks of a parallel
+										// pass 1, for pass 2
+
+	std::vector<SEncodedLine> m_encoded;	// Lines of a parallel
+										// pass 2, by line number
+
+	CSourceIndex	m_index;			// Structure of the source
+										// being assembled
+
+	const SSourceLine	*m_line_hint;	// What the index found on the
+										// line Parse gets next, or 0
+
+	CArena			m_arena;			// Memory for m_fixups
+
+	fixup_map		m_fixups;			// Words waiting, by
+										// the label they name
+
+	CStringList		*m_output;			// Output of the current
+										// AssembleFromFile, or 0
+
+	std::vector<CErrorException> m_warnings;	// Single-pass warnings
+										// for AssembleFromFile to
+										// report
+
+	CStringList		m_source;			// Source of the last
+											// AssembleFromFile
+
+	std::string		m_read_line;		// Line a single pass is
+										// reading
+
+	char			m_read_buffer[8192];	// Buffer for the file a
+										// single pass reads
+
+	std::string		m_image;			// The coe image, rebuilt by
+										// each assembly
+
+	bool			m_record_image;		// Keep words for WriteImage
+
+	std::vector<SImageWord>	m_words;	// Words formatted by the last
+										// assembly, in order
+
+	bool			m_image_complete;	// It succeeded (a coe image
+										// may be written)
+
+	bool			m_collect_stats;	// Time and count assemblies
+
+	SAssemblyStats	m_stats;			// Statistics of the last one
+
+	unsigned long long	m_stats_start;	// When it started (ns)
+
+	unsigned long long	m_stats_mark;	// When the last phase ended
+
+	size_t			m_output_start;		// Output lines before it
 
 	// List of available instructions and info:
 	static SInstruction m_instruction_list[NUM_VALID_INSTRUCTIONS]; 
@@ -0,0 +1,262 @@
+// File:	MemoryImage.cpp
+// Description:
+//		A memory image held as a sorted list of contiguous segments.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "MemoryImage.hpp"
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CMemoryImage::CMemoryImage() {
+
+	m_last = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CMemoryImage::~CMemoryImage() {
+} // (destructor)
+
+//
+// Name:	Store
+//
+void CMemoryImage::Store( unsigned address, unsigned short word ) {
+
+	// Most stores rewrite or extend the segment stored to last:
+	if( m_last < m_segments.size() ) {
+		SSegment &last = m_segments[m_last];
+		const unsigned end = last.start + (unsigned)last.words.size();
+
+		if( address >= last.start && address < end ) {
+			last.words[address - last.start] = word;
+			return;
+		}
+		if( address == end ) {
+			last.words.push_back( word );
+			Join( m_last + 1 );
+			return;
+		}
+	}
+
+	// Otherwise, look for the segment that holds or ends at it:
+	const size_t next = Find( address );
+	if( next > 0 ) {
+		SSegment &before = m_segments[next - 1];
+		const unsigned end = before.start + (unsigned)before.words.size();
+
+		if( address < end ) {
+			before.words[address - before.start] = word;
+			m_last = next - 1;
+			return;
+		}
+		if( address == end ) {
+			before.words.push_back( word );
+			m_last = next - 1;
+			Join( next );
+			return;
+		}
+	}
+
+	// Or the one that starts right after it:
+	if( next < m_segments.size() && m_segments[next].start == address + 1 ) {
+		SSegment &after = m_segments[next];
+		after.words.insert( after.words.begin(), word );
+		after.start = address;
+		m_last = next;
+		return;
+	}
+
+	Insert( next, address, word );
+	m_last = next;
+
+} // Store
+
+//
+// Name:	Clear
+//
+void CMemoryImage::Clear() {
+
+	// Keep the storage, the first segment's last, so that the same
+	// segments stored again get their own storage back:
+	for( size_t segment = m_segments.size(); segment > 0; segment-- ) {
+		m_segments[segment - 1].words.clear();
+		m_spare.push_back( vector<unsigned short>() );
+		m_spare.back().swap( m_segments[segment - 1].words );
+	}
+	m_segments.clear();
+	m_last = 0;
+
+} // Clear
+
+//
+// Name:	Fetch
+//
+unsigned short CMemoryImage::Fetch( unsigned address ) const {
+
+	const size_t next = Find( address );
+	if( next > 0 ) {
+		const SSegment &before = m_segments[next - 1];
+		if( address - before.start < before.words.size() ) {
+			return before.words[address - before.start];
+		}
+	}
+	return 0;
+
+} // Fetch
+
+//
+// Name:	IsStored
+//
+bool CMemoryImage::IsStored( unsigned address ) const {
+
+	const size_t next = Find( address );
+	return next > 0 && address - m_segments[next - 1].start
+		< m_segments[next - 1].words.size();
+
+} // IsStored
+
+//
+// Name:	IsEmpty
+//
+bool CMemoryImage::IsEmpty() const {
+
+	return m_segments.empty();
+
+} // IsEmpty
+
+//
+// Name:	GetEnd
+//
+unsigned CMemoryImage::GetEnd() const {
+
+	if( m_segments.empty() ) {
+		return 0;
+	}
+	return m_segments.back().start + (unsigned)m_segments.back().words.size();
+
+} // GetEnd
+
+//
+// Name:	GetWordCount
+//
+size_t CMemoryImage::GetWordCount() const {
+	size_t count = 0;
+
+	for( size_t segment = 0; segment < m_segments.size(); segment++ ) {
+		count += m_segments[segment].words.size();
+	}
+	return count;
+
+} // GetWordCount
+
+//
+// Name:	GetSegmentCount
+//
+size_t CMemoryImage::GetSegmentCount() const {
+
+	return m_segments.size();
+
+} // GetSegmentCount
+
+//
+// Name:	GetSegment
+//
+const CMemoryImage::SSegment &CMemoryImage::GetSegment(
+	size_t segment ) const
+{
+
+	return m_segments[segment];
+
+} // GetSegment
+
+//
+// Name:	CopyTo
+//
+void CMemoryImage::CopyTo( unsigned short *memory, size_t size ) const {
+
+	for( size_t segment = 0; segment < m_segments.size(); segment++ ) {
+		const SSegment &stored = m_segments[segment];
+
+		for( size_t word = 0; word < stored.words.size()
+			&& stored.start + word < size; word++ )
+		{
+			memory[stored.start + word] = stored.words[word];
+		}
+	}
+
+} // CopyTo
+
+//
+// Name:	Find
+//
+size_t CMemoryImage::Find( unsigned address ) const {
+	size_t low = 0, high = m_segments.size();
+
+	while( low < high ) {
+		const size_t middle = (low + high) / 2;
+
+		if( m_segments[middle].start <= address ) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+
+} // Find
+
+//
+// Name:	Insert
+//
+void CMemoryImage::Insert( size_t segment, unsigned address,
+	unsigned short word )
+{
+
+	m_segments.insert( m_segments.begin() + segment, SSegment() );
+
+	SSegment &added = m_segments[segment];
+	if( !m_spare.empty() ) {
+		added.words.swap( m_spare.back() );
+		m_spare.pop_back();
+	}
+	added.start = address;
+	added.words.push_back( word );
+
+} // Insert
+
+//
+// Name:	Join
+//
+void CMemoryImage::Join( size_t segment ) {
+
+	if( segment == 0 || segment >= m_segments.size() ) {
+		return;
+	}
+
+	SSegment &before = m_segments[segment - 1];
+	SSegment &after = m_segments[segment];
+	if( before.start + before.words.size() != after.start ) {
+		return;
+	}
+
+	before.words.insert( before.words.end(), after.words.begin(),
+		after.words.end() );
+
+	after.words.clear();
+	m_spare.push_back( vector<unsigned short>() );
+	m_spare.back().swap( after.words );
+	m_segments.erase( m_segments.begin() + segment );
+
+	if( m_last >= segment ) {
+		m_last = segment - 1;
+	}
+
+} // Join
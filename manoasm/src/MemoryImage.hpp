@@ -0,0 +1,182 @@
+// File:	MemoryImage.hpp
+// Description:
+//		A memory image held as a sorted list of contiguous segments,
+//		so a program placed in a few small pieces with ORG takes
+//		room only for the words it stores.
+// Usage:
+//		1. create one instance of this class
+//		2. call Store for each word, in any order
+//		3. call Fetch for single words, or GetSegmentCount and
+//		   GetSegment to walk the stored words in address order
+//		4. call Clear to start over.
+//
+// Notes:
+//
+//		Segments never touch or overlap: a word stored next to a
+//		segment extends it, and one that closes the gap between two
+//		joins them.  Words not stored read as 0.
+//
+//		Stores that follow each other in address order, as an
+//		assembly makes them, extend the last segment stored to
+//		without a search.  Clear keeps the segments' storage for
+//		reuse, so filling an image no bigger than the last takes
+//		nothing from the heap.
+//
+//		An image is not thread-safe.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class CMemoryImage {
+
+public:	// Types
+
+	// A run of stored words:
+	struct SSegment {
+		unsigned	start;		// Address of its first word
+		std::vector<unsigned short> words;	// The words, in order
+	};
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CMemoryImage object.
+	//
+	CMemoryImage();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CMemoryImage object.
+	//
+	~CMemoryImage();
+
+public:	// Modification
+
+	//
+	// Name:	Store
+	//
+	// Description:	Stores a word, replacing any stored at its address.
+	// Arguments:	The address, and the word
+	// Modifies:	m_segments
+	//
+	void Store( unsigned address, unsigned short word );
+
+	//
+	// Name:	Clear
+	//
+	// Description:	Forgets every word, keeping the storage.
+	// Modifies:	m_segments, m_spare
+	//
+	void Clear();
+
+public:	// Accessors
+
+	//
+	// Name:	Fetch
+	//
+	// Returns:	The word stored at an address, or 0 if none is.
+	//
+	unsigned short Fetch( unsigned address ) const;
+
+	//
+	// Name:	IsStored
+	//
+	// Returns:	true if a word is stored at an address.
+	//
+	bool IsStored( unsigned address ) const;
+
+	//
+	// Name:	IsEmpty
+	//
+	// Returns:	true if no word is stored.
+	//
+	bool IsEmpty() const;
+
+	//
+	// Name:	GetEnd
+	//
+	// Returns:	The address after the last word stored, or 0 if the
+	//		image is empty.
+	//
+	unsigned GetEnd() const;
+
+	//
+	// Name:	GetWordCount
+	//
+	// Returns:	The number of words stored.
+	//
+	size_t GetWordCount() const;
+
+	//
+	// Name:	GetSegmentCount
+	//
+	// Returns:	The number of segments.
+	//
+	size_t GetSegmentCount() const;
+
+	//
+	// Name:	GetSegment
+	//
+	// Returns:	A segment, by its place in address order.
+	//
+	const SSegment &GetSegment( size_t segment ) const;
+
+	//
+	// Name:	CopyTo
+	//
+	// Description:	Writes the image over a dense memory, leaving the
+	//		words not stored as they are.
+	// Arguments:	The memory, and its size in words; words stored
+	//		beyond it are left out
+	//
+	void CopyTo( unsigned short *memory, size_t size ) const;
+
+protected: // Utility functions
+
+	//
+	// Name:	Find
+	//
+	// Returns:	The first segment that starts after an address (so
+	//		the one before it, if any, is the only one that may
+	//		hold it).
+	//
+	size_t Find( unsigned address ) const;
+
+	//
+	// Name:	Insert
+	//
+	// Description:	Starts a segment with one word.
+	// Arguments:	Where it goes in m_segments, its address, and the
+	//		word
+	// Modifies:	m_segments, m_spare
+	//
+	void Insert( size_t segment, unsigned address, unsigned short word );
+
+	//
+	// Name:	Join
+	//
+	// Description:	Appends a segment to the one before it, if it
+	//		starts where that one ends.
+	// Arguments:	The segment
+	// Modifies:	m_segments, m_spare
+	//
+	void Join( size_t segment );
+
+protected: // Attributes
+
+	std::vector<SSegment>	m_segments;	// In address order
+
+	std::vector<std::vector<unsigned short> > m_spare;	// Storage
+							// of cleared segments
+
+	size_t			m_last;		// Segment last stored to
+};
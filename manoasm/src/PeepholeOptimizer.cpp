@@ -0,0 +1,571 @@
+// File:	PeepholeOptimizer.cpp
+// Description:
+//		Peephole pass over Mano assembly sources.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "PeepholeOptimizer.hpp"
+#include "ErrorException.hpp"
+
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+// Words IsAcDead follows before giving up:
+#define OPTIMIZER_DEAD_STEPS	32
+
+// main.v clock cycles of the memory-reference instructions by opcode,
+// direct and then indirect (CManoSimulator charges the same):
+static const int memory_cycles[2][7] = {
+	{ 3, 3, 3, 3, 2, 3, 5 },
+	{ 5, 5, 5, 5, 4, 5, 7 }
+};
+
+// Instructions that may skip the word after them:
+static const char *const skip_instructions[] = {
+	"SPA", "SNA", "SZA", "SZE", "SKI", "SKO", "ISZ"
+};
+
+//
+// Name:	(constructor)
+//
+CPeepholeOptimizer::CPeepholeOptimizer()
+	: m_grammar( CManoAssembler::normal )
+{
+
+	m_filename = "";
+	m_rewrites = 0;
+	m_words_saved = 0;
+	m_cycles_saved = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CPeepholeOptimizer::~CPeepholeOptimizer() {
+} // (destructor)
+
+//
+// Name:	Optimize
+//
+void CPeepholeOptimizer::Optimize( const char *filename, CStringList &source,
+	ostream &status_stream )
+{
+
+	m_filename = filename;
+	m_rewrites = 0;
+	m_words_saved = 0;
+	m_cycles_saved = 0;
+
+	status_stream << "Optimizing..." << endl;
+
+	if( !Load( source ) ) {
+		status_stream << "Optimization skipped - the source does not parse"
+			<< endl;
+		return;
+	}
+	MarkReferences();
+
+	for( int index = 0; index < (int)m_statements.size(); index++ ) {
+		if( m_statements[index].removed ) {
+			continue;
+		}
+		if( !FoldIncrement( index, source, status_stream ) ) {
+			FoldReload( index, source, status_stream );
+		}
+	}
+
+	status_stream << "Optimization saved " << m_words_saved
+		<< " word(s) and " << m_cycles_saved << " cycle(s) in "
+		<< m_rewrites << " rewrite(s)" << endl;
+
+} // Optimize
+
+//
+// Name:	GetRewriteCount
+//
+int CPeepholeOptimizer::GetRewriteCount() const {
+	return m_rewrites;
+} // GetRewriteCount
+
+//
+// Name:	GetWordsSaved
+//
+int CPeepholeOptimizer::GetWordsSaved() const {
+	return m_words_saved;
+} // GetWordsSaved
+
+//
+// Name:	GetCyclesSaved
+//
+int CPeepholeOptimizer::GetCyclesSaved() const {
+	return m_cycles_saved;
+} // GetCyclesSaved
+
+//
+// Name:	Load
+//
+bool CPeepholeOptimizer::Load( const CStringList &source ) {
+
+	char line[81];
+	char label[33];
+	char instruction[4];
+	char argument[11];
+	char indirect[2];
+
+	m_statements.clear();
+	m_labels.clear();
+	m_addresses.clear();
+	m_numeric.clear();
+
+	// Words ahead of the first ORG go at 000, as the assembler puts them:
+	m_block_starts.assign( 1, 0 );
+	m_block_ends.assign( 1, -1 );
+	int block = 0;
+	int location_counter = 0;
+
+	m_grammar.SetFilename( m_filename );
+
+	for( size_t line_number = 0; line_number < source.size();
+		line_number++ )
+	{
+		if( source[line_number].size() > 80 ) {
+			return false;
+		}
+		strcpy( line, source[line_number].c_str() );
+		for( char *p = line; *p; p++ ) {
+			*p = (char)toupper( *p );
+		}
+
+		try {
+			m_grammar.SetLineNumber( (int)line_number );
+			m_grammar.Parse( line, label, instruction, argument,
+				indirect );
+		}
+		catch( CErrorException ) {
+			return false;
+		}
+
+		if( strcmp( instruction, "" ) == 0 ) {
+			continue;
+		}
+		if( strcmp( instruction, "END" ) == 0 ) {
+			break;
+		}
+		if( strcmp( instruction, "ORG" ) == 0 ) {
+			location_counter = CManoAssembler::HexToInteger( argument );
+			m_block_starts.push_back( location_counter );
+			m_block_ends.push_back( location_counter - 1 );
+			block = (int)m_block_ends.size() - 1;
+			continue;
+		}
+		if( location_counter > 0xFFF ) {
+			return false;
+		}
+
+		SStatement statement;
+		statement.line = (int)line_number;
+		statement.label = label;
+		statement.instruction = instruction;
+		statement.argument = argument;
+		statement.indirect = strcmp( indirect, "I" ) == 0;
+		statement.address = location_counter;
+		statement.block = block;
+		statement.entry = false;
+		statement.read = false;
+		statement.written = false;
+		statement.removed = false;
+
+		const int index = (int)m_statements.size();
+		if( !statement.label.empty() ) {
+			m_labels[statement.label] = index;
+		}
+		m_addresses[location_counter] = index;
+		m_block_ends[block] = location_counter;
+		m_statements.push_back( statement );
+
+		location_counter++;
+	}
+
+	return true;
+
+} // Load
+
+//
+// Name:	MarkReferences
+//
+void CPeepholeOptimizer::MarkReferences() {
+
+	map<int, int>::const_iterator found;
+
+	for( size_t index = 0; index < m_statements.size(); index++ ) {
+		const SStatement &statement = m_statements[index];
+
+		SInstruction info;
+		if( !m_grammar.GetInstructionInfo(
+			statement.instruction.c_str(), &info ) )
+		{
+			continue;
+		}
+
+		// A skip enters the word after the one it skips:
+		for( size_t skip = 0; skip < sizeof(skip_instructions)
+			/ sizeof(skip_instructions[0]); skip++ )
+		{
+			if( statement.instruction == skip_instructions[skip] ) {
+				found = m_addresses.find( statement.address + 2 );
+				if( found != m_addresses.end() ) {
+					m_statements[found->second].entry = true;
+				}
+			}
+		}
+
+		if( !info.resolve_references || statement.argument.empty() ) {
+			continue;
+		}
+
+		bool numeric;
+		const int target = Resolve( statement.argument, &numeric );
+
+		// A HEX word takes an address, which may be used in any way;
+		// numeric HEX words are taken to be data:
+		if( !info.i_bit_valid ) {
+			if( target >= 0 && !numeric ) {
+				m_statements[target].entry = true;
+				m_statements[target].read = true;
+				m_statements[target].written = true;
+			}
+			continue;
+		}
+
+		if( numeric ) {
+			m_numeric.push_back( CManoAssembler::HexToInteger(
+				statement.argument.c_str() ) & 0xFFF );
+		}
+		if( target < 0 ) {
+			continue;
+		}
+
+		// Through a pointer, only the pointer itself is known:
+		if( statement.indirect ) {
+			m_statements[target].read = true;
+			continue;
+		}
+
+		switch( info.opcode ) {
+		case 0x0:	// AND
+		case 0x1:	// ADD
+		case 0x2:	// LDA
+			m_statements[target].read = true;
+			break;
+		case 0x3:	// STA
+		case 0x6:	// ISZ
+			m_statements[target].written = true;
+			break;
+		case 0x4:	// BUN
+			m_statements[target].entry = true;
+			break;
+		case 0x5:	// BSA
+			m_statements[target].written = true;
+			found = m_addresses.find(
+				m_statements[target].address + 1 );
+			if( found != m_addresses.end() ) {
+				m_statements[found->second].entry = true;
+			}
+			break;
+		}
+	}
+
+} // MarkReferences
+
+//
+// Name:	Resolve
+//
+int CPeepholeOptimizer::Resolve( const string &argument, bool *numeric ) const
+{
+
+	*numeric = false;
+
+	map<string, int>::const_iterator label = m_labels.find( argument );
+	if( label != m_labels.end() ) {
+		return label->second;
+	}
+
+	if( !CManoAssembler::IsHexNumeric( argument.c_str() ) ) {
+		return -1;
+	}
+	*numeric = true;
+
+	map<int, int>::const_iterator address = m_addresses.find(
+		CManoAssembler::HexToInteger( argument.c_str() ) & 0xFFF );
+	return address != m_addresses.end() ? address->second : -1;
+
+} // Resolve
+
+//
+// Name:	Next
+//
+int CPeepholeOptimizer::Next( int index ) const {
+
+	for( int next = index + 1; next < (int)m_statements.size(); next++ ) {
+		if( m_statements[next].block != m_statements[index].block ) {
+			break;
+		}
+		if( !m_statements[next].removed ) {
+			return next;
+		}
+	}
+	return -1;
+
+} // Next
+
+//
+// Name:	IsFixed
+//
+bool CPeepholeOptimizer::IsFixed( int index, bool keep_label ) const {
+
+	const SStatement &statement = m_statements[index];
+
+	if( statement.read || statement.written ) {
+		return true;
+	}
+	return !keep_label && (statement.entry || !statement.label.empty());
+
+} // IsFixed
+
+//
+// Name:	CanRemove
+//
+bool CPeepholeOptimizer::CanRemove( int index ) const {
+
+	const SStatement &statement = m_statements[index];
+	const int block_end = m_block_ends[statement.block];
+
+	// The last word of the block would no longer fall into a block
+	// that starts right after it:
+	if( m_addresses.find( block_end + 1 ) != m_addresses.end() ) {
+		return false;
+	}
+
+	for( size_t i = 0; i < m_numeric.size(); i++ ) {
+		if( m_numeric[i] > statement.address
+			&& m_numeric[i] <= block_end )
+		{
+			return false;
+		}
+	}
+
+	// Where another block overlaps the words that move, a different
+	// word would end up under it (or above it, for an earlier block):
+	for( size_t block = 0; block < m_block_ends.size(); block++ ) {
+		if( (int)block != statement.block
+			&& m_block_ends[block] >= m_block_starts[block]
+			&& m_block_starts[block] <= block_end
+			&& m_block_ends[block] >= statement.address )
+		{
+			return false;
+		}
+	}
+	return true;
+
+} // CanRemove
+
+//
+// Name:	IsAcDead
+//
+bool CPeepholeOptimizer::IsAcDead( int index ) const {
+
+	for( int steps = 0; index >= 0 && steps < OPTIMIZER_DEAD_STEPS;
+		steps++ )
+	{
+		const SStatement &statement = m_statements[index];
+
+		if( statement.written ) {
+			return false;
+		}
+		if( statement.instruction == "LDA" || statement.instruction == "CLA" )
+		{
+			return true;
+		}
+		if( statement.instruction == "CLE" || statement.instruction == "CME" )
+		{
+			index = Next( index );
+		}
+		else if( statement.instruction == "BUN" && !statement.indirect ) {
+			bool numeric;
+			index = Resolve( statement.argument, &numeric );
+		}
+		else {
+			return false;
+		}
+	}
+	return false;
+
+} // IsAcDead
+
+//
+// Name:	GetCycles
+//
+int CPeepholeOptimizer::GetCycles( const string &instruction,
+	bool indirect ) const
+{
+
+	SInstruction info;
+	m_grammar.GetInstructionInfo( instruction.c_str(), &info );
+
+	if( info.opcode <= 0x6 ) {
+		return memory_cycles[indirect ? 1 : 0][info.opcode];
+	}
+
+	// HLT stops the sequencer in par_sc_instexec; the rest of the
+	// register and input/output instructions take two cycles:
+	return instruction == "HLT" ? 1 : 2;
+
+} // GetCycles
+
+//
+// Name:	FoldReload
+//
+bool CPeepholeOptimizer::FoldReload( int index, CStringList &source,
+	ostream &status_stream )
+{
+
+	SStatement &store = m_statements[index];
+	if( store.instruction != "STA" || store.indirect || store.written ) {
+		return false;
+	}
+
+	const int next = Next( index );
+	if( next < 0 ) {
+		return false;
+	}
+	SStatement &load = m_statements[next];
+	if( load.instruction != "LDA" || load.indirect
+		|| load.argument != store.argument || IsFixed( next, false )
+		|| !CanRemove( next ) )
+	{
+		return false;
+	}
+
+	const int cycles = GetCycles( "LDA", false );
+	if( cycles <= 0 ) {
+		return false;
+	}
+
+	Remove( next, source );
+	Report( index, "STA, LDA " + store.argument + " -> STA", cycles, 1,
+		status_stream );
+	return true;
+
+} // FoldReload
+
+//
+// Name:	FoldIncrement
+//
+bool CPeepholeOptimizer::FoldIncrement( int index, CStringList &source,
+	ostream &status_stream )
+{
+
+	SStatement &load = m_statements[index];
+	if( load.instruction != "LDA" || IsFixed( index, true ) ) {
+		return false;
+	}
+
+	const int increment = Next( index );
+	if( increment < 0 || m_statements[increment].instruction != "INC"
+		|| IsFixed( increment, false ) )
+	{
+		return false;
+	}
+
+	const int store = Next( increment );
+	if( store < 0 || m_statements[store].instruction != "STA"
+		|| m_statements[store].argument != load.argument
+		|| m_statements[store].indirect != load.indirect
+		|| IsFixed( store, false ) || !CanRemove( store ) )
+	{
+		return false;
+	}
+
+	// ISZ leaves the AC alone and the CLA clears it, where the
+	// original left X + 1 in it:
+	if( !IsAcDead( Next( store ) ) ) {
+		return false;
+	}
+
+	const int cycles = GetCycles( "LDA", load.indirect )
+		+ GetCycles( "INC", false ) + GetCycles( "STA", load.indirect )
+		- GetCycles( "ISZ", load.indirect ) - GetCycles( "CLA", false );
+	if( cycles <= 0 ) {
+		return false;
+	}
+
+	load.instruction = "ISZ";
+	m_statements[increment].instruction = "CLA";
+	Rewrite( index, source );
+	Rewrite( increment, source );
+	Remove( store, source );
+
+	Report( index, "LDA, INC, STA " + load.argument
+		+ (load.indirect ? " I" : "") + " -> ISZ, CLA", cycles, 1,
+		status_stream );
+	return true;
+
+} // FoldIncrement
+
+//
+// Name:	Rewrite
+//
+void CPeepholeOptimizer::Rewrite( int index, CStringList &source ) const {
+
+	const SStatement &statement = m_statements[index];
+
+	string line = statement.label.empty() ? "" : statement.label + ",";
+	line += "\t" + statement.instruction;
+	if( !statement.argument.empty() ) {
+		line += " " + statement.argument;
+	}
+	if( statement.indirect ) {
+		line += " I";
+	}
+
+	const size_t comment = source[statement.line].find( '/' );
+	if( comment != string::npos ) {
+		line += "\t" + source[statement.line].substr( comment );
+	}
+	source[statement.line] = line.substr( 0, 80 );
+
+} // Rewrite
+
+//
+// Name:	Remove
+//
+void CPeepholeOptimizer::Remove( int index, CStringList &source ) {
+
+	SStatement &statement = m_statements[index];
+
+	statement.removed = true;
+	source[statement.line] = "/" + source[statement.line].substr( 0, 79 );
+
+} // Remove
+
+//
+// Name:	Report
+//
+void CPeepholeOptimizer::Report( int index, const string &description,
+	int cycles, int words, ostream &status_stream )
+{
+
+	status_stream << "\t" << m_filename << "("
+		<< m_statements[index].line + 1 << "): " << description
+		<< ", saves " << cycles << " cycle(s) and " << words
+		<< " word(s)" << endl;
+
+	m_rewrites++;
+	m_cycles_saved += cycles;
+	m_words_saved += words;
+
+} // Report
@@ -0,0 +1,290 @@
+// File:	PeepholeOptimizer.hpp
+// Description:
+//		Optional peephole pass that rewrites redundant instruction
+//		sequences in a Mano assembly source before it is assembled.
+// Usage:
+//		1. create one instance of this class
+//		2. call Optimize with the source read into a CStringList; the
+//		   list is rewritten in place
+//		3. assemble the list as usual (CManoAssembler::SetOptimize
+//		   makes AssembleFromFile do both).
+//
+// Notes:
+//
+//		Two rewrites are made:
+//
+//			STA X / LDA X		becomes	STA X
+//			LDA X / INC / STA X	becomes	ISZ X / CLA
+//
+//		The CLA after the ISZ is where the ISZ skips to when X
+//		wraps to 0, so the skip lands on a word that only clears
+//		the AC.  The second rewrite is only made when the AC is
+//		overwritten before it is next read, and works with the I
+//		bit as long as all three words agree on it.
+//
+//		A rewrite is only made if no word it changes or removes can
+//		be reached other than by falling into it, and if none of
+//		them is read or written as data: words after skip
+//		instructions and BSA targets, targets of BUN, BSA and
+//		memory operands, and words whose address is taken with HEX
+//		are left alone.  Pointers computed at run time, or held in
+//		numeric HEX or DEC words, are not followed.
+//
+//		Each candidate is costed with the clock cycles main.v spends
+//		on its instructions (the same costs CManoSimulator charges),
+//		and only kept if it is cheaper than the original.
+//
+//		Removed words become comments, so every line keeps its line
+//		number; rewritten words keep their comments.  Words after a
+//		removed word move down one address, so nothing is removed
+//		ahead of a numeric address operand in the same ORG block,
+//		or where another ORG block overlaps the words that move.
+//
+//		A source that does not parse is left unchanged; pass 1 then
+//		reports its errors.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoAssembler.hpp"
+#include "StringList.hpp"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class CPeepholeOptimizer {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CPeepholeOptimizer object.
+	//
+	CPeepholeOptimizer();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CPeepholeOptimizer object.
+	//
+	~CPeepholeOptimizer();
+
+public:	// Optimization
+
+	//
+	// Name:	Optimize
+	//
+	// Description:	Rewrites a source, and reports each rewrite and the
+	//		totals saved to the status stream.
+	// Arguments:	The name of the source (for the report), the source,
+	//		and the stream to report to
+	// Modifies:	source, and the counts below
+	//
+	void Optimize( const char *filename, CStringList &source,
+		std::ostream &status_stream );
+
+public:	// Accessors
+
+	//
+	// Name:	GetRewriteCount
+	//
+	// Returns:	The number of rewrites made by the last Optimize.
+	//
+	int GetRewriteCount() const;
+
+	//
+	// Name:	GetWordsSaved
+	//
+	// Returns:	The number of words the last Optimize removed.
+	//
+	int GetWordsSaved() const;
+
+	//
+	// Name:	GetCyclesSaved
+	//
+	// Returns:	The main.v clock cycles saved by the last Optimize,
+	//		counting each rewritten sequence once.
+	//
+	int GetCyclesSaved() const;
+
+protected: // Types
+
+	// A word of the source, in source order:
+	struct SStatement {
+		int		line;		// Index into the source
+		std::string	label;		// Label, or empty
+		std::string	instruction;	// Mnemonic
+		std::string	argument;	// Operand, or empty
+		bool		indirect;	// I bit
+		int		address;	// Address before optimizing
+		int		block;		// ORG block it is in
+		bool		entry;		// Reached other than by falling in
+		bool		read;		// Read as data
+		bool		written;	// Written as data
+		bool		removed;	// Taken out by a rewrite
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Load
+	//
+	// Description:	Parses the source into m_statements and lays out
+	//		its addresses.
+	// Arguments:	The source
+	// Returns:	false if the source does not parse.
+	// Modifies:	m_statements, m_labels, m_addresses, m_block_starts,
+	//		m_block_ends, m_numeric
+	//
+	bool Load( const CStringList &source );
+
+	//
+	// Name:	MarkReferences
+	//
+	// Description:	Marks the words that can be entered other than by
+	//		falling into them, or are used as data.
+	// Modifies:	m_statements
+	//
+	void MarkReferences();
+
+	//
+	// Name:	Resolve
+	//
+	// Description:	Finds the word an operand names.
+	// Arguments:	The operand, and where to store whether it was a
+	//		number rather than a label
+	// Returns:	The index into m_statements, or -1 if it names no
+	//		word of the source.
+	//
+	int Resolve( const std::string &argument, bool *numeric ) const;
+
+	//
+	// Name:	Next
+	//
+	// Description:	Finds the word that follows another in memory.
+	// Arguments:	The index of the word in m_statements
+	// Returns:	The index of the next word that has not been
+	//		removed, or -1 if the ORG block ends first.
+	//
+	int Next( int index ) const;
+
+	//
+	// Name:	IsFixed
+	//
+	// Description:	Determines whether a word must stay as it is.
+	// Arguments:	The index of the word, and whether it may keep a
+	//		label that is only branched to
+	// Returns:	true if a rewrite may not change or remove it.
+	//
+	bool IsFixed( int index, bool keep_label ) const;
+
+	//
+	// Name:	CanRemove
+	//
+	// Description:	Determines whether removing a word would move a
+	//		word that a numeric address operand names, or that
+	//		another ORG block overlaps.
+	// Arguments:	The index of the word
+	// Returns:	true if the word may be removed.
+	//
+	bool CanRemove( int index ) const;
+
+	//
+	// Name:	IsAcDead
+	//
+	// Description:	Determines whether the AC is overwritten before it
+	//		is read, following the program from a word.
+	// Arguments:	The index of the word, or -1
+	// Returns:	true if the AC is certainly dead there.
+	//
+	bool IsAcDead( int index ) const;
+
+	//
+	// Name:	GetCycles
+	//
+	// Description:	Gives the main.v clock cycles an instruction takes.
+	// Arguments:	The mnemonic, and its I bit
+	// Returns:	The number of cycles.
+	//
+	int GetCycles( const std::string &instruction, bool indirect ) const;
+
+	//
+	// Name:	FoldReload
+	//
+	// Description:	Tries the STA X / LDA X rewrite at a word.
+	// Arguments:	The index of the STA, the source, and the stream to
+	//		report to
+	// Returns:	true if the rewrite was made.
+	//
+	bool FoldReload( int index, CStringList &source,
+		std::ostream &status_stream );
+
+	//
+	// Name:	FoldIncrement
+	//
+	// Description:	Tries the LDA X / INC / STA X rewrite at a word.
+	// Arguments:	The index of the LDA, the source, and the stream to
+	//		report to
+	// Returns:	true if the rewrite was made.
+	//
+	bool FoldIncrement( int index, CStringList &source,
+		std::ostream &status_stream );
+
+	//
+	// Name:	Rewrite
+	//
+	// Description:	Writes a statement back into its source line,
+	//		keeping the line's comment.
+	// Arguments:	The index of the statement, and the source
+	//
+	void Rewrite( int index, CStringList &source ) const;
+
+	//
+	// Name:	Remove
+	//
+	// Description:	Turns a statement's source line into a comment.
+	// Arguments:	The index of the statement, and the source
+	//
+	void Remove( int index, CStringList &source );
+
+	//
+	// Name:	Report
+	//
+	// Description:	Reports a rewrite and adds up what it saved.
+	// Arguments:	The index of its first word, a description, the
+	//		cycles and words it saved, and the stream to report to
+	//
+	void Report( int index, const std::string &description, int cycles,
+		int words, std::ostream &status_stream );
+
+protected: // Attributes
+
+	CManoAssembler		m_grammar;	// Parses the source
+
+	const char		*m_filename;	// Source name for the report
+
+	std::vector<SStatement>	m_statements;	// The words, in source order
+
+	std::map<std::string, int> m_labels;	// Label to statement index
+
+	std::map<int, int>	m_addresses;	// Address to statement index
+
+	std::vector<int>	m_block_starts;	// First address of each block
+
+	std::vector<int>	m_block_ends;	// Last address of each block
+
+	std::vector<int>	m_numeric;	// Addresses named by numeric
+						// memory-reference operands
+
+	int			m_rewrites;	// Rewrites made
+
+	int			m_words_saved;	// Words removed
+
+	int			m_cycles_saved;	// Cycles saved
+};
@@ -0,0 +1,62 @@
+// File:	ProgramFormat.hpp
+// Description:
+//		Layout of the program container written by manoasm (-o p=)
+//		and read in place by CProgramFile: the memory image, the
+//		symbols and the source lines of one assembly.
+//
+// Notes:
+//
+//		All fields are little-endian.  A program file is:
+//
+//		header:		"MANOPRG" and a version byte, then the number
+//				of sections (4 bytes) and 4 reserved bytes
+//		directory:	for each section, its id, its offset from
+//				the start of the file and its size (4 bytes
+//				each)
+//		sections:	each starting on a 4-byte boundary
+//
+//		The sections are:
+//
+//		image		a binary image, as in ImageFormat.hpp
+//		strings		NUL-terminated strings, each stored once;
+//				other sections name them by offset
+//		symbols		for each symbol, its name and its address (4
+//				bytes each), in address order and then name
+//				order
+//		lines		runs of addresses assembled from consecutive
+//				lines: the first address (2 bytes), the
+//				number of addresses (2 bytes), and the line
+//				of the first address, from 1 (4 bytes); in
+//				address order
+//		source		the name of the source file and its number of
+//				lines (4 bytes each), then the text of each
+//				line (4 bytes each, as the strings)
+//
+//		Every table holds fixed-size entries, so a mapped file is
+//		used as it is.  Readers skip sections they do not know, so
+//		sections can be added without a new version.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#define PROGRAM_MAGIC		"MANOPRG"
+#define PROGRAM_VERSION		1
+
+#define PROGRAM_HEADER_SIZE	16	// Magic, version, sections, reserved
+#define PROGRAM_ENTRY_SIZE	12	// Id, offset, size
+#define PROGRAM_ALIGNMENT	4	// Of each section
+
+// Section ids:
+#define PROGRAM_SECTION_IMAGE	1
+#define PROGRAM_SECTION_STRINGS	2
+#define PROGRAM_SECTION_SYMBOLS	3
+#define PROGRAM_SECTION_LINES	4
+#define PROGRAM_SECTION_SOURCE	5
+
+// Sizes of table entries:
+#define PROGRAM_SYMBOL_SIZE	8	// Name, address
+#define PROGRAM_LINE_SIZE	8	// Address, count, line
+#define PROGRAM_SOURCE_HEADER_SIZE 8	// Name, line count
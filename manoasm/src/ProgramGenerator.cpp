@@ -0,0 +1,548 @@
+// File:	ProgramGenerator.cpp
+// Description:
+//		Generates synthetic Mano assembly programs.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "ProgramGenerator.hpp"
+#include "ErrorException.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// Size of the address space:
+#define GENERATOR_MEMORY_SIZE	4096
+
+// Most words a program may have; more than the address space are laid
+// out again over it:
+#define GENERATOR_MAX_WORDS	(256 * GENERATOR_MEMORY_SIZE)
+
+// Label names MakeLabelName can make before they repeat:
+#define GENERATOR_LABEL_NAMES	(26 + 26 * 36 + 26 * 36 * 36)
+
+// Percent of code words that are memory-reference instructions:
+#define GENERATOR_MEMORY_OPS	55
+
+// Percent of HEX words that hold the address of a label:
+#define GENERATOR_POINTERS	33
+
+// Kinds of invalid line MakeInvalid makes:
+#define GENERATOR_INVALID_KINDS	10
+
+// Attempts at an invalid line before giving up on it:
+#define GENERATOR_INVALID_TRIES	10
+
+// The file name given in error messages:
+static const char generated_name[] = "generated";
+
+//
+// Name:	(constructor)
+//
+CProgramGenerator::CProgramGenerator() : m_grammar( CManoAssembler::normal ) {
+
+	m_grammar.SetFilename( generated_name );
+
+	// Sort the mnemonics the way the assembler encodes them:
+	m_hlt = -1;
+	for( unsigned i = 0; i < CManoAssembler::GetInstructionCount(); i++ ) {
+		const SInstruction &info = CManoAssembler::GetInstruction( i );
+
+		if( info.resolve_references && info.i_bit_valid ) {
+			m_memory_ops.push_back( i );
+		}
+		else if( info.opcode == 0x7 || info.opcode == 0xF ) {
+			if( strcmp( info.name, "HLT" ) == 0 ) {
+				m_hlt = i;
+			}
+			else {
+				m_register_ops.push_back( i );
+			}
+		}
+	}
+
+	SetDefaults( m_options );
+	m_state = 1;
+	m_invalid_count = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CProgramGenerator::~CProgramGenerator() {
+} // (destructor)
+
+//
+// Name:	SetDefaults
+//
+void CProgramGenerator::SetDefaults( SGeneratorOptions &options ) {
+
+	options.words = 4000;
+	options.label_density = 30;
+	options.forward_references = 50;
+	options.org_segments = 1;
+	options.indirect = 25;
+	options.self_modifying = 10;
+	options.data = 20;
+	options.comments = 25;
+	options.invalid = 0;
+	options.bsa = true;
+	options.seed = 1;
+
+} // SetDefaults
+
+//
+// Name:	Generate
+//
+void CProgramGenerator::Generate( const SGeneratorOptions &options,
+	CStringList &source )
+{
+
+	// Each layout of the address space needs a word per ORG block:
+	const int layouts = (options.words + GENERATOR_MEMORY_SIZE - 1)
+		/ GENERATOR_MEMORY_SIZE;
+
+	if( options.words < 1 || options.words > GENERATOR_MAX_WORDS
+		|| options.org_segments < 1
+		|| options.org_segments > options.words / layouts
+		|| options.label_density < 0 || options.label_density > 100
+		|| options.forward_references < 0
+		|| options.forward_references > 100
+		|| options.indirect < 0 || options.indirect > 100
+		|| options.self_modifying < 0 || options.self_modifying > 100
+		|| options.data < 0 || options.data > 100
+		|| options.comments < 0 || options.comments > 100
+		|| options.invalid < 0 || options.invalid > 100 )
+	{
+		throw CErrorException( generated_name, 0, "A4001",
+			"Generator option out of range", CErrorException::ERROR );
+	}
+
+	m_options = options;
+	m_state = options.seed * 0x2545F4914F6CDD1DULL + 0x9E3779B97F4A7C15ULL;
+	if( !m_state ) {
+		m_state = 1;
+	}
+	m_invalid_count = 0;
+
+	Layout();
+
+	char line[81];
+	sprintf( line, "// Generated program: %d words, seed %lu",
+		options.words, options.seed );
+	Add( line, true, source );
+
+	for( size_t position = 0; position < m_words.size(); position++ ) {
+
+		// Start each ORG block:
+		if( !position
+			|| m_words[position].address
+				!= m_words[position - 1].address + 1 )
+		{
+			sprintf( line, "\torg %x", m_words[position].address );
+			Add( line, true, source );
+		}
+
+		if( Chance( m_options.comments / 4 ) ) {
+			sprintf( line, "// Word %03x", m_words[position].address );
+			Add( line, true, source );
+		}
+
+		MakeWord( position, line );
+		Add( line, true, source );
+
+		if( Chance( m_options.invalid ) ) {
+			for( int tries = 0; tries < GENERATOR_INVALID_TRIES; tries++ ) {
+				MakeInvalid( line );
+				if( Add( line, false, source ) ) {
+					m_invalid_count++;
+					break;
+				}
+			}
+		}
+	}
+
+	// END takes an address as a word does, so a program whose last
+	// word is at FFF ends without one:
+	if( m_words.back().address < GENERATOR_MEMORY_SIZE - 1 ) {
+		Add( "\tend", true, source );
+	}
+
+} // Generate
+
+//
+// Name:	GetWordCount
+//
+int CProgramGenerator::GetWordCount() const {
+	return (int)m_words.size();
+} // GetWordCount
+
+//
+// Name:	GetInvalidCount
+//
+int CProgramGenerator::GetInvalidCount() const {
+	return m_invalid_count;
+} // GetInvalidCount
+
+//
+// Name:	Random
+//
+unsigned CProgramGenerator::Random( unsigned range ) {
+
+	// xorshift64*:
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+	return (unsigned)(((m_state * 0x2545F4914F6CDD1DULL) >> 32) % range);
+
+} // Random
+
+//
+// Name:	Chance
+//
+bool CProgramGenerator::Chance( int percent ) {
+	return (int)Random( 100 ) < percent;
+} // Chance
+
+//
+// Name:	Layout
+//
+void CProgramGenerator::Layout() {
+
+	m_words.clear();
+	m_labels.clear();
+	m_code_labels.clear();
+	m_data_labels.clear();
+
+	// Words beyond the address space go in further layouts of it,
+	// each overwriting the one before.  The layouts share their ORG
+	// blocks, and none is smaller than one before it, so the word a
+	// coe image stores for an ORG line lands in a gap or on a word
+	// that a later layout stores again:
+	const int layouts = (m_options.words + GENERATOR_MEMORY_SIZE - 1)
+		/ GENERATOR_MEMORY_SIZE;
+	const int largest = m_options.words / layouts
+		+ (m_options.words % layouts ? 1 : 0);
+	const int segments = m_options.org_segments;
+	const int spare = GENERATOR_MEMORY_SIZE - largest;
+	vector<int> starts( segments );
+	int slot = 0;
+	m_words.reserve( m_options.words );
+	for( int layout = 0; layout < layouts; layout++ ) {
+		const int words = m_options.words / layouts
+			+ (layout >= layouts - m_options.words % layouts ? 1 : 0);
+
+		// Spread the words over slots of the address space, one block
+		// per slot.  Each slot holds the largest layout's block and an
+		// equal share of the spare addresses, and the block starts
+		// anywhere in it that it fits.  The first block starts at 000,
+		// with code:
+		for( int segment = 0; segment < segments; segment++ ) {
+			const int size = words / segments
+				+ (segment < words % segments ? 1 : 0);
+			if( !layout ) {
+				const int block = largest / segments
+					+ (segment < largest % segments ? 1 : 0);
+				const int room = spare / segments
+					+ (segment < spare % segments ? 1 : 0);
+				starts[segment] = slot
+					+ (segment ? (int)Random( room + 1 ) : 0);
+				slot += block + room;
+			}
+			const int start = starts[segment];
+
+			for( int address = start; address < start + size;
+				address++ )
+			{
+				SWord word;
+				word.address = address;
+				word.type = Chance( m_options.data ) && address 
+					? data : code;
+				word.label = -1;
+				m_words.push_back( word );
+			}
+		}
+	}
+
+	// Label words.  The entry point and the first data word always
+	// get one, so references have somewhere to go.  A long program
+	// stops labelling when the names run out:
+	bool data_labelled = false;
+	int candidate = (int)Random( 1000 );
+	for( size_t position = 0; position < m_words.size(); position++ ) {
+		SWord &word = m_words[position];
+		const bool first_data = word.type == data && !data_labelled;
+
+		if( position && !first_data && !Chance( m_options.label_density ) ) {
+			continue;
+		}
+
+		// Skip names that are not identifiers or are mnemonics:
+		char name[4];
+		SInstruction info;
+		bool named = false;
+		while( !named && candidate < GENERATOR_LABEL_NAMES ) {
+			MakeLabelName( candidate++, name );
+			named = CManoAssembler::IsValidIdentifier( name )
+				&& strcmp( name, "I" ) != 0
+				&& !m_grammar.GetInstructionInfo( name, &info );
+		}
+		if( !named ) {
+			break;
+		}
+
+		word.label = (int)m_labels.size();
+		m_labels.push_back( name );
+		if( word.type == code ) {
+			m_code_labels.push_back( position );
+		}
+		else {
+			m_data_labels.push_back( position );
+			data_labelled = true;
+		}
+	}
+
+} // Layout
+
+//
+// Name:	PickLabel
+//
+const string &CProgramGenerator::PickLabel( size_t position, kind type ) {
+
+	const vector<size_t> *labels =
+		type == code ? &m_code_labels : &m_data_labels;
+	if( labels->empty() ) {
+		labels = type == code ? &m_data_labels : &m_code_labels;
+	}
+
+	// Labels after this word, and labels up to it:
+	const size_t later = (size_t)(upper_bound( labels->begin(),
+		labels->end(), position ) - labels->begin());
+	const size_t count = labels->size();
+
+	size_t chosen;
+	if( Chance( m_options.forward_references ) && later < count ) {
+		chosen = later + Random( (unsigned)(count - later) );
+	}
+	else if( later > 0 ) {
+		chosen = Random( (unsigned)later );
+	}
+	else {
+		chosen = Random( (unsigned)count );
+	}
+
+	return m_labels[m_words[(*labels)[chosen]].label];
+
+} // PickLabel
+
+//
+// Name:	MakeWord
+//
+void CProgramGenerator::MakeWord( size_t position, char *line ) {
+
+	const SWord &word = m_words[position];
+	char label[8] = "";
+	char body[64];
+
+	if( word.label >= 0 ) {
+		sprintf( label, "%s,", m_labels[word.label].c_str() );
+	}
+
+	// The last code word halts:
+	bool last_code = word.type == code;
+	for( size_t next = position + 1; last_code && next < m_words.size();
+		next++ )
+	{
+		last_code = m_words[next].type != code;
+	}
+
+	if( word.type == data ) {
+		if( Random( 2 ) ) {
+			sprintf( body, "dec %d", (int)Random( 0x10000 ) - 0x8000 );
+		}
+		else if( Chance( GENERATOR_POINTERS ) ) {
+			sprintf( body, "hex %s", PickLabel( position, code ).c_str() );
+		}
+		else {
+			// A leading 0 keeps it from reading as a label:
+			sprintf( body, "hex 0%04x", Random( 0x10000 ) );
+		}
+	}
+	else if( last_code ) {
+		strcpy( body, CManoAssembler::GetInstruction( m_hlt ).name );
+	}
+	else if( Chance( GENERATOR_MEMORY_OPS ) ) {
+		int op;
+		do {
+			op = m_memory_ops[Random( (unsigned)m_memory_ops.size() )];
+		} while( !m_options.bsa 
+			&& strcmp( CManoAssembler::GetInstruction( op ).name, 
+				"BSA" ) == 0 );
+		const SInstruction &info = CManoAssembler::GetInstruction( op );
+
+		// Branches go to code; STA and ISZ store to code sometimes,
+		// everything else reads data:
+		kind target = data;
+		if( strcmp( info.name, "BUN" ) == 0
+			|| strcmp( info.name, "BSA" ) == 0 )
+		{
+			target = code;
+		}
+		else if( (strcmp( info.name, "STA" ) == 0
+				|| strcmp( info.name, "ISZ" ) == 0)
+			&& Chance( m_options.self_modifying ) )
+		{
+			target = code;
+		}
+
+		sprintf( body, "%s %s%s", info.name,
+			PickLabel( position, target ).c_str(),
+			Chance( m_options.indirect ) ? " i" : "" );
+	}
+	else {
+		strcpy( body, CManoAssembler::GetInstruction(
+			m_register_ops[Random(
+				(unsigned)m_register_ops.size() )] ).name );
+	}
+
+	// Sources are usually written in lower case:
+	for( char *p = body; *p; p++ ) {
+		*p = (char)tolower( *p );
+	}
+	for( char *p = label; *p; p++ ) {
+		*p = (char)tolower( *p );
+	}
+
+	sprintf( line, "%s\t%s", label, body );
+	if( Chance( m_options.comments ) ) {
+		sprintf( line + strlen( line ), "\t// at %03x", word.address );
+	}
+
+} // MakeWord
+
+//
+// Name:	MakeInvalid
+//
+void CProgramGenerator::MakeInvalid( char *line ) {
+
+	const char *label = m_labels[Random( (unsigned)m_labels.size() )].c_str();
+	const char *memory_op = CManoAssembler::GetInstruction(
+		m_memory_ops[Random( (unsigned)m_memory_ops.size() )] ).name;
+	const char *register_op = CManoAssembler::GetInstruction(
+		m_register_ops[Random( (unsigned)m_register_ops.size() )] ).name;
+
+	switch( Random( GENERATOR_INVALID_KINDS ) ) {
+	case 0:		// A1008: an operand where none belongs
+		sprintf( line, "\t%s %s", register_op, label );
+		break;
+	case 1:		// A1007 or A1008: an indirect bit where none belongs
+		sprintf( line, "\t%s i", register_op );
+		break;
+	case 2:		// A1012: no operand where one is needed
+		sprintf( line, "\t%s", memory_op );
+		break;
+	case 3:		// A1010: DEC of something that is not a number
+		sprintf( line, "\tdec %dq", (int)Random( 1000 ) );
+		break;
+	case 4:		// A1009: ORG of something that is not a number
+		sprintf( line, "\torg %s", "zz" );
+		break;
+	case 5:		// A1003: no such instruction
+		sprintf( line, "\tq%s %s", memory_op, label );
+		break;
+	case 6:		// A1001: a label that is not an identifier
+		sprintf( line, "%d%s,\t%s", (int)Random( 10 ), label,
+			register_op );
+		break;
+	case 7:		// A1006: text after the indirect bit
+		sprintf( line, "\t%s %s i %s", memory_op, label, label );
+		break;
+	case 8:		// A1014: a label on ORG
+		sprintf( line, "%s,\torg %x", label, Random( 0x1000 ) );
+		break;
+	default:	// A1005: a label with no instruction
+		sprintf( line, "%s,", label );
+		break;
+	}
+
+	for( char *p = line; *p; p++ ) {
+		*p = (char)tolower( *p );
+	}
+
+} // MakeInvalid
+
+//
+// Name:	Add
+//
+bool CProgramGenerator::Add( const char *line, bool valid,
+	CStringList &source )
+{
+
+	char upper[81];
+	char label[33], instruction[4], argument[11], indirect[2];
+
+	// Parse sees lines in upper case, as AssembleFromFile gives them:
+	strncpy( upper, line, 80 );
+	upper[80] = 0;
+	for( char *p = upper; *p; p++ ) {
+		*p = (char)toupper( *p );
+	}
+
+	m_grammar.SetLineNumber( (int)source.size() );
+	try {
+		m_grammar.Parse( upper, label, instruction, argument, indirect );
+	}
+	catch( CErrorException e ) {
+		if( valid ) {
+			throw CErrorException( generated_name, (int)source.size(),
+				"A4002", "Generated line failed its grammar check",
+				CErrorException::FATAL );
+		}
+		if( e.GetSeverity() != CErrorException::ERROR ) {
+			return false;
+		}
+
+		source.push_back( line );
+		return true;
+	}
+
+	if( !valid ) {
+		return false;
+	}
+
+	source.push_back( line );
+	return true;
+
+} // Add
+
+//
+// Name:	MakeLabelName
+//
+void CProgramGenerator::MakeLabelName( int number, char *name ) const {
+
+	static const char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	static const char alphanumerics[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+	// One letter, then one letter and one more character, then one
+	// letter and two more:
+	if( number < 26 ) {
+		sprintf( name, "%c", letters[number] );
+	}
+	else if( number < 26 + 26 * 36 ) {
+		number -= 26;
+		sprintf( name, "%c%c", letters[number / 36],
+			alphanumerics[number % 36] );
+	}
+	else {
+		number = (number - 26 - 26 * 36) % (26 * 36 * 36);
+		sprintf( name, "%c%c%c", letters[number / (36 * 36)],
+			alphanumerics[number / 36 % 36], alphanumerics[number % 36] );
+	}
+
+} // MakeLabelName
@@ -0,0 +1,252 @@
+// File:	ProgramGenerator.hpp
+// Description:
+//		Generates synthetic Mano assembly programs for stress and fuzz
+//		workloads: valid programs of any size, up to the full address
+//		space and beyond it, and programs with deliberately invalid
+//		lines mixed in.
+// Usage:
+//		1. fill in an SGeneratorOptions, starting from SetDefaults
+//		2. create one instance of this class
+//		3. call Generate, which fills a CStringList with the source
+//		   (write it out with CStringList::Dump)
+//		4. GetWordCount and GetInvalidCount describe what was made.
+//
+// Notes:
+//
+//		The generator takes its grammar from CManoAssembler: the
+//		mnemonics and their operand rules come from its
+//		GetInstruction, and every line is checked with its public
+//		Parse before it is kept.  Valid lines must parse; invalid
+//		lines must be rejected by Parse with an error, so a source
+//		with invalid lines makes pass 1 report exactly
+//		GetInvalidCount errors.
+//
+//		Invalid lines are extra lines, so they do not move any word;
+//		with the invalid lines taken out, the same options and seed
+//		give the same valid program.
+//
+//		A program of more than 4096 words is written as several
+//		layouts of the address space, one after another, each of up
+//		to 4096 words in its own ORG blocks; each overwrites the
+//		memory the one before it assembled to.  Such sources reach
+//		the parallel passes, which only split sources of many
+//		thousand lines.  Labels stay unique, so once the label
+//		names run out the rest of the words go unlabelled.
+//
+//		Programs start at address 000, which holds the first code
+//		word of the last layout, and the last code word is HLT.
+//		Nothing else about their behaviour is arranged: run them
+//		with an instruction limit.
+//
+//		A program ends with END, unless its last word is at FFF:
+//		END takes an address as a word does.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//		0.1:	Programs longer than the address space
+//
+
+#pragma once
+
+#include "ManoAssembler.hpp"
+#include "StringList.hpp"
+
+#include <string>
+#include <vector>
+
+// What to generate.  Percentages are 0 to 100.
+struct SGeneratorOptions {
+	int		words;		// Words to assemble, 1 to 1048576
+	int		label_density;	// Percent of words with a label
+	int		forward_references; // Percent of references to labels
+					// defined later in the source
+	int		org_segments;	// ORG blocks each layout of the words
+					// is spread over
+	int		indirect;	// Percent of memory references with I
+	int		self_modifying;	// Percent of STA and ISZ that store to
+					// code rather than data
+	int		data;		// Percent of words that are HEX or DEC
+	int		comments;	// Percent of lines with a comment
+	int		invalid;	// Invalid lines per 100 valid lines
+	bool		bsa;		// Memory references may be BSA
+	unsigned long	seed;		// Seed of the random choices
+};
+
+class CProgramGenerator {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CProgramGenerator object.
+	//
+	CProgramGenerator();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CProgramGenerator object.
+	//
+	~CProgramGenerator();
+
+public:	// Generation
+
+	//
+	// Name:	SetDefaults
+	//
+	// Description:	Fills in options for a valid 4000-word program in
+	//		one ORG block.
+	// Arguments:	The options to fill in
+	//
+	static void SetDefaults( SGeneratorOptions &options );
+
+	//
+	// Name:	Generate
+	//
+	// Description:	Generates a program.
+	// Arguments:	The options, and the list to append the source to
+	// Exceptions:	Throws a CErrorException if an option is out of
+	//		range (A4001), or if a line fails its grammar check
+	//		(A4002, a bug in the generator or the assembler).
+	// Modifies:	Everything
+	//
+	void Generate( const SGeneratorOptions &options, CStringList &source );
+
+public:	// Accessors
+
+	//
+	// Name:	GetWordCount
+	//
+	// Returns:	The number of words the last program assembles,
+	//		counting those a later layout overwrites.
+	//
+	int GetWordCount() const;
+
+	//
+	// Name:	GetInvalidCount
+	//
+	// Returns:	The number of invalid lines in the last program.
+	//
+	int GetInvalidCount() const;
+
+protected: // Types
+
+	// Kinds of word:
+	enum kind {
+		code,
+		data
+	};
+
+	// A word of the program, in source order:
+	struct SWord {
+		int		address;	// Where it assembles to
+		kind		type;		// Code or data
+		int		label;		// Index into m_labels, or -1
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Random
+	//
+	// Description:	Draws a random number.
+	// Arguments:	The number of possible values
+	// Returns:	A number from 0 to range - 1.
+	//
+	unsigned Random( unsigned range );
+
+	//
+	// Name:	Chance
+	//
+	// Returns:	true with the given percent probability.
+	//
+	bool Chance( int percent );
+
+	//
+	// Name:	Layout
+	//
+	// Description:	Places the words in their layouts and ORG blocks,
+	//		chooses which are code and which are labelled, and
+	//		names the labels.
+	// Modifies:	m_words, m_labels, m_code_labels, m_data_labels
+	//
+	void Layout();
+
+	//
+	// Name:	PickLabel
+	//
+	// Description:	Chooses a label for an operand, forward or backward
+	//		according to the options.
+	// Arguments:	The source position of the referring word, and the
+	//		kind of word the label should be on
+	// Returns:	The label's name.
+	//
+	const std::string &PickLabel( size_t position, kind type );
+
+	//
+	// Name:	MakeWord
+	//
+	// Description:	Writes the line for a word.
+	// Arguments:	Its source position, and the buffer to write to (at
+	//		least 81 characters)
+	//
+	void MakeWord( size_t position, char *line );
+
+	//
+	// Name:	MakeInvalid
+	//
+	// Description:	Writes a line that Parse rejects.
+	// Arguments:	The buffer to write to (at least 81 characters)
+	//
+	void MakeInvalid( char *line );
+
+	//
+	// Name:	Add
+	//
+	// Description:	Checks a line with CManoAssembler::Parse and adds it
+	//		to the source.
+	// Arguments:	The line, whether it should parse, and the source
+	// Returns:	false if an invalid line parsed after all.
+	// Exceptions:	Throws a CErrorException if a valid line did not
+	//		parse (A4002).
+	//
+	bool Add( const char *line, bool valid, CStringList &source );
+
+	//
+	// Name:	MakeLabelName
+	//
+	// Description:	Makes the n-th candidate label name: one letter,
+	//		then up to two letters or digits.  Some candidates are
+	//		mnemonics, which Layout skips.
+	// Arguments:	The candidate number, and the buffer to write to (at
+	//		least 4 characters)
+	//
+	void MakeLabelName( int number, char *name ) const;
+
+protected: // Attributes
+
+	SGeneratorOptions	m_options;	// The options being used
+
+	unsigned long long	m_state;	// Random generator state
+
+	CManoAssembler		m_grammar;	// Checks every line
+
+	std::vector<SWord>	m_words;	// The words, in source order
+
+	std::vector<std::string> m_labels;	// Label names
+
+	std::vector<size_t>	m_code_labels;	// Positions of labelled code
+
+	std::vector<size_t>	m_data_labels;	// Positions of labelled data
+
+	std::vector<int>	m_memory_ops;	// GetInstruction indices of
+						// memory-reference instructions
+
+	std::vector<int>	m_register_ops;	// ...of register and I/O
+						// instructions, except HLT
+
+	int			m_hlt;		// ...of HLT
+
+	int			m_invalid_count; // Invalid lines generated
+};
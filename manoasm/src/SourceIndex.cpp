@@ -0,0 +1,400 @@
+// File:	SourceIndex.cpp
+// Description:
+//		A structural index of a whole assembly source: bitmaps of
+//		its newlines, comment slashes, commas and whitespace, and
+//		the lines they describe.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "SourceIndex.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#if !defined(MANOASM_SCALAR) && (defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOURCE_INDEX_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Bytes described by one word of each bitmap:
+#define BLOCK_SIZE	64
+
+// Longest line CStringList::ReadFromFile accepts:
+#define MAX_LINE_LENGTH	255
+
+// Bytes ReadFromFile asks for at a time:
+#define READ_SIZE	65536
+
+//
+// Name:	LowestBit
+//
+// Description:	Gives the position of the lowest set bit of a word that
+//		is not 0.
+//
+static inline int LowestBit( unsigned long long word ) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long bit;
+	_BitScanForward64( &bit, word );
+	return (int)bit;
+#elif defined(__GNUC__)
+	return __builtin_ctzll( word );
+#else
+	int bit = 0;
+	while( !(word & 1) ) {
+		word >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+} // LowestBit
+
+//
+// Name:	(constructor)
+//
+CSourceIndex::CSourceIndex( bool scalar ) {
+
+	m_scalar = scalar;
+	m_filename = "";
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CSourceIndex::~CSourceIndex() {
+} // (destructor)
+
+//
+// Name:	ReadFromFile
+//
+void CSourceIndex::ReadFromFile( const char *filename ) {
+
+	// Read in text mode, so line ends come out as ReadFromFile's do,
+	// through a buffer the stream does not free when it closes:
+	ifstream input_stream;
+	input_stream.rdbuf()->pubsetbuf( m_read_buffer,
+		sizeof( m_read_buffer ) );
+	input_stream.open( filename, ios::in );
+	if( !input_stream.is_open() ) {
+		throw CErrorException( filename, 0, "SL1001",
+			"Could not open input file", CErrorException::ERROR );
+	}
+
+	// Read straight into the text, which keeps its storage from the
+	// last source:
+	Clear();
+	size_t length = 0;
+	while( input_stream ) {
+		if( m_text.size() < length + READ_SIZE ) {
+			m_text.resize( length + READ_SIZE );
+		}
+		input_stream.read( &m_text[length], READ_SIZE );
+		length += (size_t)input_stream.gcount();
+	}
+	m_text.resize( length );
+
+	m_filename = filename;
+	try {
+		Scan();
+	}
+	catch( CErrorException ) {
+		m_filename = "";
+		throw;
+	}
+	m_filename = "";
+
+} // ReadFromFile
+
+//
+// Name:	Index
+//
+void CSourceIndex::Index( const string &text ) {
+
+	Clear();
+	m_text = text;
+	Scan();
+
+} // Index
+
+//
+// Name:	Index
+//
+void CSourceIndex::Index( const CStringList &lines ) {
+
+	Clear();
+	for( size_t line = 0; line < lines.size(); line++ ) {
+		if( line > 0 ) {
+			m_text += '\n';
+		}
+		m_text += lines[line];
+	}
+	Scan();
+
+} // Index
+
+//
+// Name:	Scan
+//
+void CSourceIndex::Scan() {
+	unsigned char tail[BLOCK_SIZE];
+
+	const size_t blocks = (m_text.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_newlines.resize( blocks );
+	m_comments.resize( blocks );
+	m_commas.resize( blocks );
+	m_spaces.resize( blocks );
+
+	const unsigned char *data = (const unsigned char *)m_text.data();
+	for( size_t b = 0; b < blocks; b++ ) {
+		const unsigned char *block = data + b * BLOCK_SIZE;
+
+		// Pad the last block with bytes that match nothing:
+		if( (b + 1) * BLOCK_SIZE > m_text.size() ) {
+			memset( tail, 0, BLOCK_SIZE );
+			memcpy( tail, block, m_text.size() - b * BLOCK_SIZE );
+			block = tail;
+		}
+
+#ifdef SOURCE_INDEX_SSE2
+		if( !m_scalar ) {
+			ScanBlockSse2( block, m_newlines[b], m_comments[b],
+				m_commas[b], m_spaces[b] );
+			continue;
+		}
+#endif
+		ScanBlock( block, m_newlines[b], m_comments[b], m_commas[b],
+			m_spaces[b] );
+	}
+
+	FindLines();
+
+} // Scan
+
+//
+// Name:	Clear
+//
+void CSourceIndex::Clear() {
+
+	m_text.clear();
+	m_newlines.clear();
+	m_comments.clear();
+	m_commas.clear();
+	m_spaces.clear();
+	m_lines.clear();
+
+} // Clear
+
+//
+// Name:	GetLines
+//
+void CSourceIndex::GetLines( CStringList &lines ) const {
+
+	lines.reserve( lines.size() + m_lines.size() );
+	for( size_t line = 0; line < m_lines.size(); line++ ) {
+		lines.Append( m_text.data() + m_lines[line].start,
+			m_lines[line].length );
+	}
+
+} // GetLines
+
+//
+// Name:	GetLineCount
+//
+size_t CSourceIndex::GetLineCount() const {
+
+	return m_lines.size();
+
+} // GetLineCount
+
+//
+// Name:	GetLine
+//
+const SSourceLine *CSourceIndex::GetLine( size_t line ) const {
+
+	if( line >= m_lines.size() ) {
+		return 0;
+	}
+	return &m_lines[line];
+
+} // GetLine
+
+//
+// Name:	GetBitmaps
+//
+void CSourceIndex::GetBitmaps( const vector<unsigned long long> **newlines,
+	const vector<unsigned long long> **comments,
+	const vector<unsigned long long> **commas,
+	const vector<unsigned long long> **spaces ) const
+{
+
+	*newlines = &m_newlines;
+	*comments = &m_comments;
+	*commas = &m_commas;
+	*spaces = &m_spaces;
+
+} // GetBitmaps
+
+//
+// Name:	ScanBlock
+//
+void CSourceIndex::ScanBlock( const unsigned char *block,
+	unsigned long long &newlines, unsigned long long &comments,
+	unsigned long long &commas, unsigned long long &spaces )
+{
+
+	newlines = comments = commas = spaces = 0;
+
+	for( int byte = 0; byte < BLOCK_SIZE; byte++ ) {
+		const unsigned long long bit = 1ULL << byte;
+
+		switch( block[byte] ) {
+		case '\n':
+			newlines |= bit;
+			spaces |= bit;
+			break;
+		case '/':
+			comments |= bit;
+			break;
+		case ',':
+			commas |= bit;
+			break;
+		case ' ':
+		case '\t':
+		case '\v':
+		case '\f':
+		case '\r':
+			spaces |= bit;
+			break;
+		}
+	}
+
+} // ScanBlock
+
+//
+// Name:	ScanBlockSse2
+//
+void CSourceIndex::ScanBlockSse2( const unsigned char *block,
+	unsigned long long &newlines, unsigned long long &comments,
+	unsigned long long &commas, unsigned long long &spaces )
+{
+#ifdef SOURCE_INDEX_SSE2
+	const __m128i newline = _mm_set1_epi8( '\n' );
+	const __m128i slash = _mm_set1_epi8( '/' );
+	const __m128i comma = _mm_set1_epi8( ',' );
+	const __m128i space = _mm_set1_epi8( ' ' );
+
+	// '\t' to '\r' are 9 to 13; bytes above 7F compare as negative:
+	const __m128i below_tab = _mm_set1_epi8( '\t' - 1 );
+	const __m128i above_return = _mm_set1_epi8( '\r' + 1 );
+
+	newlines = comments = commas = spaces = 0;
+
+	for( int part = 0; part < BLOCK_SIZE / 16; part++ ) {
+		const __m128i bytes = _mm_loadu_si128(
+			(const __m128i *)(block + part * 16) );
+		const int shift = part * 16;
+
+		newlines |= (unsigned long long)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8( bytes, newline ) ) << shift;
+		comments |= (unsigned long long)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8( bytes, slash ) ) << shift;
+		commas |= (unsigned long long)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8( bytes, comma ) ) << shift;
+
+		const __m128i controls = _mm_and_si128(
+			_mm_cmpgt_epi8( bytes, below_tab ),
+			_mm_cmplt_epi8( bytes, above_return ) );
+		spaces |= (unsigned long long)(unsigned)_mm_movemask_epi8(
+			_mm_or_si128( controls,
+				_mm_cmpeq_epi8( bytes, space ) ) ) << shift;
+	}
+#else
+	ScanBlock( block, newlines, comments, commas, spaces );
+#endif
+} // ScanBlockSse2
+
+//
+// Name:	FindFirst
+//
+size_t CSourceIndex::FindFirst( const vector<unsigned long long> &bits,
+	size_t from, size_t to, bool set )
+{
+
+	while( from < to ) {
+		const size_t word = from / BLOCK_SIZE;
+		unsigned long long value = set ? bits[word] : ~bits[word];
+
+		// Drop the bits before from:
+		value &= ~0ULL << (from % BLOCK_SIZE);
+		if( value ) {
+			const size_t found = word * BLOCK_SIZE + LowestBit( value );
+			return found < to ? found : to;
+		}
+		from = (word + 1) * BLOCK_SIZE;
+	}
+	return to;
+
+} // FindFirst
+
+//
+// Name:	FindLines
+//
+void CSourceIndex::FindLines() {
+	size_t start = 0;
+	const size_t size = m_text.size();
+
+	for( size_t word = 0; word <= m_newlines.size(); word++ ) {
+		unsigned long long value = 0;
+		size_t end = size;
+
+		if( word < m_newlines.size() ) {
+			value = m_newlines[word];
+			if( !value ) {
+				continue;
+			}
+		}
+
+		// Each newline ends a line, and the end of the text ends the
+		// last one:
+		do {
+			if( value ) {
+				end = word * BLOCK_SIZE + LowestBit( value );
+				value &= value - 1;
+			}
+
+			if( end - start > MAX_LINE_LENGTH ) {
+				throw CErrorException( m_filename,
+					(int)m_lines.size(), "SL1003",
+					"Line longer than 80 characters encountered",
+					CErrorException::ERROR );
+			}
+
+			SSourceLine line;
+			line.start = start;
+			line.length = (int)(end - start);
+
+			const size_t comment = FindFirst( m_comments, start, end );
+			line.comment = comment < end ? (int)(comment - start) : -1;
+
+			const size_t comma = FindFirst( m_commas, start, comment );
+			line.comma = comma < comment ? (int)(comma - start) : -1;
+
+			const size_t first = FindFirst( m_spaces, start, comment,
+				false );
+			line.first = first < comment ? (int)(first - start) : -1;
+
+			m_lines.push_back( line );
+			start = end + 1;
+		} while( value );
+	}
+
+} // FindLines
@@ -0,0 +1,219 @@
+// File:	SourceIndex.hpp
+// Description:
+//		A structural index of a whole assembly source: bitmaps of
+//		its newlines, comment slashes, commas and whitespace, and
+//		the lines they describe.
+// Usage:
+//		1. create one instance of this class
+//		2. call ReadFromFile, or Index with a source already read
+//		3. call GetLines for the lines, and GetLine for what the
+//		   bitmaps say about each of them.
+//
+// Notes:
+//
+//		The source is scanned once, 64 bytes at a time, and each
+//		block sets one bit per byte in each bitmap.  Blocks are
+//		scanned with SSE2 where the compiler targets it, and byte by
+//		byte otherwise (or when MANOASM_SCALAR is defined, or the
+//		index is constructed to be scalar); both give the same bits.
+//		Lines are then found from the newline bits, and the comment,
+//		label comma and first token of each line from the others,
+//		without looking at the text again.
+//
+//		The lines are those CStringList::ReadFromFile would give,
+//		including the empty line after a final newline, and lines
+//		longer than 255 characters are refused the same way.
+//
+//		The text, bitmaps and lines keep their storage from one
+//		source to the next, and GetLines reuses the strings of a
+//		Rewound list, so indexing a source no bigger than the last
+//		takes nothing from the heap.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "StringList.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// What the index knows about a line:
+struct SSourceLine {
+	size_t		start;		// Offset of its first character
+	int		length;		// Characters, without the newline
+	int		comment;	// Offset of the first '/', or -1
+	int		comma;		// Offset of the first ',' before the
+					// comment, or -1
+	int		first;		// Offset of the first character that is
+					// not whitespace, before the comment,
+					// or -1
+};
+
+class CSourceIndex {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CSourceIndex object.
+	// Arguments:	true to scan byte by byte even where SSE2 is
+	//		available
+	//
+	CSourceIndex( bool scalar = false );
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CSourceIndex object.
+	//
+	~CSourceIndex();
+
+public:	// Indexing
+
+	//
+	// Name:	ReadFromFile
+	//
+	// Description:	Reads a whole source file and indexes it.
+	// Arguments:	The file to read
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		opened (SL1001), or has a line longer than 255
+	//		characters (SL1003).
+	//
+	void ReadFromFile( const char *filename );
+
+	//
+	// Name:	Index
+	//
+	// Description:	Indexes a source held in memory.
+	// Arguments:	The text, or a list of lines to index as if joined
+	//		by newlines
+	// Exceptions:	As ReadFromFile, for long lines
+	//
+	void Index( const std::string &text );
+	void Index( const CStringList &lines );
+
+	//
+	// Name:	Clear
+	//
+	// Description:	Forgets the source.
+	//
+	void Clear();
+
+public:	// Accessors
+
+	//
+	// Name:	GetLines
+	//
+	// Description:	Appends the lines of the source to a list.
+	// Arguments:	The list
+	//
+	void GetLines( CStringList &lines ) const;
+
+	//
+	// Name:	GetLineCount
+	//
+	// Returns:	The number of lines, or 0 if nothing is indexed.
+	//
+	size_t GetLineCount() const;
+
+	//
+	// Name:	GetLine
+	//
+	// Returns:	What the index knows about a line, or 0 if there is
+	//		no such line.
+	//
+	const SSourceLine *GetLine( size_t line ) const;
+
+	//
+	// Name:	GetBitmaps
+	//
+	// Description:	Gives the bitmaps themselves, one word per 64 bytes
+	//		of the source, bit n of word w describing byte 64w+n.
+	// Arguments:	Where to store the newline, comment, comma and
+	//		whitespace bitmaps
+	//
+	void GetBitmaps( const std::vector<unsigned long long> **newlines,
+		const std::vector<unsigned long long> **comments,
+		const std::vector<unsigned long long> **commas,
+		const std::vector<unsigned long long> **spaces ) const;
+
+protected: // Utility functions
+
+	//
+	// Name:	ScanBlock
+	//
+	// Description:	Sets the bits of one 64-byte block, byte by byte.
+	// Arguments:	The block, and the words to set for it
+	//
+	static void ScanBlock( const unsigned char *block,
+		unsigned long long &newlines, unsigned long long &comments,
+		unsigned long long &commas, unsigned long long &spaces );
+
+	//
+	// Name:	ScanBlockSse2
+	//
+	// Description:	As ScanBlock, 16 bytes at a time.  Only built where
+	//		SSE2 is available.
+	//
+	static void ScanBlockSse2( const unsigned char *block,
+		unsigned long long &newlines, unsigned long long &comments,
+		unsigned long long &commas, unsigned long long &spaces );
+
+	//
+	// Name:	FindFirst
+	//
+	// Description:	Finds the first set (or clear) bit of a bitmap in a
+	//		range of bytes.
+	// Arguments:	The bitmap, the range [from, to), and false to look
+	//		for a clear bit
+	// Returns:	The byte offset, or to if there is no such bit.
+	//
+	static size_t FindFirst( const std::vector<unsigned long long> &bits,
+		size_t from, size_t to, bool set = true );
+
+	//
+	// Name:	FindLines
+	//
+	// Description:	Splits the source into lines at the newline bits,
+	//		and fills in what the other bitmaps say about each.
+	// Exceptions:	Throws a CErrorException (SL1003) for a line longer
+	//		than 255 characters.
+	// Modifies:	m_lines
+	//
+	void FindLines();
+
+	//
+	// Name:	Scan
+	//
+	// Description:	Builds the bitmaps of m_text, and finds its lines.
+	// Exceptions:	As FindLines
+	// Modifies:	The bitmaps, m_lines
+	//
+	void Scan();
+
+protected: // Attributes
+
+	bool			m_scalar;	// Never use SSE2
+
+	const char		*m_filename;	// Source name for errors
+
+	std::string		m_text;		// The source
+
+	char			m_read_buffer[4096];	// Buffer for the file
+							// ReadFromFile reads
+
+	std::vector<unsigned long long> m_newlines;	// '\n'
+
+	std::vector<unsigned long long> m_comments;	// '/'
+
+	std::vector<unsigned long long> m_commas;	// ','
+
+	std::vector<unsigned long long> m_spaces;	// What isspace accepts
+
+	std::vector<SSourceLine> m_lines;	// The lines
+};
@@ -57,6 +57,44 @@ void CStringList::ReadFromFile( const char *filename ) {
 } // ReadFromFile
 
 
+//
+// Name:	Rewind
+//
+void CStringList::Rewind() {
+
+	m_spare.reserve( m_spare.size() + size() );
+	while( !empty() ) {
+		m_spare.push_back( string() );
+		m_spare.back().swap( back() );
+		pop_back();
+	}
+
+} // Rewind
+
+
+//
+// Name:	Append
+//
+void CStringList::Append( const char *text ) {
+	Append( text, strlen( text ) );
+} // Append
+
+void CStringList::Append( const char *text, size_t length ) {
+
+	if( m_spare.empty() ) {
+		push_back( string( text, length ) );
+		return;
+	}
+
+	// Take over a kept string; assigning reuses its storage:
+	push_back( string() );
+	back().swap( m_spare.back() );
+	m_spare.pop_back();
+	back().assign( text, length );
+
+} // Append
+
+
 //
 // Name:		Dump
 //
@@ -29,6 +29,30 @@ public:
 	//
 	void ReadFromFile( const char *filename );
 
+public:		// Reuse
+
+	//
+	// Name:	Rewind
+	//
+	// Description:	Empties the list, keeping its strings for Append to
+	//		reuse, so a list filled the same way again takes
+	//		nothing from the heap.
+	// Modifies:	The list, m_spare
+	//
+	void Rewind();
+
+	//
+	// Name:	Append
+	//
+	// Description:	Adds a string to the end of the list, in a string a
+	//		Rewind kept if there is one.
+	// Arguments:	The characters, and their number if they are not
+	//		0-terminated
+	// Modifies:	The list, m_spare
+	//
+	void Append( const char *text );
+	void Append( const char *text, size_t length );
+
 public:		// Output
 
 	//
@@ -39,4 +63,9 @@ public:		// Output
 	//
 	void Dump( std::ostream &out );
 
+protected:	// Attributes
+
+	// Strings kept by Rewind, the first line's last:
+	std::vector<std::string>	m_spare;
+
 };
@@ -19,7 +19,9 @@ using namespace std;
 //
 // Name:	(constructor)
 //
-CSymbolTable::CSymbolTable() {
+CSymbolTable::CSymbolTable()
+	: m_symbols( symbol_map::key_compare(),
+		symbol_map::allocator_type( &m_arena ) ) {
 } // (constructor)
 
 //
@@ -32,6 +34,11 @@ CSymbolTable::~CSymbolTable() {
 // Name:	Reset
 //
 void CSymbolTable::Reset() {
+
+	// The nodes go first, then the memory they were in:
+	m_symbols.clear();
+	m_arena.Reset();
+
 } // Reset
 
 //
@@ -50,7 +57,7 @@ void CSymbolTable::AddSymbol( const char *symbol, int address ) {
 // Name:		GetAddress
 //
 int CSymbolTable::GetAddress( const char *symbol ) const {
-	const map<string, int>::const_iterator i = m_symbols.find(symbol);
+	const symbol_map::const_iterator i = m_symbols.find(symbol);
 	// If not found, return failure code
 	if (i == m_symbols.end())
 		return -1;
@@ -59,13 +66,20 @@ int CSymbolTable::GetAddress( const char *symbol ) const {
 
 } // GetAddress
 
+//
+// Name:	GetSymbols
+//
+const CSymbolTable::symbol_map &CSymbolTable::GetSymbols() const {
+	return m_symbols;
+} // GetSymbols
+
 
 //
 // Name:	Dump
 //
 void CSymbolTable::Dump( ostream &out ) {
 
-	map<string, int>::const_iterator index;
+	symbol_map::const_iterator index;
 
 	// Dump each symbol, one at a time
 	for (index = m_symbols.begin(); index != m_symbols.end(); index++) {
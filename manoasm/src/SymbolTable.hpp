@@ -6,18 +6,30 @@
 // Usage:	
 //		To add a symbol, call the AddSymbol method
 //		To retrieve the value of a symbol, call the GetAddress accessor
+// Notes:
+//		The table's nodes live in an arena that Reset rewinds, so
+//		refilling a table after a Reset takes nothing from the heap
+//		(beyond symbols too long for a string's own storage).
 // Revision History:
 //		0.0:	Initial Revision
 //
 
 #pragma once
 
+#include "Arena.hpp"
+
 #include <ostream>
 #include <string>
 #include <map>
 
 class CSymbolTable {
 
+public:	// Types
+
+	// Symbols and their addresses, in symbol order:
+	typedef std::map<std::string, int, std::less<std::string>,
+		CArenaAllocator<std::pair<const std::string, int> > > symbol_map;
+
 public:	// Construction / Destruction
 
 	//
@@ -40,7 +52,7 @@ public:	// Initialization
 	//
 	// Name:		Reset
 	//
-	// Description:	Resets the symbol table
+	// Description:	Resets the symbol table, forgetting every symbol
 	// Modifies:	m_num_symbols
 	//
 	void Reset();
@@ -76,6 +88,13 @@ public: // Symbol retrieval
 	//
 	int GetAddress( const char *symbol ) const;
 
+	//
+	// Name:	GetSymbols
+	//
+	// Returns:	Every symbol and its address, in symbol order.
+	//
+	const symbol_map &GetSymbols() const;
+
 public:		// Output
 
 	//
@@ -88,6 +107,9 @@ public:		// Output
 
 protected: // Attributes
 
+	// Where the symbols' nodes live
+	CArena				m_arena;
+
 	// The name of each symbol
-	std::map<std::string, int>	m_symbols;
+	symbol_map			m_symbols;
 };
@@ -6,6 +6,17 @@
 //		0.0:	Initial Revision
 //		0.1:	(7/27/1997) Changed to use a string list instead of 
 //				reading	the file in twice.
+//		0.2:	Added -O to run the peephole optimizer.
+//		0.3:	Added -l and -b for the cycle-annotated listing.
+//		0.4:	Added -s to assemble in a single pass.
+//		0.5:	Added -j to set the threads used for pass 1.
+//		0.6:	Added -d to serve requests on a local socket.
+//		0.7:	Added --stats for phase timings and counts in JSON.
+//		0.8:	Added -o to write several formats from one assembly.
+//		0.9:	Added the binary image format to -o.
+//		0.10:	Added program files to -o.
+//		0.11:	--stats keeps standard output to the JSON line, and
+//				--stats=<path> writes it to a file.
 //
 
 #include <iostream>
@@ -14,12 +25,98 @@
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "AssemblerServer.hpp"
 #include "ManoAssembler.hpp"
+#include "CycleEstimator.hpp"
 #include "StringList.hpp"
 
 using namespace std;
 
+// Takes the banner and status messages when --stats has standard output:
+static ostream null_stream( 0 );
+
+// An output named with -o:
+struct SOutput {
+	CManoAssembler::format	format;		// What to write
+	bool			binary;		// A binary image instead
+	bool			program;	// Or a program file
+	const char		*path;		// Where
+	bool			opened;		// The file could be opened
+};
+
+//
+// Name:	ParseOutput
+//
+// Description:	Reads the <format>=<path> of a -o option.
+// Arguments:	The option's argument, and the output to fill in
+// Returns:	false if it names no format, or no path.
+//
+static bool ParseOutput( const char *spec, SOutput &output ) {
+	const char *equals = strchr( spec, '=' );
+
+	if( !equals || equals[1] == 0 ) {
+		return false;
+	}
+
+	const string name( spec, equals - spec );
+	output.format = CManoAssembler::normal;
+	output.binary = false;
+	output.program = false;
+	if( name == "b" || name == "binary" ) {
+		output.binary = true;
+	}
+	else if( name == "p" || name == "program" ) {
+		output.program = true;
+	}
+	else if( name == "n" || name == "normal" ) {
+		output.format = CManoAssembler::normal;
+	}
+	else if( name == "v" || name == "verilog" ) {
+		output.format = CManoAssembler::verilog;
+	}
+	else if( name == "c" || name == "coe" ) {
+		output.format = CManoAssembler::coe;
+	}
+	else {
+		return false;
+	}
+
+	output.path = equals + 1;
+	output.opened = false;
+	return true;
+
+} // ParseOutput
+
+//
+// Name:	WriteOutput
+//
+// Description:	Writes an assembly in the format of a -o output.  Each
+//		output is written by a thread of its own.
+// Arguments:	The assembler, and the output
+//
+static void WriteOutput( const CManoAssembler *assembler, SOutput *output ) {
+	ofstream out_stream( output->path, output->binary || output->program
+		? ios::out | ios::binary : ios::out );
+
+	if( out_stream.is_open() ) {
+		output->opened = true;
+		if( output->program ) {
+			assembler->WriteProgram( out_stream );
+		}
+		else if( output->binary ) {
+			assembler->WriteBinaryImage( out_stream );
+		}
+		else {
+			assembler->WriteImage( output->format, out_stream );
+		}
+	}
+
+} // WriteOutput
+
 int main( int argc, const char *argv[] ) {
 
 	char banner[] = "Mano Assembler (c) 1997 Rochester Institute " \
@@ -28,28 +125,101 @@ int main( int argc, const char *argv[] ) {
 			"System Architecture, 3rd ed. Englewood Cliffs, " \
 			"NJ: Prentice Hall, 1993\n";
 
-	char syntax[] = "Syntax: manoasm <infile> <outfile> [-v|-c|-n]\n";
+	char syntax[] = "Syntax: manoasm <infile> <outfile> [-v|-c|-n] [-O] [-s] "
+			"[-j <threads>] [-l <listing>] [-b <cycles>]\n"
+			"\t\t[--stats[=<path>]] [-o <format>=<path>]...\n"
+			"\t-o\talso write the output in a format (n, v, c, b for "
+			"a binary\n"
+			"\t\timage, or p for a program file with symbols and "
+			"lines); with -o,\n"
+			"\t\t<outfile> may be left out\n"
+			"\t-O\toptimize redundant sequences\n"
+			"\t-s\tassemble in a single pass (infile may be stdin)\n"
+			"\t-j\tthreads to use on long sources (default: all)\n"
+			"\t-l\twrite a listing with cycles and worst cases\n"
+			"\t-b\twarn if the interrupt path can take longer\n"
+			"\t--stats\twrite a line of JSON timing and counting the "
+			"assembly,\n"
+			"\t\tas the only standard output, or to a file\n"
+			"\n"
+			"        manoasm -d <socket> [-j <workers>]\n"
+			"\t-d\tserve assembly requests on a local socket\n"
+			"\t-j\tworker threads (default: all)\n";
 
 	const char *infile, *outfile;
+	const char *listfile = 0;
+	long budget = -1;
+	long threads = 0;
+
+	// With --stats, standard output carries the JSON line alone:
+	bool quiet = false;
+	for( int arg = 1; arg < argc; arg++ ) {
+		if( strcmp( argv[arg], "--stats" ) == 0 ) {
+			quiet = true;
+		}
+	}
+	ostream &status_stream = quiet ? null_stream : cout;
 	
 	// Output banner:
-	cout << banner << endl;
+	status_stream << banner << endl;
 	
 	// Check command-line arguments:
-	if( argc < 3 || argc > 4 ) {
+	if( argc < 3 ) {
 		cout << syntax << endl;
 		return 1;
 	}
 
-	// Retrieve infile and outfile parameters:
+	// Serve requests until a client sends QUIT:
+	if( strcmp( argv[1], "-d" ) == 0 ) {
+		if( argc == 4 || (argc == 5 && strcmp( argv[3], "-j" ) != 0)
+			|| argc > 5 )
+		{
+			cout << syntax << endl;
+			return 1;
+		}
+
+		CAssemblerServer server;
+		try {
+			server.Run( argv[2], argc == 5 ? (unsigned)atol( argv[4] ) : 0,
+				cout );
+		}
+		catch( CErrorException e ) {
+			e.Display( cerr );
+			return 1;
+		}
+
+		server.WriteLatencyReport( cout );
+		return 0;
+	}
+
+	// Retrieve infile and outfile parameters (the outfile may be left
+	// out for the -o outputs):
 	infile = argv[1];
-	outfile = argv[2];
+	outfile = argv[2][0] != '-' ? argv[2] : 0;
 
 	// Open the files, and assemble away!
-	CManoAssembler::format format;
-	if (argc == 4 && argv[3][0] == '-')
+	CManoAssembler::format format = CManoAssembler::normal;
+	bool optimize = false;
+	bool single_pass = false;
+	bool stats = false;
+	const char *statsfile = 0;
+	vector<SOutput> outputs;
+	for (int arg = outfile ? 3 : 2; arg < argc; arg++)
 	{
-		switch (argv[3][1])
+		if (argv[arg][0] != '-')
+			continue;
+		if (strcmp(argv[arg], "--stats") == 0)
+		{
+			stats = true;
+			continue;
+		}
+		if (strncmp(argv[arg], "--stats=", 8) == 0 && argv[arg][8])
+		{
+			stats = true;
+			statsfile = argv[arg] + 8;
+			continue;
+		}
+		switch (argv[arg][1])
 		{
 		case 'v':
 			format = CManoAssembler::verilog;
@@ -57,38 +227,159 @@ int main( int argc, const char *argv[] ) {
 		case 'c':
 			format = CManoAssembler::coe;
 			break;
+		case 'O':
+			optimize = true;
+			break;
+		case 's':
+			single_pass = true;
+			break;
+		case 'l':
+		case 'b':
+		case 'j':
+		case 'o':
+			if (arg + 1 >= argc)
+			{
+				cout << syntax << endl;
+				return 1;
+			}
+			if (argv[arg][1] == 'o')
+			{
+				SOutput output;
+				if (!ParseOutput(argv[++arg], output))
+				{
+					cout << syntax << endl;
+					return 1;
+				}
+				outputs.push_back(output);
+			}
+			else if (argv[arg][1] == 'l')
+				listfile = argv[++arg];
+			else if (argv[arg][1] == 'j')
+				threads = atol(argv[++arg]);
+			else
+				budget = atol(argv[++arg]);
+			break;
 		case 'n':
 		default:
 			format = CManoAssembler::normal;
 			break;
 		}
 	}
-	else
-		format = CManoAssembler::normal;
+	if (!outfile && outputs.empty())
+	{
+		cout << syntax << endl;
+		return 1;
+	}
+
+	// Without an outfile, assemble in the first -o format:
+	if (!outfile)
+		format = outputs[0].format;
+
 	CManoAssembler assembler(format);
+	assembler.SetRecordImage(!outputs.empty());
+	assembler.SetOptimize(optimize);
+	assembler.SetSinglePass(single_pass);
+	assembler.SetCollectStats(stats);
+	if (threads > 0)
+		assembler.SetThreads((unsigned)threads);
 	CStringList output_list;
 
 	try {
-		assembler.AssembleFromFile( infile, output_list );
+		assembler.AssembleFromFile( infile, output_list, status_stream );
 	}
 	catch( CErrorException e ) {
 		e.Display( cerr );
 	}
 
 	// Write the output list to the output file:
-	ofstream out_stream( outfile );
+	if( outfile ) {
+		ofstream out_stream( outfile );
 
-	if( !out_stream.is_open() ) {
-		CErrorException e( "", 0, "A0002", 
-			"Could not open output file for writing", 
-			CErrorException::FATAL );
+		if( !out_stream.is_open() ) {
+			CErrorException e( "", 0, "A0002", 
+				"Could not open output file for writing", 
+				CErrorException::FATAL );
 
-		e.Display( cerr );
-		return 1;
+			e.Display( cerr );
+			return 1;
+		}
+
+		output_list.Dump( out_stream );
+	}
+
+	// Write the -o outputs from the one assembly, side by side:
+	if( !outputs.empty() ) {
+		vector<thread> writers;
+		size_t o;
+
+		for( o = 0; o < outputs.size(); o++ ) {
+			writers.push_back( thread( WriteOutput, &assembler, 
+				&outputs[o] ) );
+		}
+		for( o = 0; o < writers.size(); o++ ) {
+			writers[o].join();
+		}
+
+		for( o = 0; o < outputs.size(); o++ ) {
+			if( !outputs[o].opened ) {
+				CErrorException e( outputs[o].path, 0, "A0002", 
+					"Could not open output file for writing", 
+					CErrorException::FATAL );
+
+				e.Display( cerr );
+				return 1;
+			}
+		}
 	}
 
+	if( statsfile ) {
+		ofstream stats_stream( statsfile );
+
+		if( !stats_stream.is_open() ) {
+			CErrorException e( statsfile, 0, "A0002", 
+				"Could not open output file for writing", 
+				CErrorException::FATAL );
 
-	output_list.Dump( out_stream );
+			e.Display( cerr );
+			return 1;
+		}
+		assembler.WriteStats( stats_stream );
+		stats_stream << endl;
+	}
+	else if( stats ) {
+		assembler.WriteStats( cout );
+		cout << endl;
+	}
+
+	// Cost the program, if it assembled and anyone asked:
+	if( (listfile || budget >= 0) && assembler.GetErrorCount() == 0
+		&& !output_list.empty() )
+	{
+		CCycleEstimator estimator;
+		estimator.Analyze( assembler );
+
+		if( listfile ) {
+			ofstream list_stream( listfile );
+			if( !list_stream.is_open() ) {
+				CErrorException e( listfile, 0, "A0002", 
+					"Could not open output file for writing", 
+					CErrorException::FATAL );
+
+				e.Display( cerr );
+				return 1;
+			}
+			estimator.WriteListing( list_stream );
+		}
+
+		const unsigned long long path = estimator.GetInterruptPath();
+		if( budget >= 0 && path > (unsigned long long)budget ) {
+			CErrorException e( infile, 0, "A5001", 
+				"Interrupt path may exceed the cycle budget", 
+				CErrorException::WARNING );
+
+			e.Display( cerr );
+		}
+	}
 
 	return 0;
 }
@@ -0,0 +1,96 @@
+// File:	BenchIo.cpp
+// Description:
+//		A character device for benchmark runs, fed from a queue.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "BenchIo.hpp"
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CBenchIo::CBenchIo() {
+
+	m_next = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CBenchIo::~CBenchIo() {
+} // (destructor)
+
+//
+// Name:	Clear
+//
+void CBenchIo::Clear() {
+
+	m_input.clear();
+	m_output.clear();
+	m_next = 0;
+	m_stop_requested = false;
+
+} // Clear
+
+//
+// Name:	Queue
+//
+void CBenchIo::Queue( unsigned char character ) {
+
+	m_input.push_back( character );
+
+} // Queue
+
+//
+// Name:	GetFgi
+//
+bool CBenchIo::GetFgi( unsigned long long ) {
+
+	if( m_next < m_input.size() ) {
+		return true;
+	}
+
+	if( !m_input.empty() ) {
+		m_stop_requested = true;
+	}
+	return false;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CBenchIo::GetFgo( unsigned long long ) {
+
+	return true;
+
+} // GetFgo
+
+//
+// Name:	Input
+//
+unsigned char CBenchIo::Input( unsigned long long ) {
+
+	return m_next < m_input.size() ? m_input[m_next++] : 0;
+
+} // Input
+
+//
+// Name:	Output
+//
+void CBenchIo::Output( unsigned char character, unsigned long long ) {
+
+	m_output.push_back( character );
+
+} // Output
+
+//
+// Name:	GetOutput
+//
+const vector<unsigned char> &CBenchIo::GetOutput() const {
+	return m_output;
+} // GetOutput
@@ -0,0 +1,89 @@
+// File:	BenchIo.hpp
+// Description:
+//		A character device for benchmark runs: input comes from a
+//		queue filled before the run, and output is kept in memory
+//		so it can be checked afterwards.
+// Usage:
+//		Call Queue for each input character, attach the object to a
+//		CManoSimulator with SetIo, and run.  Call Clear before
+//		reusing it.
+//
+// Notes:
+//
+//		FGI reads 1 while queued input is left; FGO always reads 1.
+//		Sampling FGI once queued input has run out requests a stop,
+//		so a program waiting for more input ends the run instead of
+//		spinning.  With nothing queued at all, FGI simply reads 0.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+
+#include <vector>
+
+class CBenchIo : public CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CBenchIo object with nothing queued.
+	//
+	CBenchIo();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CBenchIo object.
+	//
+	virtual ~CBenchIo();
+
+public:	// Initialization
+
+	//
+	// Name:	Clear
+	//
+	// Description:	Empties the input queue, forgets the output, and
+	//		withdraws any stop request.
+	// Modifies:	Everything
+	//
+	void Clear();
+
+	//
+	// Name:	Queue
+	//
+	// Description:	Adds a character to the end of the input queue.
+	// Arguments:	The character
+	// Modifies:	m_input
+	//
+	void Queue( unsigned char character );
+
+public:	// CManoIo
+
+	virtual bool GetFgi( unsigned long long cycle );
+	virtual bool GetFgo( unsigned long long cycle );
+	virtual unsigned char Input( unsigned long long cycle );
+	virtual void Output( unsigned char character, unsigned long long cycle );
+
+public:	// Accessors
+
+	//
+	// Name:	GetOutput
+	//
+	// Returns:	The characters output since Clear.
+	//
+	const std::vector<unsigned char> &GetOutput() const;
+
+protected: // Attributes
+
+	std::vector<unsigned char> m_input;	// Queued input
+
+	size_t		m_next;		// Next queued character to read
+
+	std::vector<unsigned char> m_output;	// Characters output
+};
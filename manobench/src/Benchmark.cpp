@@ -0,0 +1,236 @@
+// File:	Benchmark.cpp
+// Description:
+//		Collects benchmark results, writes them as JSON, and compares
+//		them with a baseline.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "Benchmark.hpp"
+#include "ErrorException.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CBenchmark::CBenchmark() {
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CBenchmark::~CBenchmark() {
+} // (destructor)
+
+//
+// Name:	Add
+//
+void CBenchmark::Add( const string &name, const string &unit,
+	double value )
+{
+
+	SResult result;
+	result.name = name;
+	result.unit = unit;
+	result.value = value;
+	result.compared = false;
+	result.baseline = 0;
+	m_results.push_back( result );
+
+} // Add
+
+//
+// Name:	LoadBaseline
+//
+void CBenchmark::LoadBaseline( const char *filename ) {
+
+	ifstream in( filename );
+	if( !in ) {
+		throw CErrorException( filename, 0, "B1001",
+			"Could not read baseline file", CErrorException::ERROR );
+	}
+
+	m_baseline.clear();
+
+	string line, name, unit, value;
+	while( getline( in, line ) ) {
+		if( FindMember( line, "name", name )
+			&& FindMember( line, "value", value ) )
+		{
+			SResult result;
+			result.name = name;
+			result.unit = FindMember( line, "unit", unit ) ? unit : "";
+			result.value = strtod( value.c_str(), 0 );
+			result.compared = false;
+			result.baseline = 0;
+			m_baseline.push_back( result );
+		}
+	}
+
+	if( m_baseline.empty() ) {
+		throw CErrorException( filename, 0, "B1002",
+			"Baseline file holds no results", CErrorException::ERROR );
+	}
+
+} // LoadBaseline
+
+//
+// Name:	Compare
+//
+int CBenchmark::Compare( double threshold, ostream &out ) {
+
+	int regressions = 0;
+
+	const ios::fmtflags flags = out.flags();
+	const streamsize precision = out.precision();
+	out << fixed;
+
+	out << left << setw( 40 ) << "Result" << right << setw( 16 )
+		<< "Baseline" << setw( 16 ) << "Now" << setw( 9 ) << "Change"
+		<< endl;
+
+	for( size_t i = 0; i < m_results.size(); i++ ) {
+		SResult &result = m_results[i];
+
+		for( size_t j = 0; j < m_baseline.size(); j++ ) {
+			if( m_baseline[j].name == result.name ) {
+				result.compared = true;
+				result.baseline = m_baseline[j].value;
+				break;
+			}
+		}
+		if( !result.compared || result.baseline <= 0 ) {
+			continue;
+		}
+
+		const double change = result.value / result.baseline - 1;
+		const bool regressed = change < -threshold;
+		if( regressed ) {
+			regressions++;
+		}
+
+		out << left << setw( 40 ) << result.name << right
+			<< setprecision( 0 ) << setw( 16 ) << result.baseline
+			<< setw( 16 ) << result.value
+			<< setprecision( 1 ) << setw( 8 ) << showpos << 100 * change
+			<< noshowpos << "%" << (regressed ? "  REGRESSION" : "")
+			<< endl;
+	}
+
+	out.precision( precision );
+	out.flags( flags );
+	return regressions;
+
+} // Compare
+
+//
+// Name:	WriteJson
+//
+void CBenchmark::WriteJson( ostream &out ) const {
+
+	const ios::fmtflags flags = out.flags();
+	const streamsize precision = out.precision( 17 );
+	out.unsetf( ios::floatfield );
+
+	out << "{" << endl
+		<< "  \"benchmark\": \"manobench\"," << endl
+		<< "  \"results\": [" << endl;
+
+	for( size_t i = 0; i < m_results.size(); i++ ) {
+		const SResult &result = m_results[i];
+
+		out << "    { \"name\": ";
+		WriteString( out, result.name );
+		out << ", \"unit\": ";
+		WriteString( out, result.unit );
+		out << ", \"value\": " << result.value;
+		if( result.compared ) {
+			out << ", \"baseline\": " << result.baseline
+				<< ", \"change\": " << (result.baseline > 0
+					? result.value / result.baseline - 1 : 0.0);
+		}
+		out << " }" << (i + 1 < m_results.size() ? "," : "") << endl;
+	}
+
+	out << "  ]" << endl
+		<< "}" << endl;
+
+	out.precision( precision );
+	out.flags( flags );
+
+} // WriteJson
+
+//
+// Name:	WriteString
+//
+void CBenchmark::WriteString( ostream &out, const string &text ) {
+
+	out << '"';
+	for( size_t i = 0; i < text.size(); i++ ) {
+		const unsigned char c = (unsigned char)text[i];
+		if( c == '"' || c == '\\' ) {
+			out << '\\' << c;
+		}
+		else if( c < 0x20 ) {
+			char escape[8];
+			sprintf( escape, "\\u%04x", c );
+			out << escape;
+		}
+		else {
+			out << c;
+		}
+	}
+	out << '"';
+
+} // WriteString
+
+//
+// Name:	FindMember
+//
+bool CBenchmark::FindMember( const string &line, const char *member,
+	string &value )
+{
+
+	const string key = string( "\"" ) + member + "\":";
+	size_t p = line.find( key );
+	if( p == string::npos ) {
+		return false;
+	}
+	p += key.size();
+	while( p < line.size() && line[p] == ' ' ) {
+		p++;
+	}
+
+	value.clear();
+	if( p < line.size() && line[p] == '"' ) {
+		// A string, whose escapes are only those WriteString makes:
+		for( p++; p < line.size() && line[p] != '"'; p++ ) {
+			if( line[p] == '\\' && p + 1 < line.size() ) {
+				p++;
+				if( line[p] == 'u' && p + 4 < line.size() ) {
+					value += (char)strtol(
+						line.substr( p + 1, 4 ).c_str(), 0, 16 );
+					p += 4;
+					continue;
+				}
+			}
+			value += line[p];
+		}
+		return p < line.size();
+	}
+
+	// A number:
+	while( p < line.size() && line[p] != ',' && line[p] != ' '
+		&& line[p] != '}' )
+	{
+		value += line[p++];
+	}
+	return !value.empty();
+
+} // FindMember
@@ -0,0 +1,141 @@
+// File:	Benchmark.hpp
+// Description:
+//		Collects benchmark results, writes them as JSON, and compares
+//		them with a baseline written by an earlier run.
+// Usage:
+//		1. create one instance of this class
+//		2. call Add once per measurement
+//		3. optionally call LoadBaseline, then Compare
+//		4. call WriteJson
+//
+// Notes:
+//
+//		Every value is a rate, so higher is better.  Results are
+//		matched with the baseline by name.
+//
+//		The JSON has one result object per line:
+//
+//		{
+//		  "benchmark": "manobench",
+//		  "results": [
+//		    { "name": "...", "unit": "...", "value": ... },
+//		    ...
+//		  ]
+//		}
+//
+//		after a comparison, each result that was in the baseline
+//		also carries "baseline" and "change" (a fraction) members.
+//		LoadBaseline reads this line format back, not JSON in
+//		general.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+class CBenchmark {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CBenchmark object with no results.
+	//
+	CBenchmark();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CBenchmark object.
+	//
+	~CBenchmark();
+
+public:	// Results
+
+	//
+	// Name:	Add
+	//
+	// Description:	Records a measurement.
+	// Arguments:	Its name ("area.metric.subject"), its unit, and
+	//		its value
+	// Modifies:	m_results
+	//
+	void Add( const std::string &name, const std::string &unit,
+		double value );
+
+	//
+	// Name:	LoadBaseline
+	//
+	// Description:	Reads the results of an earlier run.
+	// Arguments:	The JSON file written by WriteJson
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		read (B1001) or holds no results (B1002).
+	// Modifies:	m_baseline
+	//
+	void LoadBaseline( const char *filename );
+
+	//
+	// Name:	Compare
+	//
+	// Description:	Compares every result with the baseline, and lists
+	//		the changes.
+	// Arguments:	The largest slowdown that is not a regression, as
+	//		a fraction, and the stream to list the changes to
+	// Returns:	The number of regressions.
+	// Modifies:	m_results
+	//
+	int Compare( double threshold, std::ostream &out );
+
+	//
+	// Name:	WriteJson
+	//
+	// Description:	Writes every result as JSON.
+	// Arguments:	The stream to write to
+	//
+	void WriteJson( std::ostream &out ) const;
+
+protected: // Types
+
+	// A measurement:
+	struct SResult {
+		std::string	name;		// What was measured
+		std::string	unit;		// What it was measured in
+		double		value;		// The measurement
+		bool		compared;	// true if found in the baseline
+		double		baseline;	// The baseline measurement
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	WriteString
+	//
+	// Description:	Writes a string as a JSON string literal.
+	// Arguments:	The stream to write to, and the string
+	//
+	static void WriteString( std::ostream &out, const std::string &text );
+
+	//
+	// Name:	FindMember
+	//
+	// Description:	Finds a member on one line of JSON written by
+	//		WriteJson.
+	// Arguments:	The line, the member name, and the string to receive
+	//		the text of its value (without quotes for strings)
+	// Returns:	true if the member was found.
+	//
+	static bool FindMember( const std::string &line, const char *member,
+		std::string &value );
+
+protected: // Attributes
+
+	std::vector<SResult>	m_results;	// This run's results
+
+	std::vector<SResult>	m_baseline;	// The baseline's results
+};
@@ -0,0 +1,734 @@
+// File:	main.cpp
+// Description:	Main module for the Mano benchmark suite
+// Usage:
+//		manobench [-p <programs>] [-o <json>] [-b <baseline>]
+//		          [-t <percent>] [-m <seconds>] [-w <words>]
+//		          [-f <blocks>]
+//
+//		Measures, and writes as JSON:
+//
+//		assembler.*	lines/s and bytes/s assembling each sample
+//				program and a large generated source, and
+//				that source with invalid lines mixed in
+//				(checking that each is reported)
+//		emit.*		output bytes/s assembling the generated
+//				source into each output format
+//		loader.*	image bytes/s loading the generated source
+//				from memory in each image format
+//		simulator.*	instructions/s and cycles/s running each
+//				sample program
+//		reverse.*	instructions/s running each sample program
+//				with checkpoints for reverse execution, and
+//				reverse steps/s stepping it back to its start
+//		sweep.*		runs/s and instructions/s running booth.asm
+//				over every pair of 7-bit operands, reloading
+//				the image for each run and checking the
+//				product
+//
+//		It also checks that a reused assembler takes nothing from
+//		the heap assembling each sample program and the generated
+//		source again, in each output format, in one pass or two.
+//
+//		With -b, each result is compared with the baseline, and the
+//		exit code is 2 if anything slowed down by more than -t
+//		percent (10 by default).
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <new>
+
+#include "Benchmark.hpp"
+#include "BenchIo.hpp"
+#include "History.hpp"
+#include "ImageLoader.hpp"
+#include "ManoAssembler.hpp"
+#include "ManoSimulator.hpp"
+#include "MemoryImage.hpp"
+#include "ProgramGenerator.hpp"
+
+using namespace std;
+
+// The sample programs in synth/programs, booth.asm first:
+#define SAMPLE_PROGRAMS	3
+static const char *sample_programs[SAMPLE_PROGRAMS] =
+	{ "booth.asm", "fibb.asm", "speed.asm" };
+
+// The generated source, and the names of its valid and invalid forms
+// in results:
+#define GENERATED_FILE	"manobench.asm"
+#define GENERATED_NAME	"generated"
+#define INVALID_NAME	"invalid"
+
+// Invalid lines per 100 in the invalid form of the generated source:
+#define INVALID_LINES	5
+
+// The ASCII enquiry code booth.asm sends before reading its operands:
+#define BOOTH_ENQUIRY	0x05
+
+// booth.asm gives a 14-bit product, and cannot take -64 as the
+// multiplicand since it negates it in seven bits:
+#define BOOTH_PRODUCT_MASK	0x3FFF
+#define BOOTH_MIN_MULTIPLICAND	-63
+
+// Instructions between checkpoints when stepping back; the sample
+// programs run for a few hundred:
+#define REVERSE_INTERVAL	100
+
+// Discards the assembler's status messages:
+static ostream null_stream( 0 );
+
+// Assemblies to run before counting allocations, so that the
+// assembler's buffers and arenas have grown to the source:
+#define WARM_UP_ASSEMBLIES	2
+
+// Heap allocations made while counting is on (CheckAllocations runs
+// the assembler on this thread only):
+static bool counting_allocations = false;
+static unsigned long allocations = 0;
+
+// Count the allocations the standard containers and strings make:
+void *operator new( size_t size ) {
+
+	if( counting_allocations ) {
+		allocations++;
+	}
+	void *block = malloc( size ? size : 1 );
+	if( !block ) {
+		throw bad_alloc();
+	}
+	return block;
+
+} // operator new
+
+void *operator new[]( size_t size ) {
+
+	return operator new( size );
+
+} // operator new[]
+
+void operator delete( void *block ) noexcept {
+
+	free( block );
+
+} // operator delete
+
+void operator delete[]( void *block ) noexcept {
+
+	free( block );
+
+} // operator delete[]
+
+void operator delete( void *block, size_t ) noexcept {
+
+	operator delete( block );
+
+} // operator delete
+
+void operator delete[]( void *block, size_t ) noexcept {
+
+	operator delete[]( block );
+
+} // operator delete[]
+
+typedef chrono::steady_clock::time_point time_point;
+
+// Gives the seconds elapsed since a point in time:
+static double Since( const time_point &start ) {
+
+	return chrono::duration<double>(
+		chrono::steady_clock::now() - start ).count();
+
+} // Since
+
+//
+// Name:	Assemble
+//
+// Description:	Assembles a source file, with status messages discarded.
+// Arguments:	The source file, the output format, the list to
+//		receive the output, and the number of errors the source
+//		holds on purpose (their messages are discarded too)
+// Exceptions:	Throws a CErrorException if the source could not be
+//		read, did not assemble (B1004), or did not give the
+//		expected number of errors (B1007).
+//
+static void Assemble( const char *filename, CManoAssembler::format format,
+	CStringList &output, int errors = 0 )
+{
+	CManoAssembler assembler( format );
+
+	assembler.AssembleFromFile( filename, output, null_stream,
+		errors ? null_stream : cerr );
+	if( assembler.GetErrorCount() != errors ) {
+		if( !errors ) {
+			throw CErrorException( filename, 0, "B1004",
+				"Program did not assemble", CErrorException::ERROR );
+		}
+		throw CErrorException( filename, 0, "B1007",
+			"Assembler gave the wrong number of errors",
+			CErrorException::ERROR );
+	}
+
+} // Assemble
+
+//
+// Name:	CheckAllocations
+//
+// Description:	Checks that a reused assembler takes nothing from the
+//		heap: in each output format, in one pass and in two, the
+//		source is assembled a few times to warm the assembler
+//		up, and once more (after Reset and Rewind) with
+//		allocations counted.  Parallel passes allocate, so one
+//		thread is used.
+// Arguments:	The source file
+// Exceptions:	Throws a CErrorException if the source did not assemble
+//		(B1004), or the last assembly allocated (B1009).
+//
+static void CheckAllocations( const char *filename ) {
+
+	static const CManoAssembler::format formats[] =
+		{ CManoAssembler::normal, CManoAssembler::verilog,
+		  CManoAssembler::coe };
+
+	for( int f = 0; f < 6; f++ ) {
+		CManoAssembler assembler( formats[f / 2] );
+		CStringList output;
+		assembler.SetSinglePass( f % 2 != 0 );
+		assembler.SetThreads( 1 );
+
+		for( int run = 0; run <= WARM_UP_ASSEMBLIES; run++ ) {
+			assembler.Reset();
+			output.Rewind();
+
+			allocations = 0;
+			counting_allocations = run == WARM_UP_ASSEMBLIES;
+			assembler.AssembleFromFile( filename, output, 
+				null_stream, cerr );
+			counting_allocations = false;
+
+			if( assembler.GetErrorCount() ) {
+				throw CErrorException( filename, 0, "B1004",
+					"Program did not assemble",
+					CErrorException::ERROR );
+			}
+		}
+
+		if( allocations ) {
+			throw CErrorException( filename, 0, "B1009",
+				"Repeated assembly allocated memory",
+				CErrorException::ERROR );
+		}
+	}
+
+} // CheckAllocations
+
+//
+// Name:	GenerateSource
+//
+// Description:	Writes a synthetic program made by CProgramGenerator.
+// Arguments:	The file to write, the generator options, and the
+//		generator
+// Exceptions:	Throws a CErrorException if the file could not be
+//		written (B1005).
+//
+static void GenerateSource( const char *filename,
+	const SGeneratorOptions &options, CProgramGenerator &generator )
+{
+	CStringList source;
+	generator.Generate( options, source );
+
+	ofstream out( filename );
+	source.Dump( out );
+	out.close();
+	if( !out ) {
+		throw CErrorException( filename, 0, "B1005",
+			"Could not write generated source", CErrorException::ERROR );
+	}
+
+} // GenerateSource
+
+//
+// Name:	BenchAssembler
+//
+// Description:	Measures the assembler's lines/s and bytes/s on a source
+//		file, assembling it repeatedly for at least a given time.
+// Arguments:	The results, the source file, its name in results, the
+//		time to run for, and the number of errors it holds on
+//		purpose
+//
+static void BenchAssembler( CBenchmark &bench, const char *filename,
+	const string &name, double seconds, int errors = 0 )
+{
+	CStringList source;
+	source.ReadFromFile( filename );
+	ifstream file( filename, ios::in | ios::binary );
+	file.seekg( 0, ios::end );
+	const double lines = (double)source.size();
+	const double bytes = (double)file.tellg();
+
+	unsigned long long runs = 0;
+	const time_point start = chrono::steady_clock::now();
+	double elapsed;
+	do {
+		CStringList output;
+		Assemble( filename, CManoAssembler::normal, output, errors );
+		runs++;
+	} while( (elapsed = Since( start )) < seconds );
+
+	bench.Add( "assembler.lines_per_s." + name, "lines/s",
+		lines * runs / elapsed );
+	bench.Add( "assembler.bytes_per_s." + name, "bytes/s",
+		bytes * runs / elapsed );
+
+} // BenchAssembler
+
+//
+// Name:	BenchFormats
+//
+// Description:	Measures output bytes/s assembling a source file into
+//		each output format and writing the output list to memory.
+// Arguments:	The results, the source file, its name in results, and
+//		the time to run each format for
+//
+static void BenchFormats( CBenchmark &bench, const char *filename,
+	const string &name, double seconds )
+{
+	static const CManoAssembler::format formats[] =
+		{ CManoAssembler::normal, CManoAssembler::verilog,
+		  CManoAssembler::coe };
+	static const char *format_names[] = { "normal", "verilog", "coe" };
+
+	for( int f = 0; f < 3; f++ ) {
+		unsigned long long runs = 0;
+		double bytes = 0;
+		const time_point start = chrono::steady_clock::now();
+		double elapsed;
+		do {
+			CStringList output;
+			ostringstream out;
+			Assemble( filename, formats[f], output );
+			output.Dump( out );
+			bytes += (double)out.str().size();
+			runs++;
+		} while( (elapsed = Since( start )) < seconds );
+
+		bench.Add( string( "emit.bytes_per_s." ) + format_names[f]
+			+ "." + name, "bytes/s", bytes / elapsed );
+	}
+
+} // BenchFormats
+
+//
+// Name:	BenchLoader
+//
+// Description:	Measures image bytes/s loading a source file's image in
+//		each format, parsing it repeatedly from memory for at
+//		least a given time.  Each image is checked against the
+//		normal one once.
+// Arguments:	The results, the source file, its name in results, and
+//		the time to run each format for
+// Exceptions:	Throws a CErrorException if the source did not assemble,
+//		or a format loads differently (B1008).
+//
+static void BenchLoader( CBenchmark &bench, const char *filename,
+	const string &name, double seconds )
+{
+	static const CManoAssembler::format formats[] =
+		{ CManoAssembler::normal, CManoAssembler::verilog,
+		  CManoAssembler::coe };
+	static const char *format_names[] =
+		{ "normal", "verilog", "coe", "binary" };
+
+	CManoAssembler assembler( CManoAssembler::normal );
+	CStringList output;
+	assembler.SetRecordImage( true );
+	assembler.AssembleFromFile( filename, output, null_stream, cerr );
+	if( assembler.GetErrorCount() ) {
+		throw CErrorException( filename, 0, "B1004",
+			"Program did not assemble", CErrorException::ERROR );
+	}
+
+	string images[4];
+	for( int f = 0; f < 4; f++ ) {
+		ostringstream out;
+		if( f == 3 ) {
+			assembler.WriteBinaryImage( out );
+		}
+		else {
+			assembler.WriteImage( formats[f], out );
+		}
+		images[f] = out.str();
+	}
+
+	CMemoryImage expected;
+	CImageLoader::Parse( images[0].data(), images[0].size(), filename,
+		expected );
+
+	static unsigned short memory[MANO_MEMORY_SIZE];
+	for( int f = 0; f < 4; f++ ) {
+		const char *data = images[f].data();
+		const size_t size = images[f].size();
+
+		// coe also holds the words without lines, so only the words
+		// of the normal image are compared:
+		CImageLoader::Parse( data, size, filename, memory );
+		for( unsigned address = 0; address < MANO_MEMORY_SIZE;
+			address++ )
+		{
+			if( expected.IsStored( address )
+				&& memory[address] != expected.Fetch( address ) )
+			{
+				throw CErrorException( filename, 0, "B1008",
+					"Image formats load differently",
+					CErrorException::ERROR );
+			}
+		}
+
+		unsigned long long runs = 0;
+		const time_point start = chrono::steady_clock::now();
+		double elapsed;
+		do {
+			CImageLoader::Parse( data, size, filename, memory );
+			runs++;
+		} while( (elapsed = Since( start )) < seconds );
+
+		bench.Add( string( "loader.bytes_per_s." ) + format_names[f]
+			+ "." + name, "bytes/s", (double)size * runs / elapsed );
+	}
+
+} // BenchLoader
+
+//
+// Name:	QueueBoothOperands
+//
+// Description:	Queues the two operands booth.asm reads.
+//
+static void QueueBoothOperands( CBenchIo &io, int multiplicand,
+	int multiplier )
+{
+	io.Queue( (unsigned char)(multiplicand & 0x7F) );
+	io.Queue( (unsigned char)(multiplier & 0x7F) );
+
+} // QueueBoothOperands
+
+//
+// Name:	BenchSimulator
+//
+// Description:	Measures the simulator's instructions/s and cycles/s on
+//		a program, running it from a fresh load repeatedly for at
+//		least a given time.  Only the runs themselves are timed.
+//		booth.asm is given the operands of sim_ppar.v.
+// Arguments:	The results, the source file, its name in results, and
+//		the time to run for
+//
+static void BenchSimulator( CBenchmark &bench, const char *filename,
+	const string &name, double seconds )
+{
+	CStringList list;
+	Assemble( filename, CManoAssembler::normal, list );
+
+	CMemoryImage image;
+	CManoSimulator::ReadImage( list, filename, image );
+
+	CManoSimulator simulator;
+	CBenchIo io;
+	simulator.SetIo( &io );
+
+	unsigned long long instructions = 0, cycles = 0;
+	double elapsed = 0;
+	while( elapsed < seconds ) {
+		simulator.ClearMemory();
+		simulator.LoadImage( image );
+		simulator.Reset();
+		io.Clear();
+		QueueBoothOperands( io, 60, 50 );
+
+		const time_point start = chrono::steady_clock::now();
+		simulator.Run( ~0ULL );
+		elapsed += Since( start );
+
+		instructions += simulator.GetInstructions();
+		cycles += simulator.GetCycles();
+	}
+
+	bench.Add( "simulator.instructions_per_s." + name, "instructions/s",
+		instructions / elapsed );
+	bench.Add( "simulator.cycles_per_s." + name, "cycles/s",
+		cycles / elapsed );
+
+} // BenchSimulator
+
+//
+// Name:	BenchReverse
+//
+// Description:	Measures reverse execution on a program: it is run to
+//		the end under a CHistory, then stepped back one
+//		instruction at a time to its start, repeatedly for at
+//		least a given time.
+// Arguments:	The results, the source file, its name in results, and
+//		the time to run for
+//
+static void BenchReverse( CBenchmark &bench, const char *filename,
+	const string &name, double seconds )
+{
+	CStringList list;
+	Assemble( filename, CManoAssembler::normal, list );
+
+	CMemoryImage image;
+	CManoSimulator::ReadImage( list, filename, image );
+
+	CManoSimulator simulator;
+	CBenchIo io;
+	CHistory history;
+	simulator.SetIo( &history );
+
+	unsigned long long instructions = 0, steps = 0;
+	double forward = 0, backward = 0;
+	while( forward + backward < seconds ) {
+		simulator.ClearMemory();
+		simulator.LoadImage( image );
+		simulator.Reset();
+		io.Clear();
+		QueueBoothOperands( io, 60, 50 );
+		history.Attach( &simulator, &io, REVERSE_INTERVAL,
+			HISTORY_BUDGET );
+
+		time_point start = chrono::steady_clock::now();
+		instructions += history.Run( ~0ULL );
+		forward += Since( start );
+
+		start = chrono::steady_clock::now();
+		while( history.ReverseStep() ) {
+			steps++;
+		}
+		backward += Since( start );
+	}
+
+	bench.Add( "reverse.instructions_per_s." + name, "instructions/s",
+		instructions / forward );
+	bench.Add( "reverse.steps_per_s." + name, "steps/s",
+		steps / backward );
+
+} // BenchReverse
+
+//
+// Name:	BenchSweep
+//
+// Description:	Measures batch throughput: booth.asm is reloaded, reset
+//		and run for every pair of signed 7-bit operands it can
+//		multiply, and each product is checked.
+// Arguments:	The results, and the booth.asm source file
+// Exceptions:	Throws a CErrorException if a product is wrong (B1006).
+//
+static void BenchSweep( CBenchmark &bench, const char *filename ) {
+
+	CStringList list;
+	Assemble( filename, CManoAssembler::normal, list );
+
+	// Read the image once; each run loads its segments:
+	CMemoryImage image;
+	CManoSimulator::ReadImage( list, filename, image );
+
+	CManoSimulator simulator;
+	CBenchIo io;
+	simulator.SetIo( &io );
+
+	unsigned long long runs = 0, instructions = 0;
+	const time_point start = chrono::steady_clock::now();
+
+	for( int multiplicand = BOOTH_MIN_MULTIPLICAND; multiplicand < 64;
+		multiplicand++ )
+	{
+		for( int multiplier = -64; multiplier < 64; multiplier++ ) {
+			simulator.LoadImage( image );
+			simulator.Reset();
+			io.Clear();
+			QueueBoothOperands( io, multiplicand, multiplier );
+			simulator.Run( ~0ULL );
+
+			// The enquiry, then the product, low byte first:
+			const vector<unsigned char> &output = io.GetOutput();
+			if( output.size() != 3 || output[0] != BOOTH_ENQUIRY
+				|| ((output[1] | output[2] << 8) & BOOTH_PRODUCT_MASK)
+					!= ((multiplicand * multiplier)
+						& BOOTH_PRODUCT_MASK) )
+			{
+				throw CErrorException( filename, 0, "B1006",
+					"Sweep run gave a wrong result",
+					CErrorException::ERROR );
+			}
+
+			runs++;
+			instructions += simulator.GetInstructions();
+		}
+	}
+
+	const double elapsed = Since( start );
+	bench.Add( "sweep.runs_per_s.booth", "runs/s", runs / elapsed );
+	bench.Add( "sweep.instructions_per_s.booth", "instructions/s",
+		instructions / elapsed );
+
+} // BenchSweep
+
+int main( int argc, const char *argv[] ) {
+
+	char syntax[] = "Syntax: manobench [-p <programs>] [-o <json>] "
+			"[-b <baseline>] [-t <percent>] [-m <seconds>] "
+			"[-w <words>] [-f <blocks>]\n"
+			"\t-p\tdirectory holding the sample programs "
+			"(synth/programs)\n"
+			"\t-o\tfile to write the JSON results to (standard "
+			"output)\n"
+			"\t-b\tJSON results of an earlier run to compare with\n"
+			"\t-t\tslowdown, in percent, that counts as a "
+			"regression (10)\n"
+			"\t-m\tseconds to spend on each measurement (0.5)\n"
+			"\t-w\twords in the generated source (4000); beyond "
+			"4096 they\n\t\toverwrite memory in further layouts\n"
+			"\t-f\tORG blocks in each layout of the generated "
+			"source (1)\n";
+
+	string programs = "synth/programs";
+	const char *outfile = 0, *baseline = 0;
+	double threshold = 10, seconds = 0.5;
+	SGeneratorOptions options;
+	CProgramGenerator::SetDefaults( options );
+
+	// Check command-line arguments:
+	for( int arg = 1; arg < argc; arg++ ) {
+		if( argv[arg][0] == '-' && argv[arg][1] && !argv[arg][2]
+			&& arg + 1 < argc )
+		{
+			switch( argv[arg][1] ) {
+			case 'p':
+				programs = argv[++arg];
+				continue;
+			case 'o':
+				outfile = argv[++arg];
+				continue;
+			case 'b':
+				baseline = argv[++arg];
+				continue;
+			case 't':
+				threshold = strtod( argv[++arg], 0 );
+				continue;
+			case 'm':
+				seconds = strtod( argv[++arg], 0 );
+				continue;
+			case 'w':
+				options.words = atoi( argv[++arg] );
+				if( options.words < 1 ) {
+					break;
+				}
+				continue;
+			case 'f':
+				options.org_segments = atoi( argv[++arg] );
+				if( options.org_segments < 1 ) {
+					break;
+				}
+				continue;
+			}
+		}
+
+		cerr << syntax << endl;
+		return 1;
+	}
+
+	// The generated source is written to the current directory, and
+	// removed afterwards:
+	const string generated = GENERATED_FILE;
+
+	// Error messages keep pointers to file names, so these must last
+	// until the end:
+	string paths[SAMPLE_PROGRAMS];
+	for( size_t i = 0; i < SAMPLE_PROGRAMS; i++ ) {
+		paths[i] = programs + "/" + sample_programs[i];
+	}
+
+	CBenchmark bench;
+	int regressions = 0;
+
+	try {
+		if( baseline ) {
+			bench.LoadBaseline( baseline );
+		}
+
+		for( size_t i = 0; i < SAMPLE_PROGRAMS; i++ ) {
+			const char *path = paths[i].c_str();
+			const string name =
+				string( sample_programs[i] ).substr( 0,
+					strlen( sample_programs[i] ) - 4 );
+
+			cerr << "Assembling " << path << endl;
+			BenchAssembler( bench, path, name, seconds );
+			cerr << "Checking heap use assembling " << path << endl;
+			CheckAllocations( path );
+			cerr << "Simulating " << path << endl;
+			BenchSimulator( bench, path, name, seconds );
+			cerr << "Stepping back through " << path << endl;
+			BenchReverse( bench, path, name, seconds );
+		}
+
+		CProgramGenerator generator;
+		cerr << "Generating " << generated << endl;
+		GenerateSource( generated.c_str(), options, generator );
+		cerr << "Assembling " << generated << endl;
+		BenchAssembler( bench, generated.c_str(), GENERATED_NAME,
+			seconds );
+		cerr << "Checking heap use assembling " << generated << endl;
+		CheckAllocations( generated.c_str() );
+		cerr << "Emitting each format of " << generated << endl;
+		BenchFormats( bench, generated.c_str(), GENERATED_NAME,
+			seconds );
+		cerr << "Loading each image format of " << generated << endl;
+		BenchLoader( bench, generated.c_str(), GENERATED_NAME,
+			seconds );
+
+		options.invalid = INVALID_LINES;
+		cerr << "Generating " << generated << " with invalid lines"
+			<< endl;
+		GenerateSource( generated.c_str(), options, generator );
+		cerr << "Assembling " << generated << endl;
+		BenchAssembler( bench, generated.c_str(), INVALID_NAME,
+			seconds, generator.GetInvalidCount() );
+		remove( generated.c_str() );
+
+		cerr << "Sweeping booth.asm" << endl;
+		BenchSweep( bench, paths[0].c_str() );
+
+		if( baseline ) {
+			cerr << endl;
+			regressions = bench.Compare( threshold / 100, cerr );
+			cerr << regressions << " regression(s) beyond "
+				<< threshold << "%" << endl;
+		}
+
+		if( outfile ) {
+			ofstream out( outfile );
+			if( !out ) {
+				throw CErrorException( outfile, 0, "B1003",
+					"Could not open results file",
+					CErrorException::ERROR );
+			}
+			bench.WriteJson( out );
+		}
+		else {
+			bench.WriteJson( cout );
+		}
+	}
+	catch( CErrorException e ) {
+		remove( generated.c_str() );
+		e.Display( cerr );
+		return 1;
+	}
+
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,345 @@
+// File:	CallProfiler.cpp
+// Description:
+//		A monitor that follows subroutine calls and returns with a
+//		shadow call stack.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "CallProfiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// Instruction words that call and return, whatever their address field:
+#define IS_BSA( word )		(((word) & 0x7000) == 0x5000)
+#define IS_BUN_I( word )	(((word) & 0xF000) == 0xC000)
+
+// A routine's totals, for sorting the report:
+struct SRoutineLine {
+	int			routine;	// Link word, or -1
+	unsigned long long	inclusive;	// Cycles including callees
+	unsigned long long	exclusive;	// Cycles in the routine itself
+};
+
+// Orders routines by inclusive cycles, most first, then by address:
+static bool HotterRoutine( const SRoutineLine &a, const SRoutineLine &b ) {
+
+	if( a.inclusive != b.inclusive ) {
+		return a.inclusive > b.inclusive;
+	}
+	return a.routine < b.routine;
+
+} // HotterRoutine
+
+//
+// Name:	(constructor)
+//
+CCallProfiler::CCallProfiler() {
+
+	Reset();
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CCallProfiler::~CCallProfiler() {
+} // (destructor)
+
+//
+// Name:	Reset
+//
+void CCallProfiler::Reset() {
+
+	const SNode top = { -1, -1, 0, 0, map<int, int>() };
+	const SRoutine empty = { 0, 0, 0, 0, 0, 0, 0 };
+
+	m_nodes.clear();
+	m_nodes.push_back( top );
+	m_stack.clear();
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		m_routines[address] = empty;
+	}
+	m_node = 0;
+	m_max_depth = 0;
+	m_cycle = 0;
+
+} // Reset
+
+//
+// Name:	Retire
+//
+void CCallProfiler::Retire( const SRetire &retire ) {
+
+	m_nodes[m_node].cycles += retire.cycles;
+	m_cycle = retire.cycle;
+
+	// BSA saves the return address with its first store:
+	if( IS_BSA( retire.word ) && retire.store_count ) {
+		Call( retire.store_address[0], retire.store_value[0],
+			retire.cycle );
+	}
+
+	// BUN I through a link word may be a return:
+	else if( IS_BUN_I( retire.word ) ) {
+		const unsigned short link = retire.word & 0xFFF;
+
+		// Where it went, before any interrupt cycle moved the PC:
+		const unsigned short target = (retire.events & RETIRE_INTERRUPT)
+			? retire.store_value[retire.store_count - 1]
+			: retire.next_pc;
+
+		if( m_routines[link].active ) {
+			// Unwind the routines that never returned:
+			while( m_stack.back().link != link ) {
+				m_routines[m_stack.back().link].unwound++;
+				Return( retire.cycle );
+			}
+
+			if( target == m_stack.back().return_pc ) {
+				m_routines[link].returns++;
+			}
+			else {
+				m_routines[link].other_returns++;
+			}
+			Return( retire.cycle );
+		}
+		else if( m_routines[link].calls ) {
+			m_routines[link].orphans++;
+		}
+	}
+
+	// The interrupt cycle saves the return address at 0:
+	if( retire.events & RETIRE_INTERRUPT ) {
+		Call( 0, retire.store_value[retire.store_count - 1],
+			retire.cycle );
+	}
+
+} // Retire
+
+//
+// Name:	GetDepth
+//
+size_t CCallProfiler::GetDepth() const {
+	return m_stack.size();
+} // GetDepth
+
+//
+// Name:	GetMaxDepth
+//
+size_t CCallProfiler::GetMaxDepth() const {
+	return m_max_depth;
+} // GetMaxDepth
+
+//
+// Name:	Call
+//
+void CCallProfiler::Call( unsigned short link, unsigned short return_pc,
+	unsigned long long cycle )
+{
+
+	// Find or make the calling context:
+	int node;
+	const map<int, int>::const_iterator child =
+		m_nodes[m_node].children.find( link );
+	if( child != m_nodes[m_node].children.end() ) {
+		node = child->second;
+	}
+	else {
+		const SNode added = { link, m_node, 0, 0, map<int, int>() };
+		node = (int)m_nodes.size();
+		m_nodes.push_back( added );
+		m_nodes[m_node].children[link] = node;
+	}
+
+	const SFrame frame = { node, link, return_pc, cycle };
+	m_stack.push_back( frame );
+	m_nodes[node].calls++;
+	m_node = node;
+
+	m_routines[link].calls++;
+	m_routines[link].active++;
+
+	if( m_stack.size() > m_max_depth ) {
+		m_max_depth = m_stack.size();
+	}
+
+} // Call
+
+//
+// Name:	Return
+//
+void CCallProfiler::Return( unsigned long long cycle ) {
+
+	const SFrame frame = m_stack.back();
+	SRoutine &routine = m_routines[frame.link];
+
+	m_stack.pop_back();
+	m_node = m_nodes[frame.node].parent;
+
+	// A routine still on the stack below is already being timed:
+	routine.active--;
+	if( !routine.active ) {
+		routine.inclusive += cycle - frame.start;
+	}
+
+} // Return
+
+//
+// Name:	GetName
+//
+string CCallProfiler::GetName( int routine, const CSourceMap &map ) {
+
+	if( routine < 0 ) {
+		return "(top)";
+	}
+	if( map.GetLabelAddress( (unsigned short)routine ) == routine ) {
+		return map.GetLabel( (unsigned short)routine );
+	}
+
+	ostringstream name;
+	name << hex << setfill( '0' ) << setw( 3 ) << routine;
+	return name.str();
+
+} // GetName
+
+//
+// Name:	WriteReport
+//
+void CCallProfiler::WriteReport( ostream &out, const CSourceMap &map ) const {
+
+	unsigned long long exclusive[MANO_MEMORY_SIZE];
+	unsigned long long inclusive[MANO_MEMORY_SIZE];
+	unsigned long long total = 0;
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		exclusive[address] = 0;
+		inclusive[address] = m_routines[address].inclusive;
+	}
+	for( size_t i = 0; i < m_nodes.size(); i++ ) {
+		if( m_nodes[i].routine >= 0 ) {
+			exclusive[m_nodes[i].routine] += m_nodes[i].cycles;
+		}
+		total += m_nodes[i].cycles;
+	}
+
+	// Routines still running count up to now, from their outermost
+	// frame:
+	int active[MANO_MEMORY_SIZE];
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		active[address] = 0;
+	}
+	for( size_t i = 0; i < m_stack.size(); i++ ) {
+		if( !active[m_stack[i].link]++ ) {
+			inclusive[m_stack[i].link] += m_cycle - m_stack[i].start;
+		}
+	}
+
+	vector<SRoutineLine> lines;
+	const SRoutineLine top = { -1, total, m_nodes[0].cycles };
+	lines.push_back( top );
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		if( m_routines[address].calls ) {
+			const SRoutineLine line =
+				{ address, inclusive[address], exclusive[address] };
+			lines.push_back( line );
+		}
+	}
+	stable_sort( lines.begin(), lines.end(), HotterRoutine );
+
+	const ios::fmtflags flags = out.flags();
+	out << fixed << setprecision( 1 );
+
+	unsigned long long mismatched = 0;
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		mismatched += m_routines[address].unwound
+			+ m_routines[address].orphans;
+	}
+
+	out << "Call profile: " << total << " cycle(s), "
+		<< lines.size() - 1 << " routine(s), maximum depth "
+		<< m_max_depth << ", " << mismatched
+		<< " mismatched return(s)" << endl << endl;
+
+	out << left << setw( 20 ) << "Routine" << right
+		<< setw( 10 ) << "Calls"
+		<< setw( 14 ) << "Inclusive" << setw( 7 ) << "%"
+		<< setw( 14 ) << "Exclusive" << setw( 7 ) << "%"
+		<< setw( 8 ) << "Skips" << setw( 9 ) << "Unwound"
+		<< setw( 9 ) << "Orphans" << endl;
+
+	for( size_t i = 0; i < lines.size(); i++ ) {
+		const int routine = lines[i].routine;
+		out << left << setw( 20 ) << GetName( routine, map ) << right
+			<< setw( 10 );
+		if( routine < 0 ) {
+			out << "-";
+		}
+		else {
+			out << m_routines[routine].calls;
+		}
+		out << setw( 14 ) << lines[i].inclusive
+			<< setw( 6 ) << (total ? 100.0 * lines[i].inclusive / total : 0.0)
+			<< "%" << setw( 14 ) << lines[i].exclusive
+			<< setw( 6 ) << (total ? 100.0 * lines[i].exclusive / total : 0.0)
+			<< "%";
+		if( routine >= 0 ) {
+			out << setw( 8 ) << m_routines[routine].other_returns
+				<< setw( 9 ) << m_routines[routine].unwound
+				<< setw( 9 ) << m_routines[routine].orphans;
+		}
+		out << endl;
+	}
+
+	// The calls between routines, summed over calling contexts:
+	std::map< pair<int, int>, unsigned long long > edges;
+	for( size_t i = 1; i < m_nodes.size(); i++ ) {
+		edges[make_pair( m_nodes[m_nodes[i].parent].routine,
+			m_nodes[i].routine )] += m_nodes[i].calls;
+	}
+	if( !edges.empty() ) {
+		out << endl << left << setw( 20 ) << "Caller"
+			<< setw( 20 ) << "Callee" << right
+			<< setw( 10 ) << "Calls" << endl;
+	}
+	for( std::map< pair<int, int>, unsigned long long >::const_iterator i =
+			edges.begin();
+		i != edges.end();
+		i++ )
+	{
+		out << left << setw( 20 ) << GetName( i->first.first, map )
+			<< setw( 20 ) << GetName( i->first.second, map ) << right
+			<< setw( 10 ) << i->second << endl;
+	}
+
+	out.flags( flags );
+
+} // WriteReport
+
+//
+// Name:	WriteFolded
+//
+void CCallProfiler::WriteFolded( ostream &out, const CSourceMap &map ) const {
+
+	for( size_t i = 0; i < m_nodes.size(); i++ ) {
+		if( !m_nodes[i].cycles ) {
+			continue;
+		}
+
+		// Walk up to the top level, then write the frames down:
+		vector<int> path;
+		for( int node = (int)i; node >= 0; node = m_nodes[node].parent ) {
+			path.push_back( m_nodes[node].routine );
+		}
+		for( size_t frame = path.size(); frame-- > 0; ) {
+			out << GetName( path[frame], map )
+				<< (frame ? ";" : " ");
+		}
+		out << m_nodes[i].cycles << endl;
+	}
+
+} // WriteFolded
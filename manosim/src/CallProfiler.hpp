@@ -0,0 +1,206 @@
+// File:	CallProfiler.hpp
+// Description:
+//		A monitor that follows subroutine calls and returns with a
+//		shadow call stack, and reports calls, inclusive and exclusive
+//		clock cycles per routine, the deepest nesting reached and any
+//		returns that do not match the stack.
+// Usage:
+//		Attach an instance to a CManoSimulator with AddMonitor, run,
+//		then call WriteReport and/or WriteFolded.  Pass a CSourceMap
+//		to name routines after their labels.
+//
+// Notes:
+//
+//		A routine is identified by its link word: "BSA routine" saves
+//		the return address there and "BUN routine I" returns through
+//		it.  The interrupt cycle is treated as a call to the routine
+//		whose link word is address 0, so an interrupt handler shows up
+//		as a routine too.
+//
+//		A BUN I through the link word of the routine on top of the
+//		stack is a return.  Through the link word of a routine deeper
+//		in the stack, it is a mismatched return: the routines above
+//		it are unwound and counted as never having returned.  Through
+//		the link word of a routine that was called but is not on the
+//		stack, it is counted as a return without a call.  Any other
+//		BUN I is an ordinary indirect jump.  A routine may return past
+//		its call site (to skip arguments, for instance); such returns
+//		are counted, but are not errors.
+//
+//		Exclusive cycles are charged per calling context, so the cost
+//		of each instruction is one addition; the stack itself only
+//		changes on calls and returns.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoMonitor.hpp"
+#include "ManoSimulator.hpp"
+#include "SourceMap.hpp"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class CCallProfiler : public CManoMonitor {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CCallProfiler object with an empty
+	//		stack.
+	//
+	CCallProfiler();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CCallProfiler object.
+	//
+	virtual ~CCallProfiler();
+
+public:	// Initialization
+
+	//
+	// Name:	Reset
+	//
+	// Description:	Empties the stack and forgets every count.
+	// Modifies:	Everything
+	//
+	void Reset();
+
+public:	// CManoMonitor
+
+	//
+	// Name:	Retire
+	//
+	// Description:	Charges the instruction to the current calling
+	//		context, then follows any call, return or interrupt.
+	//
+	virtual void Retire( const SRetire &retire );
+
+public:	// Accessors
+
+	//
+	// Name:	GetDepth
+	//
+	// Returns:	The number of routines on the stack now.
+	//
+	size_t GetDepth() const;
+
+	//
+	// Name:	GetMaxDepth
+	//
+	// Returns:	The most routines that were ever on the stack at once.
+	//
+	size_t GetMaxDepth() const;
+
+public:	// Output
+
+	//
+	// Name:	WriteReport
+	//
+	// Description:	Writes a text report: one line per routine, sorted
+	//		by inclusive cycles, then the calls between routines.
+	//		Routines still on the stack are counted as if they
+	//		returned at the last cycle seen.
+	// Arguments:	The stream to write to, and the source map (which
+	//		may be empty)
+	//
+	void WriteReport( std::ostream &out, const CSourceMap &map ) const;
+
+	//
+	// Name:	WriteFolded
+	//
+	// Description:	Writes exclusive cycles per call stack as folded
+	//		stacks, for flame-graph tools.
+	// Arguments:	The stream to write to, and the source map (which
+	//		may be empty)
+	//
+	void WriteFolded( std::ostream &out, const CSourceMap &map ) const;
+
+protected: // Types
+
+	// A calling context: a routine reached through a particular chain
+	// of calls.  Node 0 is the top level, outside of any routine.
+	struct SNode {
+		int		routine;	// Link word address, or -1
+		int		parent;		// Parent node, or -1
+		unsigned long long calls;	// Times entered
+		unsigned long long cycles;	// Exclusive clock cycles
+		std::map<int, int> children;	// Child node by routine
+	};
+
+	// A routine on the shadow stack:
+	struct SFrame {
+		int		node;		// Its calling context
+		unsigned short	link;		// Its link word address
+		unsigned short	return_pc;	// Where it should return to
+		unsigned long long start;	// Clock cycle it was entered
+	};
+
+	// Totals for one routine:
+	struct SRoutine {
+		unsigned long long calls;	// Times called
+		unsigned long long inclusive;	// Cycles including callees
+		unsigned long long returns;	// Matched returns
+		unsigned long long other_returns; // Returns past the call site
+		unsigned long long unwound;	// Frames lost to mismatches
+		unsigned long long orphans;	// Returns without a call
+		int		active;		// Frames on the stack now
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Call
+	//
+	// Description:	Pushes a routine on the stack.
+	// Arguments:	Its link word, its return address, and the clock
+	//		cycle it starts at
+	// Modifies:	m_stack, m_nodes, m_routines, m_max_depth
+	//
+	void Call( unsigned short link, unsigned short return_pc,
+		unsigned long long cycle );
+
+	//
+	// Name:	Return
+	//
+	// Description:	Pops the top routine off the stack, and adds its
+	//		time to its inclusive cycles unless it is still on the
+	//		stack further down.
+	// Arguments:	The clock cycle it returns at
+	// Modifies:	m_stack, m_routines
+	//
+	void Return( unsigned long long cycle );
+
+	//
+	// Name:	GetName
+	//
+	// Description:	Names a routine after the label at its link word,
+	//		or after the address if there is none.
+	// Arguments:	The link word address (or -1 for the top level),
+	//		and the source map
+	//
+	static std::string GetName( int routine, const CSourceMap &map );
+
+protected: // Attributes
+
+	std::vector<SNode>	m_nodes;	// Calling contexts
+
+	std::vector<SFrame>	m_stack;	// The shadow stack
+
+	SRoutine	m_routines[MANO_MEMORY_SIZE]; // Totals by link word
+
+	int		m_node;		// Current calling context
+
+	size_t		m_max_depth;	// Deepest stack seen
+
+	unsigned long long m_cycle;	// Last clock cycle seen
+};
@@ -0,0 +1,54 @@
+// File:	EventFormat.hpp
+// Description:
+//		Layout of the event log written by CEventRecorder and replayed
+//		by CEventReplayer: everything the character device told the
+//		simulator during a run.
+//
+// Notes:
+//
+//		An event log is "MANOEVT" and a version byte, then one record
+//		per event until the end of the file.  Each record is:
+//
+//		a kind byte:	EVENT_FGI, EVENT_FGO, EVENT_INPUT or
+//				EVENT_STOP, with EVENT_SET for a flag that
+//				reads 1
+//		call delta:	device calls since the previous event, as a
+//				varint
+//		cycle delta:	clock cycles since the previous event, as a
+//				varint
+//		character:	for EVENT_INPUT only, the character read
+//
+//		Every call into the device (GetFgi, GetFgo, Input and Output)
+//		is numbered from 1.  A flag is logged at the first sample
+//		and then only when a sample reads differently from the one
+//		before, so polling loops cost nothing.  Every INP is logged
+//		with its character.  EVENT_STOP follows the call after which
+//		the device asked for the run to end.  Several events can
+//		belong to the same call (a call delta of 0).
+//
+//		Calls, not cycles, say where an event goes: two samples of
+//		a flag can fall in the same cycle.  The cycle is kept so a
+//		replay can check that it has not diverged, and so a log can
+//		be read against a waveform.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#define EVENT_MAGIC		"MANOEVT"
+#define EVENT_VERSION		1
+
+#define EVENT_HEADER_SIZE	8	// Magic, version
+
+// Event kinds, and the flag value bit:
+#define EVENT_FGI		0
+#define EVENT_FGO		1
+#define EVENT_INPUT		2
+#define EVENT_STOP		3
+#define EVENT_KIND_MASK		0x07
+#define EVENT_SET		0x08
+
+// Bytes of records gathered before they are written:
+#define EVENT_BUFFER_SIZE	65536
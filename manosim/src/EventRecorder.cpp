@@ -0,0 +1,224 @@
+// File:	EventRecorder.cpp
+// Description:
+//		A character device that logs the answers of another device,
+//		for CEventReplayer.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "EventRecorder.hpp"
+#include "EventFormat.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+
+using namespace std;
+
+//
+// Name:	PutVarint
+//
+// Description:	Appends an unsigned LEB128 varint to a byte vector.
+//
+static void PutVarint( vector<unsigned char> &out, unsigned long long value ) {
+
+	while( value >= 0x80 ) {
+		out.push_back( (unsigned char)(value | 0x80) );
+		value >>= 7;
+	}
+	out.push_back( (unsigned char)value );
+
+} // PutVarint
+
+//
+// Name:	(constructor)
+//
+CEventRecorder::CEventRecorder() {
+
+	m_file = 0;
+	m_device = 0;
+	m_failed = false;
+	m_calls = m_last_call = m_last_cycle = 0;
+	m_fgi = m_fgo = -1;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CEventRecorder::~CEventRecorder() {
+
+	try {
+		Close();
+	}
+	catch( CErrorException e ) {
+		// Nothing more can be done with the log now.
+	}
+
+} // (destructor)
+
+//
+// Name:	Open
+//
+void CEventRecorder::Open( const char *filename, CManoIo *device ) {
+
+	Close();
+
+	m_file = fopen( filename, "wb" );
+	if( !m_file ) {
+		throw CErrorException( filename, 0, "S6001",
+			"Could not open event log", CErrorException::FATAL );
+	}
+
+	m_device = device;
+	m_failed = false;
+	m_calls = m_last_call = m_last_cycle = 0;
+	m_fgi = m_fgo = -1;
+	m_stop_requested = false;
+
+	m_buffer.clear();
+	m_buffer.reserve( EVENT_BUFFER_SIZE + 32 );
+
+	if( fwrite( EVENT_MAGIC, 1, strlen( EVENT_MAGIC ), m_file )
+		!= strlen( EVENT_MAGIC ) || fputc( EVENT_VERSION, m_file ) == EOF )
+	{
+		m_failed = true;
+	}
+
+} // Open
+
+//
+// Name:	Close
+//
+void CEventRecorder::Close() {
+
+	if( !m_file ) {
+		return;
+	}
+
+	WriteBuffer();
+	if( fclose( m_file ) != 0 ) {
+		m_failed = true;
+	}
+	m_file = 0;
+
+	if( m_failed ) {
+		throw CErrorException( "", 0, "S6002",
+			"Could not write event log", CErrorException::FATAL );
+	}
+
+} // Close
+
+//
+// Name:	GetFgi
+//
+bool CEventRecorder::GetFgi( unsigned long long cycle ) {
+
+	m_calls++;
+	const bool fgi = m_device->GetFgi( cycle );
+	if( (int)fgi != m_fgi ) {
+		m_fgi = fgi;
+		Log( (unsigned char)(EVENT_FGI | (fgi ? EVENT_SET : 0)), cycle, 0 );
+	}
+	CheckStop( cycle );
+	return fgi;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CEventRecorder::GetFgo( unsigned long long cycle ) {
+
+	m_calls++;
+	const bool fgo = m_device->GetFgo( cycle );
+	if( (int)fgo != m_fgo ) {
+		m_fgo = fgo;
+		Log( (unsigned char)(EVENT_FGO | (fgo ? EVENT_SET : 0)), cycle, 0 );
+	}
+	CheckStop( cycle );
+	return fgo;
+
+} // GetFgo
+
+//
+// Name:	Input
+//
+unsigned char CEventRecorder::Input( unsigned long long cycle ) {
+
+	m_calls++;
+	const unsigned char character = m_device->Input( cycle );
+	Log( EVENT_INPUT, cycle, character );
+	CheckStop( cycle );
+	return character;
+
+} // Input
+
+//
+// Name:	Output
+//
+void CEventRecorder::Output( unsigned char character,
+	unsigned long long cycle )
+{
+
+	m_calls++;
+	m_device->Output( character, cycle );
+	CheckStop( cycle );
+
+} // Output
+
+//
+// Name:	Flush
+//
+void CEventRecorder::Flush() {
+
+	m_device->Flush();
+
+} // Flush
+
+//
+// Name:	Log
+//
+void CEventRecorder::Log( unsigned char kind, unsigned long long cycle,
+	unsigned char character )
+{
+
+	m_buffer.push_back( kind );
+	PutVarint( m_buffer, m_calls - m_last_call );
+	PutVarint( m_buffer, cycle - m_last_cycle );
+	if( (kind & EVENT_KIND_MASK) == EVENT_INPUT ) {
+		m_buffer.push_back( character );
+	}
+	m_last_call = m_calls;
+	m_last_cycle = cycle;
+
+	if( m_buffer.size() >= EVENT_BUFFER_SIZE ) {
+		WriteBuffer();
+	}
+
+} // Log
+
+//
+// Name:	CheckStop
+//
+void CEventRecorder::CheckStop( unsigned long long cycle ) {
+
+	if( !m_stop_requested && m_device->StopRequested() ) {
+		m_stop_requested = true;
+		Log( EVENT_STOP, cycle, 0 );
+	}
+
+} // CheckStop
+
+//
+// Name:	WriteBuffer
+//
+void CEventRecorder::WriteBuffer() {
+
+	if( !m_buffer.empty() && fwrite( &m_buffer[0], 1, m_buffer.size(),
+		m_file ) != m_buffer.size() )
+	{
+		m_failed = true;
+	}
+	m_buffer.clear();
+
+} // WriteBuffer
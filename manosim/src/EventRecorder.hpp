@@ -0,0 +1,129 @@
+// File:	EventRecorder.hpp
+// Description:
+//		A character device that passes every call on to another
+//		device and logs what it answered (see EventFormat.hpp), so the
+//		run can be replayed exactly with CEventReplayer.
+// Usage:
+//		Call Open with the log file and the device to record, attach
+//		the object to a CManoSimulator with SetIo instead of the
+//		device, run, then call Close.
+//
+// Notes:
+//
+//		The simulator is deterministic apart from its device: given
+//		the same image, the same answers at the same calls give the
+//		same run, down to the cycle an interrupt is taken.  So only
+//		the answers are logged, not the instructions.  Records are
+//		gathered in memory and written in blocks of
+//		EVENT_BUFFER_SIZE bytes.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+
+#include <cstdio>
+#include <vector>
+
+class CEventRecorder : public CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CEventRecorder object with no log.
+	//
+	CEventRecorder();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Closes the log, if it is open.
+	//
+	virtual ~CEventRecorder();
+
+public:	// Event log
+
+	//
+	// Name:	Open
+	//
+	// Description:	Creates the log, and starts recording a device.
+	// Arguments:	The file to create, and the device to record
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		created (S6001).
+	//
+	void Open( const char *filename, CManoIo *device );
+
+	//
+	// Name:	Close
+	//
+	// Description:	Writes the records still gathered and closes the
+	//		log.  Does nothing if no log is open.
+	// Exceptions:	Throws a CErrorException if any write failed (S6002).
+	//
+	void Close();
+
+public:	// CManoIo
+
+	virtual bool GetFgi( unsigned long long cycle );
+	virtual bool GetFgo( unsigned long long cycle );
+	virtual unsigned char Input( unsigned long long cycle );
+	virtual void Output( unsigned char character, unsigned long long cycle );
+	virtual void Flush();
+
+protected: // Utility functions
+
+	//
+	// Name:	Log
+	//
+	// Description:	Gathers one record, writing the gathered records
+	//		out once they fill a block.
+	// Arguments:	The kind byte, the clock cycle, and the character of
+	//		an EVENT_INPUT (ignored for other kinds)
+	// Modifies:	m_buffer, m_last_call, m_last_cycle
+	//
+	void Log( unsigned char kind, unsigned long long cycle,
+		unsigned char character );
+
+	//
+	// Name:	CheckStop
+	//
+	// Description:	Logs EVENT_STOP once the device asks for the run
+	//		to end, and passes the request on.
+	// Arguments:	The clock cycle
+	// Modifies:	m_stop_requested
+	//
+	void CheckStop( unsigned long long cycle );
+
+	//
+	// Name:	WriteBuffer
+	//
+	// Description:	Writes the gathered records, noting failures.
+	// Modifies:	m_buffer, m_failed
+	//
+	void WriteBuffer();
+
+protected: // Attributes
+
+	FILE		*m_file;	// The log, or 0
+
+	CManoIo		*m_device;	// The device recorded
+
+	bool		m_failed;	// A write has failed
+
+	std::vector<unsigned char> m_buffer; // Records not yet written
+
+	unsigned long long m_calls;	// Calls into the device so far
+
+	unsigned long long m_last_call;	// Call of the last event
+
+	unsigned long long m_last_cycle; // Cycle of the last event
+
+	int		m_fgi;		// FGI at the last sample, or -1
+
+	int		m_fgo;		// FGO at the last sample, or -1
+};
@@ -0,0 +1,253 @@
+// File:	EventReplayer.cpp
+// Description:
+//		A character device that answers from an event log.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "EventReplayer.hpp"
+#include "EventFormat.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CEventReplayer::CEventReplayer() {
+
+	m_p = m_end = 0;
+	m_output = 0;
+	m_calls = m_next_call = m_next_cycle = 0;
+	m_next_kind = m_next_character = 0;
+	m_fgi = false;
+	m_fgo = true;
+	m_character = 0;
+	m_characters_in = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CEventReplayer::~CEventReplayer() {
+} // (destructor)
+
+//
+// Name:	Open
+//
+void CEventReplayer::Open( const char *filename, CManoIo *output ) {
+
+	m_filename = filename;
+	if( !m_file.Open( filename ) ) {
+		throw CErrorException( filename, 0, "S6001",
+			"Could not open event log", CErrorException::FATAL );
+	}
+
+	const unsigned char *data = (const unsigned char *)m_file.GetData();
+	if( m_file.GetSize() < EVENT_HEADER_SIZE
+		|| memcmp( data, EVENT_MAGIC, strlen( EVENT_MAGIC ) ) != 0
+		|| data[strlen( EVENT_MAGIC )] != EVENT_VERSION )
+	{
+		m_file.Close();
+		throw CErrorException( filename, 0, "S6003",
+			"Not an event log", CErrorException::ERROR );
+	}
+
+	m_p = data + EVENT_HEADER_SIZE;
+	m_end = data + m_file.GetSize();
+	m_output = output;
+	m_calls = m_next_call = m_next_cycle = 0;
+	m_fgi = false;
+	m_fgo = true;
+	m_character = 0;
+	m_characters_in = 0;
+	m_stop_requested = false;
+	Next();
+
+} // Open
+
+//
+// Name:	GetFgi
+//
+bool CEventReplayer::GetFgi( unsigned long long cycle ) {
+
+	if( ++m_calls == m_next_call ) {
+		Apply( EVENT_FGI, cycle );
+	}
+	return m_fgi;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CEventReplayer::GetFgo( unsigned long long cycle ) {
+
+	if( ++m_calls == m_next_call ) {
+		Apply( EVENT_FGO, cycle );
+	}
+	return m_fgo;
+
+} // GetFgo
+
+//
+// Name:	Input
+//
+unsigned char CEventReplayer::Input( unsigned long long cycle ) {
+
+	// Every INP was logged:
+	if( ++m_calls != m_next_call || !Apply( EVENT_INPUT, cycle ) ) {
+		Diverged();
+	}
+	m_characters_in++;
+	return m_character;
+
+} // Input
+
+//
+// Name:	Output
+//
+void CEventReplayer::Output( unsigned char character,
+	unsigned long long cycle )
+{
+
+	if( m_output ) {
+		m_output->Output( character, cycle );
+	}
+	if( ++m_calls == m_next_call ) {
+		Apply( EVENT_STOP, cycle );
+	}
+
+} // Output
+
+//
+// Name:	Flush
+//
+void CEventReplayer::Flush() {
+
+	if( m_output ) {
+		m_output->Flush();
+	}
+
+} // Flush
+
+//
+// Name:	GetCharactersIn
+//
+unsigned long long CEventReplayer::GetCharactersIn() const {
+	return m_characters_in;
+} // GetCharactersIn
+
+//
+// Name:	Apply
+//
+bool CEventReplayer::Apply( unsigned char kind, unsigned long long cycle ) {
+	bool applied = false;
+
+	while( m_next_call == m_calls ) {
+		const unsigned char next = m_next_kind & EVENT_KIND_MASK;
+
+		if( m_next_cycle != cycle
+			|| (next != kind && next != EVENT_STOP) )
+		{
+			Diverged();
+		}
+
+		switch( next ) {
+		case EVENT_FGI:
+			m_fgi = (m_next_kind & EVENT_SET) != 0;
+			break;
+		case EVENT_FGO:
+			m_fgo = (m_next_kind & EVENT_SET) != 0;
+			break;
+		case EVENT_INPUT:
+			m_character = m_next_character;
+			break;
+		case EVENT_STOP:
+			m_stop_requested = true;
+			break;
+		}
+		applied = applied || next == kind;
+		Next();
+	}
+
+	return applied;
+
+} // Apply
+
+//
+// Name:	Next
+//
+void CEventReplayer::Next() {
+
+	if( m_p == m_end ) {
+		m_next_call = 0;
+		return;
+	}
+
+	m_next_kind = *m_p++;
+	if( (m_next_kind & ~(EVENT_KIND_MASK | EVENT_SET))
+		|| (m_next_kind & EVENT_KIND_MASK) > EVENT_STOP )
+	{
+		Damaged();
+	}
+	m_next_call += GetVarint();
+	m_next_cycle += GetVarint();
+	if( (m_next_kind & EVENT_KIND_MASK) == EVENT_INPUT ) {
+		if( m_p == m_end ) {
+			Damaged();
+		}
+		m_next_character = *m_p++;
+	}
+
+	// Events belong to calls from the one being made on:
+	if( m_next_call < m_calls || m_next_call == 0 ) {
+		Damaged();
+	}
+
+} // Next
+
+//
+// Name:	GetVarint
+//
+unsigned long long CEventReplayer::GetVarint() {
+
+	unsigned long long value = 0;
+	int shift = 0;
+
+	for( ;; ) {
+		if( m_p >= m_end || shift > 63 ) {
+			Damaged();
+		}
+		const unsigned char byte = *m_p++;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if( !(byte & 0x80) ) {
+			return value;
+		}
+		shift += 7;
+	}
+
+} // GetVarint
+
+//
+// Name:	Diverged
+//
+void CEventReplayer::Diverged() const {
+
+	throw CErrorException( m_filename.c_str(), 0, "S6005",
+		"Run diverged from the event log", CErrorException::ERROR );
+
+} // Diverged
+
+//
+// Name:	Damaged
+//
+void CEventReplayer::Damaged() const {
+
+	throw CErrorException( m_filename.c_str(), 0, "S6004",
+		"Event log is damaged", CErrorException::ERROR );
+
+} // Damaged
@@ -0,0 +1,155 @@
+// File:	EventReplayer.hpp
+// Description:
+//		A character device that answers from an event log written by
+//		CEventRecorder (see EventFormat.hpp), so a recorded run can be
+//		reproduced without its devices or testbench.
+// Usage:
+//		Call Open with the log and, optionally, a device to pass OUT
+//		characters on to, attach the object to a CManoSimulator with
+//		SetIo, and run the image that was recorded.
+//
+// Notes:
+//
+//		The log is mapped and read in place, one record ahead.  A
+//		call with no event due costs a counter and a comparison, so
+//		a replay runs at full speed.  Each event is checked against
+//		the call that consumes it: a different kind of call, or a
+//		different clock cycle, means the run has diverged from the
+//		recording (a different image, say), and the replay ends with
+//		an error rather than carrying on wrongly.
+//
+//		Once the log is used up, the flags keep their last values.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+#include "MappedFile.hpp"
+
+#include <string>
+
+class CEventReplayer : public CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CEventReplayer object with no log.
+	//
+	CEventReplayer();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CEventReplayer object.  The output device
+	//		is not destroyed.
+	//
+	virtual ~CEventReplayer();
+
+public:	// Event log
+
+	//
+	// Name:	Open
+	//
+	// Description:	Maps a log and starts replaying it from its first
+	//		event.
+	// Arguments:	The log, and the device to pass OUT characters on to
+	//		(or 0 to drop them)
+	// Exceptions:	Throws a CErrorException if the log could not be
+	//		opened (S6001), is not an event log (S6003), or its
+	//		first record is damaged (S6004).
+	//
+	void Open( const char *filename, CManoIo *output );
+
+public:	// CManoIo
+
+	//
+	// Exceptions:	Each throws a CErrorException if the run has
+	//		diverged from the log (S6005) or the next record is
+	//		damaged (S6004).
+	//
+	virtual bool GetFgi( unsigned long long cycle );
+	virtual bool GetFgo( unsigned long long cycle );
+	virtual unsigned char Input( unsigned long long cycle );
+	virtual void Output( unsigned char character, unsigned long long cycle );
+	virtual void Flush();
+
+public:	// Statistics
+
+	//
+	// Name:	GetCharactersIn
+	//
+	// Returns:	The number of characters replayed to INP.
+	//
+	unsigned long long GetCharactersIn() const;
+
+protected: // Utility functions
+
+	//
+	// Name:	Apply
+	//
+	// Description:	Consumes the events due at the current call.
+	// Arguments:	The kind of the call, and the clock cycle
+	// Returns:	true if an event of that kind was due.
+	// Modifies:	m_fgi, m_fgo, m_character, m_stop_requested, and the
+	//		next record
+	//
+	bool Apply( unsigned char kind, unsigned long long cycle );
+
+	//
+	// Name:	Next
+	//
+	// Description:	Decodes the next record, if there is one.
+	// Modifies:	m_p, m_next_*
+	//
+	void Next();
+
+	//
+	// Name:	GetVarint
+	//
+	// Returns:	The next varint of the log.
+	//
+	unsigned long long GetVarint();
+
+	//
+	// Name:	Diverged / Damaged
+	//
+	// Description:	Throw the S6005 and S6004 errors.
+	//
+	void Diverged() const;
+	void Damaged() const;
+
+protected: // Attributes
+
+	CMappedFile	m_file;		// The mapped log
+
+	std::string	m_filename;	// Its name, for errors
+
+	const unsigned char *m_p;	// The record after the next one
+
+	const unsigned char *m_end;	// End of the log
+
+	CManoIo		*m_output;	// Where OUT characters go, or 0
+
+	unsigned long long m_calls;	// Calls into the device so far
+
+	unsigned long long m_next_call;	// Call of the next event, or 0
+
+	unsigned long long m_next_cycle; // Cycle of the next event
+
+	unsigned char	m_next_kind;	// Kind byte of the next event
+
+	unsigned char	m_next_character; // Its character, for EVENT_INPUT
+
+	bool		m_fgi;		// FGI as last logged
+
+	bool		m_fgo;		// FGO as last logged
+
+	unsigned char	m_character;	// The character of the last INP
+
+	unsigned long long m_characters_in; // Characters replayed
+};
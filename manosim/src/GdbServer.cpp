@@ -0,0 +1,974 @@
+// File:	GdbServer.cpp
+// Description:
+//		A GDB remote serial protocol stub for CManoSimulator.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "GdbServer.hpp"
+#include "ErrorException.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <afunix.h>
+#include <io.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment( lib, "ws2_32.lib" )
+#endif
+#define INVALID_GDB_SOCKET	INVALID_SOCKET
+#define unlink			_unlink
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define INVALID_GDB_SOCKET	(-1)
+#endif
+
+// gdb going away must not kill the simulator with SIGPIPE:
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS		MSG_NOSIGNAL
+#else
+#define SEND_FLAGS		0
+#endif
+
+// Bytes of memory gdb sees, two for each word:
+#define GDB_MEMORY_BYTES	(2 * MANO_MEMORY_SIZE)
+
+// Signals given in stop replies:
+#define GDB_SIGINT		2
+#define GDB_SIGTRAP		5
+
+using namespace std;
+
+// The registers, as gdb is told of them:
+static const char target_xml[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+	"<target version=\"1.0\">\n"
+	"  <feature name=\"org.mano.core\">\n"
+	"    <reg name=\"ac\" bitsize=\"16\" type=\"uint16\" regnum=\"0\"/>\n"
+	"    <reg name=\"e\" bitsize=\"16\" type=\"uint16\"/>\n"
+	"    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>\n"
+	"    <reg name=\"ien\" bitsize=\"16\" type=\"uint16\"/>\n"
+	"  </feature>\n"
+	"</target>\n";
+
+#define GDB_REGISTERS	4
+
+static const char hex_digits[] = "0123456789abcdef";
+
+//
+// Name:	AppendHex
+//
+// Description:	Appends a value as little-endian hex bytes, as gdb
+//		sends registers and memory.
+//
+static void AppendHex( string &out, unsigned value, int bytes ) {
+
+	for( int b = 0; b < bytes; b++, value >>= 8 ) {
+		out += hex_digits[(value >> 4) & 0xF];
+		out += hex_digits[value & 0xF];
+	}
+
+} // AppendHex
+
+//
+// Name:	HexValue
+//
+// Returns:	The value of a hex digit, or -1.
+//
+static int HexValue( char c ) {
+
+	if( c >= '0' && c <= '9' ) {
+		return c - '0';
+	}
+	if( c >= 'a' && c <= 'f' ) {
+		return c - 'a' + 10;
+	}
+	if( c >= 'A' && c <= 'F' ) {
+		return c - 'A' + 10;
+	}
+	return -1;
+
+} // HexValue
+
+//
+// Name:	ReadHexBytes
+//
+// Description:	Reads little-endian hex bytes.
+// Returns:	false if there are not that many.
+//
+static bool ReadHexBytes( const string &text, size_t &at, int bytes,
+	unsigned *value )
+{
+
+	*value = 0;
+	for( int b = 0; b < bytes; b++ ) {
+		if( at + 2 > text.size() ) {
+			return false;
+		}
+		const int high = HexValue( text[at] );
+		const int low = HexValue( text[at + 1] );
+		if( high < 0 || low < 0 ) {
+			return false;
+		}
+		*value |= (unsigned)(high << 4 | low) << (8 * b);
+		at += 2;
+	}
+	return true;
+
+} // ReadHexBytes
+
+//
+// Name:	ReadNumber
+//
+// Description:	Reads a hex number, as the addresses and lengths of
+//		packets are given.
+// Returns:	false if there are no digits.
+//
+static bool ReadNumber( const string &text, size_t &at,
+	unsigned long *value )
+{
+	const size_t start = at;
+
+	*value = 0;
+	while( at < text.size() && HexValue( text[at] ) >= 0 ) {
+		*value = (*value << 4) | (unsigned long)HexValue( text[at] );
+		at++;
+	}
+	return at > start;
+
+} // ReadNumber
+
+//
+// Name:	WriteRegisters
+//
+// Description:	Sets every register from a G packet.
+// Returns:	false if the packet is short or not hex.
+//
+static bool WriteRegisters( CManoSimulator &simulator, const string &packet,
+	size_t at )
+{
+	unsigned values[GDB_REGISTERS];
+
+	for( int r = 0; r < GDB_REGISTERS; r++ ) {
+		if( !ReadHexBytes( packet, at, 2, &values[r] ) ) {
+			return false;
+		}
+	}
+	simulator.SetRegisters( (unsigned short)values[0], values[1] != 0,
+		values[3] != 0, (unsigned short)(values[2] / 2) );
+	return true;
+
+} // WriteRegisters
+
+//
+// Name:	WriteRegister
+//
+// Description:	Sets one register from a P packet.
+// Returns:	false if the packet names no register or is not hex.
+//
+static bool WriteRegister( CManoSimulator &simulator, const string &packet,
+	size_t at )
+{
+	unsigned long number;
+	unsigned value;
+
+	if( !ReadNumber( packet, at, &number ) || number >= GDB_REGISTERS
+		|| at >= packet.size() || packet[at++] != '='
+		|| !ReadHexBytes( packet, at, 2, &value ) )
+	{
+		return false;
+	}
+
+	unsigned short ac = simulator.GetAC();
+	bool e = simulator.GetE(), ien = simulator.GetIEN();
+	unsigned short pc = simulator.GetPC();
+	switch( number ) {
+	case 0:
+		ac = (unsigned short)value;
+		break;
+	case 1:
+		e = value != 0;
+		break;
+	case 2:
+		pc = (unsigned short)(value / 2);
+		break;
+	default:
+		ien = value != 0;
+		break;
+	}
+	simulator.SetRegisters( ac, e, ien, pc );
+	return true;
+
+} // WriteRegister
+
+//
+// Name:	SetPoint
+//
+// Description:	Sets or clears a breakpoint (types 0 and 1) or a write,
+//		read or access watchpoint (types 2, 3 and 4) from a Z or
+//		z packet.
+// Returns:	The reply: "" for a type that is not supported.
+//
+static const char *SetPoint( CManoSimulator &simulator,
+	const string &packet )
+{
+	unsigned long address, length;
+	size_t at = 3;
+
+	if( packet.size() < 3 || packet[1] < '0' || packet[1] > '4'
+		|| packet[2] != ',' )
+	{
+		return "";
+	}
+	if( !ReadNumber( packet, at, &address ) || at >= packet.size()
+		|| packet[at++] != ',' || !ReadNumber( packet, at, &length )
+		|| address >= GDB_MEMORY_BYTES )
+	{
+		return "E01";
+	}
+
+	const bool set = packet[0] == 'Z';
+	const unsigned short first = (unsigned short)(address / 2);
+	if( packet[1] <= '1' ) {
+		if( set ) {
+			simulator.SetBreakpoint( first );
+		}
+		else {
+			simulator.ClearBreakpoint( first );
+		}
+		return "OK";
+	}
+
+	// Watch every word that holds a byte of the range:
+	if( length == 0 || length > GDB_MEMORY_BYTES - address ) {
+		return "E01";
+	}
+	const unsigned short last = (unsigned short)((address + length - 1) / 2);
+	const bool read = packet[1] != '2', write = packet[1] != '3';
+	if( set ) {
+		simulator.SetWatchpoint( first, last, read, write );
+	}
+	else {
+		simulator.ClearWatchpoint( first, last, read, write );
+	}
+	return "OK";
+
+} // SetPoint
+
+//
+// Name:	(constructor)
+//
+CGdbServer::CGdbServer() {
+
+	m_simulator = 0;
+	m_history = 0;
+	m_map = 0;
+	m_listener = INVALID_GDB_SOCKET;
+	m_connection = INVALID_GDB_SOCKET;
+	m_ack = true;
+	m_signal = GDB_SIGTRAP;
+	m_start = m_end = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CGdbServer::~CGdbServer() {
+
+	Close();
+
+} // (destructor)
+
+//
+// Name:	Run
+//
+void CGdbServer::Run( const char *endpoint, CHistory &history,
+	const CSourceMap &map, ostream &status_stream )
+{
+
+	m_simulator = history.GetSimulator();
+	m_history = &history;
+	m_map = &map;
+	m_ack = true;
+	m_signal = GDB_SIGTRAP;
+	m_start = m_end = 0;
+
+	Listen( endpoint );
+	status_stream << "Waiting for gdb on " << endpoint << endl;
+
+	m_connection = accept( m_listener, 0, 0 );
+	if( m_connection == INVALID_GDB_SOCKET ) {
+		Close();
+		throw CErrorException( endpoint, 0, "S5001",
+			"Could not set up the debug socket",
+			CErrorException::FATAL );
+	}
+
+	// Packets are small and answered one at a time:
+	int on = 1;
+	setsockopt( m_connection, IPPROTO_TCP, TCP_NODELAY,
+		(const char *)&on, sizeof( on ) );
+	status_stream << "gdb connected" << endl;
+
+	string packet;
+	while( ReadPacket( packet ) && Handle( packet ) ) {
+	}
+
+	Close();
+	status_stream << "gdb disconnected" << endl;
+
+} // Run
+
+//
+// Name:	Listen
+//
+void CGdbServer::Listen( const char *endpoint ) {
+
+#ifdef _WIN32
+	WSADATA wsa_data;
+	if( WSAStartup( MAKEWORD( 2, 2 ), &wsa_data ) != 0 ) {
+		throw CErrorException( endpoint, 0, "S5001",
+			"Could not set up the debug socket",
+			CErrorException::FATAL );
+	}
+#endif
+
+	const char *port = endpoint[0] == ':' ? endpoint + 1 : endpoint;
+	bool bound;
+
+	if( *port && strspn( port, "0123456789" ) == strlen( port ) ) {
+		sockaddr_in address;
+		memset( &address, 0, sizeof( address ) );
+		address.sin_family = AF_INET;
+		address.sin_port = htons( (unsigned short)atoi( port ) );
+		address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+		int on = 1;
+		m_listener = socket( AF_INET, SOCK_STREAM, 0 );
+		bound = m_listener != INVALID_GDB_SOCKET
+			&& setsockopt( m_listener, SOL_SOCKET, SO_REUSEADDR,
+				(const char *)&on, sizeof( on ) ) == 0
+			&& bind( m_listener, (sockaddr *)&address,
+				sizeof( address ) ) == 0;
+	}
+	else {
+		sockaddr_un address;
+		memset( &address, 0, sizeof( address ) );
+		address.sun_family = AF_UNIX;
+		if( strlen( endpoint ) >= sizeof( address.sun_path ) ) {
+			throw CErrorException( endpoint, 0, "S5001",
+				"Could not set up the debug socket",
+				CErrorException::FATAL );
+		}
+		strcpy( address.sun_path, endpoint );
+
+		// Replace the socket of a stub that did not clean up:
+		unlink( endpoint );
+
+		m_listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+		bound = m_listener != INVALID_GDB_SOCKET
+			&& bind( m_listener, (sockaddr *)&address,
+				sizeof( address ) ) == 0;
+		if( bound ) {
+			m_path = endpoint;
+		}
+	}
+
+	if( !bound || listen( m_listener, 1 ) != 0 ) {
+		Close();
+		throw CErrorException( endpoint, 0, "S5001",
+			"Could not set up the debug socket",
+			CErrorException::FATAL );
+	}
+
+} // Listen
+
+//
+// Name:	Handle
+//
+bool CGdbServer::Handle( const string &packet ) {
+	string reply;
+	unsigned long address, length;
+	size_t at = 1;
+
+	if( packet.empty() ) {
+		return SendPacket( "" );
+	}
+
+	switch( packet[0] ) {
+
+	// An interrupt while stopped, and the reason for the last stop:
+	case '\x03':
+		reply = "S";
+		AppendHex( reply, GDB_SIGINT, 1 );
+		break;
+	case '?':
+		reply = "S";
+		AppendHex( reply, m_signal, 1 );
+		break;
+
+	// Registers:
+	case 'g':
+		AppendHex( reply, m_simulator->GetAC(), 2 );
+		AppendHex( reply, m_simulator->GetE(), 2 );
+		AppendHex( reply, 2 * m_simulator->GetPC(), 2 );
+		AppendHex( reply, m_simulator->GetIEN(), 2 );
+		break;
+	case 'G':
+		reply = WriteRegisters( *m_simulator, packet, at ) ? "OK" : "E01";
+		m_history->Invalidate();
+		break;
+	case 'p':
+		if( !ReadNumber( packet, at, &address )
+			|| address >= GDB_REGISTERS )
+		{
+			reply = "E01";
+			break;
+		}
+		AppendHex( reply, address == 0 ? m_simulator->GetAC()
+			: address == 1 ? (unsigned)m_simulator->GetE()
+			: address == 2 ? 2u * m_simulator->GetPC()
+			: (unsigned)m_simulator->GetIEN(), 2 );
+		break;
+	case 'P':
+		reply = WriteRegister( *m_simulator, packet, at ) ? "OK" : "E01";
+		m_history->Invalidate();
+		break;
+
+	// Memory, two bytes to a word:
+	case 'm':
+		if( !ReadNumber( packet, at, &address ) || at >= packet.size()
+			|| packet[at++] != ','
+			|| !ReadNumber( packet, at, &length )
+			|| address >= GDB_MEMORY_BYTES )
+		{
+			reply = "E01";
+			break;
+		}
+		for( ; length > 0 && address < GDB_MEMORY_BYTES;
+			length--, address++ )
+		{
+			const unsigned short word = m_simulator->ReadMemory(
+				(unsigned short)(address / 2) );
+			AppendHex( reply, address & 1 ? word >> 8 : word & 0xFF, 1 );
+		}
+		break;
+	case 'M':
+		if( !ReadNumber( packet, at, &address ) || at >= packet.size()
+			|| packet[at++] != ','
+			|| !ReadNumber( packet, at, &length )
+			|| at >= packet.size() || packet[at++] != ':'
+			|| length > GDB_MEMORY_BYTES - address
+			|| address > GDB_MEMORY_BYTES )
+		{
+			reply = "E01";
+			break;
+		}
+		reply = "OK";
+		for( ; length > 0; length--, address++ ) {
+			const unsigned short word_address =
+				(unsigned short)(address / 2);
+			unsigned short word =
+				m_simulator->ReadMemory( word_address );
+			unsigned byte;
+
+			if( !ReadHexBytes( packet, at, 1, &byte ) ) {
+				reply = "E01";
+				break;
+			}
+			word = address & 1
+				? (unsigned short)((word & 0x00FF) | byte << 8)
+				: (unsigned short)((word & 0xFF00) | byte);
+			m_simulator->WriteMemory( word_address, word );
+		}
+		m_history->Invalidate();
+		break;
+
+	// Running.  An address to resume at may follow:
+	case 'c':
+	case 's':
+		if( ReadNumber( packet, at, &address ) ) {
+			m_simulator->SetRegisters( m_simulator->GetAC(),
+				m_simulator->GetE(), m_simulator->GetIEN(),
+				(unsigned short)(address / 2) );
+			m_history->Invalidate();
+		}
+		return Resume( packet[0] == 's' );
+
+	// Running backwards:
+	case 'b':
+		if( packet == "bs" || packet == "bc" ) {
+			return Reverse( packet == "bs" );
+		}
+		break;
+
+	// Breakpoints and watchpoints:
+	case 'Z':
+	case 'z':
+		reply = SetPoint( *m_simulator, packet );
+		break;
+
+	// The session:
+	case 'D':
+		SendPacket( "OK" );
+		return false;
+	case 'k':
+		return false;
+	case 'H':
+	case 'T':
+		reply = "OK";
+		break;
+
+	// Queries:
+	case 'q':
+	case 'Q':
+		if( packet.compare( 0, 10, "qSupported" ) == 0 ) {
+			reply = "PacketSize=1000;qXfer:features:read+;"
+				"QStartNoAckMode+;ReverseStep+;ReverseContinue+";
+		}
+		else if( packet == "QStartNoAckMode" ) {
+			const bool sent = SendPacket( "OK" );
+			m_ack = false;
+			return sent;
+		}
+		else if( packet == "qAttached" ) {
+			reply = "1";
+		}
+		else if( packet == "qC" ) {
+			reply = "QC1";
+		}
+		else if( packet == "qfThreadInfo" ) {
+			reply = "m1";
+		}
+		else if( packet == "qsThreadInfo" ) {
+			reply = "l";
+		}
+		else if( packet == "qSymbol::" ) {
+			reply = "OK";
+		}
+		else if( packet.compare( 0, 31, "qXfer:features:read:target.xml:" )
+			== 0 )
+		{
+			at = 31;
+			const size_t size = sizeof( target_xml ) - 1;
+			if( !ReadNumber( packet, at, &address )
+				|| at >= packet.size() || packet[at++] != ','
+				|| !ReadNumber( packet, at, &length ) )
+			{
+				reply = "E01";
+				break;
+			}
+			if( address >= size ) {
+				reply = "l";
+				break;
+			}
+			if( length > size - address ) {
+				length = size - address;
+			}
+			reply = (address + length < size ? "m" : "l")
+				+ string( target_xml + address, length );
+		}
+		else if( packet.compare( 0, 6, "qRcmd," ) == 0 ) {
+			string command, output;
+			unsigned byte;
+			at = 6;
+			while( ReadHexBytes( packet, at, 1, &byte ) ) {
+				command += (char)byte;
+			}
+			Monitor( command, output );
+
+			string console = "O";
+			for( size_t i = 0; i < output.size(); i++ ) {
+				AppendHex( console, (unsigned char)output[i], 1 );
+			}
+			if( !SendPacket( console ) ) {
+				return false;
+			}
+			reply = "OK";
+		}
+		break;
+	}
+
+	return SendPacket( reply );
+
+} // Handle
+
+//
+// Name:	Resume
+//
+bool CGdbServer::Resume( bool step ) {
+
+	m_signal = GDB_SIGTRAP;
+
+	if( step ) {
+		m_history->StepOver();
+	}
+	else if( !m_simulator->AtBreakpoint() || m_history->StepOver() ) {
+
+		// Run until a breakpoint, a halt or a stop from the device
+		// cuts a run short, looking for an interrupt between runs:
+		while( m_history->Run( GDB_POLL_INSTRUCTIONS )
+			== GDB_POLL_INSTRUCTIONS && !m_simulator->IsStopped() )
+		{
+			if( Pending() ) {
+				const int byte = ReadByte();
+				if( byte < 0 ) {
+					return false;
+				}
+				if( byte == 0x03 ) {
+					m_signal = GDB_SIGINT;
+					break;
+				}
+			}
+		}
+	}
+
+	return SendStop();
+
+} // Resume
+
+//
+// Name:	Reverse
+//
+bool CGdbServer::Reverse( bool step ) {
+
+	m_signal = GDB_SIGTRAP;
+
+	const bool moved = step ? m_history->ReverseStep()
+		: m_history->ReverseContinue();
+	if( !moved ) {
+		string reply = "T";
+		AppendHex( reply, m_signal, 1 );
+		return SendPacket( reply + "replaylog:begin;" );
+	}
+
+	return SendStop();
+
+} // Reverse
+
+//
+// Name:	SendStop
+//
+bool CGdbServer::SendStop() {
+	CManoSimulator::SWatchHit hit;
+	string reply = "T";
+
+	AppendHex( reply, m_signal, 1 );
+	if( m_signal == GDB_SIGTRAP && m_simulator->TakeWatchHit( &hit ) ) {
+		ostringstream out;
+		const char *label = m_map->GetLabel( hit.address );
+
+		// Describe the hit on gdb's console:
+		out << hex << "Watchpoint at " << hit.address;
+		if( label ) {
+			out << " (" << label << "+"
+				<< hit.address - m_map->GetLabelAddress( hit.address )
+				<< ")";
+		}
+		out << ": PC=" << hit.pc;
+		if( hit.write ) {
+			out << " wrote " << hit.old_value << " -> "
+				<< hit.new_value << "\n";
+		}
+		else {
+			out << " read " << hit.old_value << "\n";
+		}
+		string console = "O";
+		const string text = out.str();
+		for( size_t i = 0; i < text.size(); i++ ) {
+			AppendHex( console, (unsigned char)text[i], 1 );
+		}
+		if( !SendPacket( console ) ) {
+			return false;
+		}
+
+		// Name the kind of watchpoint gdb set, and the byte hit:
+		const bool read = m_simulator->IsWatched( hit.address, false );
+		const bool write = m_simulator->IsWatched( hit.address, true );
+		reply += read && write ? "awatch:" : read ? "rwatch:" : "watch:";
+		for( int shift = 12; shift >= 0; shift -= 4 ) {
+			reply += hex_digits[(2 * hit.address >> shift) & 0xF];
+		}
+		reply += ';';
+	}
+	return SendPacket( reply );
+
+} // SendStop
+
+//
+// Name:	Monitor
+//
+void CGdbServer::Monitor( const string &command, string &output ) {
+	istringstream in( command );
+	ostringstream out;
+	string verb, argument;
+
+	in >> verb >> argument;
+	out << hex;
+
+	if( verb == "labels" ) {
+		for( size_t i = 0; i < m_map->GetLabelCount(); i++ ) {
+			int address;
+			const char *name = m_map->GetLabelName( i, &address );
+			out << name << "\t" << address << "\n";
+		}
+		if( !m_map->GetLabelCount() ) {
+			out << "No labels (assemble with -a, or load a program "
+				"file)\n";
+		}
+	}
+	else if( verb == "where" ) {
+		const unsigned short pc = m_simulator->GetPC();
+		const char *label = m_map->GetLabel( pc );
+
+		out << (m_simulator->IsHalted() ? "Halted" : "Stopped")
+			<< " at " << pc;
+		if( label ) {
+			out << " (" << label << "+"
+				<< pc - m_map->GetLabelAddress( pc ) << ")";
+		}
+		if( m_map->GetLine( pc ) ) {
+			out << dec << ", line " << m_map->GetLine( pc ) << ": "
+				<< m_map->GetText( pc );
+		}
+		out << "\n";
+	}
+	else if( verb == "break" || verb == "delete" ) {
+		const int address = m_map->ParseAddress( argument.c_str() );
+		if( address < 0 ) {
+			out << "No label or address " << argument << "\n";
+		}
+		else if( verb == "break" ) {
+			m_simulator->SetBreakpoint( (unsigned short)address );
+			out << "Breakpoint at " << address << "\n";
+		}
+		else {
+			m_simulator->ClearBreakpoint( (unsigned short)address );
+			out << "Deleted breakpoint at " << address << "\n";
+		}
+	}
+	else if( verb == "watch" || verb == "rwatch" || verb == "awatch"
+		|| verb == "unwatch" )
+	{
+		int first, last;
+		if( !m_map->ParseRange( argument.c_str(), &first, &last ) ) {
+			out << "No label, address or range " << argument << "\n";
+		}
+		else if( verb == "unwatch" ) {
+			m_simulator->ClearWatchpoint( (unsigned short)first,
+				(unsigned short)last, true, true );
+			out << "Deleted watchpoints at " << first << ":" << last
+				<< "\n";
+		}
+		else {
+			m_simulator->SetWatchpoint( (unsigned short)first,
+				(unsigned short)last, verb != "watch",
+				verb != "rwatch" );
+			out << "Watchpoint at " << first << ":" << last << "\n";
+		}
+	}
+	else if( verb == "history" ) {
+		out << dec << m_history->GetCheckpointCount()
+			<< " checkpoints, " << m_history->GetInterval()
+			<< " instructions apart, "
+			<< m_history->GetBytes() / 1024 << " of "
+			<< m_history->GetBudget() / 1024 << " KB\n"
+			<< "Instructions " << m_history->GetFirst() << " to "
+			<< m_history->GetLast() << " reachable, at "
+			<< m_simulator->GetInstructions() << "\n"
+			<< "Last reverse: " << m_history->GetReplayed()
+			<< " instructions run again in "
+			<< (unsigned long long)(m_history->GetSeconds() * 1e6)
+			<< " us\n";
+	}
+	else {
+		out << "Commands: labels, where, break <label|address>, "
+			"delete <label|address>,\n"
+			"          watch|rwatch|awatch|unwatch "
+			"<label|address>[:<label|address>], history\n";
+	}
+
+	output = out.str();
+
+} // Monitor
+
+//
+// Name:	ReadPacket
+//
+bool CGdbServer::ReadPacket( string &packet ) {
+	int c;
+
+	for( ;; ) {
+		// Skip acknowledgements and anything else between packets:
+		do {
+			c = ReadByte();
+			if( c < 0 ) {
+				return false;
+			}
+			if( c == 0x03 ) {
+				packet = "\x03";
+				return true;
+			}
+		} while( c != '$' );
+
+		unsigned sum = 0;
+		packet.clear();
+		while( (c = ReadByte()) >= 0 && c != '#' ) {
+			sum += (unsigned)c;
+			if( c == '}' ) {
+				c = ReadByte();
+				if( c < 0 ) {
+					return false;
+				}
+				sum += (unsigned)c;
+				c ^= 0x20;
+			}
+			packet += (char)c;
+		}
+		const int high = ReadByte();
+		const int low = ReadByte();
+		if( c < 0 || high < 0 || low < 0 ) {
+			return false;
+		}
+
+		if( !m_ack ) {
+			return true;
+		}
+		const bool good = HexValue( (char)high ) >= 0
+			&& HexValue( (char)low ) >= 0
+			&& (unsigned)(HexValue( (char)high ) << 4
+				| HexValue( (char)low )) == (sum & 0xFF);
+		if( send( m_connection, good ? "+" : "-", 1, SEND_FLAGS )
+			!= 1 )
+		{
+			return false;
+		}
+		if( good ) {
+			return true;
+		}
+	}
+
+} // ReadPacket
+
+//
+// Name:	SendPacket
+//
+bool CGdbServer::SendPacket( const string &data ) {
+	string frame = "$";
+	unsigned sum = 0;
+
+	for( size_t i = 0; i < data.size(); i++ ) {
+		const char c = data[i];
+		if( c == '$' || c == '#' || c == '}' || c == '*' ) {
+			frame += '}';
+			frame += (char)(c ^ 0x20);
+			sum += '}' + (unsigned char)(c ^ 0x20);
+		}
+		else {
+			frame += c;
+			sum += (unsigned char)c;
+		}
+	}
+	frame += '#';
+	AppendHex( frame, sum & 0xFF, 1 );
+
+	for( ;; ) {
+		size_t sent = 0;
+		while( sent < frame.size() ) {
+			const int count = (int)send( m_connection,
+				frame.data() + sent, (int)(frame.size() - sent),
+				SEND_FLAGS );
+			if( count <= 0 ) {
+				return false;
+			}
+			sent += (size_t)count;
+		}
+		if( !m_ack ) {
+			return true;
+		}
+
+		// Wait for the acknowledgement, and send again if refused:
+		int c;
+		do {
+			c = ReadByte();
+			if( c < 0 ) {
+				return false;
+			}
+		} while( c != '+' && c != '-' );
+		if( c == '+' ) {
+			return true;
+		}
+	}
+
+} // SendPacket
+
+//
+// Name:	ReadByte
+//
+int CGdbServer::ReadByte() {
+
+	if( m_start == m_end ) {
+		const int received = (int)recv( m_connection, m_buffer,
+			(int)sizeof( m_buffer ), 0 );
+		if( received <= 0 ) {
+			return -1;
+		}
+		m_start = 0;
+		m_end = (size_t)received;
+	}
+	return (unsigned char)m_buffer[m_start++];
+
+} // ReadByte
+
+//
+// Name:	Pending
+//
+bool CGdbServer::Pending() {
+
+	if( m_start < m_end ) {
+		return true;
+	}
+
+	fd_set readable;
+	timeval timeout = { 0, 0 };
+	FD_ZERO( &readable );
+	FD_SET( m_connection, &readable );
+	return select( (int)m_connection + 1, &readable, 0, 0,
+		&timeout ) > 0;
+
+} // Pending
+
+//
+// Name:	Close
+//
+void CGdbServer::Close() {
+
+	const gdb_socket sockets[] = { m_connection, m_listener };
+	for( int s = 0; s < 2; s++ ) {
+		if( sockets[s] != INVALID_GDB_SOCKET ) {
+#ifdef _WIN32
+			closesocket( sockets[s] );
+#else
+			close( sockets[s] );
+#endif
+		}
+	}
+	m_connection = m_listener = INVALID_GDB_SOCKET;
+
+	if( !m_path.empty() ) {
+		unlink( m_path.c_str() );
+		m_path.clear();
+	}
+
+} // Close
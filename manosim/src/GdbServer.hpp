@@ -0,0 +1,248 @@
+// File:	GdbServer.hpp
+// Description:
+//		A GDB remote serial protocol stub for CManoSimulator, so a
+//		program can be debugged with breakpoints and single steps
+//		from gdb ("target remote").
+// Usage:
+//		1. create one instance of this class
+//		2. call Run with the socket, the history of a loaded
+//		   simulator (see History.hpp) and its source map; it
+//		   returns once gdb detaches, kills the program or goes
+//		   away.
+//
+// Notes:
+//
+//		The socket is a TCP port on 127.0.0.1 when it is given as a
+//		number (or :number), and a Unix domain socket path
+//		otherwise.  One connection is served.
+//
+//		gdb addresses bytes, so word n of memory is bytes 2n (its
+//		low half) and 2n+1, and the 4096 words are bytes 0000-1FFF.
+//		The registers, 16 bits each, are ac, e, pc and ien, as the
+//		target description names them; pc holds a byte address too.
+//
+//		Breakpoints (Z0 and Z1) are set in the simulator's
+//		predecoded memory (see CManoSimulator), so continuing runs
+//		at full speed until one is hit.  While running, the socket
+//		is checked for an interrupt from gdb every
+//		GDB_POLL_INSTRUCTIONS instructions.  The program stops with
+//		SIGTRAP at a breakpoint, after a step, and when it halts or
+//		its input ends.
+//
+//		Watchpoints (Z2, Z3 and Z4, for writes, reads and both)
+//		watch every word that holds a byte of their range; see
+//		CManoSimulator.  The stop reply names the byte address of
+//		the word hit, and gdb's console is told the PC that read
+//		or stored it and the word before and after.
+//
+//		Reverse execution (bs and bc, gdb's reverse-stepi and
+//		reverse-continue) goes through the CHistory: reverse-continue
+//		stops at the last breakpoint or watchpoint hit before the
+//		present, and both answer "replaylog:begin" at the start of
+//		the history.  Changing registers or memory starts the
+//		history again.
+//
+//		The labels of the source map are used by the monitor
+//		commands (gdb's "monitor"):
+//
+//		  labels		list every label and its address
+//		  where			show the label, line and source of PC
+//		  break <label|addr>	set a breakpoint
+//		  delete <label|addr>	clear a breakpoint
+//		  watch <range>		watch a range for writes
+//		  rwatch <range>	watch a range for reads
+//		  awatch <range>	watch a range for both
+//		  unwatch <range>	stop watching a range
+//		  history		show the checkpoints, and the cost of
+//					the last reverse step or continue
+//
+//		Addresses given to monitor commands are word addresses, in
+//		hex; a range is an address, or first:last.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "History.hpp"
+#include "ManoSimulator.hpp"
+#include "SourceMap.hpp"
+
+#include <ostream>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET gdb_socket;
+#else
+typedef int gdb_socket;
+#endif
+
+// Instructions run between checks for an interrupt from gdb:
+#define GDB_POLL_INSTRUCTIONS	65536
+
+class CGdbServer {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CGdbServer object that is not
+	//		listening.
+	//
+	CGdbServer();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CGdbServer object.
+	//
+	~CGdbServer();
+
+public:	// Serving
+
+	//
+	// Name:	Run
+	//
+	// Description:	Waits for gdb on a socket, and serves it until it
+	//		detaches, kills the program or closes the connection.
+	// Arguments:	The socket (a port or a path), the history attached
+	//		to the simulator, its source map (which may know no
+	//		labels), and the stream to report progress to
+	// Exceptions:	Throws a CErrorException (S5001) if the socket could
+	//		not be set up.
+	//
+	void Run( const char *endpoint, CHistory &history,
+		const CSourceMap &map, std::ostream &status_stream );
+
+protected: // Utility functions
+
+	//
+	// Name:	Listen
+	//
+	// Description:	Sets up the listening socket.
+	// Arguments:	The socket (a port or a path)
+	// Exceptions:	As Run.
+	// Modifies:	m_listener, m_path
+	//
+	void Listen( const char *endpoint );
+
+	//
+	// Name:	Handle
+	//
+	// Description:	Answers one packet.
+	// Arguments:	The packet's data
+	// Returns:	false once the session is over.
+	//
+	bool Handle( const std::string &packet );
+
+	//
+	// Name:	Resume
+	//
+	// Description:	Continues or steps the program, and answers with
+	//		the stop reply once it stops.
+	// Arguments:	true to step a single instruction
+	// Returns:	false if the connection was lost.
+	// Modifies:	m_signal
+	//
+	bool Resume( bool step );
+
+	//
+	// Name:	Reverse
+	//
+	// Description:	Steps or continues backwards, and answers with the
+	//		stop reply.
+	// Arguments:	true to step a single instruction
+	// Returns:	false if the connection was lost.
+	// Modifies:	m_signal
+	//
+	bool Reverse( bool step );
+
+	//
+	// Name:	Monitor
+	//
+	// Description:	Runs a monitor command.
+	// Arguments:	The command, and the text to send back
+	//
+	void Monitor( const std::string &command, std::string &output );
+
+	//
+	// Name:	SendStop
+	//
+	// Description:	Sends the stop reply, naming the watchpoint hit if
+	//		there was one, after describing the hit on gdb's
+	//		console.
+	// Returns:	false if the connection was lost.
+	//
+	bool SendStop();
+
+	//
+	// Name:	ReadPacket
+	//
+	// Description:	Reads the next packet, acknowledging it unless
+	//		acknowledgements were turned off.  An interrupt byte
+	//		read on its own is returned as the packet "\x03".
+	// Arguments:	The string to receive the packet's data
+	// Returns:	false if the connection was lost.
+	//
+	bool ReadPacket( std::string &packet );
+
+	//
+	// Name:	SendPacket
+	//
+	// Description:	Sends a packet, and waits for its acknowledgement
+	//		unless acknowledgements were turned off.
+	// Arguments:	The packet's data
+	// Returns:	false if the connection was lost.
+	//
+	bool SendPacket( const std::string &data );
+
+	//
+	// Name:	ReadByte
+	//
+	// Returns:	The next byte received, or -1 if the connection was
+	//		lost.
+	//
+	int ReadByte();
+
+	//
+	// Name:	Pending
+	//
+	// Returns:	true if a byte can be read without waiting.
+	//
+	bool Pending();
+
+	//
+	// Name:	Close
+	//
+	// Description:	Closes the sockets, and removes a Unix socket path.
+	// Modifies:	m_listener, m_connection, m_path
+	//
+	void Close();
+
+protected: // Attributes
+
+	CManoSimulator	*m_simulator;	// The simulator being debugged
+
+	CHistory	*m_history;	// Its history
+
+	const CSourceMap *m_map;	// Its labels and lines
+
+	gdb_socket	m_listener;	// The listening socket
+
+	gdb_socket	m_connection;	// gdb's connection
+
+	std::string	m_path;		// A Unix socket path to remove, or ""
+
+	bool		m_ack;		// Packets are acknowledged
+
+	int		m_signal;	// The signal of the last stop
+
+	char		m_buffer[4096];	// Bytes received, not yet read
+
+	size_t		m_start;	// First unread byte
+
+	size_t		m_end;		// End of the received bytes
+};
@@ -0,0 +1,590 @@
+// File:	History.cpp
+// Description:
+//		Reverse execution for CManoSimulator, by checkpoints and
+//		re-execution.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "History.hpp"
+#include "EventFormat.hpp"
+
+#include <chrono>
+
+using namespace std;
+
+//
+// Name:	SecondsSince
+//
+// Description:	Returns the seconds elapsed since a point in time.
+//
+static double SecondsSince( chrono::steady_clock::time_point start ) {
+
+	return chrono::duration<double>( chrono::steady_clock::now()
+		- start ).count();
+
+} // SecondsSince
+
+//
+// Name:	(constructor)
+//
+CHistory::CHistory() {
+
+	m_simulator = 0;
+	m_device = 0;
+	m_interval = HISTORY_INTERVAL;
+	m_budget = HISTORY_BUDGET;
+	m_last = 0;
+	m_calls = m_live_calls = 0;
+	m_next = 0;
+	m_fgi = false;
+	m_fgo = true;
+	m_character = 0;
+	m_replayed = 0;
+	m_seconds = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CHistory::~CHistory() {
+} // (destructor)
+
+//
+// Name:	Attach
+//
+void CHistory::Attach( CManoSimulator *simulator, CManoIo *device,
+	unsigned long long interval, size_t budget )
+{
+
+	m_simulator = simulator;
+	m_device = device;
+	m_interval = interval ? interval : 1;
+	m_budget = budget;
+	m_calls = m_live_calls = 0;
+	m_next = 0;
+	m_fgi = false;
+	m_fgo = true;
+	m_character = 0;
+	m_stop_requested = false;
+	m_replayed = 0;
+	m_seconds = 0;
+
+	m_checkpoints.clear();
+	m_events.clear();
+	Checkpoint();
+	m_last = m_simulator->GetInstructions();
+
+} // Attach
+
+//
+// Name:	Invalidate
+//
+void CHistory::Invalidate() {
+
+	// Neither the run before the change nor the one after it leads
+	// to the present; the answers of the device still to come are
+	// kept:
+	m_events.erase( m_events.begin(), m_events.begin() + m_next );
+	m_next = 0;
+	m_checkpoints.clear();
+	Checkpoint();
+	m_last = m_simulator->GetInstructions();
+
+} // Invalidate
+
+//
+// Name:	Run
+//
+unsigned long long CHistory::Run( unsigned long long max_instructions ) {
+
+	const unsigned long long start = m_simulator->GetInstructions();
+	unsigned long long now = start;
+
+	while( now - start < max_instructions ) {
+		const unsigned long long due =
+			m_checkpoints.back().state.instructions + m_interval;
+		if( now >= due ) {
+			Checkpoint();
+			continue;
+		}
+
+		// Run up to the next checkpoint, or less:
+		unsigned long long chunk = due - now;
+		if( chunk > max_instructions - (now - start) ) {
+			chunk = max_instructions - (now - start);
+		}
+		const unsigned long long executed = m_simulator->Run( chunk );
+		now += executed;
+		if( executed < chunk || m_simulator->IsStopped() ) {
+			break;
+		}
+	}
+
+	if( now > m_last ) {
+		m_last = now;
+	}
+	return now - start;
+
+} // Run
+
+//
+// Name:	StepOver
+//
+bool CHistory::StepOver() {
+
+	if( m_simulator->GetInstructions()
+		>= m_checkpoints.back().state.instructions + m_interval )
+	{
+		Checkpoint();
+	}
+
+	const bool running = m_simulator->StepOver();
+	if( m_simulator->GetInstructions() > m_last ) {
+		m_last = m_simulator->GetInstructions();
+	}
+	return running;
+
+} // StepOver
+
+//
+// Name:	ReverseStep
+//
+bool CHistory::ReverseStep() {
+
+	const unsigned long long now = m_simulator->GetInstructions();
+	if( now <= GetFirst() ) {
+		return false;
+	}
+
+	return Seek( now - 1 );
+
+} // ReverseStep
+
+//
+// Name:	ReverseContinue
+//
+bool CHistory::ReverseContinue() {
+
+	const chrono::steady_clock::time_point start =
+		chrono::steady_clock::now();
+	unsigned long long end = m_simulator->GetInstructions();
+
+	m_replayed = 0;
+	if( end <= GetFirst() ) {
+		m_seconds = SecondsSince( start );
+		return false;
+	}
+
+	// Search the segments between checkpoints from the latest back,
+	// each for the last stop in it before the end:
+	size_t checkpoint = FindCheckpoint( end - 1 );
+	for( ;; ) {
+		const unsigned long long from =
+			m_checkpoints[checkpoint].state.instructions;
+		unsigned long long found = 0;
+		bool any = false;
+
+		Restore( checkpoint );
+		while( m_simulator->GetInstructions() < end ) {
+			if( m_simulator->AtBreakpoint() ) {
+				any = true;
+				found = m_simulator->GetInstructions();
+				if( !m_simulator->StepOver() ) {
+					break;
+				}
+				continue;
+			}
+
+			const unsigned long long executed = m_simulator->Run(
+				end - m_simulator->GetInstructions() );
+			CManoSimulator::SWatchHit hit;
+			if( m_simulator->TakeWatchHit( &hit ) ) {
+				any = true;
+				found = m_simulator->GetInstructions() - 1;
+			}
+			else if( executed == 0 && !m_simulator->AtBreakpoint() ) {
+				break;
+			}
+		}
+		m_replayed += m_simulator->GetInstructions() - from;
+
+		if( any ) {
+			Restore( checkpoint );
+			Replay( found );
+			m_replayed += found - from;
+			m_seconds = SecondsSince( start );
+			return true;
+		}
+		if( checkpoint == 0 ) {
+			Restore( 0 );
+			m_seconds = SecondsSince( start );
+			return false;
+		}
+		end = from;
+		checkpoint--;
+	}
+
+} // ReverseContinue
+
+//
+// Name:	Seek
+//
+bool CHistory::Seek( unsigned long long instruction ) {
+
+	if( instruction < GetFirst() || instruction > m_last ) {
+		return false;
+	}
+
+	const chrono::steady_clock::time_point start =
+		chrono::steady_clock::now();
+	const size_t checkpoint = FindCheckpoint( instruction );
+	const unsigned long long from =
+		m_checkpoints[checkpoint].state.instructions;
+	const unsigned long long now = m_simulator->GetInstructions();
+
+	// Going forward from the present is cheaper when it is nearer:
+	if( now <= instruction && now >= from ) {
+		m_replayed = instruction - now;
+	}
+	else {
+		Restore( checkpoint );
+		m_replayed = instruction - from;
+	}
+	Replay( instruction );
+	m_seconds = SecondsSince( start );
+	return true;
+
+} // Seek
+
+//
+// Name:	GetFgi
+//
+bool CHistory::GetFgi( unsigned long long cycle ) {
+
+	if( Call() ) {
+		return m_fgi;
+	}
+
+	const bool fgi = m_device ? m_device->GetFgi( cycle ) : false;
+	if( fgi != m_fgi ) {
+		m_fgi = fgi;
+		Log( (unsigned char)(EVENT_FGI | (fgi ? EVENT_SET : 0)), 0 );
+	}
+	Passed();
+	return fgi;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CHistory::GetFgo( unsigned long long cycle ) {
+
+	if( Call() ) {
+		return m_fgo;
+	}
+
+	const bool fgo = m_device ? m_device->GetFgo( cycle ) : true;
+	if( fgo != m_fgo ) {
+		m_fgo = fgo;
+		Log( (unsigned char)(EVENT_FGO | (fgo ? EVENT_SET : 0)), 0 );
+	}
+	Passed();
+	return fgo;
+
+} // GetFgo
+
+//
+// Name:	Input
+//
+unsigned char CHistory::Input( unsigned long long cycle ) {
+
+	if( Call() ) {
+		return m_character;
+	}
+
+	m_character = m_device ? m_device->Input( cycle ) : 0;
+	Log( EVENT_INPUT, m_character );
+	Passed();
+	return m_character;
+
+} // Input
+
+//
+// Name:	Output
+//
+void CHistory::Output( unsigned char character, unsigned long long cycle ) {
+
+	// A character already written is not written again:
+	if( Call() ) {
+		return;
+	}
+
+	if( m_device ) {
+		m_device->Output( character, cycle );
+	}
+	Passed();
+
+} // Output
+
+//
+// Name:	Flush
+//
+void CHistory::Flush() {
+
+	if( m_device ) {
+		m_device->Flush();
+	}
+
+} // Flush
+
+//
+// Name:	GetSimulator
+//
+CManoSimulator *CHistory::GetSimulator() const {
+	return m_simulator;
+} // GetSimulator
+
+//
+// Name:	GetCheckpointCount
+//
+size_t CHistory::GetCheckpointCount() const {
+	return m_checkpoints.size();
+} // GetCheckpointCount
+
+//
+// Name:	GetInterval
+//
+unsigned long long CHistory::GetInterval() const {
+	return m_interval;
+} // GetInterval
+
+//
+// Name:	GetBytes
+//
+size_t CHistory::GetBytes() const {
+
+	return m_checkpoints.size() * sizeof( SCheckpoint )
+		+ m_events.size() * sizeof( SEvent );
+
+} // GetBytes
+
+//
+// Name:	GetBudget
+//
+size_t CHistory::GetBudget() const {
+	return m_budget;
+} // GetBudget
+
+//
+// Name:	GetFirst
+//
+unsigned long long CHistory::GetFirst() const {
+	return m_checkpoints.front().state.instructions;
+} // GetFirst
+
+//
+// Name:	GetLast
+//
+unsigned long long CHistory::GetLast() const {
+	return m_last;
+} // GetLast
+
+//
+// Name:	GetReplayed
+//
+unsigned long long CHistory::GetReplayed() const {
+	return m_replayed;
+} // GetReplayed
+
+//
+// Name:	GetSeconds
+//
+double CHistory::GetSeconds() const {
+	return m_seconds;
+} // GetSeconds
+
+//
+// Name:	Checkpoint
+//
+void CHistory::Checkpoint() {
+
+	const unsigned long long now = m_simulator->GetInstructions();
+	if( !m_checkpoints.empty()
+		&& now <= m_checkpoints.back().state.instructions )
+	{
+		return;
+	}
+
+	m_checkpoints.resize( m_checkpoints.size() + 1 );
+	SCheckpoint &checkpoint = m_checkpoints.back();
+	m_simulator->SaveState( &checkpoint.state );
+	checkpoint.calls = m_calls;
+	checkpoint.event = m_next;
+	checkpoint.fgi = m_fgi;
+	checkpoint.fgo = m_fgo;
+	checkpoint.stop = m_stop_requested;
+	checkpoint.character = m_character;
+
+	Fit();
+
+} // Checkpoint
+
+//
+// Name:	Restore
+//
+void CHistory::Restore( size_t checkpoint ) {
+
+	const SCheckpoint &from = m_checkpoints[checkpoint];
+
+	m_simulator->RestoreState( from.state );
+	m_calls = from.calls;
+	m_next = from.event;
+	m_fgi = from.fgi;
+	m_fgo = from.fgo;
+	m_stop_requested = from.stop;
+	m_character = from.character;
+
+	// A hit from the abandoned present is stale:
+	CManoSimulator::SWatchHit hit;
+	m_simulator->TakeWatchHit( &hit );
+
+} // Restore
+
+//
+// Name:	Replay
+//
+void CHistory::Replay( unsigned long long instruction ) {
+
+	CManoSimulator::SWatchHit hit;
+
+	while( m_simulator->GetInstructions() < instruction ) {
+		if( m_simulator->Run( instruction
+			- m_simulator->GetInstructions() ) == 0
+			&& !m_simulator->StepOver() )
+		{
+			break;
+		}
+	}
+	m_simulator->TakeWatchHit( &hit );
+
+} // Replay
+
+//
+// Name:	FindCheckpoint
+//
+size_t CHistory::FindCheckpoint( unsigned long long instruction ) const {
+
+	size_t low = 0;
+	size_t high = m_checkpoints.size();
+
+	// The first checkpoint after the instruction is at high:
+	while( low < high ) {
+		const size_t middle = (low + high) / 2;
+		if( m_checkpoints[middle].state.instructions <= instruction ) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low ? low - 1 : 0;
+
+} // FindCheckpoint
+
+//
+// Name:	Call
+//
+bool CHistory::Call() {
+
+	if( ++m_calls > m_live_calls ) {
+		return false;
+	}
+
+	while( m_next < m_events.size() && m_events[m_next].call <= m_calls ) {
+		const SEvent &event = m_events[m_next++];
+		const bool set = (event.kind & EVENT_SET) != 0;
+
+		switch( event.kind & EVENT_KIND_MASK ) {
+		case EVENT_FGI:
+			m_fgi = set;
+			break;
+		case EVENT_FGO:
+			m_fgo = set;
+			break;
+		case EVENT_INPUT:
+			m_character = event.character;
+			break;
+		case EVENT_STOP:
+			m_stop_requested = true;
+			break;
+		}
+	}
+
+	return true;
+
+} // Call
+
+//
+// Name:	Log
+//
+void CHistory::Log( unsigned char kind, unsigned char character ) {
+
+	SEvent event;
+	event.call = m_calls;
+	event.kind = kind;
+	event.character = character;
+	m_events.push_back( event );
+	m_next = m_events.size();
+
+} // Log
+
+//
+// Name:	Passed
+//
+void CHistory::Passed() {
+
+	m_live_calls = m_calls;
+	if( m_device && !m_stop_requested && m_device->StopRequested() ) {
+		m_stop_requested = true;
+		Log( EVENT_STOP, 0 );
+	}
+
+} // Passed
+
+//
+// Name:	Fit
+//
+void CHistory::Fit() {
+
+	while( GetBytes() > m_budget && m_checkpoints.size() > 1 ) {
+
+		// While checkpoints take the most, keep the first and every
+		// other one after it:
+		if( m_checkpoints.size() > 2 && m_checkpoints.size()
+			* sizeof( SCheckpoint ) >= m_events.size() * sizeof( SEvent ) )
+		{
+			size_t kept = 1;
+			for( size_t i = 2; i < m_checkpoints.size(); i += 2 ) {
+				m_checkpoints[kept++] = m_checkpoints[i];
+			}
+			m_checkpoints.resize( kept );
+			m_interval *= 2;
+			continue;
+		}
+
+		// Otherwise forget the oldest history, with the events only
+		// it needed:
+		m_checkpoints.erase( m_checkpoints.begin() );
+		const size_t dropped = m_checkpoints.front().event;
+		m_events.erase( m_events.begin(), m_events.begin() + dropped );
+		for( size_t i = 0; i < m_checkpoints.size(); i++ ) {
+			m_checkpoints[i].event -= dropped;
+		}
+		m_next -= dropped;
+	}
+
+} // Fit
@@ -0,0 +1,318 @@
+// File:	History.hpp
+// Description:
+//		Reverse execution for CManoSimulator: periodic checkpoints of
+//		the processor and memory, and a log of the device's answers,
+//		so any earlier instruction can be returned to by restoring
+//		the nearest checkpoint before it and running forward again.
+// Usage:
+//		1. create one instance of this class
+//		2. call Attach with a loaded simulator and its device, then
+//		   attach the history to the simulator with SetIo in the
+//		   device's place
+//		3. run forward with Run and StepOver rather than the
+//		   simulator's own, so checkpoints are taken
+//		4. go back with ReverseStep, ReverseContinue or Seek
+//		5. call Invalidate after changing registers or memory.
+//
+// Notes:
+//
+//		A checkpoint is taken every GetInterval() instructions,
+//		between runs of the simulator, so running forward costs a
+//		copy of memory per interval and nothing per instruction.
+//		Going back one instruction restores a checkpoint and runs
+//		forward up to an interval of instructions again.
+//
+//		Re-execution gives the same run because the device is
+//		replayed: the first time the program makes a call into the
+//		device, the call is passed on and its answer logged (as in
+//		EventFormat.hpp, but in memory); when the same call is made
+//		again, the logged answer is given and the device is not
+//		touched, so input is not consumed twice and output is not
+//		repeated.
+//
+//		Checkpoints and the log share a memory budget.  When it is
+//		exceeded and checkpoints take most of it, every other
+//		checkpoint is dropped and the interval doubles, so the whole
+//		run stays reachable at a coarser spacing.  When the log takes
+//		most of it (a run that reads a lot of input), the oldest
+//		checkpoint is dropped instead, with the events before the
+//		next one.
+//
+//		Changing registers or memory from a debugger starts the
+//		history again from there, with a checkpoint of the changed
+//		state; the run before it can no longer be gone back to.
+//		Answers the device gave later in the run, before a reverse
+//		step, are kept, so input is not read twice.
+//
+//		Each reverse operation measures its own cost: the
+//		instructions run again and the time taken.
+//
+//		Monitors attached to the simulator (a trace, a profile) see
+//		the instructions run again as well.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+#include "ManoSimulator.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Default instructions between checkpoints, and default memory budget
+// in bytes:
+#define HISTORY_INTERVAL	10000
+#define HISTORY_BUDGET		(64 * 1024 * 1024)
+
+class CHistory : public CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CHistory object with no simulator.
+	//
+	CHistory();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CHistory object.  The simulator and the
+	//		device are not destroyed.
+	//
+	virtual ~CHistory();
+
+public:	// Initialization
+
+	//
+	// Name:	Attach
+	//
+	// Description:	Starts the history at the simulator's present state
+	//		with a first checkpoint.
+	// Arguments:	The simulator, its device (which may be 0), the
+	//		instructions between checkpoints, and the memory budget
+	//		in bytes
+	//
+	void Attach( CManoSimulator *simulator, CManoIo *device,
+		unsigned long long interval, size_t budget );
+
+	//
+	// Name:	Invalidate
+	//
+	// Description:	Starts the history again at the present, after a
+	//		debugger has changed registers or memory.
+	// Modifies:	m_checkpoints, m_events, m_next, m_last
+	//
+	void Invalidate();
+
+public:	// Execution
+
+	//
+	// Name:	Run
+	//
+	// Description:	Runs the simulator as CManoSimulator::Run does,
+	//		taking checkpoints on the way.
+	// Arguments:	The maximum number of instructions to execute
+	// Returns:	The number of instructions executed.
+	//
+	unsigned long long Run( unsigned long long max_instructions );
+
+	//
+	// Name:	StepOver
+	//
+	// Description:	Executes one instruction as
+	//		CManoSimulator::StepOver does, taking a checkpoint if
+	//		one is due.
+	// Returns:	false if the processor is halted.
+	//
+	bool StepOver();
+
+	//
+	// Name:	ReverseStep
+	//
+	// Description:	Goes back one instruction.
+	// Returns:	false if the history starts here.
+	//
+	bool ReverseStep();
+
+	//
+	// Name:	ReverseContinue
+	//
+	// Description:	Goes back to the last breakpoint reached, or the
+	//		last instruction that hit a watchpoint (to just before
+	//		it executed), or else to the start of the history.
+	// Returns:	false if it went back to the start of the history.
+	//
+	bool ReverseContinue();
+
+	//
+	// Name:	Seek
+	//
+	// Description:	Goes to the state before an instruction, anywhere
+	//		from the start of the history to the furthest the run
+	//		has gone.
+	// Arguments:	The number of instructions executed at that point
+	// Returns:	false if it lies outside the history.
+	//
+	bool Seek( unsigned long long instruction );
+
+public:	// CManoIo
+
+	virtual bool GetFgi( unsigned long long cycle );
+	virtual bool GetFgo( unsigned long long cycle );
+	virtual unsigned char Input( unsigned long long cycle );
+	virtual void Output( unsigned char character, unsigned long long cycle );
+	virtual void Flush();
+
+public:	// Accessors
+
+	CManoSimulator *GetSimulator() const;	// The simulator attached
+	size_t GetCheckpointCount() const;	// Checkpoints held
+	unsigned long long GetInterval() const;	// Instructions between them
+	size_t GetBytes() const;		// Memory they and the log use
+	size_t GetBudget() const;		// Memory they may use
+	unsigned long long GetFirst() const;	// Oldest instruction reachable
+	unsigned long long GetLast() const;	// Furthest instruction reached
+
+	//
+	// Name:	GetReplayed / GetSeconds
+	//
+	// Returns:	The instructions run again by the last reverse
+	//		operation or seek, and the seconds it took.
+	//
+	unsigned long long GetReplayed() const;
+	double GetSeconds() const;
+
+protected: // Types
+
+	// A logged answer of the device:
+	struct SEvent {
+		unsigned long long call;	// The call, from 1
+		unsigned char	kind;		// As in EventFormat.hpp
+		unsigned char	character;	// For EVENT_INPUT
+	};
+
+	// A checkpoint:
+	struct SCheckpoint {
+		CManoSimulator::SState state;	// The simulator
+		unsigned long long calls;	// Device calls made
+		size_t		event;		// The next event to replay
+		bool		fgi;		// The flags, as last answered
+		bool		fgo;
+		bool		stop;		// The device asked for a stop
+		unsigned char	character;	// The last INP
+	};
+
+protected: // Utility functions
+
+	//
+	// Name:	Checkpoint
+	//
+	// Description:	Takes a checkpoint of the present, then keeps to
+	//		the budget.
+	// Modifies:	m_checkpoints, m_interval, m_events
+	//
+	void Checkpoint();
+
+	//
+	// Name:	Restore
+	//
+	// Description:	Puts the simulator and the device replay back as a
+	//		checkpoint holds them.
+	// Arguments:	The checkpoint's index
+	//
+	void Restore( size_t checkpoint );
+
+	//
+	// Name:	Replay
+	//
+	// Description:	Runs forward to an instruction, passing over
+	//		breakpoints and watchpoints.
+	// Arguments:	The number of instructions executed to stop at
+	//
+	void Replay( unsigned long long instruction );
+
+	//
+	// Name:	FindCheckpoint
+	//
+	// Returns:	The index of the last checkpoint at or before an
+	//		instruction.
+	//
+	size_t FindCheckpoint( unsigned long long instruction ) const;
+
+	//
+	// Name:	Call
+	//
+	// Description:	Counts a call into the device, and replays the
+	//		events logged for it.
+	// Returns:	true if the call was made before, so its answer is
+	//		in the log.
+	// Modifies:	m_calls, m_next, m_fgi, m_fgo, m_character,
+	//		m_stop_requested
+	//
+	bool Call();
+
+	//
+	// Name:	Log
+	//
+	// Description:	Logs an answer of the device.
+	// Arguments:	The event kind (with EVENT_SET for a flag that reads
+	//		1), and the character of an EVENT_INPUT
+	// Modifies:	m_events
+	//
+	void Log( unsigned char kind, unsigned char character );
+
+	//
+	// Name:	Passed
+	//
+	// Description:	Finishes a call passed on to the device, logging a
+	//		stop if the device has just asked for one.
+	// Modifies:	m_live_calls, m_events, m_next, m_stop_requested
+	//
+	void Passed();
+
+	//
+	// Name:	Fit
+	//
+	// Description:	Drops checkpoints, and then the oldest history,
+	//		until the budget is kept.
+	// Modifies:	m_checkpoints, m_interval, m_events, m_next
+	//
+	void Fit();
+
+protected: // Attributes
+
+	CManoSimulator	*m_simulator;	// The simulator, or 0
+
+	CManoIo		*m_device;	// Its device, or 0
+
+	std::vector<SCheckpoint> m_checkpoints; // In instruction order
+
+	std::vector<SEvent> m_events;	// The device's answers, in call order
+
+	unsigned long long m_interval;	// Instructions between checkpoints
+
+	size_t		m_budget;	// Bytes they may use
+
+	unsigned long long m_last;	// Furthest instruction reached
+
+	unsigned long long m_calls;	// Device calls made, replayed or not
+
+	unsigned long long m_live_calls; // Device calls passed on
+
+	size_t		m_next;		// The next event to replay
+
+	bool		m_fgi;		// FGI as last answered
+
+	bool		m_fgo;		// FGO as last answered
+
+	unsigned char	m_character;	// The character of the last INP
+
+	unsigned long long m_replayed;	// Cost of the last reverse operation
+
+	double		m_seconds;
+};
@@ -0,0 +1,613 @@
+// File:	ImageLoader.cpp
+// Description:
+//		Reads the memory images manoasm writes, in any of its
+//		formats, into a CMemoryImage or a dense memory.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "ImageLoader.hpp"
+#include "ImageFormat.hpp"
+#include "ManoSimulator.hpp"
+#include "MemoryImage.hpp"
+#include "ProgramFile.hpp"
+#include "ErrorException.hpp"
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+// What a character is worth as a hex digit, or HEX_INVALID:
+#define HEX_INVALID	0x10
+
+static const unsigned char hex_value[256] = {
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,16,16,16,16,16,16,
+	16,10,11,12,13,14,15,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,10,11,12,13,14,15,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+	16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16
+};
+
+// The statements of a coe file:
+static const char coe_radix[] = "memory_initialization_radix";
+static const char coe_vector[] = "memory_initialization_vector";
+
+// Stores parsed words in a CMemoryImage:
+struct SImageSink {
+	CMemoryImage	*image;
+
+	void Store( unsigned address, unsigned short word ) {
+		image->Store( address, word );
+	}
+};
+
+// Or in a dense memory:
+struct SDenseSink {
+	unsigned short	*memory;
+
+	void Store( unsigned address, unsigned short word ) {
+		memory[address] = word;
+	}
+};
+
+//
+// Name:	ParseHex
+//
+// Description:	Reads a hex number as strtoul does: after white space,
+//		an optional sign and 0x, and saturating on overflow.
+// Arguments:	The text (advanced past the number) and its end, and
+//		where to store the number
+// Returns:	false if there are no digits.
+//
+static bool ParseHex( const unsigned char *&p, const unsigned char *end,
+	unsigned long *value )
+{
+	const unsigned char *q = p;
+	bool negative = false, overflow = false;
+
+	while( q < end && (*q == ' ' || (*q >= '\t' && *q <= '\r')) ) {
+		q++;
+	}
+	if( q < end && (*q == '+' || *q == '-') ) {
+		negative = *q == '-';
+		q++;
+	}
+	if( end - q > 2 && q[0] == '0' && (q[1] == 'x' || q[1] == 'X')
+		&& !(hex_value[q[2]] & HEX_INVALID) )
+	{
+		q += 2;
+	}
+	if( q == end || (hex_value[*q] & HEX_INVALID) ) {
+		return false;
+	}
+
+	unsigned long number = 0;
+	for( ; q < end && !(hex_value[*q] & HEX_INVALID); q++ ) {
+		if( number > (ULONG_MAX >> 4) ) {
+			overflow = true;
+		}
+		number = (number << 4) | hex_value[*q];
+	}
+
+	*value = overflow ? ULONG_MAX : negative ? 0 - number : number;
+	p = q;
+	return true;
+
+} // ParseHex
+
+//
+// Name:	LineOf
+//
+// Returns:	The line number of a place in a text.
+//
+static unsigned LineOf( const unsigned char *start, const unsigned char *p,
+	unsigned first_line )
+{
+	unsigned line = first_line;
+
+	for( ; start < p; start++ ) {
+		line += *start == '\n';
+	}
+	return line;
+
+} // LineOf
+
+//
+// Name:	ParseLine
+//
+// Description:	Reads a listing line the general way, as CManoSimulator
+//		did before the loader.
+//
+template <class TSink>
+static void ParseLine( const unsigned char *p, const unsigned char *end,
+	const char *filename, unsigned line_number, TSink &sink )
+{
+	unsigned long address, data;
+
+	// Skip leading white space, and blank lines:
+	while( p < end && (*p == ' ' || *p == '\t' || *p == '\r') ) {
+		p++;
+	}
+	if( p == end ) {
+		return;
+	}
+
+	// Both formats lead with a marker, then the address:
+	if( *p == 'm' && end - p > 1 && (p[1] == '\t' || p[1] == ' ') ) {
+		p++;
+	}
+	else if( *p == '@' ) {
+		p++;
+	}
+	else {
+		throw CErrorException( filename, line_number, "S1002",
+			"Unrecognized image line", CErrorException::ERROR );
+	}
+
+	if( !ParseHex( p, end, &address ) ) {
+		throw CErrorException( filename, line_number, "S1002",
+			"Unrecognized image line", CErrorException::ERROR );
+	}
+	if( address >= MANO_MEMORY_SIZE ) {
+		throw CErrorException( filename, line_number, "S1003",
+			"Addresses must be between 000 and FFF",
+			CErrorException::ERROR );
+	}
+	if( !ParseHex( p, end, &data ) ) {
+		throw CErrorException( filename, line_number, "S1002",
+			"Unrecognized image line", CErrorException::ERROR );
+	}
+
+	sink.Store( (unsigned)address, (unsigned short)data );
+
+} // ParseLine
+
+//
+// Name:	ParseListing
+//
+// Description:	Reads normal and verilog lines.
+//
+template <class TSink>
+static void ParseListing( const unsigned char *p, const unsigned char *end,
+	const char *filename, unsigned line_number, TSink &sink )
+{
+
+	for( ; p < end; line_number++ ) {
+		const unsigned char *eol =
+			(const unsigned char *)memchr( p, '\n', end - p );
+		if( !eol ) {
+			eol = end;
+		}
+		const size_t length = eol - p;
+
+		// The lines manoasm writes take four address digits, the first
+		// of them 0, and four data digits, a tab apart, after "m\t" or
+		// "@":
+		const unsigned char *digits = 0;
+		if( length >= 11 && p[0] == 'm' && p[1] == '\t' ) {
+			digits = p + 2;
+		}
+		else if( length >= 10 && p[0] == '@' ) {
+			digits = p + 1;
+		}
+
+		bool parsed = false;
+		if( digits && digits[0] == '0' && digits[4] == '\t'
+			&& (digits + 9 == eol
+				|| (hex_value[digits[9]] & HEX_INVALID)) )
+		{
+			const unsigned a1 = hex_value[digits[1]];
+			const unsigned a2 = hex_value[digits[2]];
+			const unsigned a3 = hex_value[digits[3]];
+			const unsigned d0 = hex_value[digits[5]];
+			const unsigned d1 = hex_value[digits[6]];
+			const unsigned d2 = hex_value[digits[7]];
+			const unsigned d3 = hex_value[digits[8]];
+
+			if( !((a1 | a2 | a3 | d0 | d1 | d2 | d3) & HEX_INVALID) ) {
+				sink.Store( a1 << 8 | a2 << 4 | a3, (unsigned short)
+					(d0 << 12 | d1 << 8 | d2 << 4 | d3) );
+				parsed = true;
+			}
+		}
+		if( !parsed ) {
+			ParseLine( p, eol, filename, line_number, sink );
+		}
+
+		if( eol == end ) {
+			break;
+		}
+		p = eol + 1;
+	}
+
+} // ParseListing
+
+//
+// Name:	SkipCoeSpace
+//
+// Description:	Skips white space, and the ';' comments that may stand
+//		where a coe statement would.
+//
+static void SkipCoeSpace( const unsigned char *&p, const unsigned char *end,
+	bool comments )
+{
+
+	while( p < end ) {
+		if( *p == ' ' || (*p >= '\t' && *p <= '\r') ) {
+			p++;
+		}
+		else if( comments && *p == ';' ) {
+			while( p < end && *p != '\n' ) {
+				p++;
+			}
+		}
+		else {
+			break;
+		}
+	}
+
+} // SkipCoeSpace
+
+//
+// Name:	MatchKeyword
+//
+// Description:	Matches a coe keyword, ignoring case.
+// Returns:	true, with the text advanced past it, if it matches.
+//
+static bool MatchKeyword( const unsigned char *&p, const unsigned char *end,
+	const char *keyword )
+{
+	const size_t length = strlen( keyword );
+
+	if( (size_t)(end - p) < length ) {
+		return false;
+	}
+	for( size_t i = 0; i < length; i++ ) {
+		if( (p[i] | 0x20) != (unsigned char)keyword[i]
+			&& p[i] != (unsigned char)keyword[i] )
+		{
+			return false;
+		}
+	}
+	p += length;
+	return true;
+
+} // MatchKeyword
+
+//
+// Name:	ParseCoe
+//
+// Description:	Reads the statements of a coe file.
+//
+template <class TSink>
+static void ParseCoe( const unsigned char *start, const unsigned char *end,
+	const char *filename, unsigned first_line, TSink &sink )
+{
+	const unsigned char *p = start;
+
+	for( ;; ) {
+		SkipCoeSpace( p, end, true );
+		if( p == end ) {
+			return;
+		}
+
+		const bool radix = MatchKeyword( p, end, coe_radix );
+		if( !radix && !MatchKeyword( p, end, coe_vector ) ) {
+			break;
+		}
+		SkipCoeSpace( p, end, false );
+		if( p == end || *p != '=' ) {
+			break;
+		}
+		p++;
+
+		if( radix ) {
+			unsigned long value = 0;
+			SkipCoeSpace( p, end, false );
+			while( p < end && *p >= '0' && *p <= '9' ) {
+				value = value * 10 + (*p++ - '0');
+			}
+			if( value != 16 ) {
+				throw CErrorException( filename,
+					LineOf( start, p, first_line ), "S1004",
+					"Only radix 16 coe files can be read",
+					CErrorException::ERROR );
+			}
+			SkipCoeSpace( p, end, false );
+			if( p == end || *p != ';' ) {
+				break;
+			}
+			p++;
+			continue;
+		}
+
+		// The vector, from address 000:
+		for( unsigned address = 0; ; address++ ) {
+			unsigned long word;
+
+			SkipCoeSpace( p, end, false );
+			if( end - p > 4 && !((hex_value[p[0]] | hex_value[p[1]]
+				| hex_value[p[2]] | hex_value[p[3]]) & HEX_INVALID)
+				&& (hex_value[p[4]] & HEX_INVALID) )
+			{
+				word = hex_value[p[0]] << 12 | hex_value[p[1]] << 8
+					| hex_value[p[2]] << 4 | hex_value[p[3]];
+				p += 4;
+			}
+			else if( !ParseHex( p, end, &word ) ) {
+				throw CErrorException( filename,
+					LineOf( start, p, first_line ), "S1002",
+					"Unrecognized image line",
+					CErrorException::ERROR );
+			}
+
+			if( address >= MANO_MEMORY_SIZE ) {
+				throw CErrorException( filename,
+					LineOf( start, p, first_line ), "S1003",
+					"Addresses must be between 000 and FFF",
+					CErrorException::ERROR );
+			}
+			sink.Store( address, (unsigned short)word );
+
+			SkipCoeSpace( p, end, false );
+			if( p < end && *p == ',' ) {
+				p++;
+				continue;
+			}
+			if( p < end && *p == ';' ) {
+				p++;
+				break;
+			}
+			throw CErrorException( filename,
+				LineOf( start, p, first_line ), "S1002",
+				"Unrecognized image line", CErrorException::ERROR );
+		}
+	}
+
+	throw CErrorException( filename, LineOf( start, p, first_line ),
+		"S1002", "Unrecognized image line", CErrorException::ERROR );
+
+} // ParseCoe
+
+//
+// Name:	GetFixed
+//
+// Returns:	A little-endian field of a binary image.
+//
+static unsigned long GetFixed( const unsigned char *field, int bytes ) {
+	unsigned long value = 0;
+
+	for( int b = bytes - 1; b >= 0; b-- ) {
+		value = (value << 8) | field[b];
+	}
+	return value;
+
+} // GetFixed
+
+//
+// Name:	ParseBinary
+//
+// Description:	Reads the segments of a binary image.
+//
+template <class TSink>
+static void ParseBinary( const unsigned char *start,
+	const unsigned char *end, const char *filename, TSink &sink )
+{
+	const size_t size = end - start;
+
+	if( size < IMAGE_HEADER_SIZE
+		|| start[strlen( IMAGE_MAGIC )] != IMAGE_VERSION )
+	{
+		throw CErrorException( filename, 0, "S1005",
+			"Image file is damaged", CErrorException::ERROR );
+	}
+
+	const unsigned long segments = GetFixed( start + 8, 4 );
+	const unsigned char *p = start + IMAGE_HEADER_SIZE;
+
+	for( unsigned long segment = 0; segment < segments; segment++ ) {
+		if( (size_t)(end - p) < IMAGE_SEGMENT_HEADER_SIZE ) {
+			break;
+		}
+		const unsigned address = (unsigned)GetFixed( p, 2 );
+		const unsigned count = (unsigned)GetFixed( p + 2, 2 );
+		p += IMAGE_SEGMENT_HEADER_SIZE;
+
+		if( (size_t)(end - p) < 2 * (size_t)count ) {
+			break;
+		}
+		if( address + count > MANO_MEMORY_SIZE ) {
+			throw CErrorException( filename, 0, "S1003",
+				"Addresses must be between 000 and FFF",
+				CErrorException::ERROR );
+		}
+
+		for( unsigned word = 0; word < count; word++, p += 2 ) {
+			sink.Store( address + word,
+				(unsigned short)(p[0] | p[1] << 8) );
+		}
+	}
+
+	if( p != end ) {
+		throw CErrorException( filename, 0, "S1005",
+			"Image file is damaged", CErrorException::ERROR );
+	}
+
+} // ParseBinary
+
+//
+// Name:	ParseProgram
+//
+// Description:	Reads the image of a program file.
+//
+template <class TSink>
+static void ParseProgram( const char *data, size_t size,
+	const char *filename, TSink &sink )
+{
+	CProgramFile program;
+	const char *image;
+	size_t image_size;
+
+	program.Attach( data, size, filename );
+	program.GetImage( &image, &image_size );
+	ParseBinary( (const unsigned char *)image,
+		(const unsigned char *)image + image_size, filename, sink );
+
+} // ParseProgram
+
+//
+// Name:	ParseAny
+//
+// Description:	Reads an image in whichever format it is.
+//
+template <class TSink>
+static void ParseAny( const char *data, size_t size, const char *filename,
+	unsigned first_line, TSink &sink )
+{
+	const unsigned char *start = (const unsigned char *)data;
+
+	switch( CImageLoader::Detect( data, size ) ) {
+	case CImageLoader::format_binary:
+		ParseBinary( start, start + size, filename, sink );
+		break;
+	case CImageLoader::format_program:
+		ParseProgram( data, size, filename, sink );
+		break;
+	case CImageLoader::format_coe:
+		ParseCoe( start, start + size, filename, first_line, sink );
+		break;
+	case CImageLoader::format_listing:
+		ParseListing( start, start + size, filename, first_line, sink );
+		break;
+	}
+
+} // ParseAny
+
+//
+// Name:	(constructor)
+//
+CImageLoader::CImageLoader() {
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CImageLoader::~CImageLoader() {
+} // (destructor)
+
+//
+// Name:	Load
+//
+void CImageLoader::Load( const char *filename, CMemoryImage &image ) {
+	const char *data;
+	size_t size;
+
+	Map( filename, &data, &size );
+	Parse( data, size, filename, image );
+	m_file.Close();
+
+} // Load
+
+void CImageLoader::Load( const char *filename, unsigned short *memory ) {
+	const char *data;
+	size_t size;
+
+	Map( filename, &data, &size );
+	Parse( data, size, filename, memory );
+	m_file.Close();
+
+} // Load
+
+//
+// Name:	Parse
+//
+void CImageLoader::Parse( const char *data, size_t size,
+	const char *filename, CMemoryImage &image, unsigned first_line )
+{
+	SImageSink sink = { &image };
+
+	ParseAny( data, size, filename, first_line, sink );
+
+} // Parse
+
+void CImageLoader::Parse( const char *data, size_t size,
+	const char *filename, unsigned short *memory, unsigned first_line )
+{
+	SDenseSink sink = { memory };
+
+	ParseAny( data, size, filename, first_line, sink );
+
+} // Parse
+
+//
+// Name:	Detect
+//
+CImageLoader::EFormat CImageLoader::Detect( const char *data,
+	size_t size )
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+
+	if( size >= strlen( IMAGE_MAGIC )
+		&& memcmp( data, IMAGE_MAGIC, strlen( IMAGE_MAGIC ) ) == 0 )
+	{
+		return format_binary;
+	}
+	if( CProgramFile::IsProgram( data, size ) ) {
+		return format_program;
+	}
+
+	// A coe file starts with a statement, after any comments:
+	SkipCoeSpace( p, end, true );
+	if( MatchKeyword( p, end, coe_radix )
+		|| MatchKeyword( p, end, coe_vector ) )
+	{
+		return format_coe;
+	}
+	return format_listing;
+
+} // Detect
+
+//
+// Name:	Map
+//
+void CImageLoader::Map( const char *filename, const char **data,
+	size_t *size )
+{
+
+	m_file.Close();
+	m_buffer.clear();
+
+	if( m_file.Open( filename ) ) {
+		*data = m_file.GetData();
+		*size = m_file.GetSize();
+		return;
+	}
+
+	// Empty files and pipes cannot be mapped; read them instead:
+	ifstream in( filename, ios::in | ios::binary );
+	if( !in ) {
+		throw CErrorException( filename, 0, "S1001",
+			"Could not read image file", CErrorException::FATAL );
+	}
+	m_buffer.assign( istreambuf_iterator<char>( in ),
+		istreambuf_iterator<char>() );
+
+	*data = m_buffer.data();
+	*size = m_buffer.size();
+
+} // Map
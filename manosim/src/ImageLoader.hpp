@@ -0,0 +1,134 @@
+// File:	ImageLoader.hpp
+// Description:
+//		Reads the memory images manoasm writes, in any of its
+//		formats, into a CMemoryImage or a dense memory.
+// Usage:
+//		1. create one instance of this class
+//		2. call Load with a file, or Parse with a buffer already in
+//		   memory, and the image or the memory to fill.
+//
+// Notes:
+//
+//		The format is found from the content:
+//
+//		listing		normal ("m\taddr\tdata\t/ ...") and verilog
+//				("@addr\tdata\t// ...") lines, which may be
+//				mixed, as CManoSimulator has always read them
+//		coe		memory_initialization_radix (which must be 16)
+//				and memory_initialization_vector statements,
+//				with ';' comments; the vector starts at 000
+//		binary		see ImageFormat.hpp
+//		program		the image of a program file (see
+//				ProgramFormat.hpp)
+//
+//		Files are mapped where they can be (see CMappedFile) and
+//		parsed in place.  A listing line of the exact shape manoasm
+//		writes is decoded with table lookups and a single test for
+//		all of its digits; anything else takes a general path that
+//		accepts what strtoul would.  Words are stored in file order,
+//		so later words replace earlier ones at the same address.
+//
+//		A dense memory must hold MANO_MEMORY_SIZE words; words the
+//		image does not store are left as they were.  After an error
+//		some words may already be stored.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <string>
+
+class CMemoryImage;
+
+class CImageLoader {
+
+public: // Enumerated types
+
+	// Image formats:
+	enum EFormat {
+		format_listing,
+		format_coe,
+		format_binary,
+		format_program
+	};
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CImageLoader object.
+	//
+	CImageLoader();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CImageLoader object.
+	//
+	~CImageLoader();
+
+public:	// Loading
+
+	//
+	// Name:	Load
+	//
+	// Description:	Reads an image file.
+	// Arguments:	The file, and the image or dense memory to store
+	//		its words to
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		read (S1001), or as Parse.
+	//
+	void Load( const char *filename, CMemoryImage &image );
+	void Load( const char *filename, unsigned short *memory );
+
+	//
+	// Name:	Parse
+	//
+	// Description:	Reads an image held in memory.
+	// Arguments:	The bytes and their count, the file name to give in
+	//		error messages, the image or dense memory to store
+	//		the words to, and the line number of the first line
+	// Exceptions:	Throws a CErrorException if a line or statement is
+	//		not understood (S1002), an address is outside of
+	//		000-FFF (S1003), a coe radix is not 16 (S1004), a
+	//		binary image is cut short or damaged (S1005), or a
+	//		program file is damaged (S1006).
+	//
+	static void Parse( const char *data, size_t size, const char *filename,
+		CMemoryImage &image, unsigned first_line = 0 );
+	static void Parse( const char *data, size_t size, const char *filename,
+		unsigned short *memory, unsigned first_line = 0 );
+
+	//
+	// Name:	Detect
+	//
+	// Returns:	The format of an image held in memory.
+	//
+	static EFormat Detect( const char *data, size_t size );
+
+protected: // Utility functions
+
+	//
+	// Name:	Map
+	//
+	// Description:	Maps a file, or reads it if it cannot be mapped.
+	// Arguments:	The file, and where to store the address and size
+	//		of its contents
+	// Exceptions:	Throws a CErrorException (S1001) if it cannot be
+	//		read.
+	// Modifies:	m_file, m_buffer
+	//
+	void Map( const char *filename, const char **data, size_t *size );
+
+protected: // Attributes
+
+	CMappedFile	m_file;		// The file being loaded, if mapped
+
+	std::string	m_buffer;	// Or its contents, if not
+};
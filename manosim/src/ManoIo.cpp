@@ -0,0 +1,41 @@
+// File:	ManoIo.cpp
+// Description:
+//		The character device interface seen by the Mano simulator.
+//		It stands in for the io_* ports of synth/src/main.v: the 8-bit
+//		INPR register with its FGI flag, and the 8-bit OUTR register
+//		with its FGO flag.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "ManoIo.hpp"
+
+//
+// Name:	(constructor)
+//
+CManoIo::CManoIo() {
+
+	m_stop_requested = false;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CManoIo::~CManoIo() {
+} // (destructor)
+
+//
+// Name:	Flush
+//
+void CManoIo::Flush() {
+} // Flush
+
+//
+// Name:	StopRequested
+//
+bool CManoIo::StopRequested() const {
+
+	return m_stop_requested;
+
+} // StopRequested
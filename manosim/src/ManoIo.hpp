@@ -0,0 +1,100 @@
+// File:	ManoIo.hpp
+// Description:
+//		The character device interface seen by the Mano simulator.
+//		It stands in for the io_* ports of synth/src/main.v: the 8-bit
+//		INPR register with its FGI flag, and the 8-bit OUTR register
+//		with its FGO flag.
+// Usage:
+//		Derive from CManoIo and attach an instance to a CManoSimulator
+//		with SetIo.  The simulator only calls into the device when it
+//		executes an input/output instruction, or when it samples the
+//		flags for an interrupt while IEN is set.  Every call carries
+//		the current clock cycle so that devices can time their events.
+//		A device that wants the run to end (for example because its
+//		input is exhausted) sets m_stop_requested.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+class CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CManoIo object
+	// Modifies:	m_stop_requested
+	//
+	CManoIo();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CManoIo object.
+	//
+	virtual ~CManoIo();
+
+public:	// Flags
+
+	//
+	// Name:	GetFgi
+	//
+	// Description:	Samples the character input flag.
+	// Arguments:	The current clock cycle
+	// Returns:	true if a character is waiting in INPR.
+	//
+	virtual bool GetFgi( unsigned long long cycle ) = 0;
+
+	//
+	// Name:	GetFgo
+	//
+	// Description:	Samples the character output flag.
+	// Arguments:	The current clock cycle
+	// Returns:	true if OUTR is ready to accept a character.
+	//
+	virtual bool GetFgo( unsigned long long cycle ) = 0;
+
+public:	// Transfers
+
+	//
+	// Name:	Input
+	//
+	// Description:	Performs the INP transfer: reads INPR and clears FGI.
+	// Arguments:	The current clock cycle
+	// Returns:	The character in INPR.
+	//
+	virtual unsigned char Input( unsigned long long cycle ) = 0;
+
+	//
+	// Name:	Output
+	//
+	// Description:	Performs the OUT transfer: loads OUTR and clears FGO.
+	// Arguments:	The character to output, and the current clock cycle
+	//
+	virtual void Output( unsigned char character,
+		unsigned long long cycle ) = 0;
+
+	//
+	// Name:	Flush
+	//
+	// Description:	Pushes any buffered output to its destination.  The
+	//		default implementation does nothing.
+	//
+	virtual void Flush();
+
+public:	// Accessors
+
+	//
+	// Name:	StopRequested
+	//
+	// Returns:	true if the device asked for the run to end.
+	//
+	bool StopRequested() const;
+
+protected: // Attributes
+
+	bool	m_stop_requested;	// Set by the device to end the run
+};
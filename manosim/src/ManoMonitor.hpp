@@ -0,0 +1,64 @@
+// File:	ManoMonitor.hpp
+// Description:
+//		The interface through which tools watch a simulation one
+//		retired instruction at a time.
+// Usage:
+//		Derive from CManoMonitor, implement Retire, and attach an
+//		instance to a CManoSimulator with AddMonitor.  The simulator
+//		fills in an SRetire record only while at least one monitor is
+//		attached, so an unmonitored run pays nothing for this.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+// SRetire::events bits:
+#define RETIRE_INPUT		0x01	// INP consumed a character
+#define RETIRE_OUTPUT		0x02	// OUT produced a character
+#define RETIRE_INTERRUPT	0x04	// The interrupt cycle followed
+
+// Most stores a single instruction can make (its own, and the return
+// address saved by the interrupt cycle):
+#define RETIRE_MAX_STORES	2
+
+// Everything that one instruction did:
+struct SRetire {
+	unsigned long long index;	// Instruction number, from 0
+	unsigned long long cycle;	// Clock cycle after it retired
+	unsigned short	pc;		// Its address
+	unsigned short	word;		// The instruction word
+	unsigned short	next_pc;	// Address of the next instruction
+	unsigned short	ac;		// AC after it retired
+	unsigned char	e;		// E after it retired
+	unsigned char	ien;		// IEN after it retired
+	unsigned char	cycles;		// Clock cycles it took
+	unsigned char	events;		// RETIRE_* bits
+	unsigned char	character;	// The character moved by INP or OUT
+	unsigned char	store_count;	// Number of stores made
+	unsigned short	store_address[RETIRE_MAX_STORES]; // Stored addresses
+	unsigned short	store_value[RETIRE_MAX_STORES];   // Stored words
+};
+
+class CManoMonitor {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CManoMonitor object.
+	//
+	virtual ~CManoMonitor() {}
+
+public:	// Notification
+
+	//
+	// Name:	Retire
+	//
+	// Description:	Called after every instruction the simulator
+	//		executes.
+	// Arguments:	What the instruction did
+	//
+	virtual void Retire( const SRetire &retire ) = 0;
+};
@@ -0,0 +1,893 @@
+// File:	ManoSimulator.cpp
+// Description:
+//		Instruction-level simulator for the Mano machine as built in
+//		synth/src/main.v.  Each instruction is charged the number of
+//		clock cycles the main.v sequencer spends on it, counted from
+//		one par_sc_instexec state to the next, so cycle totals match
+//		an RTL run of the same image.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "ManoSimulator.hpp"
+#include "ImageLoader.hpp"
+#include "MemoryImage.hpp"
+#include "StringList.hpp"
+
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// Clock cycles of the memory-reference instructions (direct, then
+// indirect), in sequencer states from par_sc_instexec back to it:
+//	AND/ADD/LDA	instexec, Xwait, Xexec
+//	STA, BSA	instexec, instreq, instwait
+//	BUN		instexec, instwait
+//	ISZ		instexec, iszwait, iszexec, instreq, instwait
+// The indirect forms add the iXwait and iXexec states.
+static const unsigned char memory_cycles[14] = {
+	3, 3, 3, 3, 2, 3, 5,
+	5, 5, 5, 5, 4, 5, 7
+};
+
+// Whole-word register-reference and input/output instructions:
+static const struct {
+	unsigned short word;
+	unsigned char operation;
+} register_operations[] = {
+	{ 0x7800, CManoSimulator::op_cla },
+	{ 0x7400, CManoSimulator::op_cle },
+	{ 0x7200, CManoSimulator::op_cma },
+	{ 0x7100, CManoSimulator::op_cme },
+	{ 0x7080, CManoSimulator::op_cir },
+	{ 0x7040, CManoSimulator::op_cil },
+	{ 0x7020, CManoSimulator::op_inc },
+	{ 0x7010, CManoSimulator::op_spa },
+	{ 0x7008, CManoSimulator::op_sna },
+	{ 0x7004, CManoSimulator::op_sza },
+	{ 0x7002, CManoSimulator::op_sze },
+	{ 0x7001, CManoSimulator::op_hlt },
+	{ 0xF800, CManoSimulator::op_inp },
+	{ 0xF400, CManoSimulator::op_out },
+	{ 0xF200, CManoSimulator::op_ski },
+	{ 0xF100, CManoSimulator::op_sko },
+	{ 0xF080, CManoSimulator::op_ion },
+	{ 0xF040, CManoSimulator::op_iof }
+};
+
+//
+// Name:	(constructor)
+//
+CManoSimulator::CManoSimulator() {
+
+	m_io = 0;
+	m_retire.store_count = 0;
+
+	memset( m_read_watches, 0, sizeof( m_read_watches ) );
+	memset( m_write_watches, 0, sizeof( m_write_watches ) );
+	m_read_pages = m_write_pages = 0;
+	m_watch_hit = false;
+
+	ClearMemory();
+	Reset();
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CManoSimulator::~CManoSimulator() {
+} // (destructor)
+
+//
+// Name:	Reset
+//
+void CManoSimulator::Reset() {
+
+	m_ac = 0;
+	m_e = false;
+	m_ien = false;
+	m_pc = 0;
+	m_halted = false;
+	m_stop = false;
+	m_instructions = 0;
+
+	// main.v starts in par_sc_instwait, one cycle before the first
+	// instruction executes:
+	m_cycles = 1;
+
+} // Reset
+
+//
+// Name:	ClearMemory
+//
+void CManoSimulator::ClearMemory() {
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		WriteMemory( (unsigned short)address, 0 );
+	}
+
+} // ClearMemory
+
+//
+// Name:	LoadFromFile
+//
+void CManoSimulator::LoadFromFile( const char *filename ) {
+
+	CImageLoader loader;
+	CMemoryImage segments;
+
+	loader.Load( filename, segments );
+	LoadImage( segments );
+
+} // LoadFromFile
+
+//
+// Name:	LoadFromList
+//
+void CManoSimulator::LoadFromList( const CStringList &image,
+	const char *filename )
+{
+	CMemoryImage segments;
+
+	ReadImage( image, filename, segments );
+	LoadImage( segments );
+
+} // LoadFromList
+
+//
+// Name:	LoadImage
+//
+void CManoSimulator::LoadImage( const CMemoryImage &image ) {
+
+	if( image.GetEnd() > MANO_MEMORY_SIZE ) {
+		throw CErrorException( "", 0, "S1003",
+			"Addresses must be between 000 and FFF",
+			CErrorException::ERROR );
+	}
+
+	for( size_t segment = 0; segment < image.GetSegmentCount();
+		segment++ )
+	{
+		const CMemoryImage::SSegment &stored = image.GetSegment( segment );
+
+		for( size_t word = 0; word < stored.words.size(); word++ ) {
+			WriteMemory( (unsigned short)(stored.start + word),
+				stored.words[word] );
+		}
+	}
+
+} // LoadImage
+
+//
+// Name:	ReadImage
+//
+void CManoSimulator::ReadImage( const CStringList &lines,
+	const char *filename, CMemoryImage &image )
+{
+	string text;
+
+	for( unsigned line_number = 0; line_number < lines.size();
+		line_number++ )
+	{
+		text += lines[line_number];
+		text += '\n';
+	}
+
+	CImageLoader::Parse( text.data(), text.size(), filename, image );
+
+} // ReadImage
+
+//
+// Name:	SetIo
+//
+void CManoSimulator::SetIo( CManoIo *io ) {
+
+	m_io = io;
+
+} // SetIo
+
+//
+// Name:	AddMonitor
+//
+void CManoSimulator::AddMonitor( CManoMonitor *monitor ) {
+
+	m_monitors.push_back( monitor );
+
+} // AddMonitor
+
+//
+// Name:	RemoveMonitor
+//
+void CManoSimulator::RemoveMonitor( CManoMonitor *monitor ) {
+
+	for( vector<CManoMonitor *>::iterator i = m_monitors.begin();
+		i != m_monitors.end();
+		i++ )
+	{
+		if( *i == monitor ) {
+			m_monitors.erase( i );
+			break;
+		}
+	}
+
+} // RemoveMonitor
+
+//
+// Name:	Load
+//
+inline unsigned short CManoSimulator::Load( unsigned short address ) {
+
+	if( (m_read_pages >> (address >> WATCH_PAGE_SHIFT)) & 1 ) {
+		Watch( address, m_memory[address], m_memory[address], false );
+	}
+	return m_memory[address];
+
+} // Load
+
+//
+// Name:	Step
+//
+bool CManoSimulator::Step() {
+
+	if( m_halted ) {
+		return false;
+	}
+
+	const unsigned short pc = m_pc;
+	const unsigned short word = m_memory[pc];
+	const unsigned long long start_cycle = m_cycles;
+	const SDecoded decoded = m_decoded[pc];
+	unsigned short address = decoded.address;
+	unsigned short next = (pc + 1) & 0xFFF;
+	unsigned char events = 0;
+
+	m_retire.store_count = 0;
+
+	// tsk_fetch samples the interrupt request before the instruction
+	// has changed IEN or the flags:
+	bool interrupt = m_ien && (GetFgi() || GetFgo());
+
+	switch( decoded.operation ) {
+
+	// Memory-reference instructions.  The indirect forms fetch the
+	// effective address and fall through to the direct form.
+	case op_and_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_and:
+		m_ac &= Load( address );
+		break;
+
+	case op_add_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_add:
+		{
+			const unsigned long sum = (unsigned long)m_ac
+				+ Load( address );
+			m_ac = (unsigned short)sum;
+			m_e = (sum & 0x10000) != 0;
+		}
+		break;
+
+	case op_lda_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_lda:
+		m_ac = Load( address );
+		break;
+
+	case op_sta_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_sta:
+		Store( address, m_ac );
+		break;
+
+	case op_bun_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_bun:
+		next = address;
+		break;
+
+	case op_bsa_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_bsa:
+		Store( address, next );
+		next = (address + 1) & 0xFFF;
+		break;
+
+	case op_isz_i:
+		address = Load( address ) & 0xFFF;
+		// Fall through
+	case op_isz:
+		{
+			const unsigned short value =
+				(unsigned short)(Load( address ) + 1);
+			Store( address, value );
+			if( value == 0 ) {
+				next = (next + 1) & 0xFFF;
+			}
+		}
+		break;
+
+	// Register-reference instructions:
+	case op_cla:
+		m_ac = 0;
+		break;
+	case op_cle:
+		m_e = false;
+		break;
+	case op_cma:
+		m_ac = (unsigned short)~m_ac;
+		break;
+	case op_cme:
+		m_e = !m_e;
+		break;
+	case op_cir:
+		{
+			const bool e = (m_ac & 1) != 0;
+			m_ac = (unsigned short)((m_ac >> 1) | (m_e ? 0x8000 : 0));
+			m_e = e;
+		}
+		break;
+	case op_cil:
+		{
+			const bool e = (m_ac & 0x8000) != 0;
+			m_ac = (unsigned short)((m_ac << 1) | (m_e ? 1 : 0));
+			m_e = e;
+		}
+		break;
+	case op_inc:
+		m_ac++;
+		break;
+	case op_spa:
+		if( !(m_ac & 0x8000) ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_sna:
+		if( m_ac & 0x8000 ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_sza:
+		if( m_ac == 0 ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_sze:
+		if( !m_e ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_hlt:
+		m_halted = true;
+		interrupt = false;
+		break;
+
+	// Input-output instructions:
+	case op_inp:
+		if( m_io ) {
+			m_ac = (unsigned short)((m_ac & 0xFF00)
+				| m_io->Input( m_cycles ));
+			m_stop = m_io->StopRequested();
+		}
+		events = RETIRE_INPUT;
+		break;
+	case op_out:
+		if( m_io ) {
+			m_io->Output( (unsigned char)m_ac, m_cycles );
+			m_stop = m_io->StopRequested();
+		}
+		events = RETIRE_OUTPUT;
+		break;
+	case op_ski:
+		if( GetFgi() ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_sko:
+		if( GetFgo() ) {
+			next = (next + 1) & 0xFFF;
+		}
+		break;
+	case op_ion:
+		m_ien = true;
+		break;
+	case op_iof:
+		m_ien = false;
+		break;
+
+	case op_nop:
+		break;
+
+	// A breakpoint: stop before the word executes.
+	case op_break:
+		m_stop = true;
+		return true;
+	}
+
+	m_pc = next;
+	m_cycles += decoded.cycles;
+
+	// The interrupt cycle replaces the next fetch: save the return
+	// address at 0 and continue at 1.
+	if( interrupt ) {
+		m_cycles += GetInterruptCycles( decoded.operation );
+		m_ien = false;
+		Store( 0, m_pc );
+		m_pc = 1;
+		events |= RETIRE_INTERRUPT;
+	}
+
+	// Tell the monitors what happened:
+	if( !m_monitors.empty() ) {
+		m_retire.index = m_instructions;
+		m_retire.cycle = m_cycles;
+		m_retire.cycles = (unsigned char)(m_cycles - start_cycle);
+		m_retire.pc = pc;
+		m_retire.word = word;
+		m_retire.next_pc = m_pc;
+		m_retire.ac = m_ac;
+		m_retire.e = m_e;
+		m_retire.ien = m_ien;
+		m_retire.events = events;
+		m_retire.character = (unsigned char)m_ac;
+
+		for( vector<CManoMonitor *>::iterator i = m_monitors.begin();
+			i != m_monitors.end();
+			i++ )
+		{
+			(*i)->Retire( m_retire );
+		}
+	}
+
+	m_instructions++;
+
+	return !m_halted;
+
+} // Step
+
+//
+// Name:	Run
+//
+unsigned long long CManoSimulator::Run( unsigned long long max_instructions ) {
+
+	const unsigned long long start = m_instructions;
+
+	// Count what executed, which a breakpoint does not:
+	m_stop = false;
+	while( m_instructions - start < max_instructions && !m_halted
+		&& !m_stop )
+	{
+		Step();
+	}
+
+	return m_instructions - start;
+
+} // Run
+
+//
+// Name:	IsStopped
+//
+bool CManoSimulator::IsStopped() const {
+	return m_stop;
+} // IsStopped
+
+//
+// Name:	StepOver
+//
+bool CManoSimulator::StepOver() {
+
+	const unsigned short pc = m_pc;
+	if( !IsBreakpoint( pc ) ) {
+		return Step();
+	}
+
+	// Execute the word itself, then put the breakpoint back (the word
+	// may have stored over itself):
+	Decode( m_memory[pc], &m_decoded[pc] );
+	const bool running = Step();
+	m_decoded[pc].operation = op_break;
+	return running;
+
+} // StepOver
+
+//
+// Name:	SetBreakpoint
+//
+void CManoSimulator::SetBreakpoint( unsigned short address ) {
+
+	m_decoded[address & 0xFFF].operation = op_break;
+
+} // SetBreakpoint
+
+//
+// Name:	ClearBreakpoint
+//
+void CManoSimulator::ClearBreakpoint( unsigned short address ) {
+
+	address &= 0xFFF;
+	Decode( m_memory[address], &m_decoded[address] );
+
+} // ClearBreakpoint
+
+//
+// Name:	IsBreakpoint
+//
+bool CManoSimulator::IsBreakpoint( unsigned short address ) const {
+
+	return m_decoded[address & 0xFFF].operation == op_break;
+
+} // IsBreakpoint
+
+//
+// Name:	AtBreakpoint
+//
+bool CManoSimulator::AtBreakpoint() const {
+
+	return !m_halted && IsBreakpoint( m_pc );
+
+} // AtBreakpoint
+
+//
+// Name:	SetWatchpoint
+//
+void CManoSimulator::SetWatchpoint( unsigned short first, unsigned short last,
+	bool read, bool write )
+{
+
+	first &= 0xFFF;
+	last &= 0xFFF;
+	for( int address = first; address <= last; address++ ) {
+		const unsigned char bit = (unsigned char)(1 << (address & 7));
+		if( read ) {
+			m_read_watches[address >> 3] |= bit;
+		}
+		if( write ) {
+			m_write_watches[address >> 3] |= bit;
+		}
+	}
+	MapPages( first, last );
+
+} // SetWatchpoint
+
+//
+// Name:	ClearWatchpoint
+//
+void CManoSimulator::ClearWatchpoint( unsigned short first,
+	unsigned short last, bool read, bool write )
+{
+
+	first &= 0xFFF;
+	last &= 0xFFF;
+	for( int address = first; address <= last; address++ ) {
+		const unsigned char bit = (unsigned char)(1 << (address & 7));
+		if( read ) {
+			m_read_watches[address >> 3] &= (unsigned char)~bit;
+		}
+		if( write ) {
+			m_write_watches[address >> 3] &= (unsigned char)~bit;
+		}
+	}
+	MapPages( first, last );
+
+} // ClearWatchpoint
+
+//
+// Name:	IsWatched
+//
+bool CManoSimulator::IsWatched( unsigned short address, bool write ) const {
+
+	address &= 0xFFF;
+	const unsigned char *watches = write ? m_write_watches
+		: m_read_watches;
+	return (watches[address >> 3] >> (address & 7)) & 1;
+
+} // IsWatched
+
+//
+// Name:	TakeWatchHit
+//
+bool CManoSimulator::TakeWatchHit( SWatchHit *hit ) {
+
+	if( !m_watch_hit ) {
+		return false;
+	}
+
+	*hit = m_hit;
+	m_watch_hit = false;
+	return true;
+
+} // TakeWatchHit
+
+//
+// Name:	SaveState
+//
+void CManoSimulator::SaveState( SState *state ) const {
+
+	memcpy( state->memory, m_memory, sizeof( m_memory ) );
+	state->ac = m_ac;
+	state->pc = m_pc;
+	state->e = m_e;
+	state->ien = m_ien;
+	state->halted = m_halted;
+	state->cycles = m_cycles;
+	state->instructions = m_instructions;
+
+} // SaveState
+
+//
+// Name:	RestoreState
+//
+void CManoSimulator::RestoreState( const SState &state ) {
+
+	// A checkpoint differs from the present in a few words:
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		if( m_memory[address] != state.memory[address] ) {
+			WriteMemory( (unsigned short)address,
+				state.memory[address] );
+		}
+	}
+	m_ac = state.ac;
+	m_pc = state.pc;
+	m_e = state.e;
+	m_ien = state.ien;
+	m_halted = state.halted;
+	m_cycles = state.cycles;
+	m_instructions = state.instructions;
+	m_stop = false;
+
+} // RestoreState
+
+//
+// Name:	GetAC
+//
+unsigned short CManoSimulator::GetAC() const {
+	return m_ac;
+} // GetAC
+
+//
+// Name:	GetE
+//
+bool CManoSimulator::GetE() const {
+	return m_e;
+} // GetE
+
+//
+// Name:	GetPC
+//
+unsigned short CManoSimulator::GetPC() const {
+	return m_pc;
+} // GetPC
+
+//
+// Name:	GetIEN
+//
+bool CManoSimulator::GetIEN() const {
+	return m_ien;
+} // GetIEN
+
+//
+// Name:	IsHalted
+//
+bool CManoSimulator::IsHalted() const {
+	return m_halted;
+} // IsHalted
+
+//
+// Name:	SetRegisters
+//
+void CManoSimulator::SetRegisters( unsigned short ac, bool e, bool ien,
+	unsigned short pc )
+{
+
+	m_ac = ac;
+	m_e = e;
+	m_ien = ien;
+	m_pc = pc & 0xFFF;
+
+} // SetRegisters
+
+//
+// Name:	GetCycles
+//
+unsigned long long CManoSimulator::GetCycles() const {
+	return m_cycles;
+} // GetCycles
+
+//
+// Name:	GetInstructions
+//
+unsigned long long CManoSimulator::GetInstructions() const {
+	return m_instructions;
+} // GetInstructions
+
+//
+// Name:	ReadMemory
+//
+unsigned short CManoSimulator::ReadMemory( unsigned short address ) const {
+
+	return m_memory[address & 0xFFF];
+
+} // ReadMemory
+
+//
+// Name:	WriteMemory
+//
+void CManoSimulator::WriteMemory( unsigned short address,
+	unsigned short value )
+{
+
+	address &= 0xFFF;
+	const bool breakpoint = IsBreakpoint( address );
+	m_memory[address] = value;
+	Decode( value, &m_decoded[address] );
+	if( breakpoint ) {
+		m_decoded[address].operation = op_break;
+	}
+
+} // WriteMemory
+
+//
+// Name:	Decode
+//
+void CManoSimulator::Decode( unsigned short word, SDecoded *decoded ) {
+
+	const unsigned opcode = (word >> 12) & 7;
+
+	decoded->address = word & 0xFFF;
+
+	// Memory-reference instructions:
+	if( opcode != 7 ) {
+		const unsigned operation = (word & 0x8000)
+			? opcode + op_and_i : opcode;
+
+		decoded->operation = (unsigned char)operation;
+		decoded->cycles = memory_cycles[operation];
+		return;
+	}
+
+	// Register-reference and input/output instructions must match
+	// exactly; anything else falls through the sequencer untouched:
+	decoded->operation = op_nop;
+	decoded->cycles = 2;
+	for( unsigned index = 0;
+		index < sizeof(register_operations)/sizeof(register_operations[0]);
+		index++ )
+	{
+		if( register_operations[index].word == word ) {
+			decoded->operation = register_operations[index].operation;
+			break;
+		}
+	}
+
+	// HLT stops the sequencer in par_sc_instexec:
+	if( decoded->operation == op_hlt ) {
+		decoded->cycles = 1;
+	}
+
+} // Decode
+
+//
+// Name:	GetInterruptCycles
+//
+unsigned CManoSimulator::GetInterruptCycles( unsigned char operation ) {
+
+	if( operation <= op_lda
+		|| (operation >= op_and_i && operation <= op_lda_i) )
+	{
+		return 2;
+	}
+
+	return 1;
+
+} // GetInterruptCycles
+
+//
+// Name:	Store
+//
+void CManoSimulator::Store( unsigned short address, unsigned short value ) {
+
+	if( (m_write_pages >> (address >> WATCH_PAGE_SHIFT)) & 1 ) {
+		Watch( address, m_memory[address], value, true );
+	}
+
+	const bool breakpoint = m_decoded[address].operation == op_break;
+	m_memory[address] = value;
+	Decode( value, &m_decoded[address] );
+	if( breakpoint ) {
+		m_decoded[address].operation = op_break;
+	}
+
+	if( m_retire.store_count < RETIRE_MAX_STORES ) {
+		m_retire.store_address[m_retire.store_count] = address;
+		m_retire.store_value[m_retire.store_count] = value;
+		m_retire.store_count++;
+	}
+
+} // Store
+
+//
+// Name:	Watch
+//
+void CManoSimulator::Watch( unsigned short address, unsigned short old_value,
+	unsigned short new_value, bool write )
+{
+
+	if( !IsWatched( address, write ) ) {
+		return;
+	}
+
+	// Keep the first hit until it is taken:
+	if( !m_watch_hit ) {
+		m_hit.address = address;
+		m_hit.pc = m_pc;
+		m_hit.old_value = old_value;
+		m_hit.new_value = new_value;
+		m_hit.write = write;
+		m_watch_hit = true;
+	}
+	m_stop = true;
+
+} // Watch
+
+//
+// Name:	MapPages
+//
+void CManoSimulator::MapPages( unsigned short first, unsigned short last ) {
+
+	for( int page = first >> WATCH_PAGE_SHIFT;
+		page <= last >> WATCH_PAGE_SHIFT;
+		page++ )
+	{
+		const unsigned short bit = (unsigned short)(1 << page);
+		const int start = (page << WATCH_PAGE_SHIFT) / 8;
+		bool read = false, write = false;
+
+		for( int i = start; i < start + WATCH_PAGE_SIZE / 8; i++ ) {
+			read = read || m_read_watches[i];
+			write = write || m_write_watches[i];
+		}
+		m_read_pages = (unsigned short)(read ? m_read_pages | bit
+			: m_read_pages & ~bit);
+		m_write_pages = (unsigned short)(write ? m_write_pages | bit
+			: m_write_pages & ~bit);
+	}
+
+} // MapPages
+
+//
+// Name:	GetFgi
+//
+bool CManoSimulator::GetFgi() {
+
+	if( !m_io ) {
+		return false;
+	}
+
+	const bool fgi = m_io->GetFgi( m_cycles );
+	m_stop = m_io->StopRequested();
+	return fgi;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CManoSimulator::GetFgo() {
+
+	if( !m_io ) {
+		return true;
+	}
+
+	const bool fgo = m_io->GetFgo( m_cycles );
+	m_stop = m_io->StopRequested();
+	return fgo;
+
+} // GetFgo
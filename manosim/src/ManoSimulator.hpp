@@ -0,0 +1,526 @@
+// File:	ManoSimulator.hpp
+// Description:
+//		Instruction-level simulator for the Mano machine as built in
+//		synth/src/main.v.  Each instruction is charged the number of
+//		clock cycles the main.v sequencer spends on it, counted from
+//		one par_sc_instexec state to the next, so cycle totals match
+//		an RTL run of the same image.
+// Usage:
+//		1. create one instance of this class
+//		2. call LoadFromFile with the output of manoasm (normal,
+//		   verilog, coe or binary format), or LoadImage with an image
+//		   already read
+//		3. optionally attach a character device with SetIo
+//		4. call Step to execute one instruction, or Run to execute
+//		   until the processor halts
+//		5. to start over, call Reset (and ClearMemory to start from an
+//		   empty memory).
+//
+// Notes:
+//
+//		Register and input/output instructions are matched against the
+//		whole word, as main.v does; words that combine several of them
+//		execute as no-operations.
+//
+//		BSA saves the address following the BSA in the routine's first
+//		word, as the textbook specifies.  main.v saves the address of
+//		the BSA itself.
+//
+//		Every instruction is predecoded into m_decoded.  Stores keep
+//		the table coherent, so self-modifying programs run correctly.
+//
+//		A breakpoint replaces the operation of its predecoded word
+//		with op_break, which stops Run before the word executes; the
+//		dispatch already switches on the operation, so breakpoints
+//		cost nothing until one is hit.  Stores to a breakpoint keep
+//		it.  StepOver executes the word under a breakpoint.
+//
+//		Watchpoints are kept in a bitmap for each page of
+//		WATCH_PAGE_SIZE words, with a bit in m_read_pages and
+//		m_write_pages for each page that has a watched word.  Stores
+//		(and, while a read watchpoint is set, reads) look at a page's
+//		bitmap only when its bit is set, so unwatched pages cost one
+//		test of a register-sized mask.  A hit stops Run once the
+//		instruction has retired, and is kept for TakeWatchHit.
+//		WriteMemory and the instruction fetch do not hit.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+#include "ManoMonitor.hpp"
+#include "ErrorException.hpp"
+
+#include <vector>
+
+class CStringList;
+class CMemoryImage;
+
+// Number of words in the Mano machine memory:
+#define MANO_MEMORY_SIZE	4096
+
+// Words in each page of the watchpoint bitmaps, and the number of pages:
+#define WATCH_PAGE_SHIFT	8
+#define WATCH_PAGE_SIZE		(1 << WATCH_PAGE_SHIFT)
+#define WATCH_PAGES		(MANO_MEMORY_SIZE >> WATCH_PAGE_SHIFT)
+
+class CManoSimulator {
+public: // Enumerated types
+
+	// Predecoded operations.  Memory-reference operations come in direct
+	// and indirect flavors.
+	enum EOperation {
+		op_and, op_add, op_lda, op_sta, op_bun, op_bsa, op_isz,
+		op_and_i, op_add_i, op_lda_i, op_sta_i, op_bun_i, op_bsa_i,
+		op_isz_i,
+		op_cla, op_cle, op_cma, op_cme, op_cir, op_cil, op_inc,
+		op_spa, op_sna, op_sza, op_sze, op_hlt,
+		op_inp, op_out, op_ski, op_sko, op_ion, op_iof,
+		op_nop,
+		op_break
+	};
+
+	// A predecoded memory word:
+	struct SDecoded {
+		unsigned char	operation;	// One of EOperation
+		unsigned char	cycles;		// main.v clock cycles taken
+		unsigned short	address;	// Address field (12 bits)
+	};
+
+	// A watchpoint hit:
+	struct SWatchHit {
+		unsigned short	address;	// The word read or written
+		unsigned short	pc;		// The instruction that did it
+		unsigned short	old_value;	// The word before
+		unsigned short	new_value;	// The word after (as before,
+						// for a read)
+		bool		write;		// true for a store
+	};
+
+	// Everything a run depends on, apart from the device, the
+	// breakpoints and the watchpoints:
+	struct SState {
+		unsigned short	memory[MANO_MEMORY_SIZE];
+		unsigned short	ac;
+		unsigned short	pc;
+		bool		e;
+		bool		ien;
+		bool		halted;
+		unsigned long long cycles;
+		unsigned long long instructions;
+	};
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CManoSimulator object with a cleared
+	//		memory and no character device.
+	//
+	CManoSimulator();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CManoSimulator object.  The character
+	//		device is not destroyed.
+	//
+	~CManoSimulator();
+
+public:	// Initialization
+
+	//
+	// Name:	Reset
+	//
+	// Description:	Resets the registers to the values of the initial
+	//		block of main.v.  Memory is not changed.
+	// Modifies:	m_ac, m_e, m_ien, m_pc, m_halted, m_cycles,
+	//		m_instructions
+	//
+	void Reset();
+
+	//
+	// Name:	ClearMemory
+	//
+	// Description:	Sets every word of memory to 0.
+	// Modifies:	m_memory, m_decoded
+	//
+	void ClearMemory();
+
+	//
+	// Name:	LoadFromFile
+	//
+	// Description:	Loads an image produced by manoasm in any of its
+	//		formats, through CImageLoader.
+	// Arguments:	The image file to read
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		read (S1001), if a line is not an image line (S1002),
+	//		if an address is outside of 000-FFF (S1003), if a coe
+	//		radix is not 16 (S1004), or if a binary image is
+	//		damaged (S1005).  A file in error loads nothing.
+	//
+	void LoadFromFile( const char *filename );
+
+	//
+	// Name:	LoadFromList
+	//
+	// Description:	Loads an image that is already in memory, such as
+	//		the output list of CManoAssembler::AssembleFromFile.
+	// Arguments:	The image lines, and the file name to give in error
+	//		messages
+	// Exceptions:	As LoadFromFile, except for S1001.  A line in error
+	//		loads nothing.
+	//
+	void LoadFromList( const CStringList &image, const char *filename );
+
+	//
+	// Name:	LoadImage
+	//
+	// Description:	Loads the segments of an image, such as one read
+	//		once with ReadImage and loaded for each of many runs.
+	// Arguments:	The image
+	// Exceptions:	Throws a CErrorException (S1003) if a word lies
+	//		outside of 000-FFF; nothing is loaded then.
+	//
+	void LoadImage( const CMemoryImage &image );
+
+	//
+	// Name:	ReadImage
+	//
+	// Description:	Reads the lines of an image into segments, without
+	//		loading them.
+	// Arguments:	The image lines, the file name to give in error
+	//		messages, and the image to store the words to
+	// Exceptions:	As LoadFromList
+	//
+	static void ReadImage( const CStringList &lines, const char *filename,
+		CMemoryImage &image );
+
+	//
+	// Name:	SetIo
+	//
+	// Description:	Attaches a character device.  Without one, FGI
+	//		reads 0, FGO reads 1 and output is discarded.
+	// Arguments:	The device to attach, or 0 to detach
+	// Modifies:	m_io
+	//
+	void SetIo( CManoIo *io );
+
+	//
+	// Name:	AddMonitor
+	//
+	// Description:	Attaches a monitor, which is then told about every
+	//		instruction executed.
+	// Arguments:	The monitor to attach
+	// Modifies:	m_monitors
+	//
+	void AddMonitor( CManoMonitor *monitor );
+
+	//
+	// Name:	RemoveMonitor
+	//
+	// Description:	Detaches a monitor.  It is not destroyed.
+	// Arguments:	The monitor to detach
+	// Modifies:	m_monitors
+	//
+	void RemoveMonitor( CManoMonitor *monitor );
+
+public:	// Execution
+
+	//
+	// Name:	Step
+	//
+	// Description:	Executes a single instruction, followed by the
+	//		interrupt cycle if an interrupt was requested while it
+	//		executed.  At a breakpoint, it executes nothing and
+	//		requests a stop.
+	// Returns:	false if the processor is halted.
+	//
+	bool Step();
+
+	//
+	// Name:	Run
+	//
+	// Description:	Executes instructions until the processor halts,
+	//		the character device requests a stop, a breakpoint is
+	//		reached, or the given number of instructions has been
+	//		executed.
+	// Arguments:	The maximum number of instructions to execute
+	// Returns:	The number of instructions executed.
+	//
+	unsigned long long Run( unsigned long long max_instructions );
+
+	//
+	// Name:	IsStopped
+	//
+	// Returns:	true if the device, a breakpoint or a watchpoint
+	//		stopped the last run.  A stop on its last instruction
+	//		counts, though the run returns its full count then.
+	//
+	bool IsStopped() const;
+
+	//
+	// Name:	StepOver
+	//
+	// Description:	Executes a single instruction as Step does, even if
+	//		a breakpoint stopped the processor there.
+	// Returns:	false if the processor is halted.
+	//
+	bool StepOver();
+
+public:	// Breakpoints
+
+	//
+	// Name:	SetBreakpoint / ClearBreakpoint
+	//
+	// Description:	Sets or clears a breakpoint at an address.
+	// Arguments:	The address
+	// Modifies:	m_decoded
+	//
+	void SetBreakpoint( unsigned short address );
+	void ClearBreakpoint( unsigned short address );
+
+	//
+	// Name:	IsBreakpoint
+	//
+	// Returns:	true if a breakpoint is set at an address.
+	//
+	bool IsBreakpoint( unsigned short address ) const;
+
+	//
+	// Name:	AtBreakpoint
+	//
+	// Returns:	true if the processor stopped at a breakpoint: one
+	//		is set at the PC, and the processor has not halted.
+	//
+	bool AtBreakpoint() const;
+
+public:	// Watchpoints
+
+	//
+	// Name:	SetWatchpoint / ClearWatchpoint
+	//
+	// Description:	Watches a range of words for reads, writes or
+	//		both, or stops watching it.
+	// Arguments:	The first and last address, and whether reads and
+	//		writes are (un)watched
+	// Modifies:	m_read_watches, m_write_watches, m_read_pages,
+	//		m_write_pages
+	//
+	void SetWatchpoint( unsigned short first, unsigned short last,
+		bool read, bool write );
+	void ClearWatchpoint( unsigned short first, unsigned short last,
+		bool read, bool write );
+
+	//
+	// Name:	IsWatched
+	//
+	// Returns:	true if an address is watched for writes (or for
+	//		reads).
+	//
+	bool IsWatched( unsigned short address, bool write ) const;
+
+	//
+	// Name:	TakeWatchHit
+	//
+	// Description:	Gives the first watchpoint hit since the last one
+	//		taken, and forgets it.
+	// Arguments:	Where to store the hit
+	// Returns:	false if there was none.
+	// Modifies:	m_watch_hit
+	//
+	bool TakeWatchHit( SWatchHit *hit );
+
+public:	// Checkpoints
+
+	//
+	// Name:	SaveState
+	//
+	// Description:	Copies the memory, the registers and the counts.
+	// Arguments:	Where to copy them
+	//
+	void SaveState( SState *state ) const;
+
+	//
+	// Name:	RestoreState
+	//
+	// Description:	Puts back a state saved by SaveState.  Only the
+	//		words that differ are decoded again, and breakpoints
+	//		are kept.
+	// Arguments:	The state
+	// Modifies:	Everything SaveState copies, and m_decoded
+	//
+	void RestoreState( const SState &state );
+
+public:	// Accessors
+
+	unsigned short GetAC() const;		// Accumulator
+	bool GetE() const;			// Extra carry flag
+	unsigned short GetPC() const;		// Next instruction address
+	bool GetIEN() const;			// Interrupt enable flag
+	bool IsHalted() const;			// true after HLT
+
+	//
+	// Name:	SetRegisters
+	//
+	// Description:	Sets the registers on behalf of a debugger.
+	// Arguments:	The accumulator, the E and IEN flags, and the
+	//		address of the next instruction
+	// Modifies:	m_ac, m_e, m_ien, m_pc
+	//
+	void SetRegisters( unsigned short ac, bool e, bool ien,
+		unsigned short pc );
+
+	//
+	// Name:	GetCycles
+	//
+	// Returns:	The number of main.v clock cycles simulated so far.
+	//
+	unsigned long long GetCycles() const;
+
+	//
+	// Name:	GetInstructions
+	//
+	// Returns:	The number of instructions executed so far.
+	//
+	unsigned long long GetInstructions() const;
+
+	//
+	// Name:	ReadMemory
+	//
+	// Returns:	The word stored at the given address.
+	//
+	unsigned short ReadMemory( unsigned short address ) const;
+
+	//
+	// Name:	WriteMemory
+	//
+	// Description:	Stores a word on behalf of the host (a loader or a
+	//		debugger); the program does not see this as a store.
+	//		A breakpoint at the address is kept.
+	// Arguments:	The address and the word to store
+	// Modifies:	m_memory, m_decoded
+	//
+	void WriteMemory( unsigned short address, unsigned short value );
+
+public:	// Decoding
+
+	//
+	// Name:	Decode
+	//
+	// Description:	Decodes a memory word the way the main.v sequencer
+	//		does.
+	// Arguments:	The word to decode, and the structure to fill in
+	//
+	static void Decode( unsigned short word, SDecoded *decoded );
+
+	//
+	// Name:	GetInterruptCycles
+	//
+	// Description:	Gives the clock cycles the interrupt cycle adds
+	//		after an operation.  AND, ADD and LDA fetch from their
+	//		wait state and pass through the par_sc_Xint states,
+	//		which costs one cycle more than the other operations.
+	// Arguments:	The operation (one of EOperation)
+	// Returns:	The number of extra clock cycles.
+	//
+	static unsigned GetInterruptCycles( unsigned char operation );
+
+protected: // Utility functions
+
+	//
+	// Name:	Store
+	//
+	// Description:	Stores a word on behalf of the program, keeping the
+	//		predecoded table coherent (and any breakpoint),
+	//		checks the write watchpoints, and records the store
+	//		for the monitors.
+	// Arguments:	The address and the word to store
+	// Modifies:	m_memory, m_decoded, m_retire
+	//
+	void Store( unsigned short address, unsigned short value );
+
+	//
+	// Name:	Load
+	//
+	// Description:	Reads a word on behalf of the program, checking
+	//		the read watchpoints.
+	// Arguments:	The address
+	// Returns:	The word.
+	//
+	unsigned short Load( unsigned short address );
+
+	//
+	// Name:	Watch
+	//
+	// Description:	Records a hit if a word of a watched page is
+	//		watched, and stops Run.
+	// Arguments:	The address, the word before and after, and true for
+	//		a store
+	// Modifies:	m_hit, m_watch_hit, m_stop
+	//
+	void Watch( unsigned short address, unsigned short old_value,
+		unsigned short new_value, bool write );
+
+	//
+	// Name:	MapPages
+	//
+	// Description:	Sets the page bits of the pages of a range from
+	//		their bitmaps.
+	// Arguments:	The first and last address
+	// Modifies:	m_read_pages, m_write_pages
+	//
+	void MapPages( unsigned short first, unsigned short last );
+
+	//
+	// Name:	GetFgi / GetFgo
+	//
+	// Returns:	The flags of the attached device, or the defaults if
+	//		there is none.
+	//
+	bool GetFgi();
+	bool GetFgo();
+
+protected: // Attributes
+
+	unsigned short	m_memory[MANO_MEMORY_SIZE];	// Main memory
+
+	SDecoded	m_decoded[MANO_MEMORY_SIZE];	// Predecoded memory
+
+	unsigned short	m_ac;		// Accumulator
+
+	bool		m_e;		// Extra carry flag
+
+	bool		m_ien;		// Interrupt enable flag
+
+	unsigned short	m_pc;		// Address of the next instruction
+
+	bool		m_halted;	// Set by HLT
+
+	bool		m_stop;		// Set when the device requests a stop,
+					// or a breakpoint or watchpoint is hit
+
+	// Watched words, a bit each, and the pages that have any:
+	unsigned char	m_read_watches[MANO_MEMORY_SIZE / 8];
+	unsigned char	m_write_watches[MANO_MEMORY_SIZE / 8];
+	unsigned short	m_read_pages;
+	unsigned short	m_write_pages;
+
+	SWatchHit	m_hit;		// The first hit not yet taken
+
+	bool		m_watch_hit;	// m_hit holds a hit
+
+	unsigned long long m_cycles;	// Clock cycles simulated
+
+	unsigned long long m_instructions; // Instructions executed
+
+	CManoIo		*m_io;		// The character device, or 0
+
+	std::vector<CManoMonitor *> m_monitors;	// Attached monitors
+
+	SRetire		m_retire;	// The instruction being retired
+};
@@ -0,0 +1,149 @@
+// File:	MappedFile.cpp
+// Description:
+//		A read-only memory mapping of a whole file.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// Name:	(constructor)
+//
+CMappedFile::CMappedFile() {
+
+	m_data = 0;
+	m_size = 0;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = 0;
+#endif
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CMappedFile::~CMappedFile() {
+
+	Close();
+
+} // (destructor)
+
+//
+// Name:	Open
+//
+bool CMappedFile::Open( const char *filename ) {
+
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+	if( m_file == INVALID_HANDLE_VALUE ) {
+		return false;
+	}
+
+	// Only disk files can be mapped:
+	LARGE_INTEGER size;
+	if( GetFileType( m_file ) != FILE_TYPE_DISK
+		|| !GetFileSizeEx( m_file, &size ) || size.QuadPart == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA( m_file, 0, PAGE_READONLY, 0, 0, 0 );
+	if( !m_mapping ) {
+		Close();
+		return false;
+	}
+
+	m_data = (const char *)MapViewOfFile( m_mapping, FILE_MAP_READ,
+		0, 0, 0 );
+	if( !m_data ) {
+		Close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+#else
+	const int fd = open( filename, O_RDONLY );
+	if( fd < 0 ) {
+		return false;
+	}
+
+	// Only regular files can be mapped:
+	struct stat status;
+	if( fstat( fd, &status ) != 0 || !S_ISREG( status.st_mode )
+		|| status.st_size == 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	void *data = mmap( 0, (size_t)status.st_size, PROT_READ, MAP_SHARED,
+		fd, 0 );
+	close( fd );
+	if( data == MAP_FAILED ) {
+		return false;
+	}
+	madvise( data, (size_t)status.st_size, MADV_SEQUENTIAL );
+
+	m_data = (const char *)data;
+	m_size = (size_t)status.st_size;
+#endif
+
+	return true;
+
+} // Open
+
+//
+// Name:	Close
+//
+void CMappedFile::Close() {
+
+#ifdef _WIN32
+	if( m_data ) {
+		UnmapViewOfFile( m_data );
+	}
+	if( m_mapping ) {
+		CloseHandle( m_mapping );
+	}
+	if( m_file != INVALID_HANDLE_VALUE ) {
+		CloseHandle( m_file );
+	}
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = 0;
+#else
+	if( m_data ) {
+		munmap( (void *)m_data, m_size );
+	}
+#endif
+
+	m_data = 0;
+	m_size = 0;
+
+} // Close
+
+//
+// Name:	GetData
+//
+const char *CMappedFile::GetData() const {
+	return m_data;
+} // GetData
+
+//
+// Name:	GetSize
+//
+size_t CMappedFile::GetSize() const {
+	return m_size;
+} // GetSize
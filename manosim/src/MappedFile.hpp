@@ -0,0 +1,84 @@
+// File:	MappedFile.hpp
+// Description:
+//		A read-only memory mapping of a whole file.
+// Usage:
+//		Call Open with a filename.  If it succeeds, GetData and
+//		GetSize describe the file contents until Close is called or
+//		the object is destroyed.  Open fails for anything that cannot
+//		be mapped (pipes, terminals, empty files); callers fall back
+//		to ordinary reads in that case.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include <cstddef>
+
+class CMappedFile {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CMappedFile object
+	//
+	CMappedFile();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Unmaps the file, if one is mapped.
+	//
+	~CMappedFile();
+
+public:	// Mapping
+
+	//
+	// Name:	Open
+	//
+	// Description:	Maps the given file for reading.
+	// Arguments:	The file to map
+	// Returns:	true if the file is mapped, or false if it could not
+	//		be opened or mapped.
+	// Modifies:	m_data, m_size
+	//
+	bool Open( const char *filename );
+
+	//
+	// Name:	Close
+	//
+	// Description:	Unmaps the file.  Does nothing if none is mapped.
+	// Modifies:	m_data, m_size
+	//
+	void Close();
+
+public:	// Accessors
+
+	//
+	// Name:	GetData
+	//
+	// Returns:	The first byte of the mapping, or 0 if none.
+	//
+	const char *GetData() const;
+
+	//
+	// Name:	GetSize
+	//
+	// Returns:	The size of the mapping in bytes.
+	//
+	size_t GetSize() const;
+
+protected: // Attributes
+
+	const char	*m_data;	// The mapped contents
+
+	size_t		m_size;		// The size of the mapping
+
+#ifdef _WIN32
+	void		*m_file;	// The file handle
+
+	void		*m_mapping;	// The file mapping handle
+#endif
+};
@@ -0,0 +1,221 @@
+// File:	Profiler.cpp
+// Description:
+//		A monitor that counts the instructions executed and the main.v
+//		clock cycles spent at every memory address.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Totals of one label's region:
+struct SRegion {
+	int			label;		// Label address, or -1
+	unsigned long long	count;		// Instructions
+	unsigned long long	cycles;		// Clock cycles
+};
+
+// Orders regions by cycles, most first, then by address:
+static bool HotterRegion( const SRegion &a, const SRegion &b ) {
+
+	if( a.cycles != b.cycles ) {
+		return a.cycles > b.cycles;
+	}
+	return a.label < b.label;
+
+} // HotterRegion
+
+// Gives a cycle count as a percentage of the total:
+static double Percent( unsigned long long cycles, unsigned long long total ) {
+
+	return total ? 100.0 * cycles / total : 0.0;
+
+} // Percent
+
+//
+// Name:	(constructor)
+//
+CProfiler::CProfiler() {
+
+	Reset();
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CProfiler::~CProfiler() {
+} // (destructor)
+
+//
+// Name:	Reset
+//
+void CProfiler::Reset() {
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		m_counts[address] = 0;
+		m_cycles[address] = 0;
+	}
+
+} // Reset
+
+//
+// Name:	Retire
+//
+void CProfiler::Retire( const SRetire &retire ) {
+
+	m_counts[retire.pc]++;
+	m_cycles[retire.pc] += retire.cycles;
+
+} // Retire
+
+//
+// Name:	GetCount
+//
+unsigned long long CProfiler::GetCount( unsigned short address ) const {
+	return m_counts[address & 0xFFF];
+} // GetCount
+
+//
+// Name:	GetCycles
+//
+unsigned long long CProfiler::GetCycles( unsigned short address ) const {
+	return m_cycles[address & 0xFFF];
+} // GetCycles
+
+//
+// Name:	WriteReport
+//
+void CProfiler::WriteReport( ostream &out, const CSourceMap &map ) const {
+
+	unsigned long long total_count = 0, total_cycles = 0;
+	vector<SRegion> regions;
+
+	// Total the regions.  Addresses come in order, so each region's
+	// addresses are contiguous:
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		const int label = map.GetLabelAddress( (unsigned short)address );
+		if( regions.empty() || regions.back().label != label ) {
+			const SRegion region = { label, 0, 0 };
+			regions.push_back( region );
+		}
+		regions.back().count += m_counts[address];
+		regions.back().cycles += m_cycles[address];
+		total_count += m_counts[address];
+		total_cycles += m_cycles[address];
+	}
+	stable_sort( regions.begin(), regions.end(), HotterRegion );
+
+	const ios::fmtflags flags = out.flags();
+	const char fill = out.fill();
+	out << fixed << setprecision( 1 );
+
+	out << "Profile: " << total_count << " instruction(s), "
+		<< total_cycles << " cycle(s)" << endl << endl;
+
+	// The labels, hottest first:
+	out << left << setw( 24 ) << "Label" << right
+		<< setw( 14 ) << "Cycles" << setw( 8 ) << "%"
+		<< setw( 14 ) << "Instructions" << endl;
+	for( size_t i = 0; i < regions.size() && regions[i].count; i++ ) {
+		const char *name = regions[i].label < 0 ? "(none)"
+			: map.GetLabel( (unsigned short)regions[i].label );
+		out << left << setw( 24 ) << name << right
+			<< setw( 14 ) << regions[i].cycles
+			<< setw( 7 ) << Percent( regions[i].cycles, total_cycles )
+			<< "%" << setw( 14 ) << regions[i].count << endl;
+	}
+
+	// The lines of each label, in address order, with the cycles
+	// each execution took so that expensive forms stand out:
+	for( size_t i = 0; i < regions.size() && regions[i].count; i++ ) {
+		out << endl;
+		if( regions[i].label < 0 ) {
+			out << "(none)" << endl;
+		}
+		else {
+			out << map.GetLabel( (unsigned short)regions[i].label )
+				<< " (" << hex << setfill( '0' ) << setw( 3 )
+				<< regions[i].label << setfill( ' ' ) << dec
+				<< ")" << endl;
+		}
+		out << setw( 6 ) << "Line" << setw( 6 ) << "Addr"
+			<< setw( 14 ) << "Count" << setw( 14 ) << "Cycles"
+			<< setw( 8 ) << "Cyc/Ex" << setw( 8 ) << "%"
+			<< "  Source" << endl;
+
+		for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+			if( !m_counts[address]
+				|| map.GetLabelAddress( (unsigned short)address )
+					!= regions[i].label )
+			{
+				continue;
+			}
+
+			const int line = map.GetLine( (unsigned short)address );
+			out << setw( 6 );
+			if( line ) {
+				out << line;
+			}
+			else {
+				out << "-";
+			}
+			out << "   " << hex << setfill( '0' ) << setw( 3 )
+				<< address << setfill( ' ' ) << dec
+				<< setw( 14 ) << m_counts[address]
+				<< setw( 14 ) << m_cycles[address]
+				<< setw( 8 )
+				<< (double)m_cycles[address] / m_counts[address]
+				<< setw( 7 ) << Percent( m_cycles[address], total_cycles )
+				<< "%  " << map.GetText( (unsigned short)address )
+				<< endl;
+		}
+	}
+
+	out.flags( flags );
+	out.fill( fill );
+
+} // WriteReport
+
+//
+// Name:	WriteFolded
+//
+void CProfiler::WriteFolded( ostream &out, const CSourceMap &map ) const {
+
+	const ios::fmtflags flags = out.flags();
+	const char fill = out.fill();
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		if( !m_cycles[address] ) {
+			continue;
+		}
+
+		const char *label = map.GetLabel( (unsigned short)address );
+		out << (label ? label : "(none)") << ";";
+
+		// Name the frame after its line, or its address if there is
+		// no source.  Semicolons would split the frame:
+		const int line = map.GetLine( (unsigned short)address );
+		if( line ) {
+			string text = map.GetText( (unsigned short)address );
+			replace( text.begin(), text.end(), ';', ',' );
+			out << "line " << line << ": " << text;
+		}
+		else {
+			out << "addr " << hex << setfill( '0' ) << setw( 3 )
+				<< address << setfill( ' ' ) << dec;
+		}
+		out << " " << m_cycles[address] << endl;
+	}
+
+	out.flags( flags );
+	out.fill( fill );
+
+} // WriteFolded
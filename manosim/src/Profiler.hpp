@@ -0,0 +1,117 @@
+// File:	Profiler.hpp
+// Description:
+//		A monitor that counts the instructions executed and the main.v
+//		clock cycles spent at every memory address, and reports them
+//		by label and by source line.
+// Usage:
+//		Attach an instance to a CManoSimulator with AddMonitor, run,
+//		then call WriteReport and/or WriteFolded.  Pass a CSourceMap
+//		to name addresses after the labels and lines of the source.
+//
+// Notes:
+//
+//		Retire only adds to two per-address counters, so a profile
+//		can be left on for long runs and sweeps.  All the work of
+//		grouping by label and line is done when a report is written.
+//
+//		The folded output has one "frame;frame count" line per hot
+//		address, weighted by clock cycles, as read by flame-graph
+//		tools such as flamegraph.pl.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoMonitor.hpp"
+#include "ManoSimulator.hpp"
+#include "SourceMap.hpp"
+
+#include <ostream>
+
+class CProfiler : public CManoMonitor {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CProfiler object with every count at
+	//		zero.
+	//
+	CProfiler();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CProfiler object.
+	//
+	virtual ~CProfiler();
+
+public:	// Initialization
+
+	//
+	// Name:	Reset
+	//
+	// Description:	Sets every count back to zero.
+	// Modifies:	m_counts, m_cycles
+	//
+	void Reset();
+
+public:	// CManoMonitor
+
+	//
+	// Name:	Retire
+	//
+	// Description:	Charges the instruction and its clock cycles to
+	//		its address.
+	//
+	virtual void Retire( const SRetire &retire );
+
+public:	// Accessors
+
+	//
+	// Name:	GetCount
+	//
+	// Returns:	The number of instructions executed at an address.
+	//
+	unsigned long long GetCount( unsigned short address ) const;
+
+	//
+	// Name:	GetCycles
+	//
+	// Returns:	The clock cycles spent at an address, including any
+	//		interrupt cycle that followed.
+	//
+	unsigned long long GetCycles( unsigned short address ) const;
+
+public:	// Output
+
+	//
+	// Name:	WriteReport
+	//
+	// Description:	Writes a text report: the labels sorted by the
+	//		cycles spent in them, then the hot lines of each label
+	//		in address order, with their cost per execution.
+	// Arguments:	The stream to write to, and the source map (which
+	//		may be empty)
+	//
+	void WriteReport( std::ostream &out, const CSourceMap &map ) const;
+
+	//
+	// Name:	WriteFolded
+	//
+	// Description:	Writes the profile as folded stacks: a label frame
+	//		and a line frame per address, weighted by clock cycles.
+	// Arguments:	The stream to write to, and the source map (which
+	//		may be empty)
+	//
+	void WriteFolded( std::ostream &out, const CSourceMap &map ) const;
+
+protected: // Attributes
+
+	unsigned long long m_counts[MANO_MEMORY_SIZE]; // Instructions
+
+	unsigned long long m_cycles[MANO_MEMORY_SIZE]; // Clock cycles
+};
@@ -0,0 +1,325 @@
+// File:	ProgramFile.cpp
+// Description:
+//		A program file written by manoasm, mapped and read in place.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "ProgramFile.hpp"
+#include "ProgramFormat.hpp"
+#include "ManoSimulator.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+
+using namespace std;
+
+//
+// Name:	GetFixed
+//
+// Returns:	A little-endian field of a program file.
+//
+static unsigned long GetFixed( const unsigned char *field, int bytes ) {
+	unsigned long value = 0;
+
+	for( int b = bytes - 1; b >= 0; b-- ) {
+		value = (value << 8) | field[b];
+	}
+	return value;
+
+} // GetFixed
+
+//
+// Name:	Damaged
+//
+// Description:	Reports a program file that cannot be used.
+//
+static void Damaged( const char *filename ) {
+
+	throw CErrorException( filename, 0, "S1006",
+		"Program file is damaged", CErrorException::ERROR );
+
+} // Damaged
+
+//
+// Name:	(constructor)
+//
+CProgramFile::CProgramFile() {
+
+	Close();
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CProgramFile::~CProgramFile() {
+} // (destructor)
+
+//
+// Name:	Open
+//
+bool CProgramFile::Open( const char *filename ) {
+
+	Close();
+	if( !m_file.Open( filename ) ) {
+		return false;
+	}
+	if( !IsProgram( m_file.GetData(), m_file.GetSize() ) ) {
+		m_file.Close();
+		return false;
+	}
+
+	Attach( m_file.GetData(), m_file.GetSize(), filename );
+	return true;
+
+} // Open
+
+//
+// Name:	Attach
+//
+void CProgramFile::Attach( const char *data, size_t size,
+	const char *filename )
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	const unsigned char *source = 0;
+	size_t strings_size = 0, symbols_size = 0, lines_size = 0;
+	size_t source_size = 0;
+
+	m_image = 0;
+	m_strings = 0;
+	m_symbols = m_lines = m_source = 0;
+
+	if( !IsProgram( data, size ) || size < PROGRAM_HEADER_SIZE
+		|| bytes[strlen( PROGRAM_MAGIC )] != PROGRAM_VERSION )
+	{
+		Damaged( filename );
+	}
+
+	// Find the sections:
+	const unsigned long sections = GetFixed( bytes + 8, 4 );
+	if( sections > (size - PROGRAM_HEADER_SIZE) / PROGRAM_ENTRY_SIZE ) {
+		Damaged( filename );
+	}
+	for( unsigned long section = 0; section < sections; section++ ) {
+		const unsigned char *entry = bytes + PROGRAM_HEADER_SIZE
+			+ section * PROGRAM_ENTRY_SIZE;
+		const unsigned long offset = GetFixed( entry + 4, 4 );
+		const unsigned long length = GetFixed( entry + 8, 4 );
+
+		if( offset > size || length > size - offset ) {
+			Damaged( filename );
+		}
+
+		switch( GetFixed( entry, 4 ) ) {
+		case PROGRAM_SECTION_IMAGE:
+			m_image = bytes + offset;
+			m_image_size = length;
+			break;
+		case PROGRAM_SECTION_STRINGS:
+			m_strings = data + offset;
+			strings_size = length;
+			break;
+		case PROGRAM_SECTION_SYMBOLS:
+			m_symbols = bytes + offset;
+			symbols_size = length;
+			break;
+		case PROGRAM_SECTION_LINES:
+			m_lines = bytes + offset;
+			lines_size = length;
+			break;
+		case PROGRAM_SECTION_SOURCE:
+			source = bytes + offset;
+			source_size = length;
+			break;
+		}
+	}
+
+	// Every string must end within the strings:
+	if( !m_image || (strings_size && m_strings[strings_size - 1]) ) {
+		Damaged( filename );
+	}
+
+	if( symbols_size % PROGRAM_SYMBOL_SIZE ) {
+		Damaged( filename );
+	}
+	m_symbol_count = symbols_size / PROGRAM_SYMBOL_SIZE;
+	for( size_t symbol = 0; symbol < m_symbol_count; symbol++ ) {
+		if( GetFixed( m_symbols + symbol * PROGRAM_SYMBOL_SIZE, 4 )
+			>= strings_size )
+		{
+			Damaged( filename );
+		}
+	}
+
+	if( lines_size % PROGRAM_LINE_SIZE ) {
+		Damaged( filename );
+	}
+	m_line_count = lines_size / PROGRAM_LINE_SIZE;
+	for( size_t run = 0; run < m_line_count; run++ ) {
+		const unsigned char *entry = m_lines + run * PROGRAM_LINE_SIZE;
+
+		if( GetFixed( entry, 2 ) + GetFixed( entry + 2, 2 )
+			> MANO_MEMORY_SIZE )
+		{
+			Damaged( filename );
+		}
+	}
+
+	m_source_lines = 0;
+	if( source ) {
+		if( source_size < PROGRAM_SOURCE_HEADER_SIZE
+			|| GetFixed( source, 4 ) >= strings_size )
+		{
+			Damaged( filename );
+		}
+		m_source_lines = GetFixed( source + 4, 4 );
+		if( m_source_lines > (source_size
+			- PROGRAM_SOURCE_HEADER_SIZE) / 4 )
+		{
+			Damaged( filename );
+		}
+		for( size_t line = 0; line < m_source_lines; line++ ) {
+			if( GetFixed( source + PROGRAM_SOURCE_HEADER_SIZE
+				+ 4 * line, 4 ) >= strings_size )
+			{
+				Damaged( filename );
+			}
+		}
+		m_source = source;
+	}
+
+} // Attach
+
+//
+// Name:	Close
+//
+void CProgramFile::Close() {
+
+	m_file.Close();
+	m_image = 0;
+	m_image_size = 0;
+	m_strings = 0;
+	m_symbols = 0;
+	m_symbol_count = 0;
+	m_lines = 0;
+	m_line_count = 0;
+	m_source = 0;
+	m_source_lines = 0;
+
+} // Close
+
+//
+// Name:	IsProgram
+//
+bool CProgramFile::IsProgram( const char *data, size_t size ) {
+
+	return size >= strlen( PROGRAM_MAGIC )
+		&& memcmp( data, PROGRAM_MAGIC, strlen( PROGRAM_MAGIC ) ) == 0;
+
+} // IsProgram
+
+//
+// Name:	GetImage
+//
+void CProgramFile::GetImage( const char **data, size_t *size ) const {
+
+	*data = (const char *)m_image;
+	*size = m_image_size;
+
+} // GetImage
+
+//
+// Name:	GetSymbolCount
+//
+size_t CProgramFile::GetSymbolCount() const {
+	return m_symbol_count;
+} // GetSymbolCount
+
+//
+// Name:	GetSymbolName
+//
+const char *CProgramFile::GetSymbolName( size_t symbol ) const {
+
+	return GetString( m_symbols + symbol * PROGRAM_SYMBOL_SIZE );
+
+} // GetSymbolName
+
+//
+// Name:	GetSymbolAddress
+//
+int CProgramFile::GetSymbolAddress( size_t symbol ) const {
+
+	return (int)GetFixed( m_symbols + symbol * PROGRAM_SYMBOL_SIZE + 4, 4 );
+
+} // GetSymbolAddress
+
+//
+// Name:	GetLine
+//
+int CProgramFile::GetLine( unsigned short address ) const {
+	size_t low = 0, high = m_line_count;
+
+	// Find the last run that starts at or before the address:
+	while( low < high ) {
+		const size_t middle = (low + high) / 2;
+
+		if( GetFixed( m_lines + middle * PROGRAM_LINE_SIZE, 2 )
+			<= address )
+		{
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if( low == 0 ) {
+		return 0;
+	}
+
+	const unsigned char *run = m_lines + (low - 1) * PROGRAM_LINE_SIZE;
+	const unsigned long start = GetFixed( run, 2 );
+	if( address - start >= GetFixed( run + 2, 2 ) ) {
+		return 0;
+	}
+	return (int)(GetFixed( run + 4, 4 ) + (address - start));
+
+} // GetLine
+
+//
+// Name:	GetSourceName
+//
+const char *CProgramFile::GetSourceName() const {
+
+	return m_source ? GetString( m_source ) : "";
+
+} // GetSourceName
+
+//
+// Name:	GetLineCount
+//
+size_t CProgramFile::GetLineCount() const {
+	return m_source_lines;
+} // GetLineCount
+
+//
+// Name:	GetText
+//
+const char *CProgramFile::GetText( int line ) const {
+
+	if( line < 1 || (size_t)line > m_source_lines ) {
+		return "";
+	}
+	return GetString( m_source + PROGRAM_SOURCE_HEADER_SIZE
+		+ 4 * (line - 1) );
+
+} // GetText
+
+//
+// Name:	GetString
+//
+const char *CProgramFile::GetString( const unsigned char *field ) const {
+
+	return m_strings + GetFixed( field, 4 );
+
+} // GetString
@@ -0,0 +1,180 @@
+// File:	ProgramFile.hpp
+// Description:
+//		A program file written by manoasm (-o p=), mapped and read in
+//		place: its image, symbols and source lines.
+// Usage:
+//		1. create one instance of this class
+//		2. call Open with a file, or Attach with a program already in
+//		   memory
+//		3. use the accessors; what they return lives as long as the
+//		   file stays open.
+//
+// Notes:
+//
+//		Attach checks that the header, the directory and every
+//		table lie within the file, and that every string the tables
+//		name is terminated, once; the accessors then read the tables
+//		where they are, without copying them.  The file is mapped
+//		read-only, so processes that open the same file share the
+//		same pages.
+//
+//		Sections other than the image may be left out; the
+//		accessors then find no symbols or lines.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+
+class CProgramFile {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CProgramFile object.
+	//
+	CProgramFile();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CProgramFile object, unmapping its file.
+	//
+	~CProgramFile();
+
+public:	// Loading
+
+	//
+	// Name:	Open
+	//
+	// Description:	Maps a file and attaches to it, if it is a program
+	//		file.
+	// Arguments:	The file
+	// Returns:	false if the file cannot be mapped or is not a
+	//		program file.
+	// Exceptions:	As Attach.
+	//
+	bool Open( const char *filename );
+
+	//
+	// Name:	Attach
+	//
+	// Description:	Attaches to a program file held in memory, which
+	//		must stay there while it is used.
+	// Arguments:	The bytes and their count, and the file name to give
+	//		in error messages
+	// Exceptions:	Throws a CErrorException (S1006) if it is not a
+	//		program file, or its tables do not fit in it.
+	//
+	void Attach( const char *data, size_t size, const char *filename );
+
+	//
+	// Name:	Close
+	//
+	// Description:	Detaches, and unmaps the file if Open mapped it.
+	//
+	void Close();
+
+	//
+	// Name:	IsProgram
+	//
+	// Returns:	true if the bytes start as a program file does.
+	//
+	static bool IsProgram( const char *data, size_t size );
+
+public:	// Accessors
+
+	//
+	// Name:	GetImage
+	//
+	// Description:	Finds the binary image (see ImageFormat.hpp), for
+	//		CImageLoader::Parse.
+	// Arguments:	Where to store its address and size
+	//
+	void GetImage( const char **data, size_t *size ) const;
+
+	//
+	// Name:	GetSymbolCount
+	//
+	// Returns:	The number of symbols.
+	//
+	size_t GetSymbolCount() const;
+
+	//
+	// Name:	GetSymbolName
+	//
+	// Returns:	The name of a symbol, in address order.
+	//
+	const char *GetSymbolName( size_t symbol ) const;
+
+	//
+	// Name:	GetSymbolAddress
+	//
+	// Returns:	The address of a symbol, in address order.
+	//
+	int GetSymbolAddress( size_t symbol ) const;
+
+	//
+	// Name:	GetLine
+	//
+	// Returns:	The line number (from 1) assembled into an address,
+	//		or 0 if nothing was.
+	//
+	int GetLine( unsigned short address ) const;
+
+	//
+	// Name:	GetSourceName
+	//
+	// Returns:	The name of the source file assembled.
+	//
+	const char *GetSourceName() const;
+
+	//
+	// Name:	GetLineCount
+	//
+	// Returns:	The number of lines of source.
+	//
+	size_t GetLineCount() const;
+
+	//
+	// Name:	GetText
+	//
+	// Returns:	The text of a line (from 1), or "" if there is no
+	//		such line.
+	//
+	const char *GetText( int line ) const;
+
+protected: // Utility functions
+
+	//
+	// Name:	GetString
+	//
+	// Returns:	The string at an offset named by a table.
+	//
+	const char *GetString( const unsigned char *field ) const;
+
+protected: // Attributes
+
+	CMappedFile	m_file;		// The file, if Open mapped it
+
+	const unsigned char *m_image;	// The image section
+	size_t		m_image_size;
+
+	const char	*m_strings;	// The strings section
+
+	const unsigned char *m_symbols;	// The symbol table
+	size_t		m_symbol_count;
+
+	const unsigned char *m_lines;	// The line runs
+	size_t		m_line_count;
+
+	const unsigned char *m_source;	// The source section, or 0
+	size_t		m_source_lines;
+};
@@ -0,0 +1,290 @@
+// File:	SourceMap.cpp
+// Description:
+//		Maps memory addresses back to the assembly source they came
+//		from.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "SourceMap.hpp"
+#include "ManoAssembler.hpp"
+#include "ProgramFile.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CSourceMap::CSourceMap() {
+
+	m_loaded = false;
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		m_label[address] = -1;
+		m_line[address] = 0;
+	}
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CSourceMap::~CSourceMap() {
+} // (destructor)
+
+//
+// Name:	Assemble
+//
+void CSourceMap::Assemble( const char *filename, CStringList &image ) {
+
+	CManoAssembler assembler( CManoAssembler::normal );
+	CStringList source;
+	ostringstream status;
+
+	// The assembler reads the file itself; read it again for the text:
+	assembler.AssembleFromFile( filename, image, status, cerr );
+	if( assembler.GetErrorCount() > 0 ) {
+		throw CErrorException( filename, 0, "S4001",
+			"Source file did not assemble", CErrorException::FATAL );
+	}
+	source.ReadFromFile( filename );
+
+	// Sort the labels by address:
+	const CSymbolTable::symbol_map &symbols =
+		assembler.GetSymbolTable().GetSymbols();
+	vector< pair<int, string> > sorted;
+	for( CSymbolTable::symbol_map::const_iterator i = symbols.begin();
+		i != symbols.end();
+		i++ )
+	{
+		sorted.push_back( make_pair( i->second, i->first ) );
+	}
+	sort( sorted.begin(), sorted.end() );
+
+	m_labels.clear();
+	m_label_addresses.clear();
+	for( size_t i = 0; i < sorted.size(); i++ ) {
+		m_labels.push_back( sorted[i].second );
+		m_label_addresses.push_back( sorted[i].first );
+	}
+
+	// Give every address its label region, line and text:
+	MapLabels();
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		const int line = assembler.GetSourceLine( address );
+		m_line[address] = 0;
+		m_text[address] = "";
+		if( line < 0 || (size_t)line >= source.size() ) {
+			continue;
+		}
+		m_line[address] = line + 1;
+		Collapse( source[line].c_str(), m_text[address] );
+	}
+
+	m_loaded = true;
+
+} // Assemble
+
+//
+// Name:	Load
+//
+void CSourceMap::Load( const CProgramFile &program ) {
+
+	// The program's symbols are in address order already:
+	m_labels.clear();
+	m_label_addresses.clear();
+	for( size_t i = 0; i < program.GetSymbolCount(); i++ ) {
+		m_labels.push_back( program.GetSymbolName( i ) );
+		m_label_addresses.push_back( program.GetSymbolAddress( i ) );
+	}
+
+	MapLabels();
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		const int line = program.GetLine( (unsigned short)address );
+		m_line[address] = line;
+		m_text[address] = "";
+		if( line ) {
+			Collapse( program.GetText( line ), m_text[address] );
+		}
+	}
+
+	m_loaded = true;
+
+} // Load
+
+//
+// Name:	IsLoaded
+//
+bool CSourceMap::IsLoaded() const {
+	return m_loaded;
+} // IsLoaded
+
+//
+// Name:	GetLabel
+//
+const char *CSourceMap::GetLabel( unsigned short address ) const {
+
+	const int label = m_label[address & 0xFFF];
+	if( label < 0 ) {
+		return 0;
+	}
+
+	return m_labels[label].c_str();
+
+} // GetLabel
+
+//
+// Name:	GetLabelAddress
+//
+int CSourceMap::GetLabelAddress( unsigned short address ) const {
+
+	const int label = m_label[address & 0xFFF];
+	if( label < 0 ) {
+		return -1;
+	}
+
+	return m_label_addresses[label];
+
+} // GetLabelAddress
+
+//
+// Name:	GetLabelCount
+//
+size_t CSourceMap::GetLabelCount() const {
+	return m_labels.size();
+} // GetLabelCount
+
+//
+// Name:	GetLabelName
+//
+const char *CSourceMap::GetLabelName( size_t label, int *address ) const {
+
+	*address = m_label_addresses[label];
+	return m_labels[label].c_str();
+
+} // GetLabelName
+
+//
+// Name:	FindLabel
+//
+int CSourceMap::FindLabel( const char *label ) const {
+
+	for( size_t i = 0; i < m_labels.size(); i++ ) {
+		const char *name = m_labels[i].c_str();
+		const char *text = label;
+
+		while( *name && toupper( (unsigned char)*name )
+			== toupper( (unsigned char)*text ) )
+		{
+			name++;
+			text++;
+		}
+		if( !*name && !*text ) {
+			return m_label_addresses[i];
+		}
+	}
+	return -1;
+
+} // FindLabel
+
+//
+// Name:	ParseAddress
+//
+int CSourceMap::ParseAddress( const char *text ) const {
+
+	if( !*text ) {
+		return -1;
+	}
+
+	const int label = FindLabel( text );
+	if( label >= 0 ) {
+		return label;
+	}
+
+	char *stop;
+	const unsigned long address = strtoul( text, &stop, 16 );
+	if( *stop || address >= MANO_MEMORY_SIZE ) {
+		return -1;
+	}
+	return (int)address;
+
+} // ParseAddress
+
+//
+// Name:	ParseRange
+//
+bool CSourceMap::ParseRange( const char *text, int *first, int *last ) const {
+
+	const char *colon = strchr( text, ':' );
+	if( !colon ) {
+		*first = *last = ParseAddress( text );
+		return *first >= 0;
+	}
+
+	*first = ParseAddress( string( text, colon - text ).c_str() );
+	*last = ParseAddress( colon + 1 );
+	return *first >= 0 && *last >= *first;
+
+} // ParseRange
+
+//
+// Name:	GetLine
+//
+int CSourceMap::GetLine( unsigned short address ) const {
+	return m_line[address & 0xFFF];
+} // GetLine
+
+//
+// Name:	GetText
+//
+const char *CSourceMap::GetText( unsigned short address ) const {
+	return m_text[address & 0xFFF].c_str();
+} // GetText
+
+//
+// Name:	MapLabels
+//
+void CSourceMap::MapLabels() {
+	size_t label = 0;
+	int current = -1;
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		while( label < m_label_addresses.size()
+			&& m_label_addresses[label] <= address )
+		{
+			current = (int)label;
+			label++;
+		}
+		m_label[address] = current;
+	}
+
+} // MapLabels
+
+//
+// Name:	Collapse
+//
+void CSourceMap::Collapse( const char *text, string &out ) {
+
+	// Collapse runs of white space, so the text fits a report:
+	out = "";
+	for( ; *text; text++ ) {
+		const char c = *text;
+		if( c == ' ' || c == '\t' || c == '\r' || c == '\n' ) {
+			if( !out.empty() && out[out.size() - 1] != ' ' ) {
+				out += ' ';
+			}
+		}
+		else {
+			out += c;
+		}
+	}
+	if( !out.empty() && out[out.size() - 1] == ' ' ) {
+		out.erase( out.size() - 1 );
+	}
+
+} // Collapse
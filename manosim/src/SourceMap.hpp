@@ -0,0 +1,192 @@
+// File:	SourceMap.hpp
+// Description:
+//		Maps memory addresses back to the assembly source they came
+//		from: the label whose region holds each address, and the line
+//		assembled into it.
+// Usage:
+//		Call Assemble with a Mano assembly source file.  The image it
+//		produces can be passed to CManoSimulator::LoadFromList, and
+//		the accessors then describe any address of it.  Or call Load
+//		with a program file that manoasm wrote, whose image the
+//		simulator loads itself.
+//
+// Notes:
+//
+//		A label's region runs from its address up to the next label,
+//		so code that follows a label without one of its own is charged
+//		to it.  Labels keep the upper case the assembler gives them.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoSimulator.hpp"
+#include "StringList.hpp"
+
+class CProgramFile;
+
+#include <string>
+#include <vector>
+
+class CSourceMap {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs an empty CSourceMap object, which knows
+	//		no labels or lines.
+	//
+	CSourceMap();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CSourceMap object.
+	//
+	~CSourceMap();
+
+public:	// Initialization
+
+	//
+	// Name:	Assemble
+	//
+	// Description:	Assembles a source file with CManoAssembler and
+	//		keeps its symbols and the line assembled at each
+	//		address.  Assembler errors go to the error stream.
+	// Arguments:	The source file, and a list to receive the image (in
+	//		the normal format)
+	// Exceptions:	Throws a CErrorException if the source did not
+	//		assemble (S4001), or passes on a fatal assembler error.
+	//
+	void Assemble( const char *filename, CStringList &image );
+
+	//
+	// Name:	Load
+	//
+	// Description:	Keeps the symbols and lines of a program file.
+	// Arguments:	The program file, which may be closed afterwards
+	//
+	void Load( const CProgramFile &program );
+
+public:	// Accessors
+
+	//
+	// Name:	IsLoaded
+	//
+	// Returns:	true once a source file has been assembled.
+	//
+	bool IsLoaded() const;
+
+	//
+	// Name:	GetLabel
+	//
+	// Returns:	The label whose region holds the address, or 0 if
+	//		the address lies before the first label.
+	//
+	const char *GetLabel( unsigned short address ) const;
+
+	//
+	// Name:	GetLabelAddress
+	//
+	// Returns:	The address of the label whose region holds the
+	//		address, or -1 if there is none.
+	//
+	int GetLabelAddress( unsigned short address ) const;
+
+	//
+	// Name:	GetLabelCount
+	//
+	// Returns:	The number of labels.
+	//
+	size_t GetLabelCount() const;
+
+	//
+	// Name:	GetLabelName
+	//
+	// Description:	Gives a label, in address order.
+	// Arguments:	The label's index, and where to store its address
+	// Returns:	The label.
+	//
+	const char *GetLabelName( size_t label, int *address ) const;
+
+	//
+	// Name:	FindLabel
+	//
+	// Returns:	The address of a label (case is ignored), or -1 if
+	//		there is no such label.
+	//
+	int FindLabel( const char *label ) const;
+
+	//
+	// Name:	ParseAddress
+	//
+	// Returns:	The address named by a label or given in hex, or -1 if
+	//		the text is neither.
+	//
+	int ParseAddress( const char *text ) const;
+
+	//
+	// Name:	ParseRange
+	//
+	// Description:	Reads an address, or a range written first:last.
+	// Arguments:	The text, and where to store the first and last
+	//		address (the same for a single address)
+	// Returns:	false if the text names no range.
+	//
+	bool ParseRange( const char *text, int *first, int *last ) const;
+
+	//
+	// Name:	GetLine
+	//
+	// Returns:	The line number (from 1) assembled into the address,
+	//		or 0 if nothing was.
+	//
+	int GetLine( unsigned short address ) const;
+
+	//
+	// Name:	GetText
+	//
+	// Returns:	The source line assembled into the address, with its
+	//		comment kept and its white space collapsed, or "" if
+	//		nothing was.
+	//
+	const char *GetText( unsigned short address ) const;
+
+protected: // Utility functions
+
+	//
+	// Name:	MapLabels
+	//
+	// Description:	Gives every address the label whose region holds
+	//		it.
+	// Modifies:	m_label
+	//
+	void MapLabels();
+
+	//
+	// Name:	Collapse
+	//
+	// Description:	Copies a source line with its runs of white space
+	//		collapsed to one space, and none at the ends.
+	// Arguments:	The line, and the string to copy it to
+	//
+	static void Collapse( const char *text, std::string &out );
+
+protected: // Attributes
+
+	bool		m_loaded;	// Set by Assemble and Load
+
+	std::vector<std::string> m_labels; // Labels, in address order
+
+	std::vector<int> m_label_addresses; // Address of each label
+
+	int		m_label[MANO_MEMORY_SIZE]; // Label of each address, or -1
+
+	int		m_line[MANO_MEMORY_SIZE];  // Line of each address, or 0
+
+	std::string	m_text[MANO_MEMORY_SIZE];  // Source of each address
+};
@@ -0,0 +1,266 @@
+// File:	StreamIo.cpp
+// Description:
+//		A character device that connects INPR to a host file or pipe
+//		and OUTR to a host file or pipe, so Mano programs can run as
+//		filters.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "StreamIo.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define read	_read
+#define write	_write
+#define open	_open
+#define close	_close
+#else
+#include <unistd.h>
+#define O_BINARY	0
+#endif
+
+using namespace std;
+
+// Positions in the ring wrap at the block size:
+#define RING_MASK	(STREAM_IO_BLOCK_SIZE - 1)
+
+//
+// Name:	(constructor)
+//
+CStreamIo::CStreamIo() {
+
+	m_input_fd = -1;
+	m_input_buffer = 0;
+	m_input = 0;
+	m_input_end = 0;
+	m_has_input = false;
+
+	m_output_fd = -1;
+	m_ring = new char[STREAM_IO_BLOCK_SIZE];
+	m_ring_head = 0;
+	m_ring_tail = 0;
+
+	m_characters_in = 0;
+	m_characters_out = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CStreamIo::~CStreamIo() {
+
+	try {
+		Flush();
+	}
+	catch( CErrorException e ) {
+		// Nothing more can be done with the output now.
+	}
+
+	// Leave the standard streams open:
+	if( m_input_fd > 2 ) {
+		close( m_input_fd );
+	}
+	if( m_output_fd > 2 ) {
+		close( m_output_fd );
+	}
+
+	delete [] m_input_buffer;
+	delete [] m_ring;
+
+} // (destructor)
+
+//
+// Name:	OpenInput
+//
+void CStreamIo::OpenInput( const char *filename ) {
+
+	m_has_input = true;
+
+	// Map regular files and read them in place:
+	if( strcmp( filename, "-" ) != 0 && m_mapping.Open( filename ) ) {
+		m_input = m_mapping.GetData();
+		m_input_end = m_input + m_mapping.GetSize();
+		return;
+	}
+
+	// Everything else is read block by block:
+	if( strcmp( filename, "-" ) == 0 ) {
+		m_input_fd = 0;
+#ifdef _WIN32
+		_setmode( 0, O_BINARY );
+#endif
+	}
+	else {
+		m_input_fd = open( filename, O_RDONLY | O_BINARY );
+		if( m_input_fd < 0 ) {
+			throw CErrorException( filename, 0, "S2001",
+				"Could not open input stream",
+				CErrorException::FATAL );
+		}
+	}
+
+	m_input_buffer = new char[STREAM_IO_BLOCK_SIZE];
+	m_input = m_input_buffer;
+	m_input_end = m_input_buffer;
+
+} // OpenInput
+
+//
+// Name:	OpenOutput
+//
+void CStreamIo::OpenOutput( const char *filename ) {
+
+	if( strcmp( filename, "-" ) == 0 ) {
+		m_output_fd = 1;
+#ifdef _WIN32
+		_setmode( 1, O_BINARY );
+#endif
+		return;
+	}
+
+	m_output_fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+		0666 );
+	if( m_output_fd < 0 ) {
+		throw CErrorException( filename, 0, "S2002",
+			"Could not open output stream", CErrorException::FATAL );
+	}
+
+} // OpenOutput
+
+//
+// Name:	GetFgi
+//
+bool CStreamIo::GetFgi( unsigned long long ) {
+
+	if( m_input != m_input_end || Refill() ) {
+		return true;
+	}
+
+	// The program is polling an input that has run dry.  Without
+	// any input, FGI just stays clear:
+	if( m_has_input ) {
+		m_stop_requested = true;
+	}
+	return false;
+
+} // GetFgi
+
+//
+// Name:	GetFgo
+//
+bool CStreamIo::GetFgo( unsigned long long ) {
+
+	// A full ring drains before the device reports ready again:
+	if( m_ring_tail - m_ring_head == STREAM_IO_BLOCK_SIZE ) {
+		Flush();
+	}
+
+	return true;
+
+} // GetFgo
+
+//
+// Name:	Input
+//
+unsigned char CStreamIo::Input( unsigned long long ) {
+
+	// INP without a character leaves INPR at its last value; there is
+	// nothing sensible to return but 0:
+	if( m_input == m_input_end && !Refill() ) {
+		m_stop_requested = true;
+		return 0;
+	}
+
+	m_characters_in++;
+	return (unsigned char)*m_input++;
+
+} // Input
+
+//
+// Name:	Output
+//
+void CStreamIo::Output( unsigned char character, unsigned long long ) {
+
+	// Programs that ignore FGO still must not overrun the ring:
+	if( m_ring_tail - m_ring_head == STREAM_IO_BLOCK_SIZE ) {
+		Flush();
+	}
+
+	m_ring[m_ring_tail & RING_MASK] = (char)character;
+	m_ring_tail++;
+	m_characters_out++;
+
+} // Output
+
+//
+// Name:	Flush
+//
+void CStreamIo::Flush() {
+
+	// Without an output stream, characters are only counted:
+	if( m_output_fd < 0 ) {
+		m_ring_head = m_ring_tail;
+		return;
+	}
+
+	// The live part of the ring is at most two contiguous spans:
+	while( m_ring_head != m_ring_tail ) {
+		const unsigned long start = m_ring_head & RING_MASK;
+		unsigned long length = m_ring_tail - m_ring_head;
+		if( length > STREAM_IO_BLOCK_SIZE - start ) {
+			length = STREAM_IO_BLOCK_SIZE - start;
+		}
+
+		const int written = write( m_output_fd, m_ring + start,
+			(unsigned)length );
+		if( written <= 0 ) {
+			m_ring_head = m_ring_tail;
+			throw CErrorException( "", 0, "S2003",
+				"Could not write output stream",
+				CErrorException::FATAL );
+		}
+		m_ring_head += written;
+	}
+
+} // Flush
+
+//
+// Name:	GetCharactersIn
+//
+unsigned long long CStreamIo::GetCharactersIn() const {
+	return m_characters_in;
+} // GetCharactersIn
+
+//
+// Name:	GetCharactersOut
+//
+unsigned long long CStreamIo::GetCharactersOut() const {
+	return m_characters_out;
+} // GetCharactersOut
+
+//
+// Name:	Refill
+//
+bool CStreamIo::Refill() {
+
+	if( m_input_fd < 0 ) {
+		return false;
+	}
+
+	const int count = read( m_input_fd, m_input_buffer,
+		STREAM_IO_BLOCK_SIZE );
+	if( count <= 0 ) {
+		return false;
+	}
+
+	m_input = m_input_buffer;
+	m_input_end = m_input_buffer + count;
+	return true;
+
+} // Refill
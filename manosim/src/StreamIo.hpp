@@ -0,0 +1,145 @@
+// File:	StreamIo.hpp
+// Description:
+//		A character device that connects INPR to a host file or pipe
+//		and OUTR to a host file or pipe, so Mano programs can run as
+//		filters.
+// Usage:
+//		Call OpenInput and/or OpenOutput ("-" selects standard input
+//		or output), attach the object to a CManoSimulator with SetIo,
+//		run, then call Flush.
+//
+// Notes:
+//
+//		Regular input files are memory mapped and read in place.
+//		Pipes are read in large blocks.  Output collects in a ring
+//		buffer that is written out in large blocks.  No system call
+//		is made per character.
+//
+//		FGI reads 1 while input is left.  FGO reads 1 while the ring
+//		has room; sampling FGO on a full ring drains it first.
+//		Sampling FGI once the input is exhausted requests a stop,
+//		since the program is then waiting for input that will never
+//		arrive.  With no input opened, FGI simply reads 0.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoIo.hpp"
+#include "MappedFile.hpp"
+
+// Size of the output ring and of each block read from a pipe, in bytes:
+#define STREAM_IO_BLOCK_SIZE	65536
+
+class CStreamIo : public CManoIo {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CStreamIo object with no input and no
+	//		output.  Without input FGI stays 0; without output,
+	//		characters are counted and discarded.
+	//
+	CStreamIo();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Flushes the output and closes both streams.
+	//
+	virtual ~CStreamIo();
+
+public:	// Streams
+
+	//
+	// Name:	OpenInput
+	//
+	// Description:	Connects INPR to a file, or to standard input.
+	// Arguments:	The file to read, or "-" for standard input
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		opened (S2001).
+	//
+	void OpenInput( const char *filename );
+
+	//
+	// Name:	OpenOutput
+	//
+	// Description:	Connects OUTR to a file, or to standard output.
+	// Arguments:	The file to write, or "-" for standard output
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		opened (S2002).
+	//
+	void OpenOutput( const char *filename );
+
+public:	// CManoIo
+
+	virtual bool GetFgi( unsigned long long cycle );
+	virtual bool GetFgo( unsigned long long cycle );
+	virtual unsigned char Input( unsigned long long cycle );
+	virtual void Output( unsigned char character, unsigned long long cycle );
+
+	//
+	// Name:	Flush
+	//
+	// Description:	Writes out everything in the output ring.
+	// Exceptions:	Throws a CErrorException if the write fails (S2003).
+	//
+	virtual void Flush();
+
+public:	// Statistics
+
+	//
+	// Name:	GetCharactersIn
+	//
+	// Returns:	The number of characters consumed by INP.
+	//
+	unsigned long long GetCharactersIn() const;
+
+	//
+	// Name:	GetCharactersOut
+	//
+	// Returns:	The number of characters produced by OUT.
+	//
+	unsigned long long GetCharactersOut() const;
+
+protected: // Utility functions
+
+	//
+	// Name:	Refill
+	//
+	// Description:	Reads the next block from a piped input.
+	// Returns:	false if the input is exhausted.
+	// Modifies:	m_input, m_input_end, m_input_buffer
+	//
+	bool Refill();
+
+protected: // Attributes
+
+	CMappedFile	m_mapping;	// Mapped input file, if mappable
+
+	int		m_input_fd;	// Piped input, or -1
+
+	char		*m_input_buffer; // Block buffer for piped input
+
+	const char	*m_input;	// Next input character
+
+	const char	*m_input_end;	// End of the available input
+
+	bool		m_has_input;	// Set by OpenInput
+
+	int		m_output_fd;	// Output, or -1
+
+	char		*m_ring;	// Output ring buffer
+
+	unsigned long	m_ring_head;	// Ring position of the oldest character
+
+	unsigned long	m_ring_tail;	// Ring position past the newest one
+
+	unsigned long long m_characters_in;	// Characters consumed
+
+	unsigned long long m_characters_out;	// Characters produced
+};
@@ -0,0 +1,68 @@
+// File:	TraceFormat.hpp
+// Description:
+//		Layout of the binary instruction trace written by CTraceWriter
+//		and read back by CTraceReader.
+//
+// Notes:
+//
+//		All fixed-size fields are little-endian.  A trace file is:
+//
+//		header:		"MANOTRC" and a version byte, then the number
+//				of records per block (4 bytes)
+//		blocks:		stored size (4 bytes), raw size (4 bytes), then
+//				the payload.  The payload is zstd-compressed
+//				when the stored size is smaller than the raw
+//				size, and raw otherwise.
+//		index:		for each block, the index of its first record
+//				and its file offset (8 bytes each)
+//		trailer:	index offset, block count, record count (8
+//				bytes each), then "MANOIDX" and a 0 byte
+//
+//		Records are numbered from 0 in the order they were written;
+//		this is the instruction index unless the simulator was reset
+//		during the trace.  Each block decodes on its own, so a reader
+//		can seek to any record by decoding a single block.  A raw
+//		payload starts with varints for the first record's index, the
+//		clock cycle before it, its PC, AC before it, and the number of
+//		records.
+//		Each record then starts with a flags byte:
+//
+//		TRACE_NEXT_PC	next PC follows as a varint (else PC+1)
+//		TRACE_WORD	instruction word follows as a varint (else the
+//				word last seen at this PC in this block)
+//		TRACE_AC	AC delta follows as a zigzag varint
+//		TRACE_E		E after the instruction
+//		TRACE_IEN	IEN after the instruction
+//		TRACE_STORES	number of stores; each store is a varint
+//				address and a zigzag varint of (word - AC)
+//		TRACE_EVENT	an SRetire events byte follows, then the
+//				character if it has RETIRE_INPUT or
+//				RETIRE_OUTPUT
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#define TRACE_MAGIC		"MANOTRC"
+#define TRACE_INDEX_MAGIC	"MANOIDX"
+#define TRACE_VERSION		1
+
+#define TRACE_HEADER_SIZE	12	// Magic, version, records per block
+#define TRACE_BLOCK_HEADER_SIZE	8	// Stored size, raw size
+#define TRACE_INDEX_ENTRY_SIZE	16	// First record, offset
+#define TRACE_TRAILER_SIZE	32	// Offset, blocks, records, magic
+
+// Records per block, which bounds the work of a seek:
+#define TRACE_BLOCK_RECORDS	8192
+
+// Record flag bits:
+#define TRACE_NEXT_PC		0x01
+#define TRACE_WORD		0x02
+#define TRACE_AC		0x04
+#define TRACE_E			0x08
+#define TRACE_IEN		0x10
+#define TRACE_STORES		0x60
+#define TRACE_STORES_SHIFT	5
+#define TRACE_EVENT		0x80
@@ -0,0 +1,319 @@
+// File:	TraceReader.cpp
+// Description:
+//		Reads back a binary instruction trace written by CTraceWriter.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "TraceReader.hpp"
+#include "TraceFormat.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+
+#ifdef MANOSIM_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+//
+// Name:	(constructor)
+//
+CTraceReader::CTraceReader() {
+
+	m_filename = "";
+	m_records = 0;
+	m_block = 0;
+	m_p = 0;
+	m_end = 0;
+	m_left = 0;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CTraceReader::~CTraceReader() {
+} // (destructor)
+
+//
+// Name:	Open
+//
+void CTraceReader::Open( const char *filename ) {
+
+	m_filename = filename;
+	if( !m_file.Open( filename ) ) {
+		throw CErrorException( filename, 0, "S3001",
+			"Could not open trace file", CErrorException::FATAL );
+	}
+
+	const unsigned char *data = (const unsigned char *)m_file.GetData();
+	const size_t size = m_file.GetSize();
+
+	// Check the header and the trailer:
+	if( size < TRACE_HEADER_SIZE + TRACE_TRAILER_SIZE
+		|| memcmp( data, TRACE_MAGIC, strlen( TRACE_MAGIC ) ) != 0
+		|| data[strlen( TRACE_MAGIC )] != TRACE_VERSION
+		|| memcmp( data + size - 8, TRACE_INDEX_MAGIC,
+			strlen( TRACE_INDEX_MAGIC ) + 1 ) != 0 )
+	{
+		throw CErrorException( filename, 0, "S3004",
+			"Not a trace file", CErrorException::FATAL );
+	}
+
+	const unsigned char *trailer = data + size - TRACE_TRAILER_SIZE;
+	const unsigned long long index_offset = GetFixed( trailer, 8 );
+	const unsigned long long blocks = GetFixed( trailer + 8, 8 );
+	m_records = GetFixed( trailer + 16, 8 );
+
+	if( index_offset + blocks * TRACE_INDEX_ENTRY_SIZE
+		!= size - TRACE_TRAILER_SIZE )
+	{
+		Damaged();
+	}
+
+	m_index.resize( (size_t)blocks * 2 );
+	for( size_t i = 0; i < m_index.size(); i++ ) {
+		m_index[i] = GetFixed( data + index_offset + 8 * i, 8 );
+	}
+
+	m_block = 0;
+	m_left = 0;
+	if( blocks ) {
+		LoadBlock( 0 );
+	}
+
+} // Open
+
+//
+// Name:	GetRecordCount
+//
+unsigned long long CTraceReader::GetRecordCount() const {
+	return m_records;
+} // GetRecordCount
+
+//
+// Name:	Seek
+//
+void CTraceReader::Seek( unsigned long long index ) {
+
+	if( index >= m_records ) {
+		throw CErrorException( m_filename, 0, "S3005",
+			"Instruction index is past the end of the trace",
+			CErrorException::ERROR );
+	}
+
+	// Find the last block starting at or before the index:
+	size_t low = 0, high = m_index.size() / 2;
+	while( high - low > 1 ) {
+		const size_t middle = (low + high) / 2;
+		if( m_index[2 * middle] <= index ) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	// Decode up to the record:
+	LoadBlock( low );
+	SRetire skipped;
+	while( m_next_index < index ) {
+		if( !Next( &skipped ) ) {
+			Damaged();
+		}
+	}
+
+} // Seek
+
+//
+// Name:	Next
+//
+bool CTraceReader::Next( SRetire *record ) {
+
+	// Move on to the next block when this one is used up:
+	while( m_left == 0 ) {
+		if( m_block + 1 >= m_index.size() / 2 ) {
+			return false;
+		}
+		LoadBlock( m_block + 1 );
+	}
+
+	if( m_p >= m_end ) {
+		Damaged();
+	}
+	const unsigned char flags = *m_p++;
+
+	record->index = m_next_index;
+	record->pc = m_pc;
+	record->next_pc = (flags & TRACE_NEXT_PC)
+		? (unsigned short)GetVarint() : (unsigned short)((m_pc + 1) & 0xFFF);
+
+	if( flags & TRACE_WORD ) {
+		m_words[m_pc] = (int)(GetVarint() & 0xFFFF);
+	}
+	if( m_words[m_pc] < 0 ) {
+		Damaged();
+	}
+	record->word = (unsigned short)m_words[m_pc];
+
+	if( flags & TRACE_AC ) {
+		const unsigned short zigzag = (unsigned short)GetVarint();
+		m_ac = (unsigned short)(m_ac + ((zigzag >> 1) ^ -(zigzag & 1)));
+	}
+	record->ac = m_ac;
+	record->e = (flags & TRACE_E) != 0;
+	record->ien = (flags & TRACE_IEN) != 0;
+
+	record->store_count = (flags & TRACE_STORES) >> TRACE_STORES_SHIFT;
+	if( record->store_count > RETIRE_MAX_STORES ) {
+		Damaged();
+	}
+	for( int i = 0; i < record->store_count; i++ ) {
+		record->store_address[i] = (unsigned short)GetVarint();
+		const unsigned short zigzag = (unsigned short)GetVarint();
+		record->store_value[i] = (unsigned short)(m_ac
+			+ ((zigzag >> 1) ^ -(zigzag & 1)));
+	}
+
+	record->events = 0;
+	record->character = (unsigned char)m_ac;
+	if( flags & TRACE_EVENT ) {
+		if( m_p >= m_end ) {
+			Damaged();
+		}
+		record->events = *m_p++;
+		if( record->events & (RETIRE_INPUT | RETIRE_OUTPUT) ) {
+			if( m_p >= m_end ) {
+				Damaged();
+			}
+			record->character = *m_p++;
+		}
+	}
+
+	// Rebuild the cycle count from the instruction word:
+	CManoSimulator::SDecoded decoded;
+	CManoSimulator::Decode( record->word, &decoded );
+	record->cycles = decoded.cycles;
+	if( record->events & RETIRE_INTERRUPT ) {
+		record->cycles = (unsigned char)(record->cycles
+			+ CManoSimulator::GetInterruptCycles( decoded.operation ));
+	}
+	m_cycle += record->cycles;
+	record->cycle = m_cycle;
+
+	m_pc = record->next_pc;
+	m_next_index++;
+	m_left--;
+
+	return true;
+
+} // Next
+
+//
+// Name:	LoadBlock
+//
+void CTraceReader::LoadBlock( size_t block ) {
+
+	const unsigned char *data = (const unsigned char *)m_file.GetData();
+	const unsigned long long offset = m_index[2 * block + 1];
+	const unsigned long long index_offset =
+		m_file.GetSize() - TRACE_TRAILER_SIZE
+		- m_index.size() / 2 * TRACE_INDEX_ENTRY_SIZE;
+
+	if( offset + TRACE_BLOCK_HEADER_SIZE > index_offset ) {
+		Damaged();
+	}
+	const unsigned long long stored_size = GetFixed( data + offset, 4 );
+	const unsigned long long raw_size = GetFixed( data + offset + 4, 4 );
+	const unsigned char *stored = data + offset + TRACE_BLOCK_HEADER_SIZE;
+	if( offset + TRACE_BLOCK_HEADER_SIZE + stored_size > index_offset ) {
+		Damaged();
+	}
+
+	if( stored_size == raw_size ) {
+		// Raw blocks are decoded straight from the mapping:
+		m_p = stored;
+		m_end = stored + raw_size;
+	}
+	else {
+#ifdef MANOSIM_ZSTD
+		m_payload.resize( (size_t)raw_size );
+		const size_t size = ZSTD_decompress( &m_payload[0], m_payload.size(),
+			stored, (size_t)stored_size );
+		if( ZSTD_isError( size ) || size != raw_size ) {
+			Damaged();
+		}
+		m_p = &m_payload[0];
+		m_end = m_p + raw_size;
+#else
+		throw CErrorException( m_filename, 0, "S3002",
+			"Trace compression is not available in this build",
+			CErrorException::FATAL );
+#endif
+	}
+
+	// Decode the block header:
+	m_block = block;
+	m_next_index = GetVarint();
+	m_cycle = GetVarint();
+	m_pc = (unsigned short)(GetVarint() & 0xFFF);
+	m_ac = (unsigned short)GetVarint();
+	m_left = (unsigned long)GetVarint();
+	if( m_next_index != m_index[2 * block] ) {
+		Damaged();
+	}
+
+	for( int i = 0; i < MANO_MEMORY_SIZE; i++ ) {
+		m_words[i] = -1;
+	}
+
+} // LoadBlock
+
+//
+// Name:	GetVarint
+//
+unsigned long long CTraceReader::GetVarint() {
+
+	unsigned long long value = 0;
+	int shift = 0;
+
+	for( ;; ) {
+		if( m_p >= m_end || shift > 63 ) {
+			Damaged();
+		}
+		const unsigned char byte = *m_p++;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if( !(byte & 0x80) ) {
+			return value;
+		}
+		shift += 7;
+	}
+
+} // GetVarint
+
+//
+// Name:	GetFixed
+//
+unsigned long long CTraceReader::GetFixed( const unsigned char *p, int size ) {
+
+	unsigned long long value = 0;
+
+	for( int i = size - 1; i >= 0; i-- ) {
+		value = (value << 8) | p[i];
+	}
+
+	return value;
+
+} // GetFixed
+
+//
+// Name:	Damaged
+//
+void CTraceReader::Damaged() const {
+
+	throw CErrorException( m_filename, 0, "S3006",
+		"Trace file is damaged", CErrorException::FATAL );
+
+} // Damaged
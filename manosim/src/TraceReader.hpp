@@ -0,0 +1,155 @@
+// File:	TraceReader.hpp
+// Description:
+//		Reads back a binary instruction trace written by CTraceWriter.
+// Usage:
+//		Call Open, then Seek to the instruction of interest, and call
+//		Next repeatedly to decode records from there on.
+//
+// Notes:
+//
+//		The file is memory mapped.  A seek finds the block holding the
+//		instruction through the index in the trailer, and decodes that
+//		block only up to the instruction.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoMonitor.hpp"
+#include "ManoSimulator.hpp"
+#include "MappedFile.hpp"
+
+#include <vector>
+
+class CTraceReader {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CTraceReader object with no file.
+	//
+	CTraceReader();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys a CTraceReader object.
+	//
+	~CTraceReader();
+
+public:	// Trace file
+
+	//
+	// Name:	Open
+	//
+	// Description:	Maps a trace file and reads its index.  The reader
+	//		is positioned at the first record.
+	// Arguments:	The trace file
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		opened (S3001), if it is not a trace file (S3004), if it
+	//		is damaged (S3006), or if it is compressed and this
+	//		build has no zstd support (S3002).
+	//
+	void Open( const char *filename );
+
+	//
+	// Name:	GetRecordCount
+	//
+	// Returns:	The number of records in the trace.
+	//
+	unsigned long long GetRecordCount() const;
+
+public:	// Decoding
+
+	//
+	// Name:	Seek
+	//
+	// Description:	Positions the reader so that the next call to Next
+	//		returns the record of the given instruction.
+	// Arguments:	The instruction index
+	// Exceptions:	Throws a CErrorException if the index is past the
+	//		end of the trace (S3005), or if the file is damaged
+	//		(S3006).
+	//
+	void Seek( unsigned long long index );
+
+	//
+	// Name:	Next
+	//
+	// Description:	Decodes the next record.  The store values, AC and
+	//		cycle counts are rebuilt exactly; cycles comes from
+	//		decoding the instruction word.
+	// Arguments:	The record to fill in
+	// Returns:	false at the end of the trace.
+	// Exceptions:	Throws a CErrorException if the file is damaged
+	//		(S3006).
+	//
+	bool Next( SRetire *record );
+
+protected: // Utility functions
+
+	//
+	// Name:	LoadBlock
+	//
+	// Description:	Makes the given block current, decompressing it if
+	//		needed, and decodes its header.
+	// Arguments:	The block number
+	// Modifies:	m_payload, m_p, m_end and the decoder state
+	//
+	void LoadBlock( size_t block );
+
+	//
+	// Name:	GetVarint
+	//
+	// Description:	Decodes a varint from the current block.
+	//
+	unsigned long long GetVarint();
+
+	//
+	// Name:	GetFixed
+	//
+	// Description:	Decodes a little-endian integer of the given size.
+	//
+	static unsigned long long GetFixed( const unsigned char *p, int size );
+
+	//
+	// Name:	Damaged
+	//
+	// Description:	Throws the damaged-file error (S3006).
+	//
+	void Damaged() const;
+
+protected: // Attributes
+
+	CMappedFile	m_file;		// The mapped trace
+
+	const char	*m_filename;	// The trace file name
+
+	std::vector<unsigned long long> m_index; // First record, offset pairs
+
+	unsigned long long m_records;	// Records in the trace
+
+	size_t		m_block;	// Current block number
+
+	std::vector<unsigned char> m_payload; // Decompressed payload
+
+	const unsigned char *m_p;	// Next byte of the current block
+
+	const unsigned char *m_end;	// End of the current block
+
+	unsigned long	m_left;		// Records left in the current block
+
+	unsigned long long m_next_index; // Index of the next record
+
+	unsigned long long m_cycle;	// Clock cycle before the next record
+
+	unsigned short	m_pc;		// PC of the next record
+
+	unsigned short	m_ac;		// AC after the previous record
+
+	int		m_words[MANO_MEMORY_SIZE]; // Last word seen at each PC
+};
@@ -0,0 +1,374 @@
+// File:	TraceWriter.cpp
+// Description:
+//		A monitor that records every retired instruction into a
+//		compact binary trace file (see TraceFormat.hpp).
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "TraceWriter.hpp"
+#include "TraceFormat.hpp"
+#include "ErrorException.hpp"
+
+#include <cstring>
+
+#ifdef MANOSIM_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+// Positions in the ring wrap at its size:
+#define RING_MASK	(TRACE_RING_SIZE - 1)
+
+// The writer thread publishes its progress this often, so that a full
+// ring frees up before a whole ring's worth has been encoded:
+#define PUBLISH_INTERVAL	1024
+
+//
+// Name:	(constructor)
+//
+CTraceWriter::CTraceWriter() {
+
+	m_file = 0;
+	m_compress = false;
+	m_failed = false;
+	m_ring = 0;
+	m_head = 0;
+	m_tail = 0;
+	m_head_cache = 0;
+	m_closing = false;
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CTraceWriter::~CTraceWriter() {
+
+	try {
+		Close();
+	}
+	catch( CErrorException e ) {
+		// Nothing more can be done with the trace now.
+	}
+
+} // (destructor)
+
+//
+// Name:	Open
+//
+void CTraceWriter::Open( const char *filename, bool compress ) {
+
+	Close();
+
+#ifndef MANOSIM_ZSTD
+	if( compress ) {
+		throw CErrorException( filename, 0, "S3002",
+			"Trace compression is not available in this build",
+			CErrorException::FATAL );
+	}
+#endif
+
+	m_file = fopen( filename, "wb" );
+	if( !m_file ) {
+		throw CErrorException( filename, 0, "S3001",
+			"Could not open trace file", CErrorException::FATAL );
+	}
+
+	m_compress = compress;
+	m_failed = false;
+	m_offset = 0;
+	m_records = 0;
+	m_block_records = 0;
+	m_next_index = 0;
+	m_next_cycle = 0;
+	m_next_pc = 0;
+	m_ac = 0;
+	m_index.clear();
+	m_block.clear();
+
+	// Write the header:
+	vector<unsigned char> header( TRACE_MAGIC,
+		TRACE_MAGIC + strlen( TRACE_MAGIC ) );
+	header.push_back( TRACE_VERSION );
+	PutFixed( header, TRACE_BLOCK_RECORDS, 4 );
+	Write( &header[0], header.size() );
+
+	// Start the writer thread:
+	m_ring = new SRetire[TRACE_RING_SIZE];
+	m_head = 0;
+	m_tail = 0;
+	m_head_cache = 0;
+	m_closing = false;
+	m_thread = thread( &CTraceWriter::Consume, this );
+
+} // Open
+
+//
+// Name:	Close
+//
+void CTraceWriter::Close() {
+
+	if( !m_file ) {
+		return;
+	}
+
+	// Let the writer thread drain the ring:
+	m_closing.store( true, memory_order_release );
+	m_thread.join();
+	delete [] m_ring;
+	m_ring = 0;
+
+	if( m_block_records ) {
+		FinishBlock();
+	}
+
+	// Write the index and the trailer:
+	const unsigned long long index_offset = m_offset;
+	vector<unsigned char> tail;
+	for( size_t i = 0; i < m_index.size(); i++ ) {
+		PutFixed( tail, m_index[i], 8 );
+	}
+	PutFixed( tail, index_offset, 8 );
+	PutFixed( tail, m_index.size() / 2, 8 );
+	PutFixed( tail, m_records, 8 );
+	tail.insert( tail.end(), TRACE_INDEX_MAGIC,
+		TRACE_INDEX_MAGIC + strlen( TRACE_INDEX_MAGIC ) + 1 );
+	Write( &tail[0], tail.size() );
+
+	if( fclose( m_file ) != 0 ) {
+		m_failed = true;
+	}
+	m_file = 0;
+
+	if( m_failed ) {
+		throw CErrorException( "", 0, "S3003",
+			"Could not write trace file", CErrorException::FATAL );
+	}
+
+} // Close
+
+//
+// Name:	Retire
+//
+void CTraceWriter::Retire( const SRetire &retire ) {
+
+	const unsigned long tail = m_tail.load( memory_order_relaxed );
+
+	// Wait for room, rereading the writer's position only when the
+	// ring looks full:
+	while( tail - m_head_cache == TRACE_RING_SIZE ) {
+		m_head_cache = m_head.load( memory_order_acquire );
+		if( tail - m_head_cache == TRACE_RING_SIZE ) {
+			this_thread::yield();
+		}
+	}
+
+	m_ring[tail & RING_MASK] = retire;
+	m_tail.store( tail + 1, memory_order_release );
+
+} // Retire
+
+//
+// Name:	Consume
+//
+void CTraceWriter::Consume() {
+
+	unsigned long head = m_head.load( memory_order_relaxed );
+
+	for( ;; ) {
+		const bool closing = m_closing.load( memory_order_acquire );
+		const unsigned long tail = m_tail.load( memory_order_acquire );
+
+		if( head == tail ) {
+			// Everything queued before Close has been seen:
+			if( closing ) {
+				break;
+			}
+			this_thread::yield();
+			continue;
+		}
+
+		while( head != tail ) {
+			Encode( m_ring[head & RING_MASK] );
+			head++;
+			if( (head & (PUBLISH_INTERVAL - 1)) == 0 ) {
+				m_head.store( head, memory_order_release );
+			}
+		}
+		m_head.store( head, memory_order_release );
+	}
+
+} // Consume
+
+//
+// Name:	Encode
+//
+void CTraceWriter::Encode( const SRetire &retire ) {
+
+	const unsigned long long start_cycle = retire.cycle - retire.cycles;
+
+	// Start a new block when this one is full, or when the record does
+	// not follow on from the previous one (the simulator was reset or
+	// its PC was changed between instructions):
+	if( m_block_records == TRACE_BLOCK_RECORDS
+		|| (m_block_records
+			&& (retire.index != m_next_index
+				|| retire.pc != m_next_pc
+				|| start_cycle != m_next_cycle)) )
+	{
+		FinishBlock();
+	}
+
+	if( m_block_records == 0 ) {
+		m_block_first = m_records;
+		m_block_cycle = start_cycle;
+		m_block_pc = retire.pc;
+		m_block_ac = m_ac;
+		for( int i = 0; i < MANO_MEMORY_SIZE; i++ ) {
+			m_words[i] = -1;
+		}
+	}
+
+	// Work out which fields differ from what the reader will predict:
+	unsigned char flags = 0;
+	if( retire.next_pc != ((retire.pc + 1) & 0xFFF) ) {
+		flags |= TRACE_NEXT_PC;
+	}
+	if( m_words[retire.pc] != retire.word ) {
+		flags |= TRACE_WORD;
+		m_words[retire.pc] = retire.word;
+	}
+	if( retire.ac != m_ac ) {
+		flags |= TRACE_AC;
+	}
+	if( retire.e ) {
+		flags |= TRACE_E;
+	}
+	if( retire.ien ) {
+		flags |= TRACE_IEN;
+	}
+	flags |= retire.store_count << TRACE_STORES_SHIFT;
+	if( retire.events ) {
+		flags |= TRACE_EVENT;
+	}
+
+	m_block.push_back( flags );
+	if( flags & TRACE_NEXT_PC ) {
+		PutVarint( m_block, retire.next_pc );
+	}
+	if( flags & TRACE_WORD ) {
+		PutVarint( m_block, retire.word );
+	}
+	if( flags & TRACE_AC ) {
+		// Zigzag the 16-bit difference so small changes either way
+		// take one byte:
+		const short delta = (short)(retire.ac - m_ac);
+		PutVarint( m_block, (unsigned short)((delta << 1) ^ (delta >> 15)) );
+	}
+	for( int i = 0; i < retire.store_count; i++ ) {
+		const short delta = (short)(retire.store_value[i] - retire.ac);
+		PutVarint( m_block, retire.store_address[i] );
+		PutVarint( m_block, (unsigned short)((delta << 1) ^ (delta >> 15)) );
+	}
+	if( flags & TRACE_EVENT ) {
+		m_block.push_back( retire.events );
+		if( retire.events & (RETIRE_INPUT | RETIRE_OUTPUT) ) {
+			m_block.push_back( retire.character );
+		}
+	}
+
+	m_ac = retire.ac;
+	m_next_index = retire.index + 1;
+	m_next_cycle = retire.cycle;
+	m_next_pc = retire.next_pc;
+	m_block_records++;
+	m_records++;
+
+} // Encode
+
+//
+// Name:	FinishBlock
+//
+void CTraceWriter::FinishBlock() {
+
+	m_index.push_back( m_block_first );
+	m_index.push_back( m_offset );
+
+	// The payload leads with the state the records are relative to:
+	m_payload.clear();
+	PutVarint( m_payload, m_block_first );
+	PutVarint( m_payload, m_block_cycle );
+	PutVarint( m_payload, m_block_pc );
+	PutVarint( m_payload, m_block_ac );
+	PutVarint( m_payload, m_block_records );
+	m_payload.insert( m_payload.end(), m_block.begin(), m_block.end() );
+
+	const unsigned char *stored = &m_payload[0];
+	size_t stored_size = m_payload.size();
+
+#ifdef MANOSIM_ZSTD
+	if( m_compress ) {
+		m_stored.resize( ZSTD_compressBound( m_payload.size() ) );
+		const size_t size = ZSTD_compress( &m_stored[0], m_stored.size(),
+			&m_payload[0], m_payload.size(), 3 );
+
+		// Keep the block raw unless compression actually helped:
+		if( !ZSTD_isError( size ) && size < m_payload.size() ) {
+			stored = &m_stored[0];
+			stored_size = size;
+		}
+	}
+#endif
+
+	vector<unsigned char> header;
+	PutFixed( header, stored_size, 4 );
+	PutFixed( header, m_payload.size(), 4 );
+	Write( &header[0], header.size() );
+	Write( stored, stored_size );
+
+	m_block.clear();
+	m_block_records = 0;
+
+} // FinishBlock
+
+//
+// Name:	Write
+//
+void CTraceWriter::Write( const void *data, size_t size ) {
+
+	if( fwrite( data, 1, size, m_file ) != size ) {
+		m_failed = true;
+	}
+	m_offset += size;
+
+} // Write
+
+//
+// Name:	PutVarint
+//
+void CTraceWriter::PutVarint( vector<unsigned char> &out,
+	unsigned long long value )
+{
+
+	while( value >= 0x80 ) {
+		out.push_back( (unsigned char)(value | 0x80) );
+		value >>= 7;
+	}
+	out.push_back( (unsigned char)value );
+
+} // PutVarint
+
+//
+// Name:	PutFixed
+//
+void CTraceWriter::PutFixed( vector<unsigned char> &out,
+	unsigned long long value, int size )
+{
+
+	for( int i = 0; i < size; i++ ) {
+		out.push_back( (unsigned char)(value >> (8 * i)) );
+	}
+
+} // PutFixed
@@ -0,0 +1,185 @@
+// File:	TraceWriter.hpp
+// Description:
+//		A monitor that records every retired instruction into a
+//		compact binary trace file (see TraceFormat.hpp).
+// Usage:
+//		Call Open, attach the object to a CManoSimulator with
+//		AddMonitor, run, then call Close.
+//
+// Notes:
+//
+//		The simulator thread only copies each SRetire record into a
+//		single-producer, single-consumer ring.  A background thread
+//		does the delta and varint encoding, the optional compression
+//		and the file writes.  When the ring is full the simulator
+//		waits, so no record is ever dropped.
+//
+//		Compression needs zstd: define MANOSIM_ZSTD and link libzstd.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include "ManoMonitor.hpp"
+#include "ManoSimulator.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Records held by the ring between the simulator and the writer thread
+// (a power of two):
+#define TRACE_RING_SIZE		65536
+
+class CTraceWriter : public CManoMonitor {
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a CTraceWriter object with no file.
+	//
+	CTraceWriter();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Closes the trace, if it is open.
+	//
+	virtual ~CTraceWriter();
+
+public:	// Trace file
+
+	//
+	// Name:	Open
+	//
+	// Description:	Creates the trace file and starts the writer thread.
+	// Arguments:	The file to create, and whether to compress blocks
+	// Exceptions:	Throws a CErrorException if the file could not be
+	//		created (S3001), or if compression was requested
+	//		without zstd support (S3002).
+	//
+	void Open( const char *filename, bool compress );
+
+	//
+	// Name:	Close
+	//
+	// Description:	Waits for the writer thread to encode every record,
+	//		then writes the last block, the index and the trailer.
+	//		Does nothing if no trace is open.
+	// Exceptions:	Throws a CErrorException if any write failed (S3003).
+	//
+	void Close();
+
+public:	// CManoMonitor
+
+	//
+	// Name:	Retire
+	//
+	// Description:	Queues a record for the writer thread.
+	//
+	virtual void Retire( const SRetire &retire );
+
+protected: // Utility functions
+
+	//
+	// Name:	Consume
+	//
+	// Description:	The writer thread: drains the ring until Close.
+	//
+	void Consume();
+
+	//
+	// Name:	Encode
+	//
+	// Description:	Appends one record to the current block, starting
+	//		a new block when the current one is full or the record
+	//		does not follow on from the previous one.
+	// Modifies:	m_block and the block state
+	//
+	void Encode( const SRetire &retire );
+
+	//
+	// Name:	FinishBlock
+	//
+	// Description:	Compresses (if enabled) and writes the current
+	//		block, and adds it to the index.
+	// Modifies:	m_block, m_index, m_offset
+	//
+	void FinishBlock();
+
+	//
+	// Name:	Write
+	//
+	// Description:	Writes bytes to the trace file, noting failures.
+	// Modifies:	m_offset, m_failed
+	//
+	void Write( const void *data, size_t size );
+
+	//
+	// Name:	PutVarint / PutFixed
+	//
+	// Description:	Append an unsigned LEB128 varint, or a fixed-size
+	//		little-endian integer, to a byte vector.
+	//
+	static void PutVarint( std::vector<unsigned char> &out,
+		unsigned long long value );
+	static void PutFixed( std::vector<unsigned char> &out,
+		unsigned long long value, int size );
+
+protected: // Attributes
+
+	FILE		*m_file;	// The trace file, or 0
+
+	bool		m_compress;	// Compress blocks with zstd
+
+	bool		m_failed;	// A write has failed
+
+	SRetire		*m_ring;	// Records waiting to be encoded
+
+	std::atomic<unsigned long> m_head;	// Next record to encode
+
+	std::atomic<unsigned long> m_tail;	// Next free ring slot
+
+	unsigned long	m_head_cache;	// Producer's view of m_head
+
+	std::atomic<bool> m_closing;	// Tells the writer thread to finish
+
+	std::thread	m_thread;	// The writer thread
+
+	std::vector<unsigned char> m_block;	// Records of the current block
+
+	std::vector<unsigned char> m_payload;	// Block header and records
+
+	std::vector<unsigned char> m_stored;	// Compressed payload
+
+	std::vector<unsigned long long> m_index; // First record, offset pairs
+
+	unsigned long long m_offset;	// Current file offset
+
+	unsigned long long m_records;	// Records written
+
+	unsigned long long m_block_first; // First record of the block
+
+	unsigned long	m_block_records; // Records in the current block
+
+	unsigned long long m_block_cycle; // Cycle before the block's first record
+
+	unsigned short	m_block_pc;	// PC of the block's first record
+
+	unsigned short	m_block_ac;	// AC the block's deltas start from
+
+	unsigned long long m_next_index; // Expected index of the next record
+
+	unsigned long long m_next_cycle; // Expected cycle before it
+
+	unsigned short	m_next_pc;	// Expected PC of the next record
+
+	unsigned short	m_ac;		// AC after the previous record
+
+	int		m_words[MANO_MEMORY_SIZE]; // Last word seen at each PC
+};
@@ -0,0 +1,450 @@
+// File:	main.cpp
+// Description:	Main module for the Mano Simulator
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <vector>
+
+#include "CallProfiler.hpp"
+#include "EventRecorder.hpp"
+#include "EventReplayer.hpp"
+#include "GdbServer.hpp"
+#include "History.hpp"
+#include "ImageLoader.hpp"
+#include "ManoSimulator.hpp"
+#include "MemoryImage.hpp"
+#include "Profiler.hpp"
+#include "ProgramFile.hpp"
+#include "SourceMap.hpp"
+#include "StreamIo.hpp"
+#include "TraceReader.hpp"
+#include "TraceWriter.hpp"
+
+using namespace std;
+
+//
+// Name:	ListTrace
+//
+// Description:	Lists records of a trace, one instruction per line.
+// Arguments:	The trace file, the first instruction to list, and the
+//		number of instructions to list
+// Returns:	The process exit code.
+//
+static int ListTrace( const char *filename, unsigned long long first,
+	unsigned long long count )
+{
+	CTraceReader reader;
+	SRetire record;
+
+	try {
+		reader.Open( filename );
+		if( count && first < reader.GetRecordCount() ) {
+			reader.Seek( first );
+		}
+
+		cout << hex << setfill( '0' );
+		for( ; count && first < reader.GetRecordCount()
+			&& reader.Next( &record ); count-- )
+		{
+			cout << dec << record.index << hex
+				<< "\t" << setw(3) << record.pc
+				<< "\t" << setw(4) << record.word
+				<< "\tAC=" << setw(4) << record.ac
+				<< " E=" << (int)record.e
+				<< " IEN=" << (int)record.ien;
+			for( int i = 0; i < record.store_count; i++ ) {
+				cout << " M[" << setw(3) << record.store_address[i]
+					<< "]=" << setw(4) << record.store_value[i];
+			}
+			if( record.events & RETIRE_INPUT ) {
+				cout << " IN=" << setw(2) << (int)record.character;
+			}
+			if( record.events & RETIRE_OUTPUT ) {
+				cout << " OUT=" << setw(2) << (int)record.character;
+			}
+			if( record.events & RETIRE_INTERRUPT ) {
+				cout << " INTERRUPT";
+			}
+			cout << endl;
+		}
+	}
+	catch( CErrorException e ) {
+		e.Display( cerr );
+		return 1;
+	}
+
+	return 0;
+
+} // ListTrace
+
+//
+// Name:	AddWatchpoints
+//
+// Description:	Watches the ranges given on the command line.
+// Arguments:	The simulator, the map to look labels up in, the ranges,
+//		and true to watch reads as well as writes
+// Exceptions:	Throws a CErrorException if a range names no label or
+//		address (S5002).
+//
+static void AddWatchpoints( CManoSimulator &simulator, const CSourceMap &map,
+	const vector<const char *> &ranges, bool read )
+{
+
+	for( size_t i = 0; i < ranges.size(); i++ ) {
+		int first, last;
+
+		if( !map.ParseRange( ranges[i], &first, &last ) ) {
+			throw CErrorException( ranges[i], 0, "S5002",
+				"Watchpoint names no label, address or range",
+				CErrorException::ERROR );
+		}
+		simulator.SetWatchpoint( (unsigned short)first,
+			(unsigned short)last, read, true );
+	}
+
+} // AddWatchpoints
+
+//
+// Name:	RunWatched
+//
+// Description:	Runs the simulator as Run does, reporting each
+//		watchpoint hit and carrying on.
+// Arguments:	The simulator, its source map, and the maximum number
+//		of instructions to execute
+//
+static void RunWatched( CManoSimulator &simulator, const CSourceMap &map,
+	unsigned long long max_instructions )
+{
+	CManoSimulator::SWatchHit hit;
+
+	for( ;; ) {
+		max_instructions -= simulator.Run( max_instructions );
+		if( !simulator.TakeWatchHit( &hit ) ) {
+			break;
+		}
+
+		const char *label = map.GetLabel( hit.address );
+		cerr << "Watchpoint: PC=" << hex << setfill( '0' )
+			<< setw(3) << hit.pc
+			<< (hit.write ? " wrote M[" : " read M[")
+			<< setw(3) << hit.address << "]";
+		if( label ) {
+			cerr << " (" << label << "+"
+				<< hit.address - map.GetLabelAddress( hit.address )
+				<< ")";
+		}
+		cerr << " " << setw(4) << hit.old_value;
+		if( hit.write ) {
+			cerr << " -> " << setw(4) << hit.new_value;
+		}
+		cerr << setfill( ' ' ) << dec << endl;
+	}
+
+} // RunWatched
+
+//
+// Name:	OpenReport
+//
+// Description:	Opens a file for a report.
+// Arguments:	The file, or - for standard output, and the stream to
+//		open it with
+// Returns:	The stream to write the report to.
+// Exceptions:	Throws a CErrorException if the file could not be
+//		created (S4002).
+//
+static ostream &OpenReport( const char *filename, ofstream &file ) {
+
+	if( strcmp( filename, "-" ) == 0 ) {
+		return cout;
+	}
+
+	file.open( filename );
+	if( !file.is_open() ) {
+		throw CErrorException( filename, 0, "S4002",
+			"Could not open profile file", CErrorException::FATAL );
+	}
+
+	return file;
+
+} // OpenReport
+
+int main( int argc, const char *argv[] ) {
+
+	char banner[] = "Mano Simulator, for the Mano machine of synth/src/main.v\n";
+
+	char syntax[] = "Syntax: manosim <image> [-a] [-i <infile>] "
+			"[-o <outfile>] [-n <instructions>]\n"
+			"        [-t <tracefile> [-z]] [-p <report>] "
+			"[-f <folded>] [-c <report>] [-k <folded>]\n"
+			"        [-g <socket> [-b <instructions>] [-B <megabytes>]] "
+			"[-w <range>] [-W <range>]\n"
+			"        [-e <eventlog> | -E <eventlog>]\n"
+			"        manosim -r <tracefile> [-s <instruction>] "
+			"[-n <instructions>]\n"
+			"\t-a\tthe image is assembly source; assemble it and "
+			"keep its labels and lines\n"
+			"\t\t(a program file from manoasm -o p= keeps them "
+			"without -a)\n"
+			"\t-i\tconnect INPR to a file, or - for standard input\n"
+			"\t-o\tconnect OUTR to a file, or - for standard output\n"
+			"\t-n\tstop after this many instructions\n"
+			"\t-g\tdebug with gdb on a socket: a port on localhost, "
+			"or a Unix socket path\n"
+			"\t-b\tinstructions between checkpoints for reverse "
+			"execution under gdb\n"
+			"\t-B\tmegabytes the checkpoints may use\n"
+			"\t-w\treport writes to a label or hex address, or a "
+			"range first:last\n"
+			"\t-W\treport reads and writes to a range\n"
+			"\t-e\trecord every answer of the device, with its "
+			"cycle, in an event log\n"
+			"\t-E\treplay an event log instead of the input (the "
+			"same image must be run)\n"
+			"\t-t\trecord an instruction trace\n"
+			"\t-z\tcompress the trace\n"
+			"\t-r\tlist the records of a trace\n"
+			"\t-s\tstart the listing at this instruction\n"
+			"\t-p\twrite a profile by label and source line\n"
+			"\t-f\twrite the profile as folded stacks\n"
+			"\t-c\twrite a call-graph profile of BSA routines\n"
+			"\t-k\twrite the call-graph profile as folded stacks\n";
+
+	const char *image = 0, *infile = 0, *outfile = 0;
+	const char *tracefile = 0, *readfile = 0;
+	const char *reportfile = 0, *foldedfile = 0;
+	const char *callfile = 0, *stackfile = 0;
+	const char *debugfile = 0, *recordfile = 0, *replayfile = 0;
+	vector<const char *> write_watches, access_watches;
+	bool compress = false, source = false;
+	unsigned long long max_instructions = (unsigned long long)-1;
+	unsigned long long start_instruction = 0;
+	unsigned long long interval = HISTORY_INTERVAL;
+	size_t budget = HISTORY_BUDGET;
+
+	// Status goes to the error stream, so output can be piped:
+	cerr << banner << endl;
+
+	// Check command-line arguments:
+	for( int arg = 1; arg < argc; arg++ ) {
+		if( strcmp( argv[arg], "-z" ) == 0 ) {
+			compress = true;
+			continue;
+		}
+		if( strcmp( argv[arg], "-a" ) == 0 ) {
+			source = true;
+			continue;
+		}
+		if( argv[arg][0] == '-' && argv[arg][1] && !argv[arg][2]
+			&& arg + 1 < argc )
+		{
+			switch( argv[arg][1] ) {
+			case 'i':
+				infile = argv[++arg];
+				continue;
+			case 'o':
+				outfile = argv[++arg];
+				continue;
+			case 'n':
+				max_instructions = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 't':
+				tracefile = argv[++arg];
+				continue;
+			case 'r':
+				readfile = argv[++arg];
+				continue;
+			case 's':
+				start_instruction = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'p':
+				reportfile = argv[++arg];
+				continue;
+			case 'f':
+				foldedfile = argv[++arg];
+				continue;
+			case 'c':
+				callfile = argv[++arg];
+				continue;
+			case 'k':
+				stackfile = argv[++arg];
+				continue;
+			case 'g':
+				debugfile = argv[++arg];
+				continue;
+			case 'b':
+				interval = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'B':
+				budget = (size_t)strtoull( argv[++arg], 0, 0 )
+					* 1024 * 1024;
+				continue;
+			case 'w':
+				write_watches.push_back( argv[++arg] );
+				continue;
+			case 'W':
+				access_watches.push_back( argv[++arg] );
+				continue;
+			case 'e':
+				recordfile = argv[++arg];
+				continue;
+			case 'E':
+				replayfile = argv[++arg];
+				continue;
+			}
+		}
+		else if( !image ) {
+			image = argv[arg];
+			continue;
+		}
+
+		cerr << syntax << endl;
+		return 1;
+	}
+	if( readfile ) {
+		return ListTrace( readfile, start_instruction, max_instructions );
+	}
+	if( !image || (replayfile && (infile || recordfile)) ) {
+		cerr << syntax << endl;
+		return 1;
+	}
+
+	CManoSimulator simulator;
+	CStreamIo io;
+	CEventRecorder recorder;
+	CEventReplayer replayer;
+	CHistory history;
+	CManoIo *device = &io;
+	CTraceWriter trace;
+	CProfiler profiler;
+	CCallProfiler calls;
+	CSourceMap map;
+	CProgramFile program;
+
+	try {
+		if( source ) {
+			CStringList list;
+			map.Assemble( image, list );
+			simulator.LoadFromList( list, image );
+		}
+		else if( program.Open( image ) ) {
+			CMemoryImage segments;
+			const char *data;
+			size_t size;
+
+			// The image, labels and lines are read where they are
+			// mapped:
+			program.GetImage( &data, &size );
+			CImageLoader::Parse( data, size, image, segments );
+			simulator.LoadImage( segments );
+			map.Load( program );
+			program.Close();
+		}
+		else {
+			simulator.LoadFromFile( image );
+		}
+		if( infile ) {
+			io.OpenInput( infile );
+		}
+		if( outfile ) {
+			io.OpenOutput( outfile );
+		}
+		if( recordfile ) {
+			recorder.Open( recordfile, &io );
+			device = &recorder;
+		}
+		else if( replayfile ) {
+			replayer.Open( replayfile, &io );
+			device = &replayer;
+		}
+
+		// Under gdb, the history stands between the simulator and
+		// the device, so a run can be gone back over:
+		if( debugfile ) {
+			history.Attach( &simulator, device, interval, budget );
+			simulator.SetIo( &history );
+		}
+		else {
+			simulator.SetIo( device );
+		}
+		if( tracefile ) {
+			trace.Open( tracefile, compress );
+			simulator.AddMonitor( &trace );
+		}
+		if( reportfile || foldedfile ) {
+			simulator.AddMonitor( &profiler );
+		}
+		if( callfile || stackfile ) {
+			simulator.AddMonitor( &calls );
+		}
+		AddWatchpoints( simulator, map, write_watches, false );
+		AddWatchpoints( simulator, map, access_watches, true );
+
+		const chrono::steady_clock::time_point start =
+			chrono::steady_clock::now();
+		if( debugfile ) {
+			CGdbServer server;
+			server.Run( debugfile, history, map, cerr );
+		}
+		else if( !write_watches.empty() || !access_watches.empty() ) {
+			RunWatched( simulator, map, max_instructions );
+		}
+		else {
+			simulator.Run( max_instructions );
+		}
+		io.Flush();
+		recorder.Close();
+		trace.Close();
+		const double seconds = chrono::duration<double>(
+			chrono::steady_clock::now() - start ).count();
+		const unsigned long long characters_in = replayfile
+			? replayer.GetCharactersIn() : io.GetCharactersIn();
+
+		// Report the final state and the throughput:
+		cerr << (simulator.IsHalted() ? "Halted" : "Stopped")
+			<< " at PC=" << hex << simulator.GetPC()
+			<< " AC=" << simulator.GetAC()
+			<< " E=" << simulator.GetE() << dec << endl
+			<< simulator.GetInstructions() << " instruction(s), "
+			<< simulator.GetCycles() << " cycle(s)" << endl
+			<< characters_in << " character(s) in, "
+			<< io.GetCharactersOut() << " character(s) out" << endl;
+
+		if( seconds > 0 ) {
+			cerr << simulator.GetInstructions() / seconds
+				<< " instructions/s, "
+				<< (characters_in + io.GetCharactersOut())
+					/ seconds
+				<< " characters/s" << endl;
+		}
+
+		if( reportfile ) {
+			ofstream file;
+			profiler.WriteReport( OpenReport( reportfile, file ), map );
+		}
+		if( foldedfile ) {
+			ofstream file;
+			profiler.WriteFolded( OpenReport( foldedfile, file ), map );
+		}
+		if( callfile ) {
+			ofstream file;
+			calls.WriteReport( OpenReport( callfile, file ), map );
+		}
+		if( stackfile ) {
+			ofstream file;
+			calls.WriteFolded( OpenReport( stackfile, file ), map );
+		}
+	}
+	catch( CErrorException e ) {
+		e.Display( cerr );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,238 @@
+// File:	RtlModel.cpp
+// Description:
+//		A clock-by-clock driver for the Verilator model of main.v.
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include "RtlModel.hpp"
+#include "ManoSimulator.hpp"
+
+#include "verilated.h"
+#include "Vrtl_top.h"
+#include "Vrtl_top___024root.h"
+
+// The cor_mem array, made public by its verilator metacomment:
+#define RTL_MEMORY( top ) \
+	((top)->rootp->rtl_top__DOT__uut__DOT__cor_mem_inst__DOT__mem)
+
+//
+// Name:	(constructor)
+//
+CRtlModel::CRtlModel() {
+
+	m_context = 0;
+	m_top = 0;
+	m_fgiset = false;
+	m_fgoset = false;
+	m_inpr = 0;
+
+	Reset();
+
+} // (constructor)
+
+//
+// Name:	(destructor)
+//
+CRtlModel::~CRtlModel() {
+
+	delete m_top;
+	delete m_context;
+
+} // (destructor)
+
+//
+// Name:	Reset
+//
+void CRtlModel::Reset() {
+
+	delete m_top;
+	delete m_context;
+
+	// Registers main.v leaves uninitialized (reg_ar, reg_memwe,
+	// reg_dro, and the memory) start at 0:
+	m_context = new VerilatedContext;
+	m_context->randReset( 0 );
+	m_top = new Vrtl_top( m_context );
+
+	m_top->clock = 0;
+	m_top->fgiset = m_fgiset;
+	m_top->fgoset = m_fgoset;
+	m_top->inpr = m_inpr;
+
+	// The first evaluation runs the initial blocks:
+	m_top->eval();
+
+	m_cycles = 0;
+	m_writes.clear();
+
+} // Reset
+
+//
+// Name:	WriteMemory
+//
+void CRtlModel::WriteMemory( unsigned short address, unsigned short value ) {
+
+	RTL_MEMORY( m_top )[address & 0xFFF] = value;
+
+} // WriteMemory
+
+//
+// Name:	ReadMemory
+//
+unsigned short CRtlModel::ReadMemory( unsigned short address ) const {
+
+	return (unsigned short)RTL_MEMORY( m_top )[address & 0xFFF];
+
+} // ReadMemory
+
+//
+// Name:	LoadFromSimulator
+//
+void CRtlModel::LoadFromSimulator( const CManoSimulator &simulator ) {
+
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		WriteMemory( (unsigned short)address,
+			simulator.ReadMemory( (unsigned short)address ) );
+	}
+
+} // LoadFromSimulator
+
+//
+// Name:	SetInputs
+//
+void CRtlModel::SetInputs( bool fgiset, bool fgoset, unsigned char inpr ) {
+
+	m_fgiset = fgiset;
+	m_fgoset = fgoset;
+	m_inpr = inpr;
+
+} // SetInputs
+
+//
+// Name:	Clock
+//
+void CRtlModel::Clock() {
+
+	// A write happens at the edge if the write flag is set before it:
+	if( m_top->memwe ) {
+		SWrite write;
+		write.address = m_top->ar;
+		write.value = m_top->dro;
+		m_writes.push_back( write );
+	}
+
+	m_top->fgiset = m_fgiset;
+	m_top->fgoset = m_fgoset;
+	m_top->inpr = GetInpr( m_cycles );
+
+	m_top->clock = 1;
+	m_top->eval();
+	m_top->clock = 0;
+	m_top->eval();
+
+	m_cycles++;
+
+} // Clock
+
+//
+// Name:	Retire
+//
+bool CRtlModel::Retire( unsigned max_cycles ) {
+
+	m_writes.clear();
+
+	for( unsigned cycle = 0; cycle < max_cycles; cycle++ ) {
+		Clock();
+		if( IsHalted() || GetState() == RTL_SC_INSTEXEC ) {
+			return true;
+		}
+	}
+
+	return false;
+
+} // Retire
+
+//
+// Name:	GetAC
+//
+unsigned short CRtlModel::GetAC() const {
+	return m_top->ac;
+} // GetAC
+
+//
+// Name:	GetE
+//
+bool CRtlModel::GetE() const {
+	return m_top->e != 0;
+} // GetE
+
+//
+// Name:	GetIEN
+//
+bool CRtlModel::GetIEN() const {
+	return m_top->ien != 0;
+} // GetIEN
+
+//
+// Name:	GetPC
+//
+unsigned short CRtlModel::GetPC() const {
+	return m_top->pc;
+} // GetPC
+
+//
+// Name:	GetState
+//
+unsigned CRtlModel::GetState() const {
+	return m_top->sc;
+} // GetState
+
+//
+// Name:	IsHalted
+//
+bool CRtlModel::IsHalted() const {
+	return m_top->s == 0;
+} // IsHalted
+
+//
+// Name:	GetOUTR
+//
+unsigned char CRtlModel::GetOUTR() const {
+	return m_top->outr;
+} // GetOUTR
+
+//
+// Name:	GetFGI
+//
+bool CRtlModel::GetFGI() const {
+	return m_top->fgi != 0;
+} // GetFGI
+
+//
+// Name:	GetFGO
+//
+bool CRtlModel::GetFGO() const {
+	return m_top->fgo != 0;
+} // GetFGO
+
+//
+// Name:	GetCycles
+//
+unsigned long long CRtlModel::GetCycles() const {
+	return m_cycles;
+} // GetCycles
+
+//
+// Name:	GetWrites
+//
+const std::vector<CRtlModel::SWrite> &CRtlModel::GetWrites() const {
+	return m_writes;
+} // GetWrites
+
+//
+// Name:	GetInpr
+//
+unsigned char CRtlModel::GetInpr( unsigned long long ) {
+	return m_inpr;
+} // GetInpr
@@ -0,0 +1,180 @@
+// File:	RtlModel.hpp
+// Description:
+//		A clock-by-clock driver for the Verilator model of main.v
+//		(built from rtl_top.v and the behavioral cor_mem.v).
+// Usage:
+//		1. create one instance of this class
+//		2. load memory with WriteMemory (or LoadFromSimulator)
+//		3. set the character bus with SetInputs
+//		4. call Clock once per clock cycle, or Retire to run to the
+//		   end of the current instruction
+//		5. to start over, call Reset, which also clears memory.
+//
+// Notes:
+//
+//		main.v has no reset input; its registers are set only by its
+//		initial block.  Reset therefore builds a fresh model.
+//
+//		Cycles are counted as rising clock edges.  The first edge
+//		takes the sequencer from par_sc_instwait to par_sc_instexec,
+//		so after Reset and one Clock the count matches
+//		CManoSimulator::GetCycles before its first instruction.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#pragma once
+
+#include <vector>
+
+class VerilatedContext;
+class Vrtl_top;
+class CManoSimulator;
+
+// main.v sequencer states used by the testbenches:
+#define RTL_SC_INSTREQ	1
+#define RTL_SC_INSTWAIT	2
+#define RTL_SC_INSTEXEC	3
+
+class CRtlModel {
+public: // Types
+
+	// A memory write seen at a rising clock edge:
+	struct SWrite {
+		unsigned short	address;
+		unsigned short	value;
+	};
+
+public:	// Construction / Destruction
+
+	//
+	// Name:	(constructor)
+	//
+	// Description:	Constructs a model with a cleared memory, idle
+	//		character flag set lines and INPR at 0.
+	//
+	CRtlModel();
+
+	//
+	// Name:	(destructor)
+	//
+	// Description:	Destroys the model.
+	//
+	virtual ~CRtlModel();
+
+public:	// Initialization
+
+	//
+	// Name:	Reset
+	//
+	// Description:	Replaces the model with a fresh one in the state of
+	//		the main.v initial block, with memory cleared.
+	// Modifies:	Everything
+	//
+	void Reset();
+
+	//
+	// Name:	WriteMemory / ReadMemory
+	//
+	// Description:	Accesses the cor_mem array directly, outside of
+	//		the clock.
+	//
+	void WriteMemory( unsigned short address, unsigned short value );
+	unsigned short ReadMemory( unsigned short address ) const;
+
+	//
+	// Name:	LoadFromSimulator
+	//
+	// Description:	Copies the whole memory of a simulator into the
+	//		model, so both can run the same image.
+	// Arguments:	The simulator to copy from
+	//
+	void LoadFromSimulator( const CManoSimulator &simulator );
+
+	//
+	// Name:	SetInputs
+	//
+	// Description:	Drives the character bus for the following clocks.
+	// Arguments:	The FGI and FGO set lines, and INPR
+	//
+	void SetInputs( bool fgiset, bool fgoset, unsigned char inpr );
+
+public:	// Execution
+
+	//
+	// Name:	Clock
+	//
+	// Description:	Runs one clock cycle, noting any memory write made
+	//		at its rising edge.
+	// Modifies:	m_cycles, m_writes
+	//
+	void Clock();
+
+	//
+	// Name:	Retire
+	//
+	// Description:	Clocks until the next instruction reaches
+	//		par_sc_instexec or the processor halts, which is when
+	//		the current one has retired.  m_writes is cleared first,
+	//		and holds the instruction's writes afterwards.
+	// Arguments:	The most cycles to run
+	// Returns:	false if the instruction did not retire in time.
+	//
+	bool Retire( unsigned max_cycles );
+
+public:	// Accessors
+
+	unsigned short GetAC() const;		// Accumulator
+	bool GetE() const;			// Extra carry flag
+	bool GetIEN() const;			// Interrupt enable flag
+	unsigned short GetPC() const;		// Program counter
+	unsigned GetState() const;		// Sequence counter
+	bool IsHalted() const;			// true once reg_s is 0
+	unsigned char GetOUTR() const;		// Character output register
+	bool GetFGI() const;			// Character input flag
+	bool GetFGO() const;			// Character output flag
+
+	//
+	// Name:	GetCycles
+	//
+	// Returns:	The number of rising clock edges since Reset.
+	//
+	unsigned long long GetCycles() const;
+
+	//
+	// Name:	GetWrites
+	//
+	// Returns:	The memory writes made since the last call to Retire
+	//		started.
+	//
+	const std::vector<SWrite> &GetWrites() const;
+
+protected: // Overridables
+
+	//
+	// Name:	GetInpr
+	//
+	// Description:	Gives the value to drive on INPR for the next
+	//		rising edge.  Override this to feed characters by cycle.
+	// Arguments:	The number of the edge (GetCycles before it)
+	// Returns:	The value set by SetInputs.
+	//
+	virtual unsigned char GetInpr( unsigned long long cycle );
+
+protected: // Attributes
+
+	VerilatedContext *m_context;	// The Verilator context
+
+	Vrtl_top	*m_top;		// The model
+
+	bool		m_fgiset;	// Driven FGI set line
+
+	bool		m_fgoset;	// Driven FGO set line
+
+	unsigned char	m_inpr;		// Driven INPR
+
+	unsigned long long m_cycles;	// Rising edges since Reset
+
+	std::vector<SWrite> m_writes;	// Writes of the current instruction
+};
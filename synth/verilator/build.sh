@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# build.sh
+#
+# Builds the Verilator testbenches for main.v:
+#
+#   rtlsim  runs a manoasm image on the RTL and reports cycles/s
+#   cosim   differential co-simulation against manosim
+#
+# Usage: ./build.sh [target...]   (default: all targets)
+#
+# Each target is built in its own obj_<target> directory.
+
+set -e
+
+cd "$(dirname "$0")"
+
+ROOT=../..
+ASM=$ROOT/manoasm/src
+SIM=$ROOT/manosim/src
+
+VERILATOR=${VERILATOR:-verilator}
+VFLAGS="--cc --exe --build -O3 -Wno-fatal -j 0 --top-module rtl_top"
+CFLAGS="-O2 -I$(pwd) -I$(pwd)/$SIM -I$(pwd)/$ASM"
+RTL="$ROOT/synth/src/main.v cor_mem.v rtl_top.v"
+
+build_rtlsim() {
+	$VERILATOR $VFLAGS --Mdir obj_rtlsim -o rtlsim -CFLAGS "$CFLAGS" \
+		$RTL RtlModel.cpp rtlsim.cpp \
+		$SIM/ManoSimulator.cpp $SIM/ManoIo.cpp $SIM/ImageLoader.cpp \
+		$SIM/MappedFile.cpp $SIM/ProgramFile.cpp \
+		$ASM/ErrorException.cpp $ASM/StringList.cpp $ASM/MemoryImage.cpp
+	cp obj_rtlsim/rtlsim .
+}
+
+build_cosim() {
+	$VERILATOR $VFLAGS --Mdir obj_cosim -o cosim -CFLAGS "$CFLAGS" \
+		$RTL RtlModel.cpp cosim.cpp \
+		$SIM/ManoSimulator.cpp $SIM/ManoIo.cpp $SIM/ImageLoader.cpp \
+		$SIM/MappedFile.cpp $SIM/ProgramFile.cpp \
+		$ASM/ErrorException.cpp $ASM/StringList.cpp $ASM/MemoryImage.cpp \
+		$ASM/ManoAssembler.cpp $ASM/SymbolTable.cpp $ASM/SourceIndex.cpp \
+		$ASM/Arena.cpp $ASM/PeepholeOptimizer.cpp $ASM/ProgramGenerator.cpp
+	cp obj_cosim/cosim .
+}
+
+if [ $# -eq 0 ]; then
+	set -- rtlsim cosim
+fi
+
+for target in "$@"; do
+	case $target in
+	rtlsim)	build_rtlsim ;;
+	cosim)	build_cosim ;;
+	*)	echo "build.sh: unknown target $target" >&2; exit 1 ;;
+	esac
+done
@@ -0,0 +1,43 @@
+//////////////////////////////////////////////////////////////////////////////
+// Mano machine project
+// 
+// cor_mem.v
+// 
+// A behavioral stand-in for the cor_mem block RAM core (cor_mem.xco), for
+// simulators that cannot use the Xilinx libraries. It has the same ports
+// and timing: one read port and one write port sharing an address,
+// registered output, and No_Read_On_Write (the output holds its value during
+// a write).
+//
+// The memory is public so a C++ testbench can load and inspect it.
+
+
+// The simulation timescale.
+`timescale 1ns / 1ps
+
+
+// Module definition.
+module cor_mem
+(
+    input      [11:0] addr, // The address of the read or write.
+    input             clk,  // The clock.
+    input      [15:0] din,  // The data to write.
+    output reg [15:0] dout, // The data read.
+    input             we    // The write enable.
+);
+
+
+// The memory array.
+reg[15:0] mem[0:4095] /*verilator public_flat_rw*/;
+
+
+// Clocked logic.
+always @(posedge clk)
+begin
+    if (we)
+        mem[addr] <= din;
+    else
+        dout <= mem[addr];
+end
+
+endmodule
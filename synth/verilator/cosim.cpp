@@ -0,0 +1,488 @@
+// File:	cosim.cpp
+// Description:
+//		Differential co-simulation of main.v (through Verilator) against
+//		the manosim instruction-level simulator.  Both run the same
+//		image in lock step, and AC, E, IEN, PC, the clock cycle count,
+//		the memory writes and the output character are compared every
+//		time an instruction retires.  The run stops at the first
+//		divergence with a short report.
+// Usage:
+//		cosim [-s <seed>] [-p <programs>] [-n <instructions>]
+//		      [-w <words>] [-g] [-b] [-v]
+//		cosim -i <image> [-n <instructions>] [-v]
+//
+//		Without -i, random programs are generated, each from its own
+//		seed (the first is -s, then counting up), so a failing program
+//		can be rerun alone with -s and -p 1.  With -g they are the
+//		assembly programs of manoasm's CProgramGenerator (labels,
+//		ORG blocks, HEX and DEC data), as manobench uses, assembled
+//		with CManoAssembler; otherwise they are random words.
+//
+// Notes:
+//
+//		main.v's BSA does not match the textbook (the direct form never
+//		leaves par_sc_instexec, and the indirect form saves its own
+//		address).  Random programs leave BSA out unless -b is given,
+//		and so do generated ones.
+//
+//		The character devices of both sides hold the flag set lines
+//		at a level chosen per program, and INPR carries a character
+//		that is a function of the clock cycle, so INP reads the same
+//		value on both sides only if the instruction timing matches.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#include "ManoAssembler.hpp"
+#include "ManoSimulator.hpp"
+#include "ProgramGenerator.hpp"
+#include "RtlModel.hpp"
+
+using namespace std;
+
+// Most clock cycles any instruction and interrupt cycle can take:
+#define MAX_INSTRUCTION_CYCLES	16
+
+// Gives the character on INPR at a clock cycle:
+static unsigned char InputCharacter( unsigned long long cycle ) {
+
+	unsigned long long x = cycle * 0x9E3779B97F4A7C15ULL;
+	x ^= x >> 29;
+	return (unsigned char)(x >> 24);
+
+} // InputCharacter
+
+//
+// The simulator's side of the character bus: set lines held at a level,
+// INPR from InputCharacter.
+//
+class CCosimIo : public CManoIo {
+public:
+	CCosimIo( bool fgiset, bool fgoset ) {
+		m_fgiset = fgiset;
+		m_fgoset = fgoset;
+		m_fgo = true;
+	}
+
+	// With its set line held, a flag cleared by INP or OUT is set
+	// again on the next clock, before anything can sample it:
+	virtual bool GetFgi( unsigned long long ) {
+		return m_fgiset;
+	}
+	virtual bool GetFgo( unsigned long long ) {
+		return m_fgoset || m_fgo;
+	}
+	virtual unsigned char Input( unsigned long long cycle ) {
+		return InputCharacter( cycle );
+	}
+	virtual void Output( unsigned char, unsigned long long ) {
+		m_fgo = false;
+	}
+
+protected:
+	bool	m_fgiset;	// FGI set line
+	bool	m_fgoset;	// FGO set line
+	bool	m_fgo;		// FGO, while its set line is low
+};
+
+//
+// The model's side of the character bus.
+//
+class CCosimModel : public CRtlModel {
+protected:
+	virtual unsigned char GetInpr( unsigned long long cycle ) {
+		return InputCharacter( cycle );
+	}
+};
+
+//
+// Keeps the record of the last instruction the simulator retired.
+//
+class CLastRetire : public CManoMonitor {
+public:
+	virtual void Retire( const SRetire &retire ) {
+		m_retire = retire;
+	}
+
+	SRetire	m_retire;
+};
+
+// A small, fast generator for random programs (xorshift64*):
+class CRandom {
+public:
+	CRandom( unsigned long long seed ) {
+		m_state = seed * 0x2545F4914F6CDD1DULL + 0x9E3779B97F4A7C15ULL;
+		if( !m_state ) {
+			m_state = 1;
+		}
+	}
+
+	unsigned Next( unsigned range ) {
+		m_state ^= m_state >> 12;
+		m_state ^= m_state << 25;
+		m_state ^= m_state >> 27;
+		return (unsigned)(((m_state * 0x2545F4914F6CDD1DULL) >> 32)
+			% range);
+	}
+
+protected:
+	unsigned long long m_state;
+};
+
+// The instructions random programs are built from:
+static const unsigned short register_words[] = {
+	0x7800, 0x7400, 0x7200, 0x7100, 0x7080, 0x7040, 0x7020,
+	0x7010, 0x7008, 0x7004, 0x7002, 0x7001,
+	0xF800, 0xF400, 0xF200, 0xF100, 0xF080, 0xF040
+};
+
+//
+// Name:	Generate
+//
+// Description:	Fills the start of memory with a random program whose
+//		memory references stay within it.
+// Arguments:	The simulator to load, the random generator, the size of
+//		the program and whether to use BSA
+//
+static void Generate( CManoSimulator &simulator, CRandom &random,
+	unsigned words, bool bsa )
+{
+	simulator.ClearMemory();
+
+	for( unsigned address = 0; address < words; address++ ) {
+		unsigned short word;
+		const unsigned kind = random.Next( 100 );
+
+		if( kind < 50 ) {
+			// A memory-reference instruction:
+			unsigned opcode;
+			do {
+				opcode = random.Next( 7 );
+			} while( opcode == 5 && !bsa );
+			word = (unsigned short)((opcode << 12)
+				| (random.Next( 2 ) ? 0x8000 : 0)
+				| random.Next( words ));
+		}
+		else if( kind < 85 ) {
+			word = register_words[random.Next(
+				sizeof(register_words) / sizeof(register_words[0]) )];
+		}
+		else if( kind < 95 ) {
+			// Data that is also a pointer into the program:
+			word = (unsigned short)random.Next( words );
+		}
+		else {
+			// Anything at all, including no-operation 7xxx words:
+			do {
+				word = (unsigned short)random.Next( 0x10000 );
+			} while( (word & 0x7000) == 0x5000 && !bsa );
+		}
+
+		simulator.WriteMemory( (unsigned short)address, word );
+	}
+
+} // Generate
+
+//
+// Name:	GenerateSource
+//
+// Description:	Fills memory with a program made by CProgramGenerator and
+//		assembled by CManoAssembler.
+// Arguments:	The simulator to load, the generator options (with the
+//		program's seed), and the generator
+// Returns:	false if the program did not assemble (the errors have
+//		been reported).
+// Exceptions:	Throws a CErrorException if the generator or the
+//		assembler fails outright.
+//
+static bool GenerateSource( CManoSimulator &simulator,
+	const SGeneratorOptions &options, CProgramGenerator &generator )
+{
+	CStringList source;
+	generator.Generate( options, source );
+
+	ostringstream text;
+	source.Dump( text );
+
+	CManoAssembler assembler( CManoAssembler::normal );
+	CStringList output;
+	ostream discard( 0 );
+	assembler.AssembleFromText( "generated", text.str(), output, discard,
+		cerr );
+	if( assembler.GetErrorCount() ) {
+		return false;
+	}
+
+	simulator.ClearMemory();
+	simulator.LoadImage( assembler.GetImage() );
+	return true;
+
+} // GenerateSource
+
+// One line of the divergence report:
+static void ReportField( const char *name, unsigned long long iss,
+	unsigned long long rtl, int width )
+{
+	cout << "  " << left << setw( 8 ) << name << right << hex
+		<< setfill( '0' ) << setw( width ) << iss << "  "
+		<< setw( width ) << rtl << setfill( ' ' ) << dec
+		<< (iss != rtl ? "  <--" : "") << endl;
+
+} // ReportField
+
+//
+// Name:	Compare
+//
+// Description:	Runs an image on both sides until it halts, diverges or
+//		executes the given number of instructions.
+// Arguments:	The loaded simulator, the model, the instruction limit
+//		and whether to list every retirement
+// Returns:	true if both sides agreed throughout.
+//
+static bool Compare( CManoSimulator &simulator, CCosimModel &model,
+	unsigned long long max_instructions, bool verbose )
+{
+	CLastRetire last;
+	simulator.AddMonitor( &last );
+
+	// Bring the model to its first par_sc_instexec:
+	model.Clock();
+
+	bool agree = true;
+	for( unsigned long long count = 0;
+		agree && count < max_instructions && !simulator.IsHalted();
+		count++ )
+	{
+		simulator.Step();
+		const SRetire &retire = last.m_retire;
+		const bool retired = model.Retire( MAX_INSTRUCTION_CYCLES );
+		const vector<CRtlModel::SWrite> &writes = model.GetWrites();
+
+		agree = retired
+			&& model.GetCycles() == simulator.GetCycles()
+			&& model.GetPC() == simulator.GetPC()
+			&& model.GetAC() == simulator.GetAC()
+			&& model.GetE() == simulator.GetE()
+			&& model.GetIEN() == simulator.GetIEN()
+			&& model.IsHalted() == simulator.IsHalted()
+			&& writes.size() == retire.store_count;
+		for( size_t i = 0; agree && i < writes.size(); i++ ) {
+			agree = writes[i].address == retire.store_address[i]
+				&& writes[i].value == retire.store_value[i];
+		}
+		if( agree && (retire.events & RETIRE_OUTPUT) ) {
+			agree = model.GetOUTR() == retire.character;
+		}
+
+		if( verbose || !agree ) {
+			cout << (agree ? "" : "Divergence at ") << "instruction "
+				<< retire.index << ": PC=" << hex << setfill( '0' )
+				<< setw( 3 ) << retire.pc << " word=" << setw( 4 )
+				<< retire.word << setfill( ' ' ) << dec << endl;
+		}
+		if( !agree ) {
+			cout << "  field   ISS   RTL" << endl;
+			if( !retired ) {
+				cout << "  RTL did not retire within "
+					<< MAX_INSTRUCTION_CYCLES << " cycles" << endl;
+			}
+			ReportField( "cycle", simulator.GetCycles(),
+				model.GetCycles(), 4 );
+			ReportField( "PC", simulator.GetPC(), model.GetPC(), 3 );
+			ReportField( "AC", simulator.GetAC(), model.GetAC(), 4 );
+			ReportField( "E", simulator.GetE(), model.GetE(), 1 );
+			ReportField( "IEN", simulator.GetIEN(), model.GetIEN(), 1 );
+			ReportField( "halted", simulator.IsHalted(),
+				model.IsHalted(), 1 );
+			ReportField( "writes", retire.store_count,
+				writes.size(), 1 );
+			for( size_t i = 0; i < writes.size()
+				|| i < retire.store_count; i++ )
+			{
+				cout << "  M[" << hex << setfill( '0' );
+				if( i < retire.store_count ) {
+					cout << setw( 3 ) << retire.store_address[i]
+						<< "]=" << setw( 4 ) << retire.store_value[i];
+				}
+				else {
+					cout << "---]=----";
+				}
+				cout << "  ";
+				if( i < writes.size() ) {
+					cout << "M[" << setw( 3 ) << writes[i].address
+						<< "]=" << setw( 4 ) << writes[i].value;
+				}
+				cout << setfill( ' ' ) << dec << endl;
+			}
+			if( retire.events & RETIRE_OUTPUT ) {
+				ReportField( "OUTR", retire.character,
+					model.GetOUTR(), 2 );
+			}
+		}
+	}
+
+	simulator.RemoveMonitor( &last );
+	return agree;
+
+} // Compare
+
+int main( int argc, const char *argv[] ) {
+
+	char syntax[] = "Syntax: cosim [-s <seed>] [-p <programs>] "
+			"[-n <instructions>] [-w <words>] [-g] [-b] [-v]\n"
+			"        cosim -i <image> [-n <instructions>] [-v]\n"
+			"\t-s\tseed of the first random program\n"
+			"\t-p\tnumber of random programs to run\n"
+			"\t-n\tinstructions to run per program\n"
+			"\t-w\tsize of the random programs, in words\n"
+			"\t-g\tgenerate assembly programs, as manobench does\n"
+			"\t-b\tuse BSA in random programs\n"
+			"\t-i\trun an image produced by manoasm instead\n"
+			"\t-v\tlist every instruction retired\n";
+
+	unsigned long long seed = 1, programs = 1000;
+	unsigned long long max_instructions = 1000;
+	unsigned words = 64;
+	bool bsa = false, verbose = false, generate = false;
+	const char *image = 0;
+
+	for( int arg = 1; arg < argc; arg++ ) {
+		if( strcmp( argv[arg], "-b" ) == 0 ) {
+			bsa = true;
+			continue;
+		}
+		if( strcmp( argv[arg], "-v" ) == 0 ) {
+			verbose = true;
+			continue;
+		}
+		if( strcmp( argv[arg], "-g" ) == 0 ) {
+			generate = true;
+			continue;
+		}
+		if( argv[arg][0] == '-' && argv[arg][1] && !argv[arg][2]
+			&& arg + 1 < argc )
+		{
+			switch( argv[arg][1] ) {
+			case 's':
+				seed = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'p':
+				programs = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'n':
+				max_instructions = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'w':
+				words = (unsigned)strtoul( argv[++arg], 0, 0 );
+				if( words < 1 || words > MANO_MEMORY_SIZE ) {
+					break;
+				}
+				continue;
+			case 'i':
+				image = argv[++arg];
+				continue;
+			}
+		}
+
+		cerr << syntax << endl;
+		return 1;
+	}
+
+	CManoSimulator simulator;
+	CCosimModel model;
+
+	// Run a single image with both set lines low, as the testbenches
+	// in synth/sim start:
+	if( image ) {
+		try {
+			simulator.LoadFromFile( image );
+		}
+		catch( CErrorException e ) {
+			e.Display( cerr );
+			return 1;
+		}
+
+		CCosimIo io( false, false );
+		simulator.SetIo( &io );
+		model.SetInputs( false, false, 0 );
+		model.Reset();
+		model.LoadFromSimulator( simulator );
+
+		if( !Compare( simulator, model, max_instructions, verbose ) ) {
+			return 1;
+		}
+		cout << "Agreed for " << simulator.GetInstructions()
+			<< " instruction(s), " << simulator.GetCycles()
+			<< " cycle(s)" << endl;
+		return 0;
+	}
+
+	SGeneratorOptions options;
+	CProgramGenerator::SetDefaults( options );
+	options.words = (int)words;
+	options.bsa = bsa;
+	CProgramGenerator generator;
+
+	const chrono::steady_clock::time_point start =
+		chrono::steady_clock::now();
+	unsigned long long instructions = 0;
+
+	for( unsigned long long program = 0; program < programs; program++ ) {
+		CRandom random( seed + program );
+		const bool fgiset = random.Next( 2 ) != 0;
+		const bool fgoset = random.Next( 2 ) != 0;
+		CCosimIo io( fgiset, fgoset );
+
+		if( generate ) {
+			options.seed = (unsigned long)(seed + program);
+			try {
+				if( !GenerateSource( simulator, options, generator ) ) {
+					cout << "Program seed " << seed + program
+						<< " did not assemble" << endl;
+					return 1;
+				}
+			}
+			catch( CErrorException e ) {
+				e.Display( cerr );
+				return 1;
+			}
+		}
+		else {
+			Generate( simulator, random, words, bsa );
+		}
+		simulator.Reset();
+		simulator.SetIo( &io );
+		model.SetInputs( fgiset, fgoset, 0 );
+		model.Reset();
+		model.LoadFromSimulator( simulator );
+
+		if( !Compare( simulator, model, max_instructions, verbose ) ) {
+			cout << "Program seed " << seed + program
+				<< " (FGI set line " << fgiset << ", FGO set line "
+				<< fgoset << ") diverged; rerun with -s "
+				<< seed + program << " -p 1 -v" << endl;
+			return 1;
+		}
+		instructions += simulator.GetInstructions();
+	}
+
+	const double seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - start ).count();
+	cout << "Agreed on " << programs << " program(s), " << instructions
+		<< " instruction(s)";
+	if( seconds > 0 ) {
+		cout << ", " << programs / seconds << " programs/s";
+	}
+	cout << endl;
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////
+// Mano machine project
+// 
+// rtl_top.v
+// 
+// The top level for Verilator builds of main.v. It passes the character
+// bus through and brings the architectural registers and the memory write
+// port out as ports, so C++ testbenches can watch instructions retire
+// without depending on Verilator's internal signal names.
+
+
+// The simulation timescale.
+`timescale 1ns / 1ps
+
+
+// Module definition.
+module rtl_top
+(
+    input         clock,  // The system clock.
+
+    input   [7:0] inpr,   // The character input bus.
+    output        fgi,    // The character input flag.
+    input         fgiset, // The character input flag set line.
+    output  [7:0] outr,   // The character output register.
+    output        fgo,    // The character output flag.
+    input         fgoset, // The character output flag set line.
+
+    output [15:0] ac,     // The accumulator.
+    output        e,      // The extra carry flag.
+    output        ien,    // The interrupt enable flag.
+    output [11:0] pc,     // The program counter.
+    output        s,      // The start/stop flag (0 once halted).
+    output  [4:0] sc,     // The sequence counter.
+    output        memwe,  // The memory write flag.
+    output [11:0] ar,     // The memory address.
+    output [15:0] dro     // The data to write to memory.
+);
+
+
+// Instantiate the processor.
+main uut
+(
+    .io_clock (clock),
+    .io_inpr  (inpr),
+    .io_fgi   (fgi),
+    .io_fgiset(fgiset),
+    .io_outr  (outr),
+    .io_fgo   (fgo),
+    .io_fgoset(fgoset)
+);
+
+
+// Bring out the registers.
+assign ac    = uut.reg_ac;
+assign e     = uut.reg_e;
+assign ien   = uut.reg_ien;
+assign pc    = uut.reg_pc;
+assign s     = uut.reg_s;
+assign sc    = uut.reg_sc;
+assign memwe = uut.reg_memwe;
+assign ar    = uut.reg_ar;
+assign dro   = uut.reg_dro;
+
+endmodule
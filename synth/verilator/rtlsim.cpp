@@ -0,0 +1,208 @@
+// File:	rtlsim.cpp
+// Description:
+//		Runs an image produced by manoasm on the Verilator model of
+//		main.v, clock by clock, and reports the RTL clock rate.  This
+//		replaces the ModelSim testbenches for regression runs.
+// Usage:
+//		rtlsim [-n <cycles>] [-i <input>] [-o <output>]
+//		       [-m <memory>] <image>
+//
+//		The image may be in either manoasm format; "@addr data" is
+//		what the ModelSim testbenches load.  The run ends when the
+//		processor halts or after the given number of clock cycles.
+//
+// Notes:
+//
+//		The character devices answer in the cycle after the
+//		processor is ready, like the devices of sim_ppar.v without
+//		their delay: when FGO is clear, OUTR is written out and the
+//		FGO set line is pulsed; when FGI is clear and input is left,
+//		the next character is put on INPR and the FGI set line is
+//		pulsed.
+//
+//		The final memory can be written with -m in the "@addr data"
+//		format, one word per line, so the results of two runs (or of
+//		rtlsim and manosim) can be compared with diff.
+//
+// Revision History:
+//		0.0:	Initial Revision
+//
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "ManoSimulator.hpp"
+#include "RtlModel.hpp"
+
+using namespace std;
+
+//
+// Name:	WriteMemory
+//
+// Description:	Writes the model's memory in the "@addr data" format.
+// Arguments:	The model, and the file to write
+// Returns:	false if the file could not be written.
+//
+static bool WriteMemory( const CRtlModel &model, const char *filename ) {
+
+	ofstream file( filename );
+	if( !file ) {
+		return false;
+	}
+
+	file << hex << setfill( '0' );
+	for( int address = 0; address < MANO_MEMORY_SIZE; address++ ) {
+		file << "@" << setw( 3 ) << address << " "
+			<< setw( 4 ) << model.ReadMemory( (unsigned short)address )
+			<< endl;
+	}
+
+	return (bool)file;
+
+} // WriteMemory
+
+int main( int argc, const char *argv[] ) {
+
+	char syntax[] = "Syntax: rtlsim [-n <cycles>] [-i <input>] "
+			"[-o <output>] [-m <memory>] <image>\n"
+			"\t-n\tmaximum number of clock cycles to run\n"
+			"\t-i\tfile to feed to the character input\n"
+			"\t-o\tfile to write the character output to\n"
+			"\t-m\tfile to write the final memory to\n";
+
+	const char *image = 0, *infile = 0, *outfile = 0, *memfile = 0;
+	unsigned long long max_cycles = 100000000ULL;
+
+	for( int arg = 1; arg < argc; arg++ ) {
+		if( argv[arg][0] == '-' && argv[arg][1] && !argv[arg][2]
+			&& arg + 1 < argc )
+		{
+			switch( argv[arg][1] ) {
+			case 'n':
+				max_cycles = strtoull( argv[++arg], 0, 0 );
+				continue;
+			case 'i':
+				infile = argv[++arg];
+				continue;
+			case 'o':
+				outfile = argv[++arg];
+				continue;
+			case 'm':
+				memfile = argv[++arg];
+				continue;
+			}
+		}
+		else if( !image ) {
+			image = argv[arg];
+			continue;
+		}
+
+		cerr << syntax << endl;
+		return 1;
+	}
+	if( !image ) {
+		cerr << syntax << endl;
+		return 1;
+	}
+
+	// manosim's loader reads both image formats:
+	CManoSimulator loader;
+	try {
+		loader.LoadFromFile( image );
+	}
+	catch( CErrorException e ) {
+		e.Display( cerr );
+		return 1;
+	}
+
+	ifstream input;
+	if( infile ) {
+		input.open( infile, ios::in | ios::binary );
+		if( !input ) {
+			cerr << "Could not open input file " << infile << endl;
+			return 1;
+		}
+	}
+	ofstream output;
+	if( outfile ) {
+		output.open( outfile, ios::out | ios::binary );
+		if( !output ) {
+			cerr << "Could not open output file " << outfile << endl;
+			return 1;
+		}
+	}
+	ostream &out = outfile ? (ostream &)output : cout;
+
+	CRtlModel model;
+	model.LoadFromSimulator( loader );
+
+	unsigned long long instructions = 0;
+	unsigned long long characters_in = 0, characters_out = 0;
+	unsigned char inpr = 0;
+	bool input_left = infile != 0;
+
+	const chrono::steady_clock::time_point start =
+		chrono::steady_clock::now();
+
+	while( !model.IsHalted() && model.GetCycles() < max_cycles ) {
+		bool fgiset = false, fgoset = false;
+
+		// OUT cleared FGO: take the character, then set FGO again:
+		if( !model.GetFGO() ) {
+			out.put( (char)model.GetOUTR() );
+			characters_out++;
+			fgoset = true;
+		}
+
+		// INP cleared FGI (or nothing was read yet): offer the next
+		// character:
+		if( !model.GetFGI() && input_left ) {
+			const int character = input.get();
+			if( character == EOF ) {
+				input_left = false;
+			}
+			else {
+				inpr = (unsigned char)character;
+				characters_in++;
+				fgiset = true;
+			}
+		}
+
+		model.SetInputs( fgiset, fgoset, inpr );
+		model.Clock();
+
+		if( model.GetState() == RTL_SC_INSTEXEC ) {
+			instructions++;
+		}
+	}
+
+	out.flush();
+	const double seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - start ).count();
+
+	if( memfile && !WriteMemory( model, memfile ) ) {
+		cerr << "Could not write memory file " << memfile << endl;
+		return 1;
+	}
+
+	// Report the final state and the clock rate:
+	cerr << (model.IsHalted() ? "Halted" : "Stopped")
+		<< " at PC=" << hex << model.GetPC()
+		<< " AC=" << model.GetAC()
+		<< " E=" << model.GetE() << dec << endl
+		<< instructions << " instruction(s), "
+		<< model.GetCycles() << " cycle(s)" << endl
+		<< characters_in << " character(s) in, "
+		<< characters_out << " character(s) out" << endl;
+
+	if( seconds > 0 ) {
+		cerr << model.GetCycles() / seconds << " cycles/s, "
+			<< instructions / seconds << " instructions/s" << endl;
+	}
+
+	return model.IsHalted() ? 0 : 2;
+}